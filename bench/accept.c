@@ -0,0 +1,368 @@
+//
+//  accept.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include "poller.h"
+#include "server.h"
+#include "tcp.h"
+#include "bench.h"
+
+//
+// connection rate: one request per connection against servers that only
+// differ in their listen options, both as a closed loop of a few clients
+// and as a burst of simultaneous connects that has to fit into the backlog
+//
+// a backlog of 0 (what the listener used to get) drops the burst's
+// handshakes, their retransmissions take a second or more
+//
+
+#define TF_BENCH_ACCEPT_PORT 5653
+#define TF_BENCH_ACCEPT_CLIENTS 4
+#define TF_BENCH_ACCEPT_DURATION_MS 300
+#if defined(TF_POLLER_EPOLL)
+#define TF_BENCH_ACCEPT_BURST 1024
+#else
+/// the server's end of the burst has to fit into select()'s fd_set, above
+/// the client's end
+#define TF_BENCH_ACCEPT_BURST ((FD_SETSIZE - 64) / 2)
+#endif
+#define TF_BENCH_ACCEPT_BURST_TIMEOUT_MS 3000
+#define TF_BENCH_ACCEPT_SMALL_BUFFER 4096
+
+static const char tf_bench_accept_request[] =
+    "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+static const char tf_bench_accept_body[] = "hello";
+
+typedef struct {
+    const char* name;
+    tf_tcp_listen_options_t options;
+    // the client sends its request with the SYN
+    bool fastopen_client;
+} tf_bench_accept_variant_t;
+
+typedef struct {
+    tf_port_t port;
+    bool fastopen;
+    uint64_t deadline;
+    uint64_t connections;
+    uint64_t failures;
+} tf_bench_accept_client_t;
+
+void tf_bench_accept_handle(tf_http_server_ref server,
+                            tf_conn_ref conn,
+                            const tf_http_request_t* request,
+                            tf_http_response_t* response,
+                            tf_data_ref meta) {
+    (void)(server);
+    (void)(conn);
+    (void)(request);
+    (void)(meta);
+    
+    response->body.data = tf_bench_accept_body;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_accept_body) - 1);
+}
+
+void* tf_bench_accept_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_accept_handle, NULL);
+    return NULL;
+}
+
+bool tf_bench_accept_start(const tf_port_t port, const tf_tcp_listen_options_t* options) {
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", port,
+                                                    TF_BENCH_ACCEPT_BURST * 2, 1);
+    pthread_t thread;
+    
+    if (!server)
+        return false;
+    
+    tf_tcp_set_listen_options(tf_http_server_get_tcp(server), options);
+    
+    // the server threads are left running, exiting takes them down
+    return (pthread_create(&thread, NULL, tf_bench_accept_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+/// new socket towards the port, connecting (non-blocking) or connected
+int tf_bench_accept_open(const tf_port_t port, const bool blocking, const bool fastopen) {
+    struct sockaddr_in address;
+    bzero(&address, sizeof(address));
+    
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+    
+    int truev = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &truev, sizeof(truev));
+    
+#ifdef TCP_FASTOPEN_CONNECT
+    // connect() returns right away, the first send goes out with the SYN
+    if (fastopen)
+        setsockopt(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &truev, sizeof(truev));
+#else
+    (void)(fastopen);
+#endif
+    
+    if (!blocking)
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    
+    if (connect(sock, (struct sockaddr*)&address, sizeof(address)) < 0 &&
+        errno != EINPROGRESS) {
+        close(sock);
+        return -1;
+    }
+    
+    return sock;
+}
+
+/// one request on a connection of its own, the server closes it
+bool tf_bench_accept_request_once(const tf_port_t port, const bool fastopen) {
+    char buffer[512];
+    int sock = tf_bench_accept_open(port, true, fastopen);
+    size_t received = 0;
+    
+    if (sock < 0)
+        return false;
+    
+    bool ok = tf_bench_send(sock, tf_bench_accept_request,
+                            sizeof(tf_bench_accept_request) - 1);
+    
+    while (ok) {
+        ssize_t chunk = recv(sock, buffer, sizeof(buffer), 0);
+        if (chunk <= 0)
+            break;
+        
+        received += (size_t)chunk;
+    }
+    
+    close(sock);
+    return (ok && received > sizeof(tf_bench_accept_body));
+}
+
+void* tf_bench_accept_client_thread(void* arg) {
+    tf_bench_accept_client_t* client = (tf_bench_accept_client_t*)arg;
+    
+    while (tf_bench_now_ns() < client->deadline) {
+        if (tf_bench_accept_request_once(client->port, client->fastopen))
+            client->connections++;
+        else
+            client->failures++;
+    }
+    
+    return NULL;
+}
+
+/// closed-loop connections per second, -1 if any of them failed
+double tf_bench_accept_rate(const tf_port_t port, const bool fastopen) {
+    tf_bench_accept_client_t clients[TF_BENCH_ACCEPT_CLIENTS];
+    pthread_t threads[TF_BENCH_ACCEPT_CLIENTS];
+    uint64_t started = tf_bench_now_ns();
+    uint64_t connections = 0;
+    uint64_t failures = 0;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_ACCEPT_CLIENTS; index++) {
+        bzero(clients + index, sizeof(tf_bench_accept_client_t));
+        
+        clients[index].port = port;
+        clients[index].fastopen = fastopen;
+        clients[index].deadline = started + TF_BENCH_ACCEPT_DURATION_MS * 1000000ull;
+        
+        pthread_create(threads + index, NULL, tf_bench_accept_client_thread, clients + index);
+    }
+    
+    for (tf_index_t index = 0; index < TF_BENCH_ACCEPT_CLIENTS; index++) {
+        pthread_join(threads[index], NULL);
+        
+        connections += clients[index].connections;
+        failures += clients[index].failures;
+    }
+    
+    if (failures > 0)
+        return -1;
+    
+    return (double)connections * 1e9 / (double)(tf_bench_now_ns() - started);
+}
+
+///
+/// milliseconds until all of TF_BENCH_ACCEPT_BURST connections opened at
+/// once have got their response (or until the timeout, with fewer of them
+/// answered), -1 on failure
+///
+double tf_bench_accept_burst(const tf_port_t port, tf_index_t* answeredp) {
+    static struct pollfd fds[TF_BENCH_ACCEPT_BURST];
+    static bool sent[TF_BENCH_ACCEPT_BURST];
+    char buffer[512];
+    uint64_t started = tf_bench_now_ns();
+    tf_index_t open = 0;
+    bool ok = true;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_ACCEPT_BURST; index++) {
+        fds[index].fd = tf_bench_accept_open(port, false, false);
+        fds[index].events = POLLOUT;
+        sent[index] = false;
+        
+        if (fds[index].fd < 0)
+            ok = false;
+        else
+            open++;
+    }
+    
+    uint64_t deadline = started + TF_BENCH_ACCEPT_BURST_TIMEOUT_MS * 1000000ull;
+    
+    while (ok && open > 0 && tf_bench_now_ns() < deadline) {
+        if (poll(fds, TF_BENCH_ACCEPT_BURST, 100) < 0)
+            break;
+        
+        for (tf_index_t index = 0; index < TF_BENCH_ACCEPT_BURST; index++) {
+            struct pollfd* entry = fds + index;
+            
+            if (entry->fd < 0 || !entry->revents)
+                continue;
+            
+            if (!sent[index] && (entry->revents & POLLOUT)) {
+                // connected, the request fits into the socket buffer
+                ok = (send(entry->fd, tf_bench_accept_request,
+                           sizeof(tf_bench_accept_request) - 1, 0) > 0);
+                
+                sent[index] = true;
+                entry->events = POLLIN;
+                continue;
+            }
+            
+            ssize_t chunk = recv(entry->fd, buffer, sizeof(buffer), 0);
+            if (chunk > 0)
+                continue;
+            
+            ok = (chunk == 0 || errno == EAGAIN);
+            
+            if (chunk == 0) {
+                close(entry->fd);
+                entry->fd = -1;
+                open--;
+            }
+        }
+    }
+    
+    for (tf_index_t index = 0; index < TF_BENCH_ACCEPT_BURST; index++) {
+        if (fds[index].fd >= 0)
+            close(fds[index].fd);
+    }
+    
+    *answeredp = TF_BENCH_ACCEPT_BURST - open;
+    
+    return (ok ? (double)(tf_bench_now_ns() - started) / 1e6 : -1);
+}
+
+/// whether the system lets servers take data with the SYN
+bool tf_bench_accept_has_fastopen(void) {
+    FILE* file = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+    int flags = 0;
+    
+    if (!file)
+        return false;
+    
+    if (fscanf(file, "%d", &flags) != 1)
+        flags = 0;
+    
+    fclose(file);
+    
+    // client and server support
+    return ((flags & 3) == 3);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_bench_accept_variant_t variants[6];
+    tf_index_t count = sizeof(variants) / sizeof(variants[0]);
+    
+    for (tf_index_t index = 0; index < count; index++) {
+        variants[index].fastopen_client = false;
+        tf_tcp_get_default_listen_options(&variants[index].options);
+    }
+    
+    variants[0].name = "defaults";
+    variants[1].name = "backlog 0";
+    variants[1].options.backlog = 0;
+    variants[2].name = "defer accept";
+    variants[2].options.defer_accept = 1;
+    variants[3].name = "fast open";
+    variants[3].options.fastopen = 256;
+    variants[3].fastopen_client = true;
+    variants[4].name = "Nagle";
+    variants[4].options.nodelay = false;
+    variants[5].name = "4 KiB buffers";
+    variants[5].options.receive_buffer = TF_BENCH_ACCEPT_SMALL_BUFFER;
+    variants[5].options.send_buffer = TF_BENCH_ACCEPT_SMALL_BUFFER;
+    
+    if (tf_bench_raise_fd_limit() < TF_BENCH_ACCEPT_BURST * 3) {
+        fprintf(stderr, "not enough file descriptors\n");
+        return 1;
+    }
+    
+    bool fastopen = tf_bench_accept_has_fastopen();
+    tf_index_t defaults_answered = 0;
+    bool ok = true;
+    
+    for (tf_index_t index = 0; ok && index < count; index++) {
+        tf_bench_accept_variant_t* variant = variants + index;
+        tf_port_t port = (tf_port_t)(TF_BENCH_ACCEPT_PORT + index);
+        char param[64];
+        
+        if (variant->fastopen_client && !fastopen) {
+            TF_BENCH_SKIP("accept", variant->name, "net.ipv4.tcp_fastopen is not 3");
+            continue;
+        }
+        
+        if (!tf_bench_accept_start(port, &variant->options)) {
+            fprintf(stderr, "cannot start the %s server\n", variant->name);
+            return 1;
+        }
+        
+        tf_index_t answered = 0;
+        double rate = tf_bench_accept_rate(port, variant->fastopen_client);
+        double burst = tf_bench_accept_burst(port, &answered);
+        
+        ok = (rate > 0 && burst > 0);
+        
+        if (index == 0)
+            defaults_answered = answered;
+        
+        snprintf(param, sizeof(param), "%s, rate", variant->name);
+        TF_BENCH_REPORT("accept", param, rate, "conn/s");
+        snprintf(param, sizeof(param), "%s, burst of %u", variant->name,
+                 TF_BENCH_ACCEPT_BURST);
+        TF_BENCH_REPORT("accept", param, burst, "ms");
+        snprintf(param, sizeof(param), "%s, burst answered", variant->name);
+        TF_BENCH_REPORT("accept", param, answered, "conns");
+    }
+    
+    if (!ok) {
+        fprintf(stderr, "connections failed\n");
+        return 1;
+    }
+    
+    // the whole burst has to fit into the default backlog
+    if (defaults_answered < TF_BENCH_ACCEPT_BURST) {
+        fprintf(stderr, "connection burst doesn't fit into the backlog\n");
+        return 1;
+    }
+    
+    return 0;
+}
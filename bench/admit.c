@@ -0,0 +1,312 @@
+//
+//  admit.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "poller.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// admission control under overload: a server whose deferred handler can
+// take about TF_BENCH_ADMIT_CAPACITY requests per second gets hit by
+// TF_BENCH_ADMIT_CONNECTIONS closed-loop keep-alive connections, ten times
+// what it can answer in time, with every limit of admit.h in turn
+//
+// goodput is the responses per second that came back within
+// TF_BENCH_ADMIT_DEADLINE, anything later is as good as lost to whoever
+// asked; without admission control all of them queue up and end up late,
+// refusing the ones that waited too long has to keep the goodput up, the
+// bench fails if it drops under half the capacity
+//
+
+#define TF_BENCH_ADMIT_PORT 5654
+#define TF_BENCH_ADMIT_THREADS 2
+/// how long the deferred handler blocks
+#define TF_BENCH_ADMIT_WORK_US 2000
+#define TF_BENCH_ADMIT_CAPACITY (TF_BENCH_ADMIT_THREADS * 1000000 / TF_BENCH_ADMIT_WORK_US)
+#define TF_BENCH_ADMIT_CONNECTIONS 200
+/// milliseconds
+#define TF_BENCH_ADMIT_DEADLINE 100
+#define TF_BENCH_ADMIT_DURATION 1.0
+/// responses are tiny, they always come in one piece
+#define TF_BENCH_ADMIT_RESPONSE_SIZE 512
+
+typedef struct {
+    const char* name;
+    tf_admit_options_t options;
+} tf_bench_admit_variant_t;
+
+typedef struct {
+    tf_socket_t sock;
+    // when the request in flight was sent
+    uint64_t started_at;
+    char response[TF_BENCH_ADMIT_RESPONSE_SIZE];
+    tf_index_t length;
+} tf_bench_admit_conn_t;
+
+typedef struct {
+    uint64_t in_time;
+    uint64_t late;
+    uint64_t throttled;
+    uint64_t shed;
+    uint64_t errors;
+} tf_bench_admit_result_t;
+
+static const char tf_bench_worked[] = "worked";
+static const char tf_bench_request[] = "GET /work HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+//
+// in-process server
+//
+
+void tf_bench_admit_work(const tf_http_request_t* request,
+                         tf_http_response_t* response,
+                         tf_arena_ref arena,
+                         tf_data_ref meta) {
+    (void)(request);
+    (void)(arena);
+    (void)(meta);
+    
+    struct timespec pause = { 0, TF_BENCH_ADMIT_WORK_US * 1000l };
+    nanosleep(&pause, NULL);
+    
+    response->body.data = tf_bench_worked;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_worked) - 1);
+}
+
+void tf_bench_admit_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(meta);
+    
+    if (!tf_http_server_defer(server, conn, tf_bench_admit_work, NULL))
+        tf_bench_admit_work(request, response, NULL, NULL);
+}
+
+void* tf_bench_admit_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_admit_handle, NULL);
+    return NULL;
+}
+
+bool tf_bench_admit_start(const tf_port_t port, const tf_admit_options_t* options) {
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", port,
+                                                    TF_BENCH_ADMIT_CONNECTIONS, 1);
+    pthread_t thread;
+    
+    if (!server)
+        return false;
+    
+    tf_http_server_set_pool_size(server, TF_BENCH_ADMIT_THREADS);
+    tf_http_server_set_admission(server, options);
+    
+    // the server threads are left running, exiting takes them down
+    return (pthread_create(&thread, NULL, tf_bench_admit_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+//
+// client
+//
+
+/// (re)connects and sends the next request, false if the server is gone
+bool tf_bench_admit_open(tf_poller_ref poller, tf_bench_admit_conn_t* conn,
+                         const tf_port_t port) {
+    conn->sock = tf_bench_connect(port);
+    conn->length = 0;
+    
+    if (conn->sock < 0)
+        return false;
+    
+    if (fcntl(conn->sock, F_SETFL, fcntl(conn->sock, F_GETFL, 0) | O_NONBLOCK) < 0 ||
+        !tf_poller_add(poller, conn->sock, TF_POLLER_READABLE)) {
+        close(conn->sock);
+        conn->sock = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+void tf_bench_admit_close(tf_poller_ref poller, tf_bench_admit_conn_t* conn) {
+    tf_poller_remove(poller, conn->sock);
+    close(conn->sock);
+    conn->sock = -1;
+}
+
+bool tf_bench_admit_send(tf_bench_admit_conn_t* conn) {
+    // an idle connection has nothing queued, the request always fits
+    ssize_t sent = send(conn->sock, tf_bench_request, sizeof(tf_bench_request) - 1,
+                        MSG_NOSIGNAL);
+    
+    conn->started_at = tf_bench_now_ns();
+    conn->length = 0;
+    
+    return (sent == (ssize_t)(sizeof(tf_bench_request) - 1));
+}
+
+///
+/// takes in whatever arrived and counts a complete response, false if the
+/// connection has to be opened again (refused, closed or broken)
+///
+bool tf_bench_admit_receive(tf_bench_admit_conn_t* conn, tf_bench_admit_result_t* result) {
+    ssize_t received = recv(conn->sock, conn->response + conn->length,
+                            TF_BENCH_ADMIT_RESPONSE_SIZE - conn->length, 0);
+    
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return true;
+    
+    if (received <= 0) {
+        result->errors++;
+        return false;
+    }
+    
+    conn->length += (tf_index_t)received;
+    
+    char* end = memmem(conn->response, conn->length, "\r\n\r\n", 4);
+    char* field = memmem(conn->response, conn->length, "Content-Length: ", 16);
+    
+    if (!end || !field || field > end ||
+        (tf_index_t)(end + 4 - conn->response) + strtoul(field + 16, NULL, 10) > conn->length) {
+        if (conn->length < TF_BENCH_ADMIT_RESPONSE_SIZE)
+            return true;
+        
+        result->errors++;
+        return false;
+    }
+    
+    int status = (conn->length > 12 ? atoi(conn->response + 9) : 0);
+    uint64_t latency = tf_bench_now_ns() - conn->started_at;
+    
+    if (status == 200) {
+        if (latency <= TF_BENCH_ADMIT_DEADLINE * 1000000ull)
+            result->in_time++;
+        else
+            result->late++;
+        
+        return tf_bench_admit_send(conn);
+    }
+    
+    // the refusals close the connection
+    if (status == 429)
+        result->throttled++;
+    else if (status == 503)
+        result->shed++;
+    else
+        result->errors++;
+    
+    return false;
+}
+
+bool tf_bench_admit_run(const tf_port_t port, tf_bench_admit_result_t* result) {
+    tf_bench_admit_conn_t* conns = calloc(TF_BENCH_ADMIT_CONNECTIONS,
+                                          sizeof(tf_bench_admit_conn_t));
+    tf_poller_ref poller = tf_poller_init();
+    tf_poller_event_t events[TF_POLLER_MAX_EVENTS];
+    bool success = (conns && poller);
+    
+    bzero(result, sizeof(tf_bench_admit_result_t));
+    
+    for (tf_index_t index = 0; success && index < TF_BENCH_ADMIT_CONNECTIONS; index++)
+        success = (tf_bench_admit_open(poller, &conns[index], port) &&
+                   tf_bench_admit_send(&conns[index]));
+    
+    uint64_t ends = tf_bench_now_ns() + (uint64_t)(TF_BENCH_ADMIT_DURATION * 1e9);
+    
+    while (success && tf_bench_now_ns() < ends) {
+        int count = tf_poller_wait(poller, events, TF_POLLER_MAX_EVENTS, 10);
+        
+        for (int event = 0; success && event < count; event++) {
+            tf_bench_admit_conn_t* conn = NULL;
+            
+            for (tf_index_t index = 0; index < TF_BENCH_ADMIT_CONNECTIONS && !conn; index++) {
+                if (conns[index].sock == events[event].socket)
+                    conn = &conns[index];
+            }
+            
+            if (!conn || tf_bench_admit_receive(conn, result))
+                continue;
+            
+            // a refused client comes right back, like a retrying one would
+            tf_bench_admit_close(poller, conn);
+            success = (tf_bench_admit_open(poller, conn, port) && tf_bench_admit_send(conn));
+        }
+    }
+    
+    for (tf_index_t index = 0; conns && index < TF_BENCH_ADMIT_CONNECTIONS; index++) {
+        if (conns[index].sock >= 0)
+            tf_bench_admit_close(poller, &conns[index]);
+    }
+    
+    tf_poller_release(poller);
+    free(conns);
+    
+    return success;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_bench_admit_variant_t variants[4];
+    tf_index_t count = sizeof(variants) / sizeof(variants[0]);
+    
+    for (tf_index_t index = 0; index < count; index++)
+        tf_admit_get_default_options(&variants[index].options);
+    
+    variants[0].name = "none";
+    variants[1].name = "queue delay 20 ms";
+    variants[1].options.max_queue_delay = 20;
+    variants[2].name = "concurrency 32";
+    variants[2].options.max_concurrency = 32;
+    // every connection comes from 127.0.0.1, so this one is a global rate
+    variants[3].name = "client rate";
+    variants[3].options.client_rate = TF_BENCH_ADMIT_CAPACITY * 8 / 10;
+    variants[3].options.client_burst = TF_BENCH_ADMIT_CAPACITY / 20;
+    
+    tf_bench_raise_fd_limit();
+    
+    double goodput[4] = { 0 };
+    bool ok = true;
+    
+    for (tf_index_t index = 0; ok && index < count; index++) {
+        tf_port_t port = (tf_port_t)(TF_BENCH_ADMIT_PORT + index);
+        tf_bench_admit_result_t result;
+        char param[64];
+        
+        ok = (tf_bench_admit_start(port, &variants[index].options) &&
+              tf_bench_admit_run(port, &result));
+        
+        goodput[index] = (double)result.in_time / TF_BENCH_ADMIT_DURATION;
+        
+        snprintf(param, sizeof(param), "goodput, %s", variants[index].name);
+        TF_BENCH_REPORT("admit", param, goodput[index], "req/s");
+        snprintf(param, sizeof(param), "late, %s", variants[index].name);
+        TF_BENCH_REPORT("admit", param, (double)result.late / TF_BENCH_ADMIT_DURATION,
+                        "req/s");
+        snprintf(param, sizeof(param), "refused, %s", variants[index].name);
+        TF_BENCH_REPORT("admit", param,
+                        (double)(result.throttled + result.shed) / TF_BENCH_ADMIT_DURATION,
+                        "req/s");
+    }
+    
+    // only the queue delay limit knows what is too late, it has to save
+    // most of the capacity
+    if (!ok || goodput[1] < TF_BENCH_ADMIT_CAPACITY / 2) {
+        fprintf(stderr, "shedding does not keep the goodput up\n");
+        return 1;
+    }
+    
+    return 0;
+}
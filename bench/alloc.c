@@ -0,0 +1,169 @@
+//
+//  alloc.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "arena.h"
+#include "conn.h"
+#include "hash.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// counts malloc/free calls made while an in-process server answers
+// keep-alive requests, a warmed-up server must not make any, the handler
+// puts its per-request objects (a header hash, the body) into the
+// connection arena
+//
+// the allocator functions are wrapped at link time (-Wl,--wrap=...), so
+// only calls from tinyhttp itself and this file are counted
+//
+
+#define TF_BENCH_ALLOC_PORT 5645
+#define TF_BENCH_ALLOC_WARMUP 1000
+#define TF_BENCH_ALLOC_REQUESTS 20000
+
+static uint64_t tf_bench_alloc_calls;
+static uint64_t tf_bench_free_calls;
+
+static tf_arena_stats_t tf_bench_arena_stats;
+
+static const char tf_bench_request[] =
+    "GET /items/42?full=1 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: tinyhttp-bench\r\n"
+    "Accept: */*\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "X-Request-Identifier-That-Is-Long: 0123456789abcdef\r\n"
+    "\r\n";
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* data, size_t size);
+void __real_free(void* data);
+
+void* __wrap_malloc(size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* data, size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_realloc(data, size);
+}
+
+void __wrap_free(void* data) {
+    if (data)
+        __atomic_add_fetch(&tf_bench_free_calls, 1, __ATOMIC_RELAXED);
+    
+    __real_free(data);
+}
+
+void tf_bench_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    (void)(server);
+    (void)(meta);
+    
+    tf_arena_ref arena = tf_conn_get_arena(conn);
+    tf_hash_ref headers = tf_hash_init_in_arena(arena);
+    
+    // the kind of request-scoped objects a real handler makes
+    for (tf_index_t index = 0; index < request->header_count; index++) {
+        const tf_http_header_t* header = request->headers + index;
+        
+        tf_hash_set(headers, tf_arena_strndup(arena, header->name.data,
+                                              header->name.length),
+                    tf_arena_strndup(arena, header->value.data, header->value.length),
+                    NULL);
+    }
+    
+    const char* agent = tf_hash_get(headers, "User-Agent");
+    char* body = tf_arena_alloc(arena, 256);
+    int length = snprintf(body, 256, "%.*s for %s, %u headers",
+                          (int)request->path.length, request->path.data,
+                          (agent ? agent : "nobody"), tf_hash_get_count(headers));
+    
+    response->body.data = body;
+    response->body.length = (tf_index_t)(length > 0 ? length : 0);
+    
+    // only read by the main thread after the run
+    tf_arena_get_stats(arena, &tf_bench_arena_stats);
+}
+
+void* tf_bench_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_handle, NULL);
+    return NULL;
+}
+
+bool tf_bench_alloc_run(int sock, const tf_index_t count) {
+    for (tf_index_t index = 0; index < count; index++) {
+        if (!tf_bench_send(sock, tf_bench_request, sizeof(tf_bench_request) - 1) ||
+            !tf_bench_receive(sock, 1))
+            return false;
+    }
+    
+    return true;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", TF_BENCH_ALLOC_PORT,
+                                                    16, 1);
+    pthread_t thread;
+    
+    if (!server || pthread_create(&thread, NULL, tf_bench_server_thread, server) != 0 ||
+        !tf_bench_wait_for_port(TF_BENCH_ALLOC_PORT)) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    int sock = tf_bench_connect(TF_BENCH_ALLOC_PORT);
+    
+    // fills the buffer pool, the arena chunks and all the lazy tables
+    if (sock < 0 || !tf_bench_alloc_run(sock, TF_BENCH_ALLOC_WARMUP)) {
+        fprintf(stderr, "warm-up failed\n");
+        return 1;
+    }
+    
+    uint64_t allocs = __atomic_load_n(&tf_bench_alloc_calls, __ATOMIC_RELAXED);
+    uint64_t frees = __atomic_load_n(&tf_bench_free_calls, __ATOMIC_RELAXED);
+    uint64_t started = tf_bench_now_ns();
+    
+    bool completed = tf_bench_alloc_run(sock, TF_BENCH_ALLOC_REQUESTS);
+    
+    double elapsed = (double)(tf_bench_now_ns() - started);
+    
+    allocs = __atomic_load_n(&tf_bench_alloc_calls, __ATOMIC_RELAXED) - allocs;
+    frees = __atomic_load_n(&tf_bench_free_calls, __ATOMIC_RELAXED) - frees;
+    
+    close(sock);
+    
+    TF_BENCH_REPORT("alloc", "malloc calls per request",
+                    (double)allocs / TF_BENCH_ALLOC_REQUESTS, "");
+    TF_BENCH_REPORT("alloc", "free calls per request",
+                    (double)frees / TF_BENCH_ALLOC_REQUESTS, "");
+    TF_BENCH_REPORT("alloc", "arena peak", tf_bench_arena_stats.peak, "B");
+    TF_BENCH_REPORT("alloc", "arena chunks", tf_bench_arena_stats.chunk_count, "");
+    TF_BENCH_REPORT("alloc", "latency", elapsed / TF_BENCH_ALLOC_REQUESTS / 1000.0,
+                    "us/req");
+    
+    // the server thread is left running, exiting takes it down
+    return ((completed && allocs == 0 && frees == 0) ? 0 : 1);
+}
@@ -0,0 +1,266 @@
+//
+//  bench.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "types.h"
+#include "bufpool.h"
+
+//
+// tiny helpers shared by all the benchmarks in this directory
+//
+
+/// monotonic clock in nanoseconds
+static inline uint64_t tf_bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+/// raises the soft descriptor limit as far as allowed, returns the new limit
+static inline tf_index_t tf_bench_raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+        return 0;
+    
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+    
+    return (tf_index_t)rl.rlim_cur;
+}
+
+//
+// loopback HTTP client for the benchmarks that run a server in-process
+//
+
+/// blocking connection to the port on 127.0.0.1, -1 on failure
+static inline int tf_bench_connect(const tf_port_t port) {
+    struct sockaddr_in address;
+    bzero(&address, sizeof(address));
+    
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+    
+    int truev = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &truev, sizeof(truev));
+    
+    if (connect(sock, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(sock);
+        return -1;
+    }
+    
+    return sock;
+}
+
+/// waits up to a second for a server to start listening on the port
+static inline bool tf_bench_wait_for_port(const tf_port_t port) {
+    for (tf_index_t attempt = 0; attempt < 100; attempt++) {
+        int probe = tf_bench_connect(port);
+        
+        if (probe >= 0) {
+            close(probe);
+            return true;
+        }
+        
+        usleep(10000);
+    }
+    
+    return false;
+}
+
+static inline bool tf_bench_send(int sock, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(sock, data, length, 0);
+        if (sent <= 0)
+            return false;
+        
+        data += sent;
+        length -= (size_t)sent;
+    }
+    
+    return true;
+}
+
+/// reads exactly count complete responses, false on EOF or garbage, one
+/// without Content-Length (like a 304) has no body
+static inline bool tf_bench_receive(int sock, tf_index_t count) {
+    static char buffer[65536];
+    size_t length = 0;
+    
+    while (count > 0) {
+        ssize_t received = recv(sock, buffer + length, sizeof(buffer) - length, 0);
+        if (received <= 0)
+            return false;
+        
+        length += (size_t)received;
+        
+        // take out all the responses that are complete by now
+        while (count > 0) {
+            char* end = memmem(buffer, length, "\r\n\r\n", 4);
+            char* field = memmem(buffer, length, "Content-Length: ", 16);
+            
+            if (!end)
+                break;
+            
+            size_t total = (size_t)(end + 4 - buffer);
+            if (field && field < end)
+                total += (size_t)strtoul(field + 16, NULL, 10);
+            if (total > length)
+                break;
+            
+            memmove(buffer, buffer + total, length - total);
+            length -= total;
+            count--;
+        }
+        
+        if (length == sizeof(buffer))
+            return false;
+    }
+    
+    return true;
+}
+
+//
+// pooled buffer memory watched from a thread of its own while something runs
+//
+
+typedef struct {
+    pthread_t thread;
+    volatile bool sampling;
+    uint64_t peak;
+} tf_bench_sampler_t;
+
+static inline void* tf_bench_sampler_thread(void* arg) {
+    tf_bench_sampler_t* sampler = (tf_bench_sampler_t*)arg;
+    
+    while (sampler->sampling) {
+        tf_bufpool_stats_t stats;
+        tf_bufpool_get_stats(&stats);
+        
+        if (stats.outstanding_bytes > sampler->peak)
+            sampler->peak = stats.outstanding_bytes;
+        
+        usleep(200);
+    }
+    
+    return NULL;
+}
+
+/// starts watching, false if the thread cannot be started
+static inline bool tf_bench_sampler_start(tf_bench_sampler_t* sampler) {
+    sampler->peak = 0;
+    sampler->sampling = true;
+    
+    return (pthread_create(&sampler->thread, NULL, tf_bench_sampler_thread, sampler) == 0);
+}
+
+/// stops watching, returns the most outstanding_bytes seen at once
+static inline uint64_t tf_bench_sampler_stop(tf_bench_sampler_t* sampler) {
+    sampler->sampling = false;
+    pthread_join(sampler->thread, NULL);
+    
+    return sampler->peak;
+}
+
+//
+// results
+//
+// every measurement is printed as a line of text and, if TF_BENCH_JSON
+// names a file, appended to it as a JSON object on a line of its own
+// (tagged with TF_BENCH_COMMIT if set), so that runs on different commits
+// can be compared with bench_compare
+//
+
+static inline void tf_bench_json_string(FILE* file, const char* value) {
+    fputc('"', file);
+    
+    for (; *value; value++) {
+        if (*value == '"' || *value == '\\')
+            fprintf(file, "\\%c", *value);
+        else if ((unsigned char)*value < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char)*value);
+        else
+            fputc(*value, file);
+    }
+    
+    fputc('"', file);
+}
+
+/// skipped is the reason the value has not been measured, NULL if it has
+static inline void tf_bench_print(const char* bench, const char* param, const double value,
+                                   const char* unit, const char* skipped) {
+    static FILE* json = NULL;
+    static bool opened = false;
+    
+    if (skipped)
+        printf("%-20s %-28s %14s (%s)\n", bench, param, "skipped", skipped);
+    else
+        printf("%-20s %-28s %14.1f %s\n", bench, param, value, unit);
+    
+    if (!opened) {
+        const char* path = getenv("TF_BENCH_JSON");
+        
+        json = (path && *path ? fopen(path, "a") : NULL);
+        opened = true;
+    }
+    
+    if (!json)
+        return;
+    
+    const char* commit = getenv("TF_BENCH_COMMIT");
+    
+    fputc('{', json);
+    
+    if (commit && *commit) {
+        fputs("\"commit\": ", json);
+        tf_bench_json_string(json, commit);
+        fputs(", ", json);
+    }
+    
+    fputs("\"bench\": ", json);
+    tf_bench_json_string(json, bench);
+    fputs(", \"param\": ", json);
+    tf_bench_json_string(json, param);
+    
+    if (skipped) {
+        fputs(", \"value\": null, \"skipped\": ", json);
+        tf_bench_json_string(json, skipped);
+    } else {
+        fprintf(json, ", \"value\": %.10g, \"unit\": ", value);
+        tf_bench_json_string(json, unit);
+    }
+    
+    fputs("}\n", json);
+    fflush(json);
+}
+
+/// prints a single measurement line
+#define TF_BENCH_REPORT(bench, param, value, unit) \
+    tf_bench_print((bench), (param), (double)(value), (unit), NULL)
+
+/// prints a "not measured" line
+#define TF_BENCH_SKIP(bench, param, why) \
+    tf_bench_print((bench), (param), 0, "", (why))
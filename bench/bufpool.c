@@ -0,0 +1,82 @@
+//
+//  bufpool.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bufpool.h"
+#include "bench.h"
+
+//
+// buffer pool acquire/release cost compared to malloc/free, and a check
+// that a warmed-up pool doesn't miss anymore
+//
+
+#define TF_BENCH_POOL_ROUNDS 2000000
+/// buffers held at once, like a few busy connections
+#define TF_BENCH_POOL_DEPTH 8
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_buffer_ref held[TF_BENCH_POOL_DEPTH];
+    tf_bufpool_stats_t before;
+    tf_bufpool_stats_t after;
+    
+    // warm up
+    for (tf_index_t index = 0; index < TF_BENCH_POOL_DEPTH; index++)
+        held[index] = tf_buffer_acquire(TF_BUFPOOL_MIN_SIZE);
+    for (tf_index_t index = 0; index < TF_BENCH_POOL_DEPTH; index++)
+        tf_buffer_release(held[index]);
+    
+    tf_bufpool_get_stats(&before);
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_POOL_ROUNDS; round++) {
+        tf_index_t slot = round % TF_BENCH_POOL_DEPTH;
+        
+        if (round >= TF_BENCH_POOL_DEPTH)
+            tf_buffer_release(held[slot]);
+        
+        held[slot] = tf_buffer_acquire(TF_BUFPOOL_MIN_SIZE);
+        tf_buffer_get_data(held[slot])[0] = (char)round;
+    }
+    
+    double pooled = (double)(tf_bench_now_ns() - started) / TF_BENCH_POOL_ROUNDS;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_POOL_DEPTH; index++)
+        tf_buffer_release(held[index]);
+    
+    tf_bufpool_get_stats(&after);
+    
+    // same pattern against the system allocator
+    char* raw[TF_BENCH_POOL_DEPTH];
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_POOL_ROUNDS; round++) {
+        tf_index_t slot = round % TF_BENCH_POOL_DEPTH;
+        
+        if (round >= TF_BENCH_POOL_DEPTH)
+            free(raw[slot]);
+        
+        raw[slot] = malloc(TF_BUFPOOL_MIN_SIZE);
+        raw[slot][0] = (char)round;
+    }
+    
+    double system = (double)(tf_bench_now_ns() - started) / TF_BENCH_POOL_ROUNDS;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_POOL_DEPTH; index++)
+        free(raw[index]);
+    
+    TF_BENCH_REPORT("bufpool", "acquire+release", pooled, "ns/op");
+    TF_BENCH_REPORT("bufpool", "malloc+free", system, "ns/op");
+    TF_BENCH_REPORT("bufpool", "steady-state misses", after.misses - before.misses, "");
+    TF_BENCH_REPORT("bufpool", "outstanding bytes", after.outstanding_bytes, "B");
+    
+    return ((after.misses == before.misses && after.outstanding_bytes == 0) ? 0 : 1);
+}
@@ -0,0 +1,226 @@
+//
+//  cache.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "arena.h"
+#include "conn.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// response cache: pipelined requests for a rendered page answered by the
+// handler and from the cache, small and big (sent without copying)
+// bodies, plus If-None-Match revalidations that end in a 304
+//
+// the allocator functions are wrapped at link time like in bench_alloc,
+// a cache hit must neither call the handler nor allocate anything
+//
+
+#define TF_BENCH_CACHE_PORT 5650
+#define TF_BENCH_CACHE_UNCACHED_PORT 5651
+#define TF_BENCH_CACHE_BYTES (16 * 1024 * 1024)
+#define TF_BENCH_CACHE_TTL_MS 60000
+/// rows the page handler renders, about 16 KiB
+#define TF_BENCH_CACHE_PAGE_ROWS 256
+/// requests sent at once
+#define TF_BENCH_CACHE_BATCH 16
+#define TF_BENCH_CACHE_ROUNDS 1000
+#define TF_BENCH_CACHE_WARMUP_RUNS 3
+
+static uint64_t tf_bench_alloc_calls;
+static uint64_t tf_bench_handler_calls;
+
+static const char tf_bench_request_page[] = "GET /page HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char tf_bench_request_small[] = "GET /small HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* data, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* data, size_t size) {
+    __atomic_add_fetch(&tf_bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    return __real_realloc(data, size);
+}
+
+void tf_bench_cache_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(server);
+    (void)(meta);
+    
+    __atomic_add_fetch(&tf_bench_handler_calls, 1, __ATOMIC_RELAXED);
+    
+    tf_index_t rows = (tf_str_view_equals(request->path, "/page") ?
+                       TF_BENCH_CACHE_PAGE_ROWS : 1);
+    tf_index_t capacity = rows * 64;
+    char* body = tf_arena_alloc(tf_conn_get_arena(conn), capacity);
+    tf_index_t length = 0;
+    
+    // the kind of work a template engine does
+    for (tf_index_t row = 0; row < rows; row++)
+        length += (tf_index_t)snprintf(body + length, capacity - length,
+                                       "<tr><td>%u</td><td>item %08x</td></tr>\n",
+                                       row, row * 2654435761u);
+    
+    response->body.data = body;
+    response->body.length = length;
+    response->cache_ttl = TF_BENCH_CACHE_TTL_MS;
+}
+
+void* tf_bench_cache_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_cache_handle, NULL);
+    return NULL;
+}
+
+bool tf_bench_cache_start(const tf_port_t port, const uint64_t cache_bytes) {
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", port, 16, 1);
+    pthread_t thread;
+    
+    if (!server)
+        return false;
+    
+    tf_http_server_set_cache(server, cache_bytes, NULL);
+    
+    // the server threads are left running, exiting takes them down
+    return (pthread_create(&thread, NULL, tf_bench_cache_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+/// ETag of the response to request, false if there is none
+bool tf_bench_cache_get_etag(int sock, const char* request, char* etag,
+                             const size_t capacity) {
+    char buffer[512];
+    size_t received = 0;
+    
+    if (!tf_bench_send(sock, request, strlen(request)))
+        return false;
+    
+    // only the head is needed, the rest goes with tf_bench_receive
+    while (received < sizeof(buffer) - 1 && !memmem(buffer, received, "\r\n\r\n", 4)) {
+        ssize_t chunk = recv(sock, buffer, sizeof(buffer) - 1, MSG_PEEK);
+        if (chunk <= 0)
+            return false;
+        
+        received = (size_t)chunk;
+    }
+    
+    buffer[received] = '\0';
+    
+    char* field = strstr(buffer, "ETag: ");
+    size_t length = (field ? strcspn(field + 6, "\r") : 0);
+    
+    if (!field || length >= capacity || !tf_bench_receive(sock, 1))
+        return false;
+    
+    memcpy(etag, field + 6, length);
+    etag[length] = '\0';
+    
+    return true;
+}
+
+/// pipelined requests per second, -1 on failure
+double tf_bench_cache_run(int sock, const char* request) {
+    static char batch[TF_BENCH_CACHE_BATCH * 256];
+    size_t length = strlen(request);
+    
+    for (tf_index_t index = 0; index < TF_BENCH_CACHE_BATCH; index++)
+        memcpy(batch + index * length, request, length);
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_CACHE_ROUNDS; round++) {
+        if (!tf_bench_send(sock, batch, length * TF_BENCH_CACHE_BATCH) ||
+            !tf_bench_receive(sock, TF_BENCH_CACHE_BATCH))
+            return -1;
+    }
+    
+    return (double)TF_BENCH_CACHE_ROUNDS * TF_BENCH_CACHE_BATCH * 1e9 /
+           (double)(tf_bench_now_ns() - started);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    if (!tf_bench_cache_start(TF_BENCH_CACHE_PORT, TF_BENCH_CACHE_BYTES) ||
+        !tf_bench_cache_start(TF_BENCH_CACHE_UNCACHED_PORT, 0)) {
+        fprintf(stderr, "cannot start the servers\n");
+        return 1;
+    }
+    
+    int cached = tf_bench_connect(TF_BENCH_CACHE_PORT);
+    int uncached = tf_bench_connect(TF_BENCH_CACHE_UNCACHED_PORT);
+    char etag[64];
+    char revalidate[256];
+    
+    bool ok = (cached >= 0 && uncached >= 0 &&
+               tf_bench_cache_get_etag(cached, tf_bench_request_page, etag, sizeof(etag)));
+    
+    snprintf(revalidate, sizeof(revalidate),
+             "GET /page HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: %s\r\n\r\n", etag);
+    
+    // the first requests fill the cache, the warm-up runs the buffer pool
+    for (tf_index_t round = 0; ok && round < TF_BENCH_CACHE_WARMUP_RUNS; round++)
+        ok = (tf_bench_cache_run(cached, tf_bench_request_page) > 0 &&
+              tf_bench_cache_run(cached, tf_bench_request_small) > 0 &&
+              tf_bench_cache_run(cached, revalidate) > 0 &&
+              tf_bench_cache_run(uncached, tf_bench_request_page) > 0);
+    
+    double handler = (ok ? tf_bench_cache_run(uncached, tf_bench_request_page) : -1);
+    
+    uint64_t allocs_before = __atomic_load_n(&tf_bench_alloc_calls, __ATOMIC_RELAXED);
+    uint64_t calls_before = __atomic_load_n(&tf_bench_handler_calls, __ATOMIC_RELAXED);
+    
+    double page = (ok ? tf_bench_cache_run(cached, tf_bench_request_page) : -1);
+    double small = (ok ? tf_bench_cache_run(cached, tf_bench_request_small) : -1);
+    double not_modified = (ok ? tf_bench_cache_run(cached, revalidate) : -1);
+    
+    uint64_t allocs = __atomic_load_n(&tf_bench_alloc_calls, __ATOMIC_RELAXED) - allocs_before;
+    uint64_t calls = __atomic_load_n(&tf_bench_handler_calls, __ATOMIC_RELAXED) - calls_before;
+    double hits = 3.0 * TF_BENCH_CACHE_ROUNDS * TF_BENCH_CACHE_BATCH;
+    
+    TF_BENCH_REPORT("cache", "page, handler", handler, "req/s");
+    TF_BENCH_REPORT("cache", "page, cached", page, "req/s");
+    TF_BENCH_REPORT("cache", "small, cached", small, "req/s");
+    TF_BENCH_REPORT("cache", "page, 304", not_modified, "req/s");
+    TF_BENCH_REPORT("cache", "allocations per hit", (double)allocs / hits, "calls");
+    TF_BENCH_REPORT("cache", "handler calls per hit", (double)calls / hits, "calls");
+    
+    if (cached >= 0)
+        close(cached);
+    if (uncached >= 0)
+        close(uncached);
+    
+    if (handler < 0 || page < 0 || small < 0 || not_modified < 0) {
+        fprintf(stderr, "requests failed\n");
+        return 1;
+    }
+    
+    // hits have to be served from the cached bytes alone
+    if (allocs > 0 || calls > 0) {
+        fprintf(stderr, "cache hits allocate or call the handler\n");
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,172 @@
+//
+//  compare.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+
+//
+// puts two benchmark result files (see TF_BENCH_JSON in bench.h) side by
+// side, measurements are matched by bench and param:
+//
+//   make bench BENCH_JSON=old.json
+//   (change things)
+//   make bench BENCH_JSON=new.json
+//   ./bench_compare old.json new.json
+//
+// only reads what bench.h writes, it's not a JSON parser
+//
+
+#define TF_BENCH_COMPARE_LINE_MAX 1024
+#define TF_BENCH_COMPARE_FIELD_MAX 256
+
+typedef struct {
+    char bench[TF_BENCH_COMPARE_FIELD_MAX];
+    char param[TF_BENCH_COMPARE_FIELD_MAX];
+    char unit[TF_BENCH_COMPARE_FIELD_MAX];
+    // false for skipped measurements
+    bool measured;
+    double value;
+} tf_bench_compare_result_t;
+
+typedef struct {
+    tf_bench_compare_result_t* results;
+    tf_index_t count;
+    tf_index_t capacity;
+} tf_bench_compare_file_t;
+
+/// unescaped value of "key": "...", false if it's not there
+bool tf_bench_compare_get_string(const char* line, const char* key, char* value,
+                                 const tf_index_t capacity) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    
+    const char* current = strstr(line, pattern);
+    if (!current)
+        return false;
+    
+    tf_index_t length = 0;
+    
+    for (current += strlen(pattern); *current && *current != '"'; current++) {
+        if (*current == '\\' && current[1])
+            current++; // only \" and \\ are escaped in practice
+        
+        if (length + 1 < capacity)
+            value[length++] = *current;
+    }
+    
+    value[length] = 0;
+    return (*current == '"');
+}
+
+bool tf_bench_compare_parse(const char* line, tf_bench_compare_result_t* result) {
+    bzero(result, sizeof(tf_bench_compare_result_t));
+    
+    if (!tf_bench_compare_get_string(line, "bench", result->bench, sizeof(result->bench)) ||
+        !tf_bench_compare_get_string(line, "param", result->param, sizeof(result->param)))
+        return false;
+    
+    const char* value = strstr(line, "\"value\": ");
+    if (!value)
+        return false;
+    
+    value += strlen("\"value\": ");
+    
+    if (strncmp(value, "null", 4) != 0) {
+        char* end = NULL;
+        
+        result->value = strtod(value, &end);
+        result->measured = (end != value);
+    }
+    
+    tf_bench_compare_get_string(line, "unit", result->unit, sizeof(result->unit));
+    return true;
+}
+
+bool tf_bench_compare_load(const char* path, tf_bench_compare_file_t* file) {
+    FILE* input = fopen(path, "r");
+    char line[TF_BENCH_COMPARE_LINE_MAX];
+    
+    bzero(file, sizeof(tf_bench_compare_file_t));
+    
+    if (!input) {
+        perror(path);
+        return false;
+    }
+    
+    while (fgets(line, sizeof(line), input)) {
+        if (file->count == file->capacity) {
+            file->capacity = (file->capacity > 0 ? file->capacity * 2 : 64);
+            file->results = realloc(file->results,
+                                    file->capacity * sizeof(tf_bench_compare_result_t));
+        }
+        
+        if (tf_bench_compare_parse(line, &file->results[file->count]))
+            file->count++;
+    }
+    
+    fclose(input);
+    return true;
+}
+
+const tf_bench_compare_result_t* tf_bench_compare_find(const tf_bench_compare_file_t* file,
+                                                       const tf_bench_compare_result_t* result) {
+    for (tf_index_t index = 0; index < file->count; index++) {
+        const tf_bench_compare_result_t* current = &file->results[index];
+        
+        if (strcmp(current->bench, result->bench) == 0 &&
+            strcmp(current->param, result->param) == 0)
+            return current;
+    }
+    
+    return NULL;
+}
+
+int main(const int argc, const char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s OLD.json NEW.json\n", argv[0]);
+        return 1;
+    }
+    
+    tf_bench_compare_file_t old_file;
+    tf_bench_compare_file_t new_file;
+    
+    if (!tf_bench_compare_load(argv[1], &old_file) || !tf_bench_compare_load(argv[2], &new_file))
+        return 1;
+    
+    printf("%-20s %-28s %14s %14s %9s\n", "bench", "param", "old", "new", "change");
+    
+    for (tf_index_t index = 0; index < new_file.count; index++) {
+        const tf_bench_compare_result_t* current = &new_file.results[index];
+        const tf_bench_compare_result_t* previous = tf_bench_compare_find(&old_file, current);
+        
+        printf("%-20s %-28s ", current->bench, current->param);
+        
+        if (previous && previous->measured)
+            printf("%14.1f ", previous->value);
+        else
+            printf("%14s ", "-");
+        
+        if (current->measured)
+            printf("%14.1f ", current->value);
+        else
+            printf("%14s ", "-");
+        
+        if (previous && previous->measured && current->measured && previous->value != 0)
+            printf("%+8.1f%% %s\n", (current->value - previous->value) * 100 /
+                   previous->value, current->unit);
+        else
+            printf("%9s %s\n", "", current->unit);
+    }
+    
+    free(old_file.results);
+    free(new_file.results);
+    
+    return 0;
+}
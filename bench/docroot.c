@@ -0,0 +1,186 @@
+//
+//  docroot.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "docroot.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// static files from a temporary document root, served with the open file
+// cache and without it (every request opens and stats the file), over a
+// keep-alive connection with single and pipelined requests
+//
+
+#define TF_BENCH_DOCROOT_PORT_CACHED 5646
+#define TF_BENCH_DOCROOT_PORT_UNCACHED 5647
+#define TF_BENCH_DOCROOT_FILES 1000
+#define TF_BENCH_DOCROOT_FILE_SIZE 2048
+#define TF_BENCH_DOCROOT_REQUESTS 16000
+/// requests written at once in the pipelined run
+#define TF_BENCH_DOCROOT_DEPTH 16
+
+typedef struct {
+    tf_http_server_ref server;
+    tf_docroot_ref docroot;
+} tf_bench_docroot_t;
+
+static char tf_bench_root[] = "/tmp/tinyhttp-bench-XXXXXX";
+
+void tf_bench_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    (void)(server);
+    
+    if (!tf_docroot_handle((tf_docroot_ref)meta, conn, request, response))
+        response->status = 404;
+}
+
+void* tf_bench_server_thread(void* arg) {
+    tf_bench_docroot_t* bench = (tf_bench_docroot_t*)arg;
+    
+    tf_http_server_listen(bench->server, tf_bench_handle, bench->docroot);
+    return NULL;
+}
+
+bool tf_bench_make_files(void) {
+    if (!mkdtemp(tf_bench_root))
+        return false;
+    
+    char content[TF_BENCH_DOCROOT_FILE_SIZE];
+    char path[256];
+    
+    memset(content, 'x', sizeof(content));
+    
+    for (tf_index_t index = 0; index < TF_BENCH_DOCROOT_FILES; index++) {
+        snprintf(path, sizeof(path), "%s/file%u.html", tf_bench_root, index);
+        
+        int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0)
+            return false;
+        
+        bool written = (write(file, content, sizeof(content)) == (ssize_t)sizeof(content));
+        
+        close(file);
+        
+        if (!written)
+            return false;
+    }
+    
+    return true;
+}
+
+void tf_bench_remove_files(void) {
+    char path[256];
+    
+    for (tf_index_t index = 0; index < TF_BENCH_DOCROOT_FILES; index++) {
+        snprintf(path, sizeof(path), "%s/file%u.html", tf_bench_root, index);
+        unlink(path);
+    }
+    
+    rmdir(tf_bench_root);
+}
+
+bool tf_bench_start(tf_bench_docroot_t* bench, const tf_port_t port,
+                    const tf_index_t cache_size) {
+    pthread_t thread;
+    
+    bench->docroot = tf_docroot_init(tf_bench_root, 1, cache_size);
+    bench->server = tf_http_server_init("127.0.0.1", port, 64, 1);
+    
+    return (bench->docroot && bench->server &&
+            pthread_create(&thread, NULL, tf_bench_server_thread, bench) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+/// us per request, the files are requested round-robin, -1 on failure
+double tf_bench_run(const tf_port_t port, const tf_index_t depth) {
+    static char batch[64 * TF_BENCH_DOCROOT_DEPTH];
+    int sock = tf_bench_connect(port);
+    
+    if (sock < 0)
+        return -1;
+    
+    tf_index_t file = 0;
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_DOCROOT_REQUESTS; index += depth) {
+        size_t length = 0;
+        
+        for (tf_index_t request = 0; request < depth; request++) {
+            length += (size_t)snprintf(batch + length, sizeof(batch) - length,
+                                       "GET /file%u.html HTTP/1.1\r\nHost: b\r\n\r\n",
+                                       file);
+            file = (file + 1) % TF_BENCH_DOCROOT_FILES;
+        }
+        
+        if (!tf_bench_send(sock, batch, length) || !tf_bench_receive(sock, depth)) {
+            close(sock);
+            return -1;
+        }
+    }
+    
+    double result = (double)(tf_bench_now_ns() - started) / TF_BENCH_DOCROOT_REQUESTS;
+    
+    close(sock);
+    return result / 1000.0;
+}
+
+bool tf_bench_report(const char* name, tf_bench_docroot_t* bench, const tf_port_t port) {
+    char param[64];
+    
+    // first round fills the cache
+    double single = tf_bench_run(port, 1);
+    double pipelined = tf_bench_run(port, TF_BENCH_DOCROOT_DEPTH);
+    
+    tf_docroot_stats_t stats;
+    tf_docroot_get_stats(bench->docroot, &stats);
+    
+    snprintf(param, sizeof(param), "%s, keep-alive", name);
+    TF_BENCH_REPORT("docroot", param, single, "us/req");
+    snprintf(param, sizeof(param), "%s, pipelined x16", name);
+    TF_BENCH_REPORT("docroot", param, pipelined, "us/req");
+    snprintf(param, sizeof(param), "%s, opens per request", name);
+    TF_BENCH_REPORT("docroot", param,
+                    (double)stats.misses / (2 * TF_BENCH_DOCROOT_REQUESTS), "");
+    
+    return (single > 0 && pipelined > 0);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    if (!tf_bench_make_files()) {
+        fprintf(stderr, "cannot create the files in %s\n", tf_bench_root);
+        tf_bench_remove_files();
+        return 1;
+    }
+    
+    tf_bench_docroot_t cached;
+    tf_bench_docroot_t uncached;
+    bool result = false;
+    
+    if (tf_bench_start(&cached, TF_BENCH_DOCROOT_PORT_CACHED, TF_BENCH_DOCROOT_FILES) &&
+        tf_bench_start(&uncached, TF_BENCH_DOCROOT_PORT_UNCACHED, 0)) {
+        result = tf_bench_report("cached", &cached, TF_BENCH_DOCROOT_PORT_CACHED);
+        result = (tf_bench_report("uncached", &uncached, TF_BENCH_DOCROOT_PORT_UNCACHED) &&
+                  result);
+    } else
+        fprintf(stderr, "cannot start the servers\n");
+    
+    // the server threads are left running, exiting takes them down
+    tf_bench_remove_files();
+    return (result ? 0 : 1);
+}
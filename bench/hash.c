@@ -0,0 +1,253 @@
+//
+//  hash.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "bench.h"
+
+//
+// tf_hash lookups/inserts compared to the linked list it replaced, with
+// header-sized (8), route-table-sized (64) and big (100k) key sets
+//
+
+/// lookups per measurement
+#define TF_BENCH_HASH_LOOKUPS 1000000
+/// the list is way too slow for a million lookups in 100k keys
+#define TF_BENCH_HASH_LIST_LOOKUPS 2000
+/// inserting into the list is quadratic, skip beyond that
+#define TF_BENCH_HASH_LIST_MAX_INSERT 10000
+
+//
+// the previous tf_hash, a singly linked list with strcmp lookups
+//
+
+typedef struct tf_bench_item_s* tf_bench_item_ref;
+struct tf_bench_item_s {
+    char* key;
+    void* value;
+    tf_bench_item_ref next;
+};
+
+tf_bench_item_ref tf_bench_list_find(tf_bench_item_ref first, const char* key,
+                                     tf_bench_item_ref* lastp) {
+    tf_bench_item_ref current = first;
+    
+    while (current) {
+        if (strcmp(current->key, key) == 0)
+            break;
+        
+        if (lastp)
+            *lastp = current;
+        
+        current = current->next;
+    }
+    
+    return current;
+}
+
+void tf_bench_list_set(tf_bench_item_ref* firstp, const char* key, void* value) {
+    tf_bench_item_ref last = NULL;
+    tf_bench_item_ref item = tf_bench_list_find(*firstp, key, &last);
+    
+    if (item) {
+        item->value = value;
+        return;
+    }
+    
+    // same two allocations per item as before
+    item = calloc(1, sizeof(struct tf_bench_item_s));
+    item->key = strdup(key);
+    item->value = value;
+    
+    if (last)
+        last->next = item;
+    else
+        *firstp = item;
+}
+
+void tf_bench_list_release(tf_bench_item_ref first) {
+    while (first) {
+        tf_bench_item_ref next = first->next;
+        
+        free(first->key);
+        free(first);
+        
+        first = next;
+    }
+}
+
+//
+// benchmark
+//
+
+char** tf_bench_make_keys(const tf_index_t count) {
+    char** keys = malloc(count * sizeof(char*));
+    
+    for (tf_index_t index = 0; index < count; index++) {
+        char key[64];
+        
+        // mix of header-like short keys and route-like long ones
+        if (index % 2)
+            snprintf(key, sizeof(key), "x-header-%u", index);
+        else
+            snprintf(key, sizeof(key), "/api/v1/resources/%u/details", index);
+        
+        keys[index] = strdup(key);
+    }
+    
+    return keys;
+}
+
+/// pseudo-random lookup order, the same for both implementations
+tf_index_t tf_bench_pick(const tf_index_t round, const tf_index_t count) {
+    return (tf_index_t)(((uint64_t)round * 2654435761u) % count);
+}
+
+void tf_bench_hash_run(const tf_index_t count) {
+    char** keys = tf_bench_make_keys(count);
+    char param[64];
+    
+    // new table
+    tf_hash_ref hash = tf_hash_init_empty();
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < count; index++)
+        tf_hash_set(hash, keys[index], keys[index], NULL);
+    
+    double insert = (double)(tf_bench_now_ns() - started) / count;
+    
+    tf_index_t found = 0;
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_HASH_LOOKUPS; round++)
+        found += (tf_hash_get(hash, keys[tf_bench_pick(round, count)]) != NULL);
+    
+    double lookup = (double)(tf_bench_now_ns() - started) / TF_BENCH_HASH_LOOKUPS;
+    
+    snprintf(param, sizeof(param), "table insert, %u keys", count);
+    TF_BENCH_REPORT("hash", param, insert, "ns/op");
+    snprintf(param, sizeof(param), "table lookup, %u keys", count);
+    TF_BENCH_REPORT("hash", param, lookup, "ns/op");
+    
+    if (found != TF_BENCH_HASH_LOOKUPS || tf_hash_get_count(hash) != count)
+        printf("hash: table lost keys (%u found)\n", found);
+    
+    tf_hash_release(hash);
+    
+    // old list
+    tf_bench_item_ref list = NULL;
+    
+    snprintf(param, sizeof(param), "list insert, %u keys", count);
+    started = tf_bench_now_ns();
+    
+    if (count <= TF_BENCH_HASH_LIST_MAX_INSERT) {
+        for (tf_index_t index = 0; index < count; index++)
+            tf_bench_list_set(&list, keys[index], keys[index]);
+        
+        TF_BENCH_REPORT("hash", param, (double)(tf_bench_now_ns() - started) / count,
+                        "ns/op");
+    } else {
+        // build it back to front without the duplicate checks
+        for (tf_index_t index = count; index > 0; index--) {
+            tf_bench_item_ref item = calloc(1, sizeof(struct tf_bench_item_s));
+            
+            item->key = strdup(keys[index - 1]);
+            item->value = keys[index - 1];
+            item->next = list;
+            
+            list = item;
+        }
+        
+        TF_BENCH_SKIP("hash", param, "quadratic");
+    }
+    
+    tf_index_t rounds = (count > 1000 ? TF_BENCH_HASH_LIST_LOOKUPS : TF_BENCH_HASH_LOOKUPS);
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < rounds; round++)
+        found += (tf_bench_list_find(list, keys[tf_bench_pick(round, count)], NULL) != NULL);
+    
+    snprintf(param, sizeof(param), "list lookup, %u keys", count);
+    TF_BENCH_REPORT("hash", param, (double)(tf_bench_now_ns() - started) / rounds, "ns/op");
+    
+    tf_bench_list_release(list);
+    
+    for (tf_index_t index = 0; index < count; index++)
+        free(keys[index]);
+    
+    free(keys);
+}
+
+/// removals, reinserts and iteration have to keep the table consistent
+bool tf_bench_hash_check(void) {
+    tf_index_t count = 5000;
+    char** keys = tf_bench_make_keys(count);
+    tf_hash_ref hash = tf_hash_init_empty();
+    bool result = true;
+    
+    for (tf_index_t index = 0; index < count; index++)
+        tf_hash_set(hash, keys[index], keys[index], NULL);
+    
+    for (tf_index_t index = 0; index < count; index += 3)
+        result = (tf_hash_remove(hash, keys[index]) && result);
+    
+    for (tf_index_t index = 0; index < count; index++) {
+        bool expected = (index % 3 != 0);
+        result = (tf_hash_has(hash, keys[index]) == expected && result);
+    }
+    
+    tf_index_t visited = 0;
+    tf_hash_iter_t iter;
+    const char* key = NULL;
+    tf_data_ref value = NULL;
+    
+    tf_hash_iter_init(hash, &iter);
+    while (tf_hash_iter_step(&iter, &key, &value))
+        visited += (strcmp(key, (const char*)value) == 0);
+    
+    result = (visited == tf_hash_get_count(hash) && result);
+    
+    // the legacy iteration has to see the same
+    tf_index_t legacy = 0;
+    
+    tf_hash_iter_reset(hash);
+    while (tf_hash_iter_next(hash))
+        legacy += (tf_hash_iter_get_key(hash) == tf_hash_iter_get_value(hash) ||
+                   strcmp(tf_hash_iter_get_key(hash),
+                          (const char*)tf_hash_iter_get_value(hash)) == 0);
+    
+    result = (legacy == visited && result);
+    
+    for (tf_index_t index = 0; index < count; index += 3)
+        tf_hash_set(hash, keys[index], keys[index], NULL);
+    
+    result = (tf_hash_get_count(hash) == count && result);
+    
+    tf_hash_release(hash);
+    
+    for (tf_index_t index = 0; index < count; index++)
+        free(keys[index]);
+    
+    free(keys);
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_bench_hash_run(8);
+    tf_bench_hash_run(64);
+    tf_bench_hash_run(100000);
+    
+    bool consistent = tf_bench_hash_check();
+    TF_BENCH_REPORT("hash", "remove/iterate check", consistent, "");
+    
+    return (consistent ? 0 : 1);
+}
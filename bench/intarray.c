@@ -0,0 +1,83 @@
+//
+//  intarray.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include "intarray.h"
+#include "log.h"
+#include "bench.h"
+
+//
+// tf_int_array pushes into a preallocated and into a growing array, random
+// reads and the min/max/average scans
+//
+
+#define TF_BENCH_INTARRAY_COUNT 100000
+#define TF_BENCH_INTARRAY_READS 1000000
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    // the array logs every push in debug builds, that's not what's measured
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0)
+        tf_log_set_output(null);
+    
+    tf_int_array_ref fixed = tf_int_array_init(TF_BENCH_INTARRAY_COUNT + 1, false);
+    uint64_t started = tf_bench_now_ns();
+    
+    for (int value = 0; value < TF_BENCH_INTARRAY_COUNT; value++)
+        tf_int_array_push(fixed, value);
+    
+    double push_fixed = (double)(tf_bench_now_ns() - started) / TF_BENCH_INTARRAY_COUNT;
+    
+    tf_int_array_ref growing = tf_int_array_init(1, true);
+    started = tf_bench_now_ns();
+    
+    for (int value = 0; value < TF_BENCH_INTARRAY_COUNT; value++)
+        tf_int_array_push(growing, value);
+    
+    double push_growing = (double)(tf_bench_now_ns() - started) / TF_BENCH_INTARRAY_COUNT;
+    
+    int64_t sum = 0;
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_INTARRAY_READS; round++)
+        sum += tf_int_array_get_at(fixed, (tf_index_t)(((uint64_t)round * 2654435761u) %
+                                                       TF_BENCH_INTARRAY_COUNT), 0);
+    
+    double get_at = (double)(tf_bench_now_ns() - started) / TF_BENCH_INTARRAY_READS;
+    
+    started = tf_bench_now_ns();
+    int max = tf_int_array_get_max(fixed);
+    int min = tf_int_array_get_min(fixed);
+    int average = tf_int_array_get_average(fixed);
+    double scans = (double)(tf_bench_now_ns() - started) / (3 * TF_BENCH_INTARRAY_COUNT);
+    
+    bool consistent = (tf_int_array_get_count(fixed) == TF_BENCH_INTARRAY_COUNT &&
+                       tf_int_array_get_count(growing) == TF_BENCH_INTARRAY_COUNT &&
+                       max == TF_BENCH_INTARRAY_COUNT - 1 && min == 0 &&
+                       average == (TF_BENCH_INTARRAY_COUNT - 1) / 2 && sum > 0);
+    
+    for (int value = TF_BENCH_INTARRAY_COUNT - 1; value >= 0; value--)
+        consistent = (tf_int_array_pop(growing) == value && consistent);
+    
+    TF_BENCH_REPORT("intarray", "push, preallocated", push_fixed, "ns/op");
+    TF_BENCH_REPORT("intarray", "push, growing", push_growing, "ns/op");
+    TF_BENCH_REPORT("intarray", "get_at, random", get_at, "ns/op");
+    TF_BENCH_REPORT("intarray", "min/max/average scan", scans, "ns/item");
+    
+    if (!consistent)
+        printf("intarray: wrong contents\n");
+    
+    tf_int_array_release(fixed);
+    tf_int_array_release(growing);
+    
+    return (consistent ? 0 : 1);
+}
@@ -0,0 +1,132 @@
+//
+//  keepalive.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "server.h"
+#include "bench.h"
+
+//
+// per-request latency against an in-process server, with a new
+// connection per request, one keep-alive connection, and one keep-alive
+// connection with pipelined batches
+//
+
+#define TF_BENCH_KEEPALIVE_PORT 5644
+#define TF_BENCH_KEEPALIVE_REQUESTS 5000
+/// requests written at once in the pipelined run
+#define TF_BENCH_KEEPALIVE_DEPTH 16
+
+static const char tf_bench_hello[] = "hello";
+
+static const char tf_bench_request_close[] =
+    "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+static const char tf_bench_request_keep[] =
+    "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+void tf_bench_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    (void)(server);
+    (void)(conn);
+    (void)(request);
+    (void)(meta);
+    
+    response->body.data = tf_bench_hello;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_hello) - 1);
+}
+
+void* tf_bench_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_handle, NULL);
+    return NULL;
+}
+
+/// new connection for every request, the server closes it
+double tf_bench_run_close(void) {
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_KEEPALIVE_REQUESTS; index++) {
+        int sock = tf_bench_connect(TF_BENCH_KEEPALIVE_PORT);
+        
+        if (sock < 0 || !tf_bench_send(sock, tf_bench_request_close,
+                                       sizeof(tf_bench_request_close) - 1) ||
+            !tf_bench_receive(sock, 1)) {
+            if (sock >= 0)
+                close(sock);
+            
+            return -1;
+        }
+        
+        close(sock);
+    }
+    
+    return (double)(tf_bench_now_ns() - started) / TF_BENCH_KEEPALIVE_REQUESTS;
+}
+
+/// one connection, depth requests in flight at once
+double tf_bench_run_keep(const tf_index_t depth) {
+    static char batch[sizeof(tf_bench_request_keep) * TF_BENCH_KEEPALIVE_DEPTH];
+    size_t single = sizeof(tf_bench_request_keep) - 1;
+    
+    for (tf_index_t index = 0; index < depth; index++)
+        memcpy(batch + (index * single), tf_bench_request_keep, single);
+    
+    int sock = tf_bench_connect(TF_BENCH_KEEPALIVE_PORT);
+    if (sock < 0)
+        return -1;
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_KEEPALIVE_REQUESTS; index += depth) {
+        if (!tf_bench_send(sock, batch, single * depth) ||
+            !tf_bench_receive(sock, depth)) {
+            close(sock);
+            return -1;
+        }
+    }
+    
+    double result = (double)(tf_bench_now_ns() - started) / TF_BENCH_KEEPALIVE_REQUESTS;
+    
+    close(sock);
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1",
+                                                    TF_BENCH_KEEPALIVE_PORT, 64, 1);
+    pthread_t thread;
+    
+    if (!server || pthread_create(&thread, NULL, tf_bench_server_thread, server) != 0) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    if (!tf_bench_wait_for_port(TF_BENCH_KEEPALIVE_PORT)) {
+        fprintf(stderr, "server does not accept connections\n");
+        return 1;
+    }
+    
+    double closing = tf_bench_run_close();
+    double keep = tf_bench_run_keep(1);
+    double pipelined = tf_bench_run_keep(TF_BENCH_KEEPALIVE_DEPTH);
+    
+    TF_BENCH_REPORT("keepalive", "connection per request", closing / 1000.0, "us/req");
+    TF_BENCH_REPORT("keepalive", "keep-alive", keep / 1000.0, "us/req");
+    TF_BENCH_REPORT("keepalive", "keep-alive, pipelined x16", pipelined / 1000.0,
+                    "us/req");
+    
+    // the server thread is left running, exiting takes it down
+    return ((closing > 0 && keep > 0 && pipelined > 0) ? 0 : 1);
+}
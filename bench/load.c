@@ -0,0 +1,623 @@
+//
+//  load.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include "poller.h"
+#include "metrics.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// HTTP load generator over many keep-alive connections to 127.0.0.1
+//
+// closed loop: every connection sends its next request as soon as the
+// previous response is in, which is the most a server can take, but a
+// stall also stops the clock for everything that would have been sent
+// meanwhile (coordinated omission), so the percentiles are also reported
+// corrected for it the way HdrHistogram does, with the mean latency as the
+// expected interval
+//
+// open loop: requests are due at a fixed rate no matter how the server
+// keeps up and their latency counts from when they were due, requests
+// that have to wait for a free connection included
+//
+// without arguments an in-process server is measured with a closed loop
+// and an open loop at half the closed loop's throughput, with arguments a
+// single run against the given port:
+//
+//   bench_load --port 5643 --connections 5000 --duration 10 --rate 20000
+//
+
+#define TF_BENCH_LOAD_PORT 5645
+#define TF_BENCH_LOAD_CONNECTIONS 1000
+#define TF_BENCH_LOAD_DURATION 1.0
+/// descriptors below FD_SETSIZE kept free for everything but the
+/// connections when select() has to track them
+#define TF_BENCH_LOAD_SELECT_RESERVE 64
+/// response heads bigger than that are garbage, bodies are never stored
+#define TF_BENCH_LOAD_HEAD_SIZE 4096
+
+typedef struct {
+    tf_port_t port;
+    tf_index_t connections;
+    tf_index_t threads;
+    // seconds
+    double duration;
+    // requests per second over all threads, 0 for a closed loop
+    double rate;
+    const char* path;
+} tf_bench_load_config_t;
+
+typedef struct {
+    tf_socket_t sock;
+    // when the request in flight was sent (closed) or due (open), 0 if idle
+    uint64_t started_at;
+    
+    char head[TF_BENCH_LOAD_HEAD_SIZE];
+    tf_index_t head_length;
+    // body bytes of the current response still to come, -1 while in the head
+    int64_t body_left;
+} tf_bench_load_conn_t;
+
+typedef struct {
+    const tf_bench_load_config_t* config;
+    char request[256];
+    tf_index_t request_length;
+    
+    tf_poller_ref poller;
+    tf_bench_load_conn_t* conns;
+    tf_index_t count;
+    // socket -> connection index
+    tf_index_t* slots;
+    tf_index_t slot_count;
+    // connections without a request in flight
+    tf_index_t* idle;
+    tf_index_t idle_count;
+    
+    tf_histogram_t latency;
+    uint64_t max;
+    uint64_t completed;
+    uint64_t errors;
+    // requests due or in flight when time ran out
+    uint64_t unfinished;
+    
+    pthread_t thread;
+} tf_bench_load_worker_t;
+
+typedef struct {
+    double throughput;
+    tf_histogram_t latency;
+    uint64_t max;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t unfinished;
+} tf_bench_load_result_t;
+
+static const char tf_bench_hello[] = "hello";
+
+//
+// in-process server
+//
+
+void tf_bench_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    (void)(server);
+    (void)(conn);
+    (void)(request);
+    (void)(meta);
+    
+    response->body.data = tf_bench_hello;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_hello) - 1);
+}
+
+void* tf_bench_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_handle, NULL);
+    return NULL;
+}
+
+//
+// client
+//
+
+bool tf_bench_load_open(tf_bench_load_worker_t* worker, const tf_index_t index) {
+    tf_bench_load_conn_t* conn = &worker->conns[index];
+    tf_socket_t sock = tf_bench_connect(worker->config->port);
+    
+    conn->sock = sock;
+    conn->started_at = 0;
+    conn->head_length = 0;
+    conn->body_left = -1;
+    
+    if (sock < 0)
+        return false;
+    
+    if ((tf_index_t)sock >= worker->slot_count) {
+        tf_index_t count = (tf_index_t)sock * 2 + 1;
+        
+        worker->slots = realloc(worker->slots, count * sizeof(tf_index_t));
+        worker->slot_count = count;
+    }
+    
+    worker->slots[sock] = index;
+    
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) < 0 ||
+        !tf_poller_add(worker->poller, sock, TF_POLLER_READABLE)) {
+        close(sock);
+        conn->sock = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+void tf_bench_load_close(tf_bench_load_worker_t* worker, const tf_index_t index) {
+    tf_bench_load_conn_t* conn = &worker->conns[index];
+    
+    if (conn->sock < 0)
+        return;
+    
+    tf_poller_remove(worker->poller, conn->sock);
+    close(conn->sock);
+    
+    conn->sock = -1;
+}
+
+/// drops a broken connection and puts a new, idle one in its place
+void tf_bench_load_fail(tf_bench_load_worker_t* worker, const tf_index_t index) {
+    // idle ones are on the idle stack already
+    bool idle = (worker->conns[index].started_at < 1);
+    
+    worker->errors++;
+    tf_bench_load_close(worker, index);
+    
+    if (tf_bench_load_open(worker, index)) {
+        if (!idle)
+            worker->idle[worker->idle_count++] = index;
+        
+        return;
+    }
+    
+    // gone for good
+    for (tf_index_t position = 0; idle && position < worker->idle_count; position++) {
+        if (worker->idle[position] == index) {
+            worker->idle[position] = worker->idle[--worker->idle_count];
+            break;
+        }
+    }
+}
+
+void tf_bench_load_send(tf_bench_load_worker_t* worker, const uint64_t started_at) {
+    tf_index_t index = worker->idle[--worker->idle_count];
+    tf_bench_load_conn_t* conn = &worker->conns[index];
+    
+    // an idle connection has nothing queued, a request this small always
+    // fits into its socket buffer
+    ssize_t sent = send(conn->sock, worker->request, worker->request_length, MSG_NOSIGNAL);
+    
+    conn->started_at = started_at;
+    
+    if (sent != (ssize_t)worker->request_length)
+        tf_bench_load_fail(worker, index);
+}
+
+/// Content-Length of a complete response head, false if it has none
+bool tf_bench_load_get_content_length(const char* head, const tf_index_t length,
+                                      int64_t* lengthp) {
+    static const char field[] = "\r\ncontent-length:";
+    tf_index_t flen = (tf_index_t)(sizeof(field) - 1);
+    
+    for (tf_index_t index = 0; index + flen < length; index++) {
+        if (strncasecmp(head + index, field, flen) != 0)
+            continue;
+        
+        *lengthp = strtoll(head + index + flen, NULL, 10);
+        return (*lengthp >= 0);
+    }
+    
+    return false;
+}
+
+/// takes in whatever arrived, false if the connection has to go
+bool tf_bench_load_receive(tf_bench_load_worker_t* worker, const tf_index_t index) {
+    tf_bench_load_conn_t* conn = &worker->conns[index];
+    char buffer[16384];
+    
+    while (true) {
+        ssize_t received = recv(conn->sock, buffer, sizeof(buffer), 0);
+        
+        if (received < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        
+        if (received == 0 || conn->started_at < 1)
+            return false; // closed, or talking without being asked
+        
+        char* data = buffer;
+        tf_index_t left = (tf_index_t)received;
+        
+        while (left > 0) {
+            if (conn->body_left < 0) {
+                // still in the head, collect it until the blank line
+                tf_index_t take = TF_BENCH_LOAD_HEAD_SIZE - conn->head_length;
+                if (take > left)
+                    take = left;
+                
+                memcpy(conn->head + conn->head_length, data, take);
+                
+                char* end = memmem(conn->head, conn->head_length + take, "\r\n\r\n", 4);
+                
+                if (!end) {
+                    conn->head_length += take;
+                    data += take;
+                    left -= take;
+                    
+                    if (conn->head_length == TF_BENCH_LOAD_HEAD_SIZE)
+                        return false;
+                    
+                    continue;
+                }
+                
+                tf_index_t head_end = (tf_index_t)(end + 4 - conn->head);
+                
+                if (!tf_bench_load_get_content_length(conn->head, head_end, &conn->body_left))
+                    return false;
+                
+                take = head_end - conn->head_length;
+                data += take;
+                left -= take;
+                conn->head_length = 0;
+            }
+            
+            int64_t take = (conn->body_left < (int64_t)left ? conn->body_left : (int64_t)left);
+            
+            data += take;
+            left -= (tf_index_t)take;
+            conn->body_left -= take;
+            
+            if (conn->body_left > 0)
+                continue;
+            
+            // one more response, the connection is free again
+            uint64_t latency = tf_bench_now_ns() - conn->started_at;
+            
+            tf_histogram_record(&worker->latency, latency);
+            
+            if (latency > worker->max)
+                worker->max = latency;
+            
+            worker->completed++;
+            conn->started_at = 0;
+            conn->body_left = -1;
+            worker->idle[worker->idle_count++] = index;
+            
+            if (left > 0)
+                return false; // no pipelining, nothing else may follow
+        }
+    }
+}
+
+void* tf_bench_load_thread(void* arg) {
+    tf_bench_load_worker_t* worker = arg;
+    const tf_bench_load_config_t* config = worker->config;
+    tf_poller_event_t events[TF_POLLER_MAX_EVENTS];
+    
+    double rate = config->rate / config->threads;
+    uint64_t interval = (rate > 0 ? (uint64_t)(1e9 / rate) : 0);
+    uint64_t now = tf_bench_now_ns();
+    uint64_t ends = now + (uint64_t)(config->duration * 1e9);
+    uint64_t next_due = now;
+    
+    while (now < ends) {
+        int timeout = 100;
+        
+        if (interval < 1) {
+            while (worker->idle_count > 0)
+                tf_bench_load_send(worker, now);
+        } else {
+            // whatever is due goes out, late ones keep their due time
+            while (next_due <= now && worker->idle_count > 0) {
+                tf_bench_load_send(worker, next_due);
+                next_due += interval;
+            }
+            
+            if (next_due > now)
+                timeout = (int)((next_due - now) / 1000000);
+        }
+        
+        int count = tf_poller_wait(worker->poller, events, TF_POLLER_MAX_EVENTS, timeout);
+        
+        for (int event = 0; event < count; event++) {
+            tf_index_t index = worker->slots[events[event].socket];
+            
+            if (!tf_bench_load_receive(worker, index))
+                tf_bench_load_fail(worker, index);
+        }
+        
+        // nothing in, but the next request is due within a millisecond
+        if (count == 0 && timeout == 0)
+            sched_yield();
+        
+        now = tf_bench_now_ns();
+    }
+    
+    for (tf_index_t index = 0; index < worker->count; index++)
+        worker->unfinished += (worker->conns[index].started_at > 0);
+    
+    if (interval > 0 && next_due < ends)
+        worker->unfinished += (ends - next_due) / interval;
+    
+    return NULL;
+}
+
+/// HdrHistogram's correction: a value v stands for the requests the
+/// connection did not send meanwhile, at v - interval, v - 2 * interval ...
+void tf_bench_load_correct(const tf_histogram_t* raw, const uint64_t interval,
+                           tf_histogram_t* corrected) {
+    memcpy(corrected, raw, sizeof(tf_histogram_t));
+    
+    if (interval < 1)
+        return;
+    
+    for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++) {
+        uint64_t count = raw->buckets[bucket];
+        uint64_t value = tf_histogram_get_upper_bound(bucket);
+        
+        if (count < 1)
+            continue;
+        
+        for (uint64_t missed = value - (value > interval ? interval : value);
+             missed >= interval; missed -= interval) {
+            corrected->buckets[tf_histogram_get_bucket(missed)] += count;
+            corrected->sum += missed * count;
+        }
+    }
+}
+
+bool tf_bench_load_run(const tf_bench_load_config_t* config, tf_bench_load_result_t* result) {
+    tf_bench_load_worker_t* workers = calloc(config->threads, sizeof(tf_bench_load_worker_t));
+    tf_index_t opened = 0;
+    bool success = true;
+    
+    bzero(result, sizeof(tf_bench_load_result_t));
+    
+    for (tf_index_t thread = 0; thread < config->threads; thread++) {
+        tf_bench_load_worker_t* worker = &workers[thread];
+        
+        worker->config = config;
+        worker->request_length = (tf_index_t)snprintf(worker->request, sizeof(worker->request),
+                                                      "GET %s HTTP/1.1\r\n"
+                                                      "Host: 127.0.0.1\r\n\r\n",
+                                                      config->path);
+        worker->poller = tf_poller_init();
+        worker->count = config->connections / config->threads +
+                        (thread < config->connections % config->threads);
+        worker->conns = calloc(worker->count, sizeof(tf_bench_load_conn_t));
+        worker->idle = calloc(worker->count, sizeof(tf_index_t));
+        
+        for (tf_index_t index = 0; index < worker->count; index++) {
+            if (!tf_bench_load_open(worker, index)) {
+                fprintf(stderr, "cannot open connection %u\n", opened);
+                success = false;
+                break;
+            }
+            
+            worker->idle[worker->idle_count++] = index;
+            opened++;
+            
+            // lets an in-process server accept it before the next SYN comes
+            sched_yield();
+        }
+        
+        if (!success)
+            break;
+    }
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t thread = 0; success && thread < config->threads; thread++)
+        if (pthread_create(&workers[thread].thread, NULL, tf_bench_load_thread,
+                           &workers[thread]) != 0)
+            success = false;
+    
+    for (tf_index_t thread = 0; thread < config->threads; thread++) {
+        tf_bench_load_worker_t* worker = &workers[thread];
+        
+        if (worker->thread)
+            pthread_join(worker->thread, NULL);
+        
+        tf_histogram_merge(&result->latency, &worker->latency);
+        
+        if (worker->max > result->max)
+            result->max = worker->max;
+        
+        result->completed += worker->completed;
+        result->errors += worker->errors;
+        result->unfinished += worker->unfinished;
+        
+        for (tf_index_t index = 0; index < worker->count; index++)
+            tf_bench_load_close(worker, index);
+        
+        if (worker->poller)
+            tf_poller_release(worker->poller);
+        
+        free(worker->conns);
+        free(worker->slots);
+        free(worker->idle);
+    }
+    
+    result->throughput = (double)result->completed * 1e9 /
+                         (double)(tf_bench_now_ns() - started);
+    
+    free(workers);
+    return success;
+}
+
+void tf_bench_load_report_histogram(const char* name, const tf_histogram_t* latency) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    char param[64];
+    
+    for (tf_index_t index = 0; index < sizeof(quantiles) / sizeof(quantiles[0]); index++) {
+        snprintf(param, sizeof(param), "%s, p%g", name, quantiles[index] * 100);
+        TF_BENCH_REPORT("load", param,
+                        (double)tf_histogram_get_quantile(latency, quantiles[index]) / 1000,
+                        "us");
+    }
+}
+
+void tf_bench_load_report(const tf_bench_load_config_t* config,
+                          const tf_bench_load_result_t* result) {
+    // names stay the same from run to run, so bench_compare can match them
+    const char* name = (config->rate > 0 ? "open" : "closed");
+    char param[64];
+    
+    if (config->rate > 0) {
+        snprintf(param, sizeof(param), "%s, %u conns, offered", name, config->connections);
+        TF_BENCH_REPORT("load", param, config->rate, "req/s");
+    }
+    
+    snprintf(param, sizeof(param), "%s, %u conns", name, config->connections);
+    TF_BENCH_REPORT("load", param, result->throughput, "req/s");
+    
+    // due times are what an open loop measures from, nothing to correct
+    tf_bench_load_report_histogram(name, &result->latency);
+    
+    if (config->rate <= 0) {
+        uint64_t count = 0;
+        
+        for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++)
+            count += result->latency.buckets[bucket];
+        
+        tf_histogram_t* corrected = malloc(sizeof(tf_histogram_t));
+        tf_bench_load_correct(&result->latency, (count > 0 ? result->latency.sum / count : 0),
+                              corrected);
+        
+        snprintf(param, sizeof(param), "%s corrected", name);
+        tf_bench_load_report_histogram(param, corrected);
+        free(corrected);
+    }
+    
+    snprintf(param, sizeof(param), "%s, max", name);
+    TF_BENCH_REPORT("load", param, (double)result->max / 1000, "us");
+    snprintf(param, sizeof(param), "%s, errors", name);
+    TF_BENCH_REPORT("load", param, result->errors, "");
+    snprintf(param, sizeof(param), "%s, unfinished", name);
+    TF_BENCH_REPORT("load", param, result->unfinished, "");
+}
+
+bool tf_bench_load_parse(const int argc, const char** argv, tf_bench_load_config_t* config) {
+    for (int index = 1; index < argc; index++) {
+        const char* option = argv[index];
+        const char* value = (index + 1 < argc ? argv[++index] : NULL);
+        
+        if (!value)
+            return false;
+        
+        if (strcmp(option, "--port") == 0)
+            config->port = (tf_port_t)atoi(value);
+        else if (strcmp(option, "--connections") == 0)
+            config->connections = (tf_index_t)atoi(value);
+        else if (strcmp(option, "--threads") == 0)
+            config->threads = (tf_index_t)atoi(value);
+        else if (strcmp(option, "--duration") == 0)
+            config->duration = atof(value);
+        else if (strcmp(option, "--rate") == 0)
+            config->rate = atof(value);
+        else if (strcmp(option, "--path") == 0)
+            config->path = value;
+        else
+            return false;
+    }
+    
+    return (config->port > 0 && config->connections > 0 && config->threads > 0 &&
+            config->threads <= config->connections && config->duration > 0);
+}
+
+int main(const int argc, const char** argv) {
+    tf_bench_load_config_t config = { TF_BENCH_LOAD_PORT, TF_BENCH_LOAD_CONNECTIONS, 1,
+                                      TF_BENCH_LOAD_DURATION, 0, "/" };
+    tf_bench_load_result_t result;
+    
+    if (!tf_bench_load_parse(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--port N] [--connections N] [--threads N] "
+                "[--duration SECONDS] [--rate REQUESTS_PER_SECOND] [--path PATH]\n",
+                argv[0]);
+        return 1;
+    }
+    
+    // both ends of every connection live in this process
+    tf_index_t fd_limit = tf_bench_raise_fd_limit();
+    
+    if (argc > 1) {
+        if (config.connections + 16 > fd_limit) {
+            fprintf(stderr, "descriptor limit too low\n");
+            return 1;
+        }
+        
+#if !defined(TF_POLLER_EPOLL)
+        if (config.connections + TF_BENCH_LOAD_SELECT_RESERVE > FD_SETSIZE) {
+            fprintf(stderr, "select() cannot track more than %d connections\n",
+                    FD_SETSIZE - TF_BENCH_LOAD_SELECT_RESERVE);
+            return 1;
+        }
+#endif
+        
+        bool success = tf_bench_load_run(&config, &result);
+        tf_bench_load_report(&config, &result);
+        
+        return ((success && result.completed > 0) ? 0 : 1);
+    }
+    
+#if !defined(TF_POLLER_EPOLL)
+    // both ends of every connection have to fit into the fd_sets
+    if (config.connections * 2 + TF_BENCH_LOAD_SELECT_RESERVE > FD_SETSIZE)
+        config.connections = (FD_SETSIZE - TF_BENCH_LOAD_SELECT_RESERVE) / 2;
+#endif
+    
+    if (config.connections * 2 + 16 > fd_limit) {
+        TF_BENCH_SKIP("load", "closed", "descriptor limit too low");
+        return 0;
+    }
+    
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", config.port,
+                                                    config.connections + 16, 1);
+    pthread_t thread;
+    
+    if (!server || pthread_create(&thread, NULL, tf_bench_server_thread, server) != 0) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    if (!tf_bench_wait_for_port(config.port)) {
+        fprintf(stderr, "server does not accept connections\n");
+        return 1;
+    }
+    
+    bool success = tf_bench_load_run(&config, &result);
+    tf_bench_load_report(&config, &result);
+    
+    // half of what the server takes at most, so it is not overloaded
+    config.rate = result.throughput / 2;
+    
+    if (success && config.rate > 0) {
+        success = tf_bench_load_run(&config, &result);
+        tf_bench_load_report(&config, &result);
+    }
+    
+    // the server thread is left running, exiting takes it down
+    return ((success && result.completed > 0 && result.errors < 1) ? 0 : 1);
+}
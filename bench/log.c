@@ -0,0 +1,129 @@
+//
+//  log.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdarg.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "log.h"
+#include "bench.h"
+
+//
+// cost of a log call on the calling thread: the old synchronous stderr
+// logging (three unbuffered writes per message) against the ring logger
+// with some threads logging at once, and a level that is compiled out,
+// the ring logger has to be faster than the writes and lose nothing
+//
+
+#define TF_BENCH_LOG_THREADS 2
+/// messages per burst, fits into a ring so nothing has to be dropped
+#define TF_BENCH_LOG_BURST 400
+#define TF_BENCH_LOG_BURSTS 200
+
+#undef TF_LOG_LEVEL
+#define TF_LOG_LEVEL TF_LOG_LEVEL_INFO
+
+static FILE* tf_bench_log_sink;
+
+/// what tf_log used to do
+void tf_bench_log_sync(const char* fn, const tf_index_t line, const char* fnn,
+                       const char* fmt, ...) {
+    fprintf(tf_bench_log_sink, "[DEBUG/%s/%u/%s] ", fn, line, fnn);
+    
+    va_list vl;
+    va_start(vl, fmt);
+    vfprintf(tf_bench_log_sink, fmt, vl);
+    va_end(vl);
+    
+    fprintf(tf_bench_log_sink, "%c", '\n');
+}
+
+typedef struct {
+    bool async;
+    uint64_t elapsed;
+} tf_bench_log_thread_t;
+
+void* tf_bench_log_run(void* meta) {
+    tf_bench_log_thread_t* thread = meta;
+    
+    for (tf_index_t burst = 0; burst < TF_BENCH_LOG_BURSTS; burst++) {
+        uint64_t started = tf_bench_now_ns();
+        
+        for (tf_index_t index = 0; index < TF_BENCH_LOG_BURST; index++) {
+            if (thread->async)
+                TF_LOG_INFO("GET /hello/%u (%u headers, socket %d)", index, 3, 5);
+            else
+                tf_bench_log_sync(__FILE_NAME__, __LINE__, __FUNCTION__,
+                                  "GET /hello/%u (%u headers, socket %d)", index, 3, 5);
+        }
+        
+        thread->elapsed += tf_bench_now_ns() - started;
+        
+        // the writer catches up between bursts, like between request spikes
+        if (thread->async)
+            usleep(2 * 1000);
+    }
+    
+    return NULL;
+}
+
+/// ns per message on the logging threads
+double tf_bench_log_time(const bool async) {
+    pthread_t threads[TF_BENCH_LOG_THREADS];
+    tf_bench_log_thread_t states[TF_BENCH_LOG_THREADS];
+    uint64_t elapsed = 0;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_LOG_THREADS; index++) {
+        states[index].async = async;
+        states[index].elapsed = 0;
+        
+        pthread_create(threads + index, NULL, tf_bench_log_run, states + index);
+    }
+    
+    for (tf_index_t index = 0; index < TF_BENCH_LOG_THREADS; index++) {
+        pthread_join(threads[index], NULL);
+        elapsed += states[index].elapsed;
+    }
+    
+    return (double)elapsed / (TF_BENCH_LOG_THREADS * TF_BENCH_LOG_BURSTS * TF_BENCH_LOG_BURST);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    int null = open("/dev/null", O_WRONLY);
+    
+    tf_bench_log_sink = fdopen(dup(null), "w");
+    setvbuf(tf_bench_log_sink, NULL, _IONBF, 0);
+    tf_log_set_output(null);
+    
+    double sync = tf_bench_log_time(false);
+    double async = tf_bench_log_time(true);
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_LOG_BURST * TF_BENCH_LOG_BURSTS; index++)
+        TF_LOG_DEBUG("GET /hello/%u (%u headers, socket %d)", index, 3, 5);
+    
+    double disabled = (double)(tf_bench_now_ns() - started) /
+                      (TF_BENCH_LOG_BURST * TF_BENCH_LOG_BURSTS);
+    
+    tf_log_flush();
+    
+    uint64_t dropped = tf_log_get_dropped_count();
+    
+    TF_BENCH_REPORT("log", "synchronous stderr", sync, "ns/msg");
+    TF_BENCH_REPORT("log", "ring buffer", async, "ns/msg");
+    TF_BENCH_REPORT("log", "compiled out", disabled, "ns/msg");
+    TF_BENCH_REPORT("log", "dropped", dropped, "");
+    
+    fclose(tf_bench_log_sink);
+    close(null);
+    
+    return ((async < sync && dropped == 0) ? 0 : 1);
+}
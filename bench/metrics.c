@@ -0,0 +1,138 @@
+//
+//  metrics.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+#include "bench.h"
+
+//
+// cost of everything the server records for a request (two timings, the
+// drain timing and the counters), the timestamps themselves not included,
+// and how far histogram quantiles are off the exact ones for a long-tailed
+// latency distribution
+//
+
+#define TF_BENCH_METRICS_REQUESTS 2000000
+/// recording has to stay below this per request, unoptimized builds
+/// get some leeway
+#ifdef DEBUG
+#define TF_BENCH_METRICS_MAX_NS 60.0
+#else
+#define TF_BENCH_METRICS_MAX_NS 20.0
+#endif
+
+int tf_bench_compare_u64(const void* a, const void* b) {
+    uint64_t first = *(const uint64_t*)a;
+    uint64_t second = *(const uint64_t*)b;
+    
+    return (first > second) - (first < second);
+}
+
+uint64_t tf_bench_metrics_next(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    
+    return *state;
+}
+
+/// mostly around 20 us with a long tail up to 100 ms
+uint64_t tf_bench_metrics_latency(uint64_t* state) {
+    uint64_t random = tf_bench_metrics_next(state);
+    uint64_t base = 15000 + random % 10000;
+    
+    if ((random >> 32) % 100 == 0)
+        base *= 1 + (random >> 40) % 5000;
+    
+    return base;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_metrics_ref metrics = tf_metrics_init(1);
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    uint64_t* latencies = malloc(TF_BENCH_METRICS_REQUESTS * sizeof(uint64_t));
+    
+    for (tf_index_t index = 0; index < TF_BENCH_METRICS_REQUESTS; index++)
+        latencies[index] = tf_bench_metrics_latency(&state);
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    // what tf_http_server_handle_input and tf_tcp_write_pending do
+    for (tf_index_t index = 0; index < TF_BENCH_METRICS_REQUESTS; index++) {
+        uint64_t latency = latencies[index];
+        
+        tf_metrics_record_request(metrics, 0, latency >> 6, latency, 200);
+        tf_metrics_count(metrics, 0, TF_METRICS_BYTES_RECEIVED, 78);
+        tf_metrics_count(metrics, 0, TF_METRICS_BYTES_SENT, 101);
+        tf_metrics_record(metrics, 0, TF_METRICS_WRITE_DRAIN, latency >> 3);
+    }
+    
+    double per_request = (double)(tf_bench_now_ns() - started) / TF_BENCH_METRICS_REQUESTS;
+    
+    // a timestamp, for comparison
+    started = tf_bench_now_ns();
+    uint64_t sink = 0;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_METRICS_REQUESTS; index++)
+        sink += tf_bench_now_ns();
+    
+    double clock = (double)(tf_bench_now_ns() - started) / TF_BENCH_METRICS_REQUESTS;
+    
+    // quantiles against the exact ones, a bucket is at most 1/8 wide
+    tf_metrics_worker_t totals;
+    tf_metrics_get_totals(metrics, &totals);
+    
+    qsort(latencies, TF_BENCH_METRICS_REQUESTS, sizeof(uint64_t), tf_bench_compare_u64);
+    
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    double worst = 0;
+    char param[64];
+    
+    for (tf_index_t index = 0; index < sizeof(quantiles) / sizeof(quantiles[0]); index++) {
+        uint64_t exact = latencies[(tf_index_t)(quantiles[index] *
+                                                TF_BENCH_METRICS_REQUESTS) - 1];
+        uint64_t estimate = tf_histogram_get_quantile(&totals.histograms[TF_METRICS_HANDLER],
+                                                      quantiles[index]);
+        double error = (double)(estimate > exact ? estimate - exact : exact - estimate) /
+                       (double)exact;
+        
+        if (error > worst)
+            worst = error;
+        
+        snprintf(param, sizeof(param), "p%g, exact vs histogram", quantiles[index] * 100);
+        TF_BENCH_REPORT("metrics", param, (double)estimate / 1000, "us");
+    }
+    
+    // the text a scrape gets
+    tf_index_t length = tf_metrics_format(metrics, NULL, 0);
+    char* text = malloc(length + 1);
+    
+    started = tf_bench_now_ns();
+    tf_metrics_format(metrics, text, length + 1);
+    double format = (double)(tf_bench_now_ns() - started) / 1000;
+    
+    bool counted = (totals.counters[TF_METRICS_REQUESTS] == TF_BENCH_METRICS_REQUESTS &&
+                    strstr(text, "tinyhttp_handler_seconds_count 2000000\n") != NULL);
+    
+    TF_BENCH_REPORT("metrics", "recording per request", per_request, "ns");
+    TF_BENCH_REPORT("metrics", "timestamp", clock + (double)(sink & 0), "ns");
+    TF_BENCH_REPORT("metrics", "worst quantile error", worst * 100, "%");
+    TF_BENCH_REPORT("metrics", "scrape", format, "us");
+    TF_BENCH_REPORT("metrics", "scrape size", length, "B");
+    
+    free(text);
+    free(latencies);
+    tf_metrics_release(metrics);
+    
+    return ((counted && per_request < TF_BENCH_METRICS_MAX_NS &&
+             worst <= 1.0 / TF_HISTOGRAM_SUB_BUCKETS) ? 0 : 1);
+}
@@ -0,0 +1,309 @@
+//
+//  pool.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include "pool.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// head-of-line blocking of a single worker: latency of a fast endpoint
+// while other connections keep hitting an endpoint that blocks for a
+// while (like disk I/O would), with the slow handler run inline and
+// deferred to the thread pool, plus the cost of the mailbox and of a
+// pool round trip
+//
+
+#define TF_BENCH_POOL_INLINE_PORT 5648
+#define TF_BENCH_POOL_DEFERRED_PORT 5649
+#define TF_BENCH_POOL_THREADS 4
+/// connections hammering the slow endpoint
+#define TF_BENCH_POOL_SLOW_CONNECTIONS 4
+/// how long the slow endpoint blocks
+#define TF_BENCH_POOL_SLOW_US 2000
+/// fast requests measured per run
+#define TF_BENCH_POOL_FAST_REQUESTS 500
+#define TF_BENCH_POOL_TASKS 1000000
+#define TF_BENCH_POOL_ROUND_TRIPS 20000
+
+static const char tf_bench_hello[] = "hello";
+static const char tf_bench_slept[] = "slept";
+
+static const char tf_bench_request_fast[] = "GET /fast HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char tf_bench_request_slow[] = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+static bool tf_bench_stopping;
+
+void tf_bench_pool_block(void) {
+    struct timespec pause = { 0, TF_BENCH_POOL_SLOW_US * 1000l };
+    nanosleep(&pause, NULL);
+}
+
+void tf_bench_pool_handle_slow(const tf_http_request_t* request,
+                               tf_http_response_t* response,
+                               tf_arena_ref arena,
+                               tf_data_ref meta) {
+    (void)(request);
+    (void)(arena);
+    (void)(meta);
+    
+    tf_bench_pool_block();
+    
+    response->body.data = tf_bench_slept;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_slept) - 1);
+}
+
+void tf_bench_pool_handle(tf_http_server_ref server,
+                          tf_conn_ref conn,
+                          const tf_http_request_t* request,
+                          tf_http_response_t* response,
+                          tf_data_ref meta) {
+    (void)(meta);
+    
+    if (!tf_str_view_equals(request->path, "/slow")) {
+        response->body.data = tf_bench_hello;
+        response->body.length = (tf_index_t)(sizeof(tf_bench_hello) - 1);
+        return;
+    }
+    
+    // no pool on the inline server, so this blocks the worker
+    if (tf_http_server_defer(server, conn, tf_bench_pool_handle_slow, NULL))
+        return;
+    
+    tf_bench_pool_handle_slow(request, response, NULL, NULL);
+}
+
+void* tf_bench_pool_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_pool_handle, NULL);
+    return NULL;
+}
+
+/// one request on a keep-alive connection, the responses are tiny and
+/// come in one piece, false on EOF
+bool tf_bench_pool_request(int sock, const char* request, const size_t length) {
+    char buffer[512];
+    size_t received = 0;
+    
+    if (!tf_bench_send(sock, request, length))
+        return false;
+    
+    while (received < sizeof(buffer)) {
+        ssize_t chunk = recv(sock, buffer + received, sizeof(buffer) - received, 0);
+        if (chunk <= 0)
+            return false;
+        
+        received += (size_t)chunk;
+        
+        char* end = memmem(buffer, received, "\r\n\r\n", 4);
+        char* field = memmem(buffer, received, "Content-Length: ", 16);
+        
+        if (end && field && field < end &&
+            (size_t)(end + 4 - buffer) + strtoul(field + 16, NULL, 10) <= received)
+            return true;
+    }
+    
+    return false;
+}
+
+/// keeps requesting the slow endpoint on its own connection until stopped
+void* tf_bench_pool_slow_thread(void* arg) {
+    tf_port_t port = (tf_port_t)(uintptr_t)arg;
+    int sock = tf_bench_connect(port);
+    
+    while (sock >= 0 && !__atomic_load_n(&tf_bench_stopping, __ATOMIC_RELAXED)) {
+        if (!tf_bench_pool_request(sock, tf_bench_request_slow,
+                                   sizeof(tf_bench_request_slow) - 1))
+            break;
+    }
+    
+    if (sock >= 0)
+        close(sock);
+    
+    return NULL;
+}
+
+int tf_bench_pool_compare(const void* left, const void* right) {
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    
+    return (a > b) - (a < b);
+}
+
+/// fast endpoint latencies in us under slow load, p50 and p99, false on failure
+bool tf_bench_pool_run(const tf_port_t port, double* p50p, double* p99p) {
+    static uint64_t latencies[TF_BENCH_POOL_FAST_REQUESTS];
+    pthread_t threads[TF_BENCH_POOL_SLOW_CONNECTIONS];
+    tf_index_t started = 0;
+    bool ok = true;
+    
+    __atomic_store_n(&tf_bench_stopping, false, __ATOMIC_RELAXED);
+    
+    for (; started < TF_BENCH_POOL_SLOW_CONNECTIONS; started++) {
+        if (pthread_create(threads + started, NULL, tf_bench_pool_slow_thread,
+                           (void*)(uintptr_t)port) != 0)
+            break;
+    }
+    
+    // let the slow connections get going
+    usleep(20000);
+    
+    int sock = tf_bench_connect(port);
+    ok = (sock >= 0);
+    
+    for (tf_index_t index = 0; ok && index < TF_BENCH_POOL_FAST_REQUESTS; index++) {
+        uint64_t sent_at = tf_bench_now_ns();
+        
+        ok = tf_bench_pool_request(sock, tf_bench_request_fast,
+                                   sizeof(tf_bench_request_fast) - 1);
+        latencies[index] = tf_bench_now_ns() - sent_at;
+    }
+    
+    if (sock >= 0)
+        close(sock);
+    
+    __atomic_store_n(&tf_bench_stopping, true, __ATOMIC_RELAXED);
+    
+    for (tf_index_t index = 0; index < started; index++)
+        pthread_join(threads[index], NULL);
+    
+    qsort(latencies, TF_BENCH_POOL_FAST_REQUESTS, sizeof(uint64_t), tf_bench_pool_compare);
+    
+    *p50p = (double)latencies[TF_BENCH_POOL_FAST_REQUESTS / 2] / 1000.0;
+    *p99p = (double)latencies[TF_BENCH_POOL_FAST_REQUESTS * 99 / 100] / 1000.0;
+    
+    return (ok && started == TF_BENCH_POOL_SLOW_CONNECTIONS);
+}
+
+bool tf_bench_pool_start(const tf_port_t port, const tf_index_t threads) {
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", port, 64, 1);
+    pthread_t thread;
+    
+    if (!server)
+        return false;
+    
+    tf_http_server_set_pool_size(server, threads);
+    
+    // the server threads are left running, exiting takes them down
+    return (pthread_create(&thread, NULL, tf_bench_pool_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+void tf_bench_pool_count(tf_data_ref data) {
+    (*(uint64_t*)data)++;
+}
+
+void tf_bench_pool_nothing(tf_data_ref data) {
+    (void)(data);
+}
+
+/// posting and running tasks on the same thread, in ns per task
+double tf_bench_pool_mailbox(void) {
+    static tf_task_t tasks[1000];
+    tf_mailbox_ref mailbox = tf_mailbox_init();
+    uint64_t count = 0;
+    
+    if (!mailbox)
+        return -1;
+    
+    for (tf_index_t index = 0; index < 1000; index++) {
+        tasks[index].run = tf_bench_pool_count;
+        tasks[index].data = &count;
+    }
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_POOL_TASKS / 1000; round++) {
+        for (tf_index_t index = 0; index < 1000; index++)
+            tf_mailbox_post(mailbox, tasks + index);
+        
+        tf_mailbox_run(mailbox);
+    }
+    
+    double result = (double)(tf_bench_now_ns() - started) / TF_BENCH_POOL_TASKS;
+    
+    tf_mailbox_release(mailbox);
+    return (count == TF_BENCH_POOL_TASKS ? result : -1);
+}
+
+/// submitting a job and waiting for its completion on the mailbox, in us
+double tf_bench_pool_round_trip(void) {
+    tf_pool_ref pool = tf_pool_init(1);
+    tf_mailbox_ref mailbox = tf_mailbox_init();
+    uint64_t done = 0;
+    double result = -1;
+    
+    tf_pool_job_t job;
+    bzero(&job, sizeof(job));
+    
+    job.run = tf_bench_pool_nothing;
+    job.mailbox = mailbox;
+    job.complete.run = tf_bench_pool_count;
+    job.complete.data = &done;
+    
+    if (pool && mailbox) {
+        struct pollfd watch = { tf_mailbox_get_descriptor(mailbox), POLLIN, 0 };
+        uint64_t started = tf_bench_now_ns();
+        
+        for (tf_index_t index = 0; index < TF_BENCH_POOL_ROUND_TRIPS; index++) {
+            if (!tf_pool_submit(pool, &job))
+                break;
+            
+            while (done <= index) {
+                poll(&watch, 1, -1);
+                tf_mailbox_run(mailbox);
+            }
+        }
+        
+        if (done == TF_BENCH_POOL_ROUND_TRIPS)
+            result = (double)(tf_bench_now_ns() - started) / 1000.0 /
+                     TF_BENCH_POOL_ROUND_TRIPS;
+    }
+    
+    tf_pool_release(pool);
+    tf_mailbox_release(mailbox);
+    
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    if (!tf_bench_pool_start(TF_BENCH_POOL_INLINE_PORT, 0) ||
+        !tf_bench_pool_start(TF_BENCH_POOL_DEFERRED_PORT, TF_BENCH_POOL_THREADS)) {
+        fprintf(stderr, "cannot start the servers\n");
+        return 1;
+    }
+    
+    double inline_p50 = 0, inline_p99 = 0, deferred_p50 = 0, deferred_p99 = 0;
+    bool ok = (tf_bench_pool_run(TF_BENCH_POOL_INLINE_PORT, &inline_p50, &inline_p99) &&
+               tf_bench_pool_run(TF_BENCH_POOL_DEFERRED_PORT, &deferred_p50,
+                                 &deferred_p99));
+    
+    double mailbox = tf_bench_pool_mailbox();
+    double round_trip = tf_bench_pool_round_trip();
+    
+    TF_BENCH_REPORT("pool", "fast p50, slow inline", inline_p50, "us");
+    TF_BENCH_REPORT("pool", "fast p99, slow inline", inline_p99, "us");
+    TF_BENCH_REPORT("pool", "fast p50, slow deferred", deferred_p50, "us");
+    TF_BENCH_REPORT("pool", "fast p99, slow deferred", deferred_p99, "us");
+    TF_BENCH_REPORT("pool", "mailbox post+run", mailbox, "ns/task");
+    TF_BENCH_REPORT("pool", "submit to completion", round_trip, "us/job");
+    
+    // the slow endpoint must not hold up the fast one anymore
+    if (!ok || mailbox < 0 || round_trip < 0 || deferred_p99 >= inline_p99) {
+        fprintf(stderr, "deferring does not help the fast endpoint\n");
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,327 @@
+//
+//  proxy.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bufpool.h"
+#include "proxy.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// reverse proxy: small requests one after the other on a keep-alive
+// connection, straight to an in-process backend, through a proxy that
+// pools its upstream connections and through one that opens a new
+// connection for every request, then a big download and a big upload
+// through the pooling one, throughput and the most pooled buffer memory in
+// use at once
+//
+// the bench fails if the pooling proxy doesn't reuse its connections or a
+// big body is held in memory as a whole (the peak goes over
+// TF_BENCH_PROXY_MAX_PEAK)
+//
+
+#define TF_BENCH_PROXY_BACKEND_PORT 5660
+#define TF_BENCH_PROXY_POOLED_PORT 5661
+#define TF_BENCH_PROXY_UNPOOLED_PORT 5662
+#define TF_BENCH_PROXY_REQUESTS 5000
+#define TF_BENCH_PROXY_BODY (32 * 1024 * 1024)
+/// what the client sends at once
+#define TF_BENCH_PROXY_PIECE (64 * 1024)
+/// the high water marks of both sides and the backend's own stream ahead
+#define TF_BENCH_PROXY_MAX_PEAK (4 * 1024 * 1024)
+
+static const char tf_bench_proxy_hello[] = "hello";
+static const char tf_bench_request_small[] = "GET /small HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char tf_bench_request_download[] =
+    "GET /download HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+//
+// in-process backend
+//
+
+tf_index_t tf_bench_proxy_produce(char* buffer, const tf_index_t capacity, bool* endp,
+                                  tf_data_ref meta) {
+    uint64_t* offset = (uint64_t*)meta;
+    uint64_t left = TF_BENCH_PROXY_BODY - *offset;
+    tf_index_t length = (left < capacity ? (tf_index_t)left : capacity);
+    
+    memset(buffer, 'd', length);
+    *offset += length;
+    *endp = (*offset >= TF_BENCH_PROXY_BODY);
+    
+    return length;
+}
+
+bool tf_bench_proxy_count(const char* data, const tf_index_t length, tf_data_ref meta) {
+    (void)(data);
+    
+    *(uint64_t*)meta += length;
+    return true;
+}
+
+void tf_bench_proxy_complete(const tf_http_request_t* request,
+                             const uint16_t error,
+                             tf_http_response_t* response,
+                             tf_arena_ref arena,
+                             tf_data_ref meta) {
+    (void)(request);
+    (void)(arena);
+    
+    uint64_t* counted = (uint64_t*)meta;
+    
+    if (error < 1)
+        response->status = (*counted == TF_BENCH_PROXY_BODY ? 201 : 500);
+    
+    free(counted);
+}
+
+void tf_bench_proxy_backend_handle(tf_http_server_ref server,
+                                   tf_conn_ref conn,
+                                   const tf_http_request_t* request,
+                                   tf_http_response_t* response,
+                                   tf_data_ref meta) {
+    (void)(meta);
+    
+    if (tf_str_view_equals(request->path, "/download")) {
+        tf_http_stream_ref stream = tf_http_server_stream(server, conn, request);
+        
+        tf_http_stream_set_producer(stream, tf_bench_proxy_produce,
+                                    calloc(1, sizeof(uint64_t)), free);
+        return;
+    }
+    
+    if (tf_str_view_equals(request->path, "/upload")) {
+        uint64_t* counted = calloc(1, sizeof(uint64_t));
+        tf_http_body_ref body = tf_http_server_receive_body(server, conn, request,
+                                                            tf_bench_proxy_complete, counted);
+        
+        if (body)
+            tf_http_body_set_handler(body, tf_bench_proxy_count);
+        else {
+            free(counted);
+            response->status = 500;
+        }
+        
+        return;
+    }
+    
+    response->body.data = tf_bench_proxy_hello;
+    response->body.length = (tf_index_t)(sizeof(tf_bench_proxy_hello) - 1);
+}
+
+typedef struct {
+    tf_http_server_ref server;
+    tf_http_handler_t handler;
+    tf_data_ref meta;
+} tf_bench_proxy_server_t;
+
+void* tf_bench_proxy_server_thread(void* arg) {
+    tf_bench_proxy_server_t* server = (tf_bench_proxy_server_t*)arg;
+    
+    tf_http_server_listen(server->server, server->handler, server->meta);
+    return NULL;
+}
+
+/// starts a server on port, with a proxy to the backend unless it's the
+/// backend, the server threads are left running, exiting takes them down
+bool tf_bench_proxy_start(const tf_port_t port, const tf_index_t max_idle,
+                          tf_proxy_ref* proxyp) {
+    static tf_bench_proxy_server_t servers[3];
+    static tf_index_t count = 0;
+    tf_bench_proxy_server_t* server = &servers[count++];
+    pthread_t thread;
+    
+    server->server = tf_http_server_init("127.0.0.1", port, 64, 1);
+    server->handler = tf_bench_proxy_backend_handle;
+    
+    if (!server->server)
+        return false;
+    
+    if (proxyp) {
+        char address[32];
+        snprintf(address, sizeof(address), "127.0.0.1:%d", TF_BENCH_PROXY_BACKEND_PORT);
+        
+        *proxyp = tf_proxy_init(server->server);
+        
+        if (!*proxyp || !tf_proxy_add_upstream(*proxyp, address))
+            return false;
+        
+        tf_proxy_set_max_idle(*proxyp, max_idle);
+        
+        server->handler = tf_proxy_handle;
+        server->meta = *proxyp;
+    }
+    
+    return (pthread_create(&thread, NULL, tf_bench_proxy_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+//
+// client
+//
+
+/// small requests one after the other on one connection, requests per
+/// second, 0 if one failed
+double tf_bench_proxy_requests(const tf_port_t port) {
+    int sock = tf_bench_connect(port);
+    bool success = (sock >= 0);
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; success && index < TF_BENCH_PROXY_REQUESTS; index++)
+        success = (tf_bench_send(sock, tf_bench_request_small,
+                                 sizeof(tf_bench_request_small) - 1) &&
+                   tf_bench_receive(sock, 1));
+    
+    uint64_t total = tf_bench_now_ns() - started;
+    
+    if (sock >= 0)
+        close(sock);
+    
+    return (success ? TF_BENCH_PROXY_REQUESTS / ((double)total / 1e9) : 0);
+}
+
+/// the big body from the backend through the proxy, nanoseconds until the
+/// proxy closes, false if less than the body came back
+bool tf_bench_proxy_download(uint64_t* totalp) {
+    static char buffer[256 * 1024];
+    int sock = tf_bench_connect(TF_BENCH_PROXY_POOLED_PORT);
+    uint64_t received = 0;
+    
+    if (sock < 0)
+        return false;
+    
+    uint64_t started = tf_bench_now_ns();
+    bool success = tf_bench_send(sock, tf_bench_request_download,
+                                 sizeof(tf_bench_request_download) - 1);
+    
+    while (success) {
+        ssize_t chunk = recv(sock, buffer, sizeof(buffer), 0);
+        if (chunk <= 0)
+            break;
+        
+        received += (uint64_t)chunk;
+    }
+    
+    *totalp = tf_bench_now_ns() - started;
+    close(sock);
+    
+    // the head and the chunk framing come on top
+    return (success && received > TF_BENCH_PROXY_BODY);
+}
+
+/// the big body to the backend through the proxy, nanoseconds until the
+/// response is in, false unless it's a 201
+bool tf_bench_proxy_upload(const char* piece, uint64_t* totalp) {
+    char head[256];
+    char response[1024];
+    int sock = tf_bench_connect(TF_BENCH_PROXY_POOLED_PORT);
+    
+    if (sock < 0)
+        return false;
+    
+    int hlen = snprintf(head, sizeof(head), "PUT /upload HTTP/1.1\r\nHost: localhost\r\n"
+                        "Connection: close\r\nContent-Length: %d\r\n\r\n", TF_BENCH_PROXY_BODY);
+    uint64_t started = tf_bench_now_ns();
+    bool success = tf_bench_send(sock, head, (size_t)hlen);
+    
+    for (tf_index_t sent = 0; success && sent < TF_BENCH_PROXY_BODY; sent += TF_BENCH_PROXY_PIECE)
+        success = tf_bench_send(sock, piece, TF_BENCH_PROXY_PIECE);
+    
+    size_t length = 0;
+    
+    while (success && length < sizeof(response) - 1) {
+        ssize_t chunk = recv(sock, response + length, sizeof(response) - 1 - length, 0);
+        if (chunk <= 0)
+            break;
+        
+        length += (size_t)chunk;
+    }
+    
+    *totalp = tf_bench_now_ns() - started;
+    close(sock);
+    
+    return (success && length > 12 && strncmp(response, "HTTP/1.1 201", 12) == 0);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    static char piece[TF_BENCH_PROXY_PIECE];
+    tf_proxy_ref pooled = NULL;
+    tf_proxy_ref unpooled = NULL;
+    
+    memset(piece, 'u', sizeof(piece));
+    tf_bench_raise_fd_limit();
+    
+    if (!tf_bench_proxy_start(TF_BENCH_PROXY_BACKEND_PORT, 0, NULL) ||
+        !tf_bench_proxy_start(TF_BENCH_PROXY_POOLED_PORT, TF_PROXY_DEFAULT_MAX_IDLE, &pooled) ||
+        !tf_bench_proxy_start(TF_BENCH_PROXY_UNPOOLED_PORT, 0, &unpooled)) {
+        fprintf(stderr, "cannot start the servers\n");
+        return 1;
+    }
+    
+    double direct = tf_bench_proxy_requests(TF_BENCH_PROXY_BACKEND_PORT);
+    double reused = tf_bench_proxy_requests(TF_BENCH_PROXY_POOLED_PORT);
+    double opened = tf_bench_proxy_requests(TF_BENCH_PROXY_UNPOOLED_PORT);
+    tf_proxy_stats_t stats;
+    
+    TF_BENCH_REPORT("proxy", "small requests, direct", direct, "req/s");
+    TF_BENCH_REPORT("proxy", "small requests, pooled", reused, "req/s");
+    TF_BENCH_REPORT("proxy", "small requests, connection per request", opened, "req/s");
+    
+    tf_proxy_get_stats(pooled, &stats);
+    TF_BENCH_REPORT("proxy", "pooled, upstream connections", (double)stats.connects,
+                    "connections");
+    
+    if (direct <= 0 || reused <= 0 || opened <= 0) {
+        fprintf(stderr, "a request did not make it\n");
+        return 1;
+    }
+    
+    // one connection for the one client, whatever the request count
+    if (stats.connects > TF_BENCH_PROXY_REQUESTS / 100) {
+        fprintf(stderr, "upstream connections are not reused\n");
+        return 1;
+    }
+    
+    tf_bench_sampler_t sampler;
+    uint64_t download = 0;
+    uint64_t upload = 0;
+    
+    if (!tf_bench_sampler_start(&sampler))
+        return 1;
+    
+    bool ok = (tf_bench_proxy_download(&download) && tf_bench_proxy_upload(piece, &upload));
+    
+    uint64_t peak = tf_bench_sampler_stop(&sampler);
+    
+    TF_BENCH_REPORT("proxy", "32 MiB download",
+                    (TF_BENCH_PROXY_BODY / (1024.0 * 1024.0)) / ((double)download / 1e9),
+                    "MiB/s");
+    TF_BENCH_REPORT("proxy", "32 MiB upload",
+                    (TF_BENCH_PROXY_BODY / (1024.0 * 1024.0)) / ((double)upload / 1e9),
+                    "MiB/s");
+    TF_BENCH_REPORT("proxy", "32 MiB bodies, peak buffers",
+                    (double)peak / 1024.0, "KiB");
+    
+    if (!ok) {
+        fprintf(stderr, "a big body did not make it\n");
+        return 1;
+    }
+    
+    if (peak > TF_BENCH_PROXY_MAX_PEAK) {
+        fprintf(stderr, "proxied bodies are held in memory\n");
+        return 1;
+    }
+    
+    return 0;
+}
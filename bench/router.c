@@ -0,0 +1,227 @@
+//
+//  router.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "router.h"
+#include "bench.h"
+
+//
+// route matching with 10 to 5000 routes (static, captures and wildcard
+// tails mixed), then with growing path lengths in the biggest table, the
+// time per match has to follow the path length and stay flat over the
+// route count
+//
+// each time is the best of TF_BENCH_ROUTER_RUNS, the bound on the growth
+// leaves room for the bigger table's cache misses, a table walked route by
+// route would be hundreds of times slower
+//
+
+/// matches per measurement
+#define TF_BENCH_ROUTER_MATCHES 1000000
+/// measurements per time, the fastest one counts
+#define TF_BENCH_ROUTER_RUNS 5
+/// the biggest table may be this much slower per match than the smallest
+#define TF_BENCH_ROUTER_MAX_GROWTH 10.0
+
+typedef struct {
+    char path[128];
+    // expected route and captures
+    tf_index_t route;
+    const char* params[2];
+} tf_bench_route_t;
+
+void tf_bench_route_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           const tf_router_match_t* match,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(server);
+    (void)(conn);
+    (void)(request);
+    (void)(match);
+    (void)(response);
+    (void)(meta);
+}
+
+/// adds count routes, fills paths with one request path per route
+tf_router_ref tf_bench_make_router(const tf_index_t count, tf_bench_route_t* paths) {
+    tf_router_ref router = tf_router_init();
+    char pattern[128];
+    
+    for (tf_index_t index = 0; index < count; index++) {
+        tf_bench_route_t* route = paths + index;
+        
+        route->route = index;
+        route->params[0] = NULL;
+        route->params[1] = NULL;
+        
+        switch (index % 4) {
+            case 0:
+                snprintf(pattern, sizeof(pattern), "/api/v1/resource%u", index);
+                snprintf(route->path, sizeof(route->path), "/api/v1/resource%u", index);
+                break;
+            
+            case 1:
+                snprintf(pattern, sizeof(pattern), "/api/v1/resource%u/:id", index);
+                snprintf(route->path, sizeof(route->path), "/api/v1/resource%u/42", index);
+                route->params[0] = "42";
+                break;
+            
+            case 2:
+                snprintf(pattern, sizeof(pattern), "/api/v1/resource%u/:id/items/:item", index);
+                snprintf(route->path, sizeof(route->path),
+                         "/api/v1/resource%u/42/items/7", index);
+                route->params[0] = "42";
+                route->params[1] = "7";
+                break;
+            
+            default:
+                snprintf(pattern, sizeof(pattern), "/files%u/*path", index);
+                snprintf(route->path, sizeof(route->path), "/files%u/css/site.css", index);
+                route->params[0] = "css/site.css";
+                break;
+        }
+        
+        tf_router_add(router, "GET", pattern, tf_bench_route_handle,
+                      (tf_data_ref)(uintptr_t)(index + 1));
+    }
+    
+    tf_router_build(router);
+    return router;
+}
+
+bool tf_bench_route_check(const tf_router_ref router, const tf_bench_route_t* route) {
+    tf_router_match_t match;
+    tf_str_view_t path = { route->path, (tf_index_t)strlen(route->path) };
+    tf_str_view_t method = { "GET", 3 };
+    
+    if (tf_router_match(router, method, path, &match) != TF_ROUTER_FOUND ||
+        match.meta != (tf_data_ref)(uintptr_t)(route->route + 1))
+        return false;
+    
+    for (tf_index_t index = 0; index < 2; index++) {
+        if (!route->params[index])
+            return (match.param_count == index);
+        
+        if (index >= match.param_count ||
+            !tf_str_view_equals(match.params[index].value, route->params[index]))
+            return false;
+    }
+    
+    return true;
+}
+
+/// best ns per match over the given paths, -1 if any of them is matched
+/// wrong
+double tf_bench_router_time(const tf_router_ref router, const tf_bench_route_t* paths,
+                            const tf_index_t count) {
+    tf_str_view_t* views = malloc(count * sizeof(tf_str_view_t));
+    tf_str_view_t method = { "GET", 3 };
+    tf_router_match_t match;
+    bool correct = true;
+    
+    for (tf_index_t index = 0; index < count; index++) {
+        views[index].data = paths[index].path;
+        views[index].length = (tf_index_t)strlen(paths[index].path);
+        
+        correct = (tf_bench_route_check(router, paths + index) && correct);
+    }
+    
+    double best = 0;
+    
+    for (tf_index_t run = 0; correct && run < TF_BENCH_ROUTER_RUNS; run++) {
+        tf_index_t found = 0;
+        uint64_t started = tf_bench_now_ns();
+        
+        for (tf_index_t round = 0; round < TF_BENCH_ROUTER_MATCHES; round++) {
+            // pseudo-random order
+            tf_index_t index = (tf_index_t)(((uint64_t)round * 2654435761u) % count);
+            
+            found += (tf_router_match(router, method, views[index], &match) == TF_ROUTER_FOUND);
+        }
+        
+        double elapsed = (double)(tf_bench_now_ns() - started) / TF_BENCH_ROUTER_MATCHES;
+        
+        correct = (found == TF_BENCH_ROUTER_MATCHES);
+        
+        if (run == 0 || elapsed < best)
+            best = elapsed;
+    }
+    
+    free(views);
+    return (correct ? best : -1);
+}
+
+/// static path of the given segment count next to count routes
+double tf_bench_router_depth(const tf_index_t count, const tf_index_t segments) {
+    tf_bench_route_t* paths = malloc((count + 1) * sizeof(tf_bench_route_t));
+    tf_router_ref router = tf_bench_make_router(count, paths);
+    tf_bench_route_t* deep = paths + count;
+    size_t length = 0;
+    
+    for (tf_index_t index = 0; index < segments; index++)
+        length += (size_t)snprintf(deep->path + length, sizeof(deep->path) - length,
+                                   "/s%u", index % 10);
+    
+    deep->route = count;
+    deep->params[0] = NULL;
+    deep->params[1] = NULL;
+    
+    tf_router_add(router, "GET", deep->path, tf_bench_route_handle,
+                  (tf_data_ref)(uintptr_t)(count + 1));
+    tf_router_build(router);
+    
+    double result = tf_bench_router_time(router, deep, 1);
+    
+    tf_router_release(router);
+    free(paths);
+    
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    static const tf_index_t sizes[] = { 10, 100, 1000, 5000 };
+    double times[sizeof(sizes) / sizeof(sizes[0])];
+    bool result = true;
+    char param[64];
+    
+    for (tf_index_t index = 0; index < sizeof(sizes) / sizeof(sizes[0]); index++) {
+        tf_bench_route_t* paths = malloc(sizes[index] * sizeof(tf_bench_route_t));
+        tf_router_ref router = tf_bench_make_router(sizes[index], paths);
+        
+        times[index] = tf_bench_router_time(router, paths, sizes[index]);
+        result = (times[index] > 0 && result);
+        
+        snprintf(param, sizeof(param), "match, %u routes", sizes[index]);
+        TF_BENCH_REPORT("router", param, times[index], "ns/op");
+        snprintf(param, sizeof(param), "tree nodes, %u routes", sizes[index]);
+        TF_BENCH_REPORT("router", param, tf_router_get_node_count(router), "");
+        
+        tf_router_release(router);
+        free(paths);
+    }
+    
+    for (tf_index_t segments = 2; segments <= 32; segments *= 4) {
+        double elapsed = tf_bench_router_depth(5000, segments);
+        
+        result = (elapsed > 0 && result);
+        
+        snprintf(param, sizeof(param), "match, %u segments", segments);
+        TF_BENCH_REPORT("router", param, elapsed, "ns/op");
+    }
+    
+    double growth = times[3] / times[0];
+    
+    TF_BENCH_REPORT("router", "5000 vs 10 routes", growth, "x");
+    return ((result && growth <= TF_BENCH_ROUTER_MAX_GROWTH) ? 0 : 1);
+}
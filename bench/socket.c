@@ -0,0 +1,203 @@
+//
+//  socket.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bufpool.h"
+#include "tcp.h"
+#include "bench.h"
+
+//
+// the socket read/write path of the server over a loopback TCP connection:
+// tf_socket_send_data and tf_socket_read_data for a few message sizes, and
+// a response split into head and body going out with tf_socket_send_buffers
+// in one call vs one tf_socket_send_data per buffer
+//
+
+#define TF_BENCH_SOCKET_ROUNDS 20000
+#define TF_BENCH_SOCKET_HEAD_SIZE 160
+
+static const tf_index_t tf_bench_socket_sizes[] = { 64, 1024, 16384, 65536 };
+
+/// connected loopback pair, false on failure
+bool tf_bench_socket_pair(tf_socket_t* writerp, tf_socket_t* readerp) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    
+    bzero(&address, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    tf_socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listener, 1) < 0 ||
+        getsockname(listener, (struct sockaddr*)&address, &length) < 0) {
+        close(listener);
+        return false;
+    }
+    
+    *writerp = tf_bench_connect(ntohs(address.sin_port));
+    *readerp = accept(listener, NULL, NULL);
+    
+    close(listener);
+    return (*writerp >= 0 && *readerp >= 0);
+}
+
+/// reads until length bytes are in, false if the connection broke
+bool tf_bench_socket_drain(tf_socket_t reader, char* buffer, const tf_index_t capacity,
+                           tf_index_t* receivedp, const tf_index_t length) {
+    while (*receivedp < length) {
+        tf_index_t received = 0;
+        
+        if (!tf_socket_read_data(reader, buffer, capacity, &received))
+            return false;
+        
+        if (received < 1)
+            return true; // the rest is still on its way
+        
+        *receivedp += received;
+    }
+    
+    return true;
+}
+
+/// one message of size bytes written and read back per round, ns/round
+double tf_bench_socket_run_data(tf_socket_t writer, tf_socket_t reader, const tf_index_t size) {
+    char* data = calloc(1, size);
+    char* buffer = malloc(size);
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_SOCKET_ROUNDS; round++) {
+        tf_index_t sent = 0;
+        tf_index_t received = 0;
+        
+        while (received < size) {
+            tf_index_t chunk = 0;
+            
+            if ((sent < size && !tf_socket_send_data(writer, data + sent, size - sent, &chunk)) ||
+                !tf_bench_socket_drain(reader, buffer, size, &received, sent + chunk)) {
+                free(data);
+                free(buffer);
+                return -1;
+            }
+            
+            sent += chunk;
+        }
+    }
+    
+    double result = (double)(tf_bench_now_ns() - started) / TF_BENCH_SOCKET_ROUNDS;
+    
+    free(data);
+    free(buffer);
+    return result;
+}
+
+/// head and body of a response, gathered or one write each, ns/round
+double tf_bench_socket_run_response(tf_socket_t writer, tf_socket_t reader,
+                                    const tf_index_t body_size, const bool gathered) {
+    char* body = calloc(1, body_size);
+    char head[TF_BENCH_SOCKET_HEAD_SIZE];
+    tf_index_t total = TF_BENCH_SOCKET_HEAD_SIZE + body_size;
+    char* buffer = malloc(total);
+    double result = -1;
+    
+    memset(head, 'h', sizeof(head));
+    
+    tf_buffer_ref chain = tf_buffer_chain_append(NULL, head, sizeof(head));
+    tf_buffer_ref last = tf_buffer_acquire(body_size);
+    
+    memcpy(tf_buffer_get_data(last), body, body_size);
+    tf_buffer_set_length(last, body_size);
+    tf_buffer_set_next(chain, last);
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t round = 0; round < TF_BENCH_SOCKET_ROUNDS; round++) {
+        tf_index_t sent = 0;
+        tf_index_t received = 0;
+        
+        while (received < total) {
+            tf_index_t chunk = 0;
+            bool success = true;
+            
+            if (gathered && sent < total) {
+                success = tf_socket_send_buffers(writer, chain, sent, &chunk);
+            } else if (sent < total) {
+                // what writing the chain buffer by buffer would do
+                bool in_head = (sent < TF_BENCH_SOCKET_HEAD_SIZE);
+                
+                success = tf_socket_send_data(writer, (in_head ? head + sent :
+                                                       body + sent - TF_BENCH_SOCKET_HEAD_SIZE),
+                                              (in_head ? TF_BENCH_SOCKET_HEAD_SIZE :
+                                               total) - sent, &chunk);
+            }
+            
+            if (!success || !tf_bench_socket_drain(reader, buffer, total, &received,
+                                                   sent + chunk))
+                goto cleanup;
+            
+            sent += chunk;
+        }
+    }
+    
+    result = (double)(tf_bench_now_ns() - started) / TF_BENCH_SOCKET_ROUNDS;
+    
+cleanup:
+    tf_buffer_release(chain);
+    free(body);
+    free(buffer);
+    
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_socket_t writer = -1;
+    tf_socket_t reader = -1;
+    bool success = tf_bench_socket_pair(&writer, &reader);
+    char param[64];
+    
+    for (tf_index_t index = 0;
+         success && index < sizeof(tf_bench_socket_sizes) / sizeof(tf_bench_socket_sizes[0]);
+         index++) {
+        tf_index_t size = tf_bench_socket_sizes[index];
+        double round = tf_bench_socket_run_data(writer, reader, size);
+        
+        success = (round > 0);
+        
+        snprintf(param, sizeof(param), "send+read, %u B", size);
+        TF_BENCH_REPORT("socket", param, round, "ns/op");
+        snprintf(param, sizeof(param), "throughput, %u B", size);
+        TF_BENCH_REPORT("socket", param, (double)size * 1e3 / round, "MB/s");
+    }
+    
+    for (tf_index_t index = 0; success && index < 2; index++) {
+        tf_index_t size = (index > 0 ? 16384 : 512);
+        double single = tf_bench_socket_run_response(writer, reader, size, false);
+        double gathered = tf_bench_socket_run_response(writer, reader, size, true);
+        
+        success = (single > 0 && gathered > 0);
+        
+        snprintf(param, sizeof(param), "response %u B, 2 sends", size);
+        TF_BENCH_REPORT("socket", param, single, "ns/op");
+        snprintf(param, sizeof(param), "response %u B, gathered", size);
+        TF_BENCH_REPORT("socket", param, gathered, "ns/op");
+    }
+    
+    if (!success)
+        printf("socket: loopback connection failed\n");
+    
+    close(writer);
+    close(reader);
+    
+    return (success ? 0 : 1);
+}
@@ -0,0 +1,206 @@
+//
+//  stream.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "arena.h"
+#include "bufpool.h"
+#include "conn.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// streamed responses: the same big generated body sent as one buffered
+// response and as a streamed one made by a producer, time to the first
+// byte, throughput and the most pooled buffer memory in use at once
+//
+// a streamed body must not be held in memory as a whole, the bench fails
+// if the peak goes over TF_BENCH_STREAM_MAX_PEAK
+//
+
+#define TF_BENCH_STREAM_PORT 5652
+#define TF_BENCH_STREAM_BODY (32 * 1024 * 1024)
+#define TF_BENCH_STREAM_RUNS 3
+/// TF_HTTP_SERVER_STREAM_AHEAD plus what the buffers around it may hold
+#define TF_BENCH_STREAM_MAX_PEAK (1024 * 1024)
+
+static const char tf_bench_request_buffered[] =
+    "GET /buffered HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+static const char tf_bench_request_streamed[] =
+    "GET /streamed HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+/// the body, byte by byte
+static inline void tf_bench_stream_fill(char* data, const tf_index_t length,
+                                        const uint64_t offset) {
+    for (tf_index_t index = 0; index < length; index++)
+        data[index] = (char)('a' + (offset + index) % 26);
+}
+
+tf_index_t tf_bench_stream_produce(char* buffer, const tf_index_t capacity, bool* endp,
+                                   tf_data_ref meta) {
+    uint64_t* offset = (uint64_t*)meta;
+    uint64_t left = TF_BENCH_STREAM_BODY - *offset;
+    tf_index_t length = (left < capacity ? (tf_index_t)left : capacity);
+    
+    tf_bench_stream_fill(buffer, length, *offset);
+    *offset += length;
+    *endp = (*offset >= TF_BENCH_STREAM_BODY);
+    
+    return length;
+}
+
+void tf_bench_stream_handle(tf_http_server_ref server,
+                            tf_conn_ref conn,
+                            const tf_http_request_t* request,
+                            tf_http_response_t* response,
+                            tf_data_ref meta) {
+    (void)(meta);
+    
+    response->content_type = "text/plain";
+    
+    if (tf_str_view_equals(request->path, "/buffered")) {
+        char* body = tf_arena_alloc(tf_conn_get_arena(conn), TF_BENCH_STREAM_BODY);
+        
+        tf_bench_stream_fill(body, TF_BENCH_STREAM_BODY, 0);
+        
+        response->body.data = body;
+        response->body.length = TF_BENCH_STREAM_BODY;
+        return;
+    }
+    
+    tf_http_stream_ref stream = tf_http_server_stream(server, conn, request);
+    uint64_t* offset = calloc(1, sizeof(uint64_t));
+    
+    tf_http_stream_set_producer(stream, tf_bench_stream_produce, offset, free);
+}
+
+void* tf_bench_stream_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_stream_handle, NULL);
+    return NULL;
+}
+
+///
+/// requests request on a fresh connection and reads the response until the
+/// server closes it, time to the first byte and to the last one in
+/// nanoseconds, false if less than the body came back
+///
+bool tf_bench_stream_run(const char* request, uint64_t* firstp, uint64_t* totalp) {
+    static char buffer[256 * 1024];
+    int sock = tf_bench_connect(TF_BENCH_STREAM_PORT);
+    uint64_t received = 0;
+    
+    if (sock < 0)
+        return false;
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    if (!tf_bench_send(sock, request, strlen(request))) {
+        close(sock);
+        return false;
+    }
+    
+    while (true) {
+        ssize_t chunk = recv(sock, buffer, sizeof(buffer), 0);
+        if (chunk <= 0)
+            break;
+        
+        if (received < 1)
+            *firstp = tf_bench_now_ns() - started;
+        
+        received += (uint64_t)chunk;
+    }
+    
+    *totalp = tf_bench_now_ns() - started;
+    close(sock);
+    
+    // head and chunk framing come on top of the body
+    return (received > TF_BENCH_STREAM_BODY);
+}
+
+/// best of a few runs, returns false if one of them fails
+bool tf_bench_stream_measure(const char* request, double* ttfbp, double* throughputp,
+                             double* peakp) {
+    uint64_t best_first = UINT64_MAX;
+    uint64_t best_total = UINT64_MAX;
+    tf_bench_sampler_t sampler;
+    
+    if (!tf_bench_sampler_start(&sampler))
+        return false;
+    
+    bool ok = true;
+    
+    for (tf_index_t run = 0; ok && run < TF_BENCH_STREAM_RUNS; run++) {
+        uint64_t first = 0;
+        uint64_t total = 0;
+        
+        ok = tf_bench_stream_run(request, &first, &total);
+        
+        if (first < best_first)
+            best_first = first;
+        if (total < best_total)
+            best_total = total;
+    }
+    
+    uint64_t peak = tf_bench_sampler_stop(&sampler);
+    
+    *ttfbp = (double)best_first / 1e6;
+    *throughputp = (double)TF_BENCH_STREAM_BODY * 1e9 / (double)best_total / 1e6;
+    *peakp = (double)peak / 1024.0;
+    
+    return ok;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", TF_BENCH_STREAM_PORT,
+                                                    16, 1);
+    pthread_t thread;
+    
+    // the server thread is left running, exiting takes it down
+    if (!server || pthread_create(&thread, NULL, tf_bench_stream_server_thread, server) != 0 ||
+        !tf_bench_wait_for_port(TF_BENCH_STREAM_PORT)) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    double buffered_ttfb = 0;
+    double buffered_throughput = 0;
+    double buffered_peak = 0;
+    double streamed_ttfb = 0;
+    double streamed_throughput = 0;
+    double streamed_peak = 0;
+    
+    bool ok = (tf_bench_stream_measure(tf_bench_request_buffered, &buffered_ttfb,
+                                       &buffered_throughput, &buffered_peak) &&
+               tf_bench_stream_measure(tf_bench_request_streamed, &streamed_ttfb,
+                                       &streamed_throughput, &streamed_peak));
+    
+    if (!ok) {
+        fprintf(stderr, "requests failed\n");
+        return 1;
+    }
+    
+    TF_BENCH_REPORT("stream", "32 MiB buffered, first byte", buffered_ttfb, "ms");
+    TF_BENCH_REPORT("stream", "32 MiB buffered", buffered_throughput, "MB/s");
+    TF_BENCH_REPORT("stream", "32 MiB buffered, peak buffers", buffered_peak, "KiB");
+    TF_BENCH_REPORT("stream", "32 MiB streamed, first byte", streamed_ttfb, "ms");
+    TF_BENCH_REPORT("stream", "32 MiB streamed", streamed_throughput, "MB/s");
+    TF_BENCH_REPORT("stream", "32 MiB streamed, peak buffers", streamed_peak, "KiB");
+    
+    // what streaming is for
+    if (streamed_peak * 1024.0 > TF_BENCH_STREAM_MAX_PEAK) {
+        fprintf(stderr, "streamed responses are held in memory\n");
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,102 @@
+//
+//  timer.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "timer.h"
+#include "bench.h"
+
+//
+// timer wheel operations with a connection-table-sized amount of timers,
+// deadlines spread over a minute like keep-alive/header timeouts, then
+// the wheel is run to the end and every timer has to fire exactly once
+// and never early
+//
+
+#define TF_BENCH_TIMER_COUNT 100000
+/// deadlines are spread over this many milliseconds
+#define TF_BENCH_TIMER_SPAN 60000
+/// event loop wakeup interval while running the wheel
+#define TF_BENCH_TIMER_STEP 7
+
+static tf_timer_t tf_bench_timers[TF_BENCH_TIMER_COUNT];
+static uint8_t tf_bench_fired[TF_BENCH_TIMER_COUNT];
+
+uint64_t tf_bench_deadline(const uint64_t now, const tf_index_t index,
+                           const tf_index_t round) {
+    return now + 1 + (((uint64_t)(index + round) * 2654435761u) % TF_BENCH_TIMER_SPAN);
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    uint64_t now = 1000000;
+    tf_timer_wheel_ref wheel = tf_timer_wheel_init(now);
+    
+    for (tf_index_t index = 0; index < TF_BENCH_TIMER_COUNT; index++)
+        tf_bench_timers[index].data = tf_bench_fired + index;
+    
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_TIMER_COUNT; index++)
+        tf_timer_wheel_arm(wheel, tf_bench_timers + index, tf_bench_deadline(now, index, 0));
+    
+    double arm = (double)(tf_bench_now_ns() - started) / TF_BENCH_TIMER_COUNT;
+    
+    // what every read/write does to its connection's deadline
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_TIMER_COUNT; index++)
+        tf_timer_wheel_arm(wheel, tf_bench_timers + index, tf_bench_deadline(now, index, 1));
+    
+    double rearm = (double)(tf_bench_now_ns() - started) / TF_BENCH_TIMER_COUNT;
+    
+    // every fourth one goes away, as closed connections do
+    started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; index < TF_BENCH_TIMER_COUNT; index += 4)
+        tf_timer_wheel_cancel(wheel, tf_bench_timers + index);
+    
+    double cancel = (double)(tf_bench_now_ns() - started) / (TF_BENCH_TIMER_COUNT / 4);
+    
+    tf_index_t expired = 0;
+    tf_index_t early = 0;
+    uint64_t end = now + TF_BENCH_TIMER_SPAN + 100;
+    
+    started = tf_bench_now_ns();
+    
+    while (now < end) {
+        now += TF_BENCH_TIMER_STEP;
+        
+        tf_timer_wheel_advance(wheel, now);
+        
+        tf_timer_t* timer = NULL;
+        while ((timer = tf_timer_wheel_pop_expired(wheel))) {
+            early += (timer->expires_at > now);
+            (*(uint8_t*)timer->data)++;
+            
+            expired++;
+        }
+    }
+    
+    double run = (double)(tf_bench_now_ns() - started) / (expired ? expired : 1);
+    
+    tf_index_t wrong = 0;
+    for (tf_index_t index = 0; index < TF_BENCH_TIMER_COUNT; index++)
+        wrong += (tf_bench_fired[index] != (index % 4 ? 1 : 0));
+    
+    TF_BENCH_REPORT("timer", "arm", arm, "ns/op");
+    TF_BENCH_REPORT("timer", "re-arm", rearm, "ns/op");
+    TF_BENCH_REPORT("timer", "cancel", cancel, "ns/op");
+    TF_BENCH_REPORT("timer", "advance + expire", run, "ns/timer");
+    TF_BENCH_REPORT("timer", "wrong/early expirations", wrong + early, "");
+    
+    tf_timer_wheel_release(wheel);
+    return ((wrong == 0 && early == 0) ? 0 : 1);
+}
@@ -0,0 +1,264 @@
+//
+//  upload.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bufpool.h"
+#include "server.h"
+#include "bench.h"
+
+//
+// request bodies received after the handler: a big upload taken by a body
+// handler piece by piece, written into a file (spliced from the socket
+// where the TCP server can) and sent chunked into the same file,
+// throughput and the most pooled buffer memory in use at once
+//
+// the body must never be held in memory as a whole, the bench fails if the
+// peak goes over TF_BENCH_UPLOAD_MAX_PEAK or the server doesn't get all of
+// it
+//
+
+#define TF_BENCH_UPLOAD_PORT 5658
+#define TF_BENCH_UPLOAD_BODY (32 * 1024 * 1024)
+#define TF_BENCH_UPLOAD_RUNS 3
+/// the input buffer with room for a read or two
+#define TF_BENCH_UPLOAD_MAX_PEAK (1024 * 1024)
+/// what the client sends at once, also the size of every chunk
+#define TF_BENCH_UPLOAD_PIECE (64 * 1024)
+
+typedef struct {
+    const char* name;
+    const char* path;
+    bool chunked;
+} tf_bench_upload_variant_t;
+
+/// where the file variants go, truncated by every request
+static int tf_bench_upload_fd = -1;
+
+//
+// in-process server
+//
+
+bool tf_bench_upload_count(const char* data, const tf_index_t length, tf_data_ref meta) {
+    (void)(data);
+    
+    *(uint64_t*)meta += length;
+    return true;
+}
+
+void tf_bench_upload_complete(const tf_http_request_t* request,
+                              const uint16_t error,
+                              tf_http_response_t* response,
+                              tf_arena_ref arena,
+                              tf_data_ref meta) {
+    (void)(arena);
+    
+    uint64_t* counted = (uint64_t*)meta;
+    uint64_t length = 0;
+    
+    if (tf_str_view_equals(request->path, "/handler"))
+        length = *counted;
+    else
+        length = (uint64_t)lseek(tf_bench_upload_fd, 0, SEEK_CUR);
+    
+    free(counted);
+    
+    if (error < 1)
+        response->status = (length == TF_BENCH_UPLOAD_BODY ? 201 : 500);
+}
+
+void tf_bench_upload_handle(tf_http_server_ref server,
+                            tf_conn_ref conn,
+                            const tf_http_request_t* request,
+                            tf_http_response_t* response,
+                            tf_data_ref meta) {
+    (void)(meta);
+    
+    uint64_t* counted = calloc(1, sizeof(uint64_t));
+    tf_http_body_ref body = tf_http_server_receive_body(server, conn, request,
+                                                        tf_bench_upload_complete, counted);
+    
+    if (!body) {
+        free(counted);
+        response->status = 500;
+        return;
+    }
+    
+    if (tf_str_view_equals(request->path, "/handler")) {
+        tf_http_body_set_handler(body, tf_bench_upload_count);
+        return;
+    }
+    
+    lseek(tf_bench_upload_fd, 0, SEEK_SET);
+    
+    if (ftruncate(tf_bench_upload_fd, 0) == 0)
+        tf_http_body_set_file(body, tf_bench_upload_fd);
+}
+
+void* tf_bench_upload_server_thread(void* arg) {
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_upload_handle, NULL);
+    return NULL;
+}
+
+//
+// client
+//
+
+/// uploads the body on a fresh connection, nanoseconds until the response
+/// is in, false unless it's a 201
+bool tf_bench_upload_run(const tf_bench_upload_variant_t* variant, const char* piece,
+                         uint64_t* totalp) {
+    char head[256];
+    char response[1024];
+    int sock = tf_bench_connect(TF_BENCH_UPLOAD_PORT);
+    
+    if (sock < 0)
+        return false;
+    
+    int hlen = snprintf(head, sizeof(head), "PUT %s HTTP/1.1\r\nHost: localhost\r\n"
+                        "Connection: close\r\n", variant->path);
+    
+    if (variant->chunked)
+        hlen += snprintf(head + hlen, sizeof(head) - (size_t)hlen,
+                         "Transfer-Encoding: chunked\r\n\r\n");
+    else
+        hlen += snprintf(head + hlen, sizeof(head) - (size_t)hlen,
+                         "Content-Length: %d\r\n\r\n", TF_BENCH_UPLOAD_BODY);
+    
+    uint64_t started = tf_bench_now_ns();
+    bool success = tf_bench_send(sock, head, (size_t)hlen);
+    
+    for (tf_index_t sent = 0; success && sent < TF_BENCH_UPLOAD_BODY;
+         sent += TF_BENCH_UPLOAD_PIECE) {
+        char size[16];
+        int slen = snprintf(size, sizeof(size), "%x\r\n", TF_BENCH_UPLOAD_PIECE);
+        
+        success = ((!variant->chunked || tf_bench_send(sock, size, (size_t)slen)) &&
+                   tf_bench_send(sock, piece, TF_BENCH_UPLOAD_PIECE) &&
+                   (!variant->chunked || tf_bench_send(sock, "\r\n", 2)));
+    }
+    
+    if (success && variant->chunked)
+        success = tf_bench_send(sock, "0\r\n\r\n", 5);
+    
+    size_t length = 0;
+    
+    while (success && length < sizeof(response) - 1) {
+        ssize_t chunk = recv(sock, response + length, sizeof(response) - 1 - length, 0);
+        if (chunk <= 0)
+            break;
+        
+        length += (size_t)chunk;
+    }
+    
+    *totalp = tf_bench_now_ns() - started;
+    close(sock);
+    
+    return (success && length > 12 && strncmp(response, "HTTP/1.1 201", 12) == 0);
+}
+
+///
+/// best throughput in MiB/s of a few runs of variant and the most pooled
+/// buffer memory in use during any of them in KiB, false if an upload
+/// failed
+///
+bool tf_bench_upload_measure(const tf_bench_upload_variant_t* variant, const char* piece,
+                             double* throughputp, double* peakp) {
+    tf_bench_sampler_t sampler;
+    uint64_t best = UINT64_MAX;
+    bool success = true;
+    
+    if (!tf_bench_sampler_start(&sampler))
+        return false;
+    
+    for (tf_index_t run = 0; success && run < TF_BENCH_UPLOAD_RUNS; run++) {
+        uint64_t total = 0;
+        
+        success = tf_bench_upload_run(variant, piece, &total);
+        
+        if (total < best)
+            best = total;
+    }
+    
+    uint64_t peak = tf_bench_sampler_stop(&sampler);
+    
+    *throughputp = (TF_BENCH_UPLOAD_BODY / (1024.0 * 1024.0)) / ((double)best / 1e9);
+    *peakp = (double)peak / 1024.0;
+    
+    return success;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_bench_upload_variant_t variants[] = {
+        { "handler", "/handler", false },
+        { "file", "/file", false },
+        { "chunked file", "/file", true }
+    };
+    tf_index_t count = sizeof(variants) / sizeof(variants[0]);
+    
+    char path[] = "/tmp/tf_bench_upload_XXXXXX";
+    static char piece[TF_BENCH_UPLOAD_PIECE];
+    
+    tf_bench_upload_fd = mkstemp(path);
+    
+    if (tf_bench_upload_fd < 0) {
+        fprintf(stderr, "cannot create a file to upload into\n");
+        return 1;
+    }
+    
+    // gone once the bench exits
+    unlink(path);
+    memset(piece, 'u', sizeof(piece));
+    
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", TF_BENCH_UPLOAD_PORT, 4, 1);
+    pthread_t thread;
+    
+    // the server thread is left running, exiting takes it down
+    if (!server ||
+        pthread_create(&thread, NULL, tf_bench_upload_server_thread, server) != 0 ||
+        !tf_bench_wait_for_port(TF_BENCH_UPLOAD_PORT)) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    bool ok = true;
+    double worst_peak = 0;
+    
+    for (tf_index_t index = 0; ok && index < count; index++) {
+        double throughput = 0;
+        double peak = 0;
+        char param[64];
+        
+        ok = tf_bench_upload_measure(&variants[index], piece, &throughput, &peak);
+        
+        snprintf(param, sizeof(param), "32 MiB %s", variants[index].name);
+        TF_BENCH_REPORT("upload", param, throughput, "MiB/s");
+        snprintf(param, sizeof(param), "32 MiB %s, peak buffers", variants[index].name);
+        TF_BENCH_REPORT("upload", param, peak, "KiB");
+        
+        if (peak > worst_peak)
+            worst_peak = peak;
+    }
+    
+    if (!ok) {
+        fprintf(stderr, "an upload did not make it\n");
+        return 1;
+    }
+    
+    if (worst_peak * 1024.0 > TF_BENCH_UPLOAD_MAX_PEAK) {
+        fprintf(stderr, "uploads are held in memory\n");
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,316 @@
+//
+//  uring.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include "log.h"
+#include "server.h"
+#include "tcp.h"
+#include "bench.h"
+
+//
+// syscalls the server thread makes per keep-alive request with the poller
+// and with the io_uring backend, over a single connection (request,
+// response, next request) and over many connections with a request in
+// flight on each of them
+//
+// the socket and epoll calls and syscall() (which is how io_uring is
+// entered) are wrapped at link time (-Wl,--wrap=...) and only counted on
+// the server threads, the kernel's own work for io_uring is not visible
+// here, the latency is
+//
+
+#define TF_BENCH_URING_POLLER_PORT 5646
+#define TF_BENCH_URING_PORT 5647
+#define TF_BENCH_URING_WARMUP 1000
+#define TF_BENCH_URING_REQUESTS 20000
+#define TF_BENCH_URING_CONNECTIONS 64
+#define TF_BENCH_URING_ROUNDS 300
+
+static uint64_t tf_bench_syscalls;
+/// set on the server threads only
+static __thread bool tf_bench_counting;
+
+static const char tf_bench_request[] =
+    "GET /hello HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: tinyhttp-bench\r\n"
+    "\r\n";
+    
+#define TF_BENCH_URING_COUNT() \
+    if (tf_bench_counting) \
+        __atomic_add_fetch(&tf_bench_syscalls, 1, __ATOMIC_RELAXED)
+
+long __real_syscall(long number, ...);
+int __real_accept(int socket, struct sockaddr* address, socklen_t* length);
+int __real_accept4(int socket, struct sockaddr* address, socklen_t* length, int flags);
+ssize_t __real_recv(int socket, void* buffer, size_t length, int flags);
+ssize_t __real_send(int socket, const void* buffer, size_t length, int flags);
+ssize_t __real_sendmsg(int socket, const struct msghdr* message, int flags);
+ssize_t __real_sendfile(int socket, int file, off_t* offset, size_t count);
+int __real_epoll_wait(int poller, struct epoll_event* events, int max, int timeout);
+int __real_epoll_ctl(int poller, int op, int socket, struct epoll_event* event);
+int __real_setsockopt(int socket, int level, int name, const void* value,
+                      socklen_t length);
+int __real_fcntl(int file, int command, ...);
+int __real_shutdown(int socket, int how);
+int __real_close(int file);
+
+// only ever called with up to 5 arguments here (io_uring_enter has 6)
+long __wrap_syscall(long number, long a, long b, long c, long d, long e, long f) {
+    TF_BENCH_URING_COUNT();
+    return __real_syscall(number, a, b, c, d, e, f);
+}
+
+int __wrap_accept(int socket, struct sockaddr* address, socklen_t* length) {
+    TF_BENCH_URING_COUNT();
+    return __real_accept(socket, address, length);
+}
+
+int __wrap_accept4(int socket, struct sockaddr* address, socklen_t* length, int flags) {
+    TF_BENCH_URING_COUNT();
+    return __real_accept4(socket, address, length, flags);
+}
+
+ssize_t __wrap_recv(int socket, void* buffer, size_t length, int flags) {
+    TF_BENCH_URING_COUNT();
+    return __real_recv(socket, buffer, length, flags);
+}
+
+ssize_t __wrap_send(int socket, const void* buffer, size_t length, int flags) {
+    TF_BENCH_URING_COUNT();
+    return __real_send(socket, buffer, length, flags);
+}
+
+ssize_t __wrap_sendmsg(int socket, const struct msghdr* message, int flags) {
+    TF_BENCH_URING_COUNT();
+    return __real_sendmsg(socket, message, flags);
+}
+
+ssize_t __wrap_sendfile(int socket, int file, off_t* offset, size_t count) {
+    TF_BENCH_URING_COUNT();
+    return __real_sendfile(socket, file, offset, count);
+}
+
+int __wrap_epoll_wait(int poller, struct epoll_event* events, int max, int timeout) {
+    TF_BENCH_URING_COUNT();
+    return __real_epoll_wait(poller, events, max, timeout);
+}
+
+int __wrap_epoll_ctl(int poller, int op, int socket, struct epoll_event* event) {
+    TF_BENCH_URING_COUNT();
+    return __real_epoll_ctl(poller, op, socket, event);
+}
+
+int __wrap_setsockopt(int socket, int level, int name, const void* value,
+                      socklen_t length) {
+    TF_BENCH_URING_COUNT();
+    return __real_setsockopt(socket, level, name, value, length);
+}
+
+// F_GETFL/F_SETFL only, the argument is an int if there is one
+int __wrap_fcntl(int file, int command, ...) {
+    va_list arguments;
+    va_start(arguments, command);
+    int argument = va_arg(arguments, int);
+    va_end(arguments);
+    
+    TF_BENCH_URING_COUNT();
+    return __real_fcntl(file, command, argument);
+}
+
+int __wrap_shutdown(int socket, int how) {
+    TF_BENCH_URING_COUNT();
+    return __real_shutdown(socket, how);
+}
+
+int __wrap_close(int file) {
+    TF_BENCH_URING_COUNT();
+    return __real_close(file);
+}
+
+void tf_bench_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    (void)(server);
+    (void)(conn);
+    (void)(request);
+    (void)(meta);
+    
+    response->body.data = "hello";
+    response->body.length = 5;
+}
+
+void* tf_bench_server_thread(void* arg) {
+    tf_bench_counting = true;
+    tf_http_server_listen((tf_http_server_ref)arg, tf_bench_handle, NULL);
+    
+    return NULL;
+}
+
+bool tf_bench_uring_start(const tf_port_t port, const tf_tcp_backend_t backend) {
+    tf_http_server_ref server = tf_http_server_init("127.0.0.1", port,
+                                                    TF_BENCH_URING_CONNECTIONS * 2, 1);
+    pthread_t thread;
+    
+    if (!server)
+        return false;
+    
+    if (backend != TF_TCP_BACKEND_POLLER &&
+        !tf_tcp_set_backend(tf_http_server_get_tcp(server), backend))
+        return false;
+    
+    return (pthread_create(&thread, NULL, tf_bench_server_thread, server) == 0 &&
+            tf_bench_wait_for_port(port));
+}
+
+/// syscalls per request and microseconds per request over one connection
+bool tf_bench_uring_sequential(const tf_port_t port, double* syscallsp, double* latencyp) {
+    int sock = tf_bench_connect(port);
+    
+    for (tf_index_t index = 0; sock >= 0 && index < TF_BENCH_URING_WARMUP; index++) {
+        if (!tf_bench_send(sock, tf_bench_request, sizeof(tf_bench_request) - 1) ||
+            !tf_bench_receive(sock, 1))
+            return false;
+    }
+    
+    uint64_t syscalls = __atomic_load_n(&tf_bench_syscalls, __ATOMIC_RELAXED);
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t index = 0; sock >= 0 && index < TF_BENCH_URING_REQUESTS; index++) {
+        if (!tf_bench_send(sock, tf_bench_request, sizeof(tf_bench_request) - 1) ||
+            !tf_bench_receive(sock, 1))
+            return false;
+    }
+    
+    *latencyp = (double)(tf_bench_now_ns() - started) / TF_BENCH_URING_REQUESTS / 1000.0;
+    *syscallsp = (double)(__atomic_load_n(&tf_bench_syscalls, __ATOMIC_RELAXED) - syscalls) /
+                 TF_BENCH_URING_REQUESTS;
+    
+    close(sock);
+    return (sock >= 0);
+}
+
+/// same with a request in flight on every connection at a time, the
+/// latency is per round of requests
+bool tf_bench_uring_concurrent(const tf_port_t port, double* syscallsp, double* latencyp) {
+    int socks[TF_BENCH_URING_CONNECTIONS];
+    bool completed = true;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_URING_CONNECTIONS; index++) {
+        socks[index] = tf_bench_connect(port);
+        completed = (completed && socks[index] >= 0);
+        
+        // the listen backlog is tiny, let the server take the connection
+        sched_yield();
+    }
+    
+    uint64_t syscalls = 0;
+    uint64_t started = 0;
+    
+    for (tf_index_t round = 0; completed && round < TF_BENCH_URING_ROUNDS + 10; round++) {
+        // the first rounds only warm up
+        if (round == 10) {
+            syscalls = __atomic_load_n(&tf_bench_syscalls, __ATOMIC_RELAXED);
+            started = tf_bench_now_ns();
+        }
+        
+        for (tf_index_t index = 0; completed && index < TF_BENCH_URING_CONNECTIONS; index++)
+            completed = tf_bench_send(socks[index], tf_bench_request,
+                                      sizeof(tf_bench_request) - 1);
+        
+        for (tf_index_t index = 0; completed && index < TF_BENCH_URING_CONNECTIONS; index++)
+            completed = tf_bench_receive(socks[index], 1);
+    }
+    
+    tf_index_t requests = TF_BENCH_URING_ROUNDS * TF_BENCH_URING_CONNECTIONS;
+    
+    *latencyp = (double)(tf_bench_now_ns() - started) / TF_BENCH_URING_ROUNDS / 1000.0;
+    *syscallsp = (double)(__atomic_load_n(&tf_bench_syscalls, __ATOMIC_RELAXED) - syscalls) /
+                 requests;
+    
+    for (tf_index_t index = 0; index < TF_BENCH_URING_CONNECTIONS; index++) {
+        if (socks[index] >= 0)
+            close(socks[index]);
+    }
+    
+    return completed;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    // closed connections are logged at info
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0)
+        tf_log_set_output(null);
+    
+    if (!tf_bench_uring_start(TF_BENCH_URING_POLLER_PORT, TF_TCP_BACKEND_POLLER)) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    
+    bool uring = tf_bench_uring_start(TF_BENCH_URING_PORT, TF_TCP_BACKEND_URING);
+    
+    static const char* names[] = { "poller", "io_uring" };
+    static const tf_port_t ports[] = { TF_BENCH_URING_POLLER_PORT, TF_BENCH_URING_PORT };
+    double syscalls[2][2] = { { 0 } };
+    double latencies[2][2] = { { 0 } };
+    bool completed = true;
+    char param[64];
+    
+    for (tf_index_t backend = 0; backend < 2; backend++) {
+        if (backend > 0 && !uring) {
+            TF_BENCH_SKIP("uring", "io_uring, syscalls per request", "io_uring unavailable");
+            TF_BENCH_SKIP("uring", "io_uring, latency", "io_uring unavailable");
+            TF_BENCH_SKIP("uring", "io_uring, 64 conns, syscalls per request",
+                          "io_uring unavailable");
+            TF_BENCH_SKIP("uring", "io_uring, 64 conns, round", "io_uring unavailable");
+            break;
+        }
+        
+        if (!tf_bench_uring_sequential(ports[backend], &syscalls[backend][0],
+                                       &latencies[backend][0]) ||
+            !tf_bench_uring_concurrent(ports[backend], &syscalls[backend][1],
+                                       &latencies[backend][1])) {
+            fprintf(stderr, "%s: requests failed\n", names[backend]);
+            
+            completed = false;
+            continue;
+        }
+        
+        snprintf(param, sizeof(param), "%s, syscalls per request", names[backend]);
+        TF_BENCH_REPORT("uring", param, syscalls[backend][0], "");
+        snprintf(param, sizeof(param), "%s, latency", names[backend]);
+        TF_BENCH_REPORT("uring", param, latencies[backend][0], "us/req");
+        snprintf(param, sizeof(param), "%s, %u conns, syscalls per request", names[backend],
+                 TF_BENCH_URING_CONNECTIONS);
+        TF_BENCH_REPORT("uring", param, syscalls[backend][1], "");
+        snprintf(param, sizeof(param), "%s, %u conns, round", names[backend],
+                 TF_BENCH_URING_CONNECTIONS);
+        TF_BENCH_REPORT("uring", param, latencies[backend][1], "us");
+    }
+    
+    // batching is the whole point, with many connections io_uring has to
+    // get by with fewer syscalls
+    if (completed && uring && syscalls[1][1] >= syscalls[0][1])
+        completed = false;
+    
+    // the server threads are left running, exiting takes them down
+    return (completed ? 0 : 1);
+}
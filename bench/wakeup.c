@@ -0,0 +1,125 @@
+//
+//  wakeup.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "poller.h"
+#include "bench.h"
+
+//
+// measures how much a single wakeup costs while N idle connections are
+// registered with the poller, the epoll backend should stay flat while
+// select() grows with N
+//
+// idle connections are dup()s of a single never-written socket, so that
+// each of them only costs one descriptor
+//
+
+#define TF_BENCH_WAKEUPS 20000
+
+static const tf_index_t tf_bench_idle_counts[] = { 10, 100, 1000, 10000, 50000 };
+
+bool tf_bench_wakeup_run(const tf_index_t idle, const tf_index_t fd_limit) {
+    char param[64];
+    snprintf(param, sizeof(param), "%s/idle=%u", tf_poller_get_backend_name(),
+             idle);
+    
+    // one descriptor per idle connection, plus some headroom
+    if (idle + 16 > fd_limit) {
+        TF_BENCH_SKIP("wakeup", param, "descriptor limit too low");
+        return true;
+    }
+    
+    tf_poller_ref poller = tf_poller_init();
+    tf_socket_t* idle_socks = calloc(idle, sizeof(tf_socket_t));
+    tf_socket_t idle_pair[2] = { -1, -1 };
+    tf_socket_t active[2] = { -1, -1 };
+    
+    bool result = false;
+    tf_index_t created = 0;
+    
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, idle_pair) < 0)
+        goto cleanup;
+    
+    for (; created < idle; created++) {
+        idle_socks[created] = dup(idle_pair[0]);
+        if (idle_socks[created] < 0)
+            goto cleanup;
+        
+        if (!tf_poller_add(poller, idle_socks[created], TF_POLLER_READABLE)) {
+            created++;
+            TF_BENCH_SKIP("wakeup", param, "backend cannot track that many sockets");
+            
+            result = true;
+            goto cleanup;
+        }
+    }
+    
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, active) < 0 ||
+        !tf_poller_add(poller, active[0], TF_POLLER_READABLE)) {
+        TF_BENCH_SKIP("wakeup", param, "backend cannot track that many sockets");
+        
+        result = true;
+        goto cleanup;
+    }
+    
+    tf_poller_event_t events[TF_POLLER_MAX_EVENTS];
+    uint64_t started = tf_bench_now_ns();
+    
+    for (tf_index_t iter = 0; iter < TF_BENCH_WAKEUPS; iter++) {
+        char byte = 'x';
+        
+        if (write(active[1], &byte, 1) != 1 ||
+            tf_poller_wait(poller, events, TF_POLLER_MAX_EVENTS,
+                           TF_POLLER_WAIT_FOREVER) != 1 ||
+            read(active[0], &byte, 1) != 1)
+            goto cleanup;
+    }
+    
+    TF_BENCH_REPORT("wakeup", param,
+                    (double)(tf_bench_now_ns() - started) / TF_BENCH_WAKEUPS,
+                    "ns/wakeup");
+    result = true;
+    
+cleanup:
+    for (tf_index_t index = 0; index < created; index++)
+        close(idle_socks[index]);
+    
+    for (int index = 0; index < 2; index++) {
+        if (idle_pair[index] >= 0)
+            close(idle_pair[index]);
+    }
+    
+    if (active[0] >= 0) {
+        close(active[0]);
+        close(active[1]);
+    }
+    
+    free(idle_socks);
+    tf_poller_release(poller);
+    
+    return result;
+}
+
+int main(const int argc, const char** argv) {
+    (void)(argc);
+    (void)(argv);
+    
+    tf_index_t fd_limit = tf_bench_raise_fd_limit();
+    
+    for (size_t index = 0; index < sizeof(tf_bench_idle_counts) / sizeof(tf_index_t);
+         index++) {
+        if (!tf_bench_wakeup_run(tf_bench_idle_counts[index], fd_limit)) {
+            perror("wakeup benchmark failed");
+            return 1;
+        }
+    }
+    
+    return 0;
+}
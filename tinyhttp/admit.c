@@ -0,0 +1,185 @@
+//
+//  admit.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <strings.h>
+#include "privutil.h"
+#include "tcp.h"
+#include "admit.h"
+
+//
+// private
+//
+
+///
+/// token bucket of a client address, kept as the time it is full again
+/// (the theoretical arrival time of GCRA): each request moves it one token
+/// interval ahead and it may not get further ahead of now than the burst
+///
+typedef struct {
+    // 0 for a free entry
+    uint64_t key;
+    uint64_t full_at;
+} tf_admit_client_t;
+
+typedef struct {
+    bool locked;
+    tf_admit_client_t clients[TF_ADMIT_WAYS];
+} tf_admit_set_t;
+
+struct tf_admit_s {
+    tf_admit_options_t options;
+    
+    // nanoseconds per token and for the whole bucket
+    uint64_t interval;
+    uint64_t capacity;
+    
+    tf_admit_set_t* sets;
+    uint64_t set_mask;
+    
+    // handlers running and deferred requests, all the workers together
+    tf_index_t in_flight;
+};
+
+void tf_admit_lock(tf_admit_set_t* set) {
+    // held for a few loads and stores, not worth sleeping for
+    while (__atomic_test_and_set(&set->locked, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&set->locked, __ATOMIC_RELAXED))
+            ;
+    }
+}
+
+void tf_admit_unlock(tf_admit_set_t* set) {
+    __atomic_clear(&set->locked, __ATOMIC_RELEASE);
+}
+
+//
+// public
+//
+
+void tf_admit_get_default_options(tf_admit_options_t* optionsp) {
+    if (!optionsp)
+        return;
+    
+    bzero(optionsp, sizeof(tf_admit_options_t));
+    optionsp->clients = TF_ADMIT_DEFAULT_CLIENTS;
+}
+
+tf_admit_ref tf_admit_init(const tf_admit_options_t* options) {
+    if (!options || (options->client_rate < 1 && options->max_concurrency < 1 &&
+                     options->max_queue_delay < 1))
+        return NULL;
+    
+    tf_admit_ref admit = tf_struct_alloc(tf_admit_s);
+    admit->options = *options;
+    
+    if (options->client_rate > 0) {
+        uint32_t burst = (options->client_burst > 0 ? options->client_burst : 1);
+        uint64_t sets = 1;
+        
+        while (sets * TF_ADMIT_WAYS < options->clients)
+            sets <<= 1;
+        
+        admit->interval = 1000000000ull / options->client_rate;
+        admit->capacity = admit->interval * burst;
+        admit->set_mask = sets - 1;
+        admit->sets = calloc(sets, sizeof(tf_admit_set_t));
+        
+        if (!admit->sets) {
+            free(admit);
+            return NULL;
+        }
+    }
+    
+    return admit;
+}
+
+uint64_t tf_admit_get_client_key(tf_socket_t socket) {
+    char* ip = tf_socket_get_client_ip(socket, NULL);
+    // FNV-1a, 0 marks the free entries
+    uint64_t key = 14695981039346656037ull;
+    
+    if (!ip)
+        return 1;
+    
+    for (const char* c = ip; *c; c++)
+        key = (key ^ (uint8_t)*c) * 1099511628211ull;
+    
+    free(ip);
+    return (key > 0 ? key : 1);
+}
+
+bool tf_admit_take_token(tf_admit_ref admit, const uint64_t key, const uint64_t now) {
+    if (!admit || !admit->sets)
+        return true;
+    
+    // the low bits pick the set, FNV-1a's are as good as any
+    tf_admit_set_t* set = admit->sets + (key & admit->set_mask);
+    tf_admit_client_t* client = NULL;
+    
+    tf_admit_lock(set);
+    
+    for (tf_index_t way = 0; way < TF_ADMIT_WAYS && !client; way++) {
+        if (set->clients[way].key == key)
+            client = set->clients + way;
+    }
+    
+    if (!client) {
+        // a free entry has never been full, it comes first
+        client = set->clients;
+        
+        for (tf_index_t way = 1; way < TF_ADMIT_WAYS; way++) {
+            if (set->clients[way].full_at < client->full_at)
+                client = set->clients + way;
+        }
+        
+        // forgetting a client gives it a full bucket, only ever happens to
+        // the ones that have been quiet the longest
+        client->key = key;
+        client->full_at = now;
+    }
+    
+    uint64_t full_at = (client->full_at > now ? client->full_at : now) + admit->interval;
+    bool allowed = (full_at - now <= admit->capacity);
+    
+    if (allowed)
+        client->full_at = full_at;
+    
+    tf_admit_unlock(set);
+    return allowed;
+}
+
+bool tf_admit_is_saturated(const tf_admit_ref admit) {
+    return (admit && admit->options.max_concurrency > 0 &&
+            __atomic_load_n(&admit->in_flight, __ATOMIC_RELAXED) >=
+            admit->options.max_concurrency);
+}
+
+void tf_admit_enter(tf_admit_ref admit) {
+    if (admit)
+        __atomic_add_fetch(&admit->in_flight, 1, __ATOMIC_RELAXED);
+}
+
+void tf_admit_leave(tf_admit_ref admit) {
+    if (admit)
+        __atomic_sub_fetch(&admit->in_flight, 1, __ATOMIC_RELAXED);
+}
+
+bool tf_admit_is_overdue(const tf_admit_ref admit, const uint64_t queued_at,
+                         const uint64_t now) {
+    return (admit && admit->options.max_queue_delay > 0 && now > queued_at &&
+            now - queued_at > admit->options.max_queue_delay * 1000000ull);
+}
+
+void tf_admit_release(tf_admit_ref admit) {
+    if (!admit)
+        return;
+    
+    free(admit->sets);
+    free(admit);
+}
@@ -0,0 +1,75 @@
+//
+//  admit.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// admission control
+//
+// decides whether a request gets served before anything is spent on it,
+// so an overloaded server keeps answering the requests it takes in time
+// instead of answering all of them too late:
+//
+// - every client address has a token bucket, a request takes a token and
+//   the tokens come back at a fixed rate, the buckets are kept in a table
+//   of fixed size shared by all the workers (sets of TF_ADMIT_WAYS with a
+//   spinlock each), a new address replaces the least active one of its set
+// - the requests in flight (handlers running and deferred requests waiting
+//   for or running on the pool) are capped across all the workers
+// - deferred requests that waited longer than a limit for a pool thread are
+//   refused instead of handled, whoever sent them has likely given up
+//
+// the first two are checked before a request is even parsed
+//
+
+/// client addresses per table set
+#define TF_ADMIT_WAYS 4
+/// default amount of client addresses tracked
+#define TF_ADMIT_DEFAULT_CLIENTS 65536
+
+typedef struct {
+    // requests per second a client address may make, 0 for no limit
+    uint32_t client_rate;
+    // requests a client may make in a row after having been quiet
+    uint32_t client_burst;
+    // client addresses kept track of (rounded up to a power of two), the
+    // table takes 16 bytes per address and never grows
+    tf_index_t clients;
+    // requests in flight at once, 0 for no cap
+    tf_index_t max_concurrency;
+    // milliseconds a deferred request may wait for a pool thread, 0 for
+    // no limit
+    tf_index_t max_queue_delay;
+} tf_admit_options_t;
+
+/// everything off, TF_ADMIT_DEFAULT_CLIENTS addresses
+void tf_admit_get_default_options(tf_admit_options_t* optionsp);
+
+/// NULL if options turn everything off
+tf_admit_ref tf_admit_init(const tf_admit_options_t* options);
+
+/// key of the client on the other end of socket (its address without the
+/// port), 1 if it cannot be told
+uint64_t tf_admit_get_client_key(tf_socket_t socket);
+
+/// takes a token from the client's bucket, false if it's empty
+bool tf_admit_take_token(tf_admit_ref admit, const uint64_t key, const uint64_t now);
+
+/// whether a new request would go over the concurrency cap
+bool tf_admit_is_saturated(const tf_admit_ref admit);
+/// a request starts or stops being in flight
+void tf_admit_enter(tf_admit_ref admit);
+void tf_admit_leave(tf_admit_ref admit);
+
+/// whether a deferred request queued at queued_at has waited too long
+bool tf_admit_is_overdue(const tf_admit_ref admit, const uint64_t queued_at,
+                         const uint64_t now);
+
+void tf_admit_release(tf_admit_ref admit);
@@ -0,0 +1,173 @@
+//
+//  arena.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "privutil.h"
+#include "arena.h"
+
+//
+// private
+//
+
+typedef struct tf_arena_chunk_s* tf_arena_chunk_ref;
+struct tf_arena_chunk_s {
+    tf_arena_chunk_ref next;
+    tf_index_t capacity;
+    
+    // followed by the (aligned) data
+};
+
+struct tf_arena_s {
+    // chunks in the order they are filled, they all stay after a reset
+    tf_arena_chunk_ref first;
+    tf_arena_chunk_ref current;
+    // bytes taken from the current chunk
+    tf_index_t offset;
+    
+    tf_index_t chunk_size;
+    tf_arena_stats_t stats;
+};
+
+tf_index_t tf_arena_align(const tf_index_t size) {
+    return (size + (TF_ARENA_ALIGNMENT - 1)) & ~(tf_index_t)(TF_ARENA_ALIGNMENT - 1);
+}
+
+char* tf_arena_chunk_get_data(tf_arena_chunk_ref chunk) {
+    return (char*)chunk + tf_arena_align(sizeof(struct tf_arena_chunk_s));
+}
+
+/// moves on to a chunk that fits size bytes, reusing the following ones
+/// if possible
+bool tf_arena_next_chunk(tf_arena_ref arena, const tf_index_t size) {
+    tf_arena_chunk_ref next = (arena->current ? arena->current->next : arena->first);
+    
+    if (next && next->capacity >= size) {
+        arena->current = next;
+        arena->offset = 0;
+        
+        return true;
+    }
+    
+    tf_index_t capacity = (size > arena->chunk_size ? size : arena->chunk_size);
+    tf_arena_chunk_ref chunk = malloc(tf_arena_align(sizeof(struct tf_arena_chunk_s)) +
+                                      capacity);
+    
+    if (!chunk)
+        return false;
+    
+    chunk->capacity = capacity;
+    
+    // put it right after the current one, the too small next chunk is
+    // still going to be used later
+    chunk->next = next;
+    
+    if (arena->current)
+        arena->current->next = chunk;
+    else
+        arena->first = chunk;
+    
+    arena->current = chunk;
+    arena->offset = 0;
+    
+    arena->stats.reserved += capacity;
+    arena->stats.chunk_count++;
+    
+    return true;
+}
+
+//
+// public
+//
+
+tf_arena_ref tf_arena_init(const tf_index_t chunk_size) {
+    tf_arena_ref arena = tf_struct_alloc(tf_arena_s);
+    
+    arena->chunk_size = tf_arena_align(chunk_size >= TF_ARENA_ALIGNMENT ? chunk_size :
+                                       TF_ARENA_DEFAULT_CHUNK_SIZE);
+    return arena;
+}
+
+tf_data_ref tf_arena_alloc(tf_arena_ref arena, const tf_index_t size) {
+    if (!arena)
+        return NULL;
+    
+    tf_index_t aligned = tf_arena_align(size >= 1 ? size : 1);
+    
+    if (!arena->current || arena->current->capacity - arena->offset < aligned) {
+        if (!tf_arena_next_chunk(arena, aligned))
+            return NULL;
+    }
+    
+    tf_data_ref result = tf_arena_chunk_get_data(arena->current) + arena->offset;
+    arena->offset += aligned;
+    
+    arena->stats.used += aligned;
+    if (arena->stats.used > arena->stats.peak)
+        arena->stats.peak = arena->stats.used;
+    
+    return result;
+}
+
+tf_data_ref tf_arena_calloc(tf_arena_ref arena, const tf_index_t size) {
+    tf_data_ref result = tf_arena_alloc(arena, size);
+    
+    if (result)
+        bzero(result, size);
+    
+    return result;
+}
+
+char* tf_arena_strndup(tf_arena_ref arena, const char* str, const tf_index_t length) {
+    if (!str)
+        return NULL;
+    
+    char* result = tf_arena_alloc(arena, length + 1);
+    if (!result)
+        return NULL;
+    
+    memcpy(result, str, length);
+    result[length] = '\0';
+    
+    return result;
+}
+
+void tf_arena_reset(tf_arena_ref arena) {
+    if (!arena)
+        return;
+    
+    arena->current = arena->first;
+    arena->offset = 0;
+    
+    arena->stats.used = 0;
+    arena->stats.reset_count++;
+}
+
+void tf_arena_get_stats(const tf_arena_ref arena, tf_arena_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    if (arena)
+        *statsp = arena->stats;
+    else
+        bzero(statsp, sizeof(tf_arena_stats_t));
+}
+
+void tf_arena_release(tf_arena_ref arena) {
+    if (!arena)
+        return;
+    
+    while (arena->first) {
+        tf_arena_chunk_ref next = arena->first->next;
+        
+        free(arena->first);
+        arena->first = next;
+    }
+    
+    free(arena);
+}
@@ -0,0 +1,55 @@
+//
+//  arena.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// bump-pointer arena for request-scoped objects
+//
+// allocations are carved out of big chunks and never freed one by one,
+// tf_arena_reset makes all of them go away at once in O(1) while keeping
+// the chunks around, so a warmed-up arena does not call malloc anymore
+//
+
+/// default chunk size, bigger allocations get a chunk of their own
+#define TF_ARENA_DEFAULT_CHUNK_SIZE 4096
+/// every allocation is aligned to this
+#define TF_ARENA_ALIGNMENT 16
+
+/// arena usage counters
+typedef struct {
+    // bytes handed out since the last reset (including alignment)
+    tf_index_t used;
+    // highest used value ever seen
+    tf_index_t peak;
+    // bytes held in chunks
+    tf_index_t reserved;
+    tf_index_t chunk_count;
+    tf_index_t reset_count;
+} tf_arena_stats_t;
+
+tf_arena_ref tf_arena_init(const tf_index_t chunk_size);
+
+/// uninitialized memory valid until the next reset, NULL on failure
+tf_data_ref tf_arena_alloc(tf_arena_ref arena, const tf_index_t size);
+/// same, but NULL-ed
+tf_data_ref tf_arena_calloc(tf_arena_ref arena, const tf_index_t size);
+/// NUL-terminated copy of length bytes of str
+char* tf_arena_strndup(tf_arena_ref arena, const char* str, const tf_index_t length);
+
+/// allocates NULL-ed memory for the specified struct type in the arena
+#define tf_arena_struct_alloc(arena, type) tf_arena_calloc((arena), sizeof(struct type))
+
+/// forgets all the allocations, keeps the chunks for reuse
+void tf_arena_reset(tf_arena_ref arena);
+
+void tf_arena_get_stats(const tf_arena_ref arena, tf_arena_stats_t* statsp);
+
+void tf_arena_release(tf_arena_ref arena);
@@ -0,0 +1,441 @@
+//
+//  bufpool.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "privutil.h"
+#include "bufpool.h"
+
+//
+// private
+//
+
+/// buffers kept per thread and per size class
+#define TF_BUFPOOL_CACHE_LIMIT 32
+/// buffers kept in the shared depot per size class
+#define TF_BUFPOOL_DEPOT_LIMIT 1024
+/// size class marker for malloc-only buffers
+#define TF_BUFPOOL_OVERSIZE 0xff
+
+struct tf_buffer_s {
+    // chain link, or free list link while pooled
+    tf_buffer_ref next;
+    
+    tf_index_t capacity;
+    tf_index_t length;
+    uint8_t size_class;
+    
+    // file range this buffer stands for instead of its data, -1 if none
+    int file;
+    uint64_t file_offset;
+    // memory this buffer stands for instead of its data, NULL if none
+    const char* external;
+    // called with owner once the buffer is released
+    tf_deallocator_t release;
+    tf_data_ref owner;
+    
+    char data[];
+};
+
+/// free lists for all the size classes
+typedef struct {
+    tf_buffer_ref free[TF_BUFPOOL_CLASS_COUNT];
+    tf_index_t count[TF_BUFPOOL_CLASS_COUNT];
+} tf_bufpool_lists_t;
+
+/// per-thread state, the counters are only ever written by the owner
+typedef struct tf_bufpool_cache_s* tf_bufpool_cache_ref;
+struct tf_bufpool_cache_s {
+    tf_bufpool_lists_t lists;
+    tf_bufpool_stats_t stats;
+    
+    bool registered;
+    // all the registered caches, for tf_bufpool_get_stats
+    tf_bufpool_cache_ref next;
+};
+
+// flushed into the depot when the thread exits
+static __thread struct tf_bufpool_cache_s tf_bufpool_cache;
+
+// shared between all the threads, all under the depot lock
+static tf_bufpool_lists_t tf_bufpool_depot;
+static tf_bufpool_cache_ref tf_bufpool_caches;
+// counters of threads that are gone
+static tf_bufpool_stats_t tf_bufpool_retired_stats;
+static pthread_mutex_t tf_bufpool_depot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t tf_bufpool_cache_key;
+static pthread_once_t tf_bufpool_cache_key_once = PTHREAD_ONCE_INIT;
+
+// relaxed stores are plain moves, other threads may only read the values
+#define TF_BUFPOOL_STAT_ADD(field, value) \
+    __atomic_store_n(&tf_bufpool_cache.stats.field, \
+                     tf_bufpool_cache.stats.field + (value), __ATOMIC_RELAXED)
+#define TF_BUFPOOL_STAT_SUB(field, value) \
+    __atomic_store_n(&tf_bufpool_cache.stats.field, \
+                     tf_bufpool_cache.stats.field - (value), __ATOMIC_RELAXED)
+
+tf_index_t tf_bufpool_class_size(const uint8_t size_class) {
+    return (TF_BUFPOOL_MIN_SIZE << (2 * size_class));
+}
+
+uint8_t tf_bufpool_class_for(const tf_index_t capacity) {
+    for (uint8_t size_class = 0; size_class < TF_BUFPOOL_CLASS_COUNT; size_class++) {
+        if (capacity <= tf_bufpool_class_size(size_class))
+            return size_class;
+    }
+    
+    return TF_BUFPOOL_OVERSIZE;
+}
+
+void tf_bufpool_stats_merge(tf_bufpool_stats_t* target,
+                            const tf_bufpool_stats_t* source) {
+    target->hits += __atomic_load_n(&source->hits, __ATOMIC_RELAXED);
+    target->misses += __atomic_load_n(&source->misses, __ATOMIC_RELAXED);
+    target->outstanding_buffers += __atomic_load_n(&source->outstanding_buffers,
+                                                   __ATOMIC_RELAXED);
+    target->outstanding_bytes += __atomic_load_n(&source->outstanding_bytes,
+                                                 __ATOMIC_RELAXED);
+}
+
+void tf_bufpool_cache_flush(void* unused) {
+    (void)(unused);
+    
+    // hand everything over to the depot, free what doesn't fit
+    pthread_mutex_lock(&tf_bufpool_depot_lock);
+    
+    for (uint8_t size_class = 0; size_class < TF_BUFPOOL_CLASS_COUNT; size_class++) {
+        while (tf_bufpool_cache.lists.free[size_class]) {
+            tf_buffer_ref buffer = tf_bufpool_cache.lists.free[size_class];
+            tf_bufpool_cache.lists.free[size_class] = buffer->next;
+            
+            if (tf_bufpool_depot.count[size_class] < TF_BUFPOOL_DEPOT_LIMIT) {
+                buffer->next = tf_bufpool_depot.free[size_class];
+                tf_bufpool_depot.free[size_class] = buffer;
+                tf_bufpool_depot.count[size_class]++;
+            } else
+                free(buffer);
+        }
+        
+        tf_bufpool_cache.lists.count[size_class] = 0;
+    }
+    
+    // keep the counters of this thread around
+    tf_bufpool_stats_merge(&tf_bufpool_retired_stats, &tf_bufpool_cache.stats);
+    
+    for (tf_bufpool_cache_ref* link = &tf_bufpool_caches; *link; link = &(*link)->next) {
+        if (*link == &tf_bufpool_cache) {
+            *link = tf_bufpool_cache.next;
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&tf_bufpool_depot_lock);
+}
+
+void tf_bufpool_cache_key_init(void) {
+    pthread_key_create(&tf_bufpool_cache_key, tf_bufpool_cache_flush);
+}
+
+void tf_bufpool_cache_register(void) {
+    // the key destructor only runs for threads that set a value
+    pthread_once(&tf_bufpool_cache_key_once, tf_bufpool_cache_key_init);
+    pthread_setspecific(tf_bufpool_cache_key, &tf_bufpool_cache);
+    
+    pthread_mutex_lock(&tf_bufpool_depot_lock);
+    
+    tf_bufpool_cache.next = tf_bufpool_caches;
+    tf_bufpool_caches = &tf_bufpool_cache;
+    
+    pthread_mutex_unlock(&tf_bufpool_depot_lock);
+    tf_bufpool_cache.registered = true;
+}
+
+tf_buffer_ref tf_bufpool_take(const uint8_t size_class) {
+    tf_buffer_ref buffer = tf_bufpool_cache.lists.free[size_class];
+    
+    if (buffer) {
+        tf_bufpool_cache.lists.free[size_class] = buffer->next;
+        tf_bufpool_cache.lists.count[size_class]--;
+        
+        return buffer;
+    }
+    
+    // the thread cache is empty, try the depot before giving up
+    pthread_mutex_lock(&tf_bufpool_depot_lock);
+    
+    buffer = tf_bufpool_depot.free[size_class];
+    if (buffer) {
+        tf_bufpool_depot.free[size_class] = buffer->next;
+        tf_bufpool_depot.count[size_class]--;
+    }
+    
+    pthread_mutex_unlock(&tf_bufpool_depot_lock);
+    return buffer;
+}
+
+void tf_bufpool_put(tf_buffer_ref buffer) {
+    uint8_t size_class = buffer->size_class;
+    
+    if (size_class == TF_BUFPOOL_OVERSIZE) {
+        free(buffer);
+        return;
+    }
+    
+    if (tf_bufpool_cache.lists.count[size_class] < TF_BUFPOOL_CACHE_LIMIT) {
+        buffer->next = tf_bufpool_cache.lists.free[size_class];
+        tf_bufpool_cache.lists.free[size_class] = buffer;
+        tf_bufpool_cache.lists.count[size_class]++;
+        
+        return;
+    }
+    
+    pthread_mutex_lock(&tf_bufpool_depot_lock);
+    
+    if (tf_bufpool_depot.count[size_class] < TF_BUFPOOL_DEPOT_LIMIT) {
+        buffer->next = tf_bufpool_depot.free[size_class];
+        tf_bufpool_depot.free[size_class] = buffer;
+        tf_bufpool_depot.count[size_class]++;
+        
+        buffer = NULL;
+    }
+    
+    pthread_mutex_unlock(&tf_bufpool_depot_lock);
+    
+    // both the cache and the depot are full
+    free(buffer);
+}
+
+//
+// public
+//
+
+tf_buffer_ref tf_buffer_acquire(const tf_index_t min_capacity) {
+    uint8_t size_class = tf_bufpool_class_for(min_capacity);
+    tf_buffer_ref buffer = NULL;
+    
+    if (!tf_bufpool_cache.registered)
+        tf_bufpool_cache_register();
+    
+    if (size_class != TF_BUFPOOL_OVERSIZE)
+        buffer = tf_bufpool_take(size_class);
+    
+    if (buffer)
+        TF_BUFPOOL_STAT_ADD(hits, 1);
+    else {
+        tf_index_t capacity = (size_class != TF_BUFPOOL_OVERSIZE ?
+                               tf_bufpool_class_size(size_class) : min_capacity);
+        
+        buffer = malloc(sizeof(struct tf_buffer_s) + capacity);
+        if (!buffer)
+            return NULL;
+        
+        buffer->capacity = capacity;
+        buffer->size_class = size_class;
+        
+        TF_BUFPOOL_STAT_ADD(misses, 1);
+    }
+    
+    buffer->next = NULL;
+    buffer->length = 0;
+    buffer->file = -1;
+    buffer->external = NULL;
+    buffer->release = NULL;
+    
+    TF_BUFPOOL_STAT_ADD(outstanding_buffers, 1);
+    TF_BUFPOOL_STAT_ADD(outstanding_bytes, buffer->capacity);
+    
+    return buffer;
+}
+
+void tf_buffer_release(tf_buffer_ref buffer) {
+    if (buffer && !tf_bufpool_cache.registered)
+        tf_bufpool_cache_register();
+    
+    while (buffer) {
+        tf_buffer_ref next = buffer->next;
+        
+        if (buffer->release)
+            buffer->release(buffer->owner);
+        
+        TF_BUFPOOL_STAT_SUB(outstanding_buffers, 1);
+        TF_BUFPOOL_STAT_SUB(outstanding_bytes, buffer->capacity);
+        
+        tf_bufpool_put(buffer);
+        buffer = next;
+    }
+}
+
+tf_buffer_ref tf_buffer_acquire_file(const int file, const uint64_t offset,
+                                     const tf_index_t length,
+                                     const tf_deallocator_t release,
+                                     tf_data_ref owner) {
+    if (file < 0)
+        return NULL;
+    
+    tf_buffer_ref buffer = tf_buffer_acquire(0);
+    if (!buffer)
+        return NULL;
+    
+    // the length is the amount of file bytes, the data area stays unused
+    buffer->length = length;
+    buffer->file = file;
+    buffer->file_offset = offset;
+    buffer->release = release;
+    buffer->owner = owner;
+    
+    return buffer;
+}
+
+tf_buffer_ref tf_buffer_acquire_external(const char* data, const tf_index_t length,
+                                         const tf_deallocator_t release,
+                                         tf_data_ref owner) {
+    if (!data)
+        return NULL;
+    
+    tf_buffer_ref buffer = tf_buffer_acquire(0);
+    if (!buffer)
+        return NULL;
+    
+    // same as for files, the data area stays unused
+    buffer->length = length;
+    buffer->external = data;
+    buffer->release = release;
+    buffer->owner = owner;
+    
+    return buffer;
+}
+
+int tf_buffer_get_file(const tf_buffer_ref buffer, uint64_t* offsetp) {
+    TF_PTR_SET(offsetp, (buffer ? buffer->file_offset : 0));
+    return (buffer ? buffer->file : -1);
+}
+
+tf_buffer_ref tf_buffer_reserve(tf_buffer_ref buffer, const tf_index_t min_capacity) {
+    if (!buffer)
+        return tf_buffer_acquire(min_capacity);
+    
+    if (buffer->capacity >= min_capacity)
+        return buffer;
+    
+    tf_buffer_ref result = tf_buffer_acquire(min_capacity);
+    if (!result)
+        return NULL;
+    
+    memcpy(result->data, buffer->data, buffer->length);
+    result->length = buffer->length;
+    result->next = buffer->next;
+    
+    // only this one, not the rest of the chain
+    buffer->next = NULL;
+    tf_buffer_release(buffer);
+    
+    return result;
+}
+
+char* tf_buffer_get_data(const tf_buffer_ref buffer) {
+    if (buffer && buffer->external)
+        return (char*)buffer->external;
+    
+    return (buffer ? buffer->data : NULL);
+}
+
+tf_index_t tf_buffer_get_length(const tf_buffer_ref buffer) {
+    return (buffer ? buffer->length : 0);
+}
+
+void tf_buffer_set_length(tf_buffer_ref buffer, const tf_index_t length) {
+    if (buffer && buffer->file < 0 && !buffer->external)
+        buffer->length = (length <= buffer->capacity ? length : buffer->capacity);
+}
+
+tf_index_t tf_buffer_get_capacity(const tf_buffer_ref buffer) {
+    return (buffer ? buffer->capacity : 0);
+}
+
+tf_index_t tf_buffer_get_free(const tf_buffer_ref buffer) {
+    return ((buffer && buffer->file < 0 && !buffer->external) ?
+            buffer->capacity - buffer->length : 0);
+}
+
+//
+// chains public
+//
+
+tf_buffer_ref tf_buffer_get_next(const tf_buffer_ref buffer) {
+    return (buffer ? buffer->next : NULL);
+}
+
+void tf_buffer_set_next(tf_buffer_ref buffer, tf_buffer_ref next) {
+    if (buffer)
+        buffer->next = next;
+}
+
+tf_buffer_ref tf_buffer_chain_append(tf_buffer_ref head, const char* data,
+                                     const tf_index_t length) {
+    if (!data || length < 1)
+        return head;
+    
+    tf_buffer_ref last = head;
+    while (last && last->next)
+        last = last->next;
+    
+    tf_index_t offset = 0;
+    
+    while (offset < length) {
+        if (!last || last->file >= 0 || last->external ||
+            last->length >= last->capacity) {
+            // big appends get one big chunk instead of many small ones
+            tf_buffer_ref chunk = tf_buffer_acquire(length - offset);
+            if (!chunk)
+                break;
+            
+            if (last)
+                last->next = chunk;
+            else
+                head = chunk;
+            
+            last = chunk;
+        }
+        
+        tf_index_t part = last->capacity - last->length;
+        if (part > length - offset)
+            part = length - offset;
+        
+        memcpy(last->data + last->length, data + offset, part);
+        last->length += part;
+        offset += part;
+    }
+    
+    return head;
+}
+
+tf_index_t tf_buffer_chain_get_length(const tf_buffer_ref head) {
+    tf_index_t result = 0;
+    
+    for (tf_buffer_ref current = head; current; current = current->next)
+        result += current->length;
+    
+    return result;
+}
+
+void tf_bufpool_get_stats(tf_bufpool_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    bzero(statsp, sizeof(tf_bufpool_stats_t));
+    pthread_mutex_lock(&tf_bufpool_depot_lock);
+    
+    tf_bufpool_stats_merge(statsp, &tf_bufpool_retired_stats);
+    
+    for (tf_bufpool_cache_ref cache = tf_bufpool_caches; cache; cache = cache->next)
+        tf_bufpool_stats_merge(statsp, &cache->stats);
+    
+    pthread_mutex_unlock(&tf_bufpool_depot_lock);
+}
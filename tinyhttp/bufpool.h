@@ -0,0 +1,100 @@
+//
+//  bufpool.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// pooled I/O buffers
+//
+// buffers come in a few fixed size classes, released buffers go to a
+// small per-thread cache first and to a shared depot after that, so in
+// steady state acquire/release never reach malloc/free
+//
+// buffers can be linked into chains via tf_buffer_set_next, releasing the
+// head releases the whole chain
+//
+
+/// amount of size classes
+#define TF_BUFPOOL_CLASS_COUNT 4
+/// smallest size class, every buffer holds at least that much
+#define TF_BUFPOOL_MIN_SIZE 4096
+/// largest size class, bigger requests are served by malloc directly
+#define TF_BUFPOOL_MAX_SIZE (TF_BUFPOOL_MIN_SIZE << (2 * (TF_BUFPOOL_CLASS_COUNT - 1)))
+
+/// pool usage counters, kept per thread and summed up on read
+typedef struct {
+    // acquires served from a cache/depot
+    uint64_t hits;
+    // acquires that had to call malloc
+    uint64_t misses;
+    // buffers/bytes acquired and not released yet, a buffer released on
+    // another thread than it was acquired on is still accounted correctly
+    // in the sum
+    uint64_t outstanding_buffers;
+    uint64_t outstanding_bytes;
+} tf_bufpool_stats_t;
+
+/// returns an empty buffer that can hold at least min_capacity bytes
+tf_buffer_ref tf_buffer_acquire(const tf_index_t min_capacity);
+/// returns the buffer and everything chained after it to the pool
+void tf_buffer_release(tf_buffer_ref buffer);
+
+///
+/// buffer standing for length bytes of the file starting at offset, it
+/// goes into chains like any other buffer but the bytes are sent straight
+/// from the file (sendfile), release(owner) is called when the buffer is
+/// released so the file can be closed or unreferenced then
+///
+tf_buffer_ref tf_buffer_acquire_file(const int file, const uint64_t offset,
+                                     const tf_index_t length,
+                                     const tf_deallocator_t release,
+                                     tf_data_ref owner);
+/// file behind the buffer (and its starting offset), -1 for regular ones
+int tf_buffer_get_file(const tf_buffer_ref buffer, uint64_t* offsetp);
+
+///
+/// buffer standing for length bytes of memory owned by someone else, sent
+/// from there without copying, the memory must stay unchanged until
+/// release(owner) is called on release, nothing can be appended to it
+///
+tf_buffer_ref tf_buffer_acquire_external(const char* data, const tf_index_t length,
+                                         const tf_deallocator_t release,
+                                         tf_data_ref owner);
+
+///
+/// makes sure the buffer can hold at least min_capacity bytes, moving its
+/// contents into a bigger buffer if needed, returns the buffer to use from
+/// now on (NULL on failure, the original buffer is left intact then)
+///
+tf_buffer_ref tf_buffer_reserve(tf_buffer_ref buffer, const tf_index_t min_capacity);
+
+char* tf_buffer_get_data(const tf_buffer_ref buffer);
+tf_index_t tf_buffer_get_length(const tf_buffer_ref buffer);
+void tf_buffer_set_length(tf_buffer_ref buffer, const tf_index_t length);
+tf_index_t tf_buffer_get_capacity(const tf_buffer_ref buffer);
+/// bytes left after the current length
+tf_index_t tf_buffer_get_free(const tf_buffer_ref buffer);
+
+//
+// chains
+//
+
+tf_buffer_ref tf_buffer_get_next(const tf_buffer_ref buffer);
+void tf_buffer_set_next(tf_buffer_ref buffer, tf_buffer_ref next);
+
+///
+/// appends data to the end of the chain, filling up the last buffer and
+/// linking new ones as needed, returns the (possibly new) chain head
+///
+tf_buffer_ref tf_buffer_chain_append(tf_buffer_ref head, const char* data,
+                                     const tf_index_t length);
+tf_index_t tf_buffer_chain_get_length(const tf_buffer_ref head);
+
+void tf_bufpool_get_stats(tf_bufpool_stats_t* statsp);
@@ -0,0 +1,314 @@
+//
+//  cache.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "privutil.h"
+#include "bufpool.h"
+#include "hash.h"
+#include "cache.h"
+
+//
+// private
+//
+
+typedef struct tf_cache_shard_s* tf_cache_shard_ref;
+
+/// cached response, key, head and body in one allocation
+struct tf_cache_entry_s {
+    // monotonic milliseconds
+    uint64_t expires_at;
+    // what the entry counts against the budget
+    uint64_t size;
+    
+    // one for the shard (while cached) and one per buffer sending the body
+    tf_index_t refs;
+    
+    tf_index_t key_length;
+    tf_index_t head_length;
+    tf_index_t body_length;
+    char etag[TF_CACHE_ETAG_SIZE];
+    
+    // LRU list, most recently used first
+    tf_cache_entry_ref prev;
+    tf_cache_entry_ref next;
+    
+    // key (NUL-terminated), head, body
+    char data[];
+};
+
+/// per-worker part of the cache, only ever touched by its worker's thread
+struct tf_cache_shard_s {
+    tf_hash_ref entries;
+    tf_cache_entry_ref lru_first;
+    tf_cache_entry_ref lru_last;
+    
+    uint64_t max_bytes;
+    tf_cache_stats_t stats;
+};
+
+struct tf_cache_s {
+    tf_cache_shard_ref shards;
+    tf_index_t shard_count;
+};
+
+#define TF_CACHE_STAT_ADD(shard, field, value) \
+    __atomic_store_n(&(shard)->stats.field, (shard)->stats.field + (value), __ATOMIC_RELAXED)
+#define TF_CACHE_STAT_SUB(shard, field, value) \
+    __atomic_store_n(&(shard)->stats.field, (shard)->stats.field - (value), __ATOMIC_RELAXED)
+
+/// body buffer release callback, the last reference frees the entry
+void tf_cache_entry_unref(void* data) {
+    tf_cache_entry_ref entry = (tf_cache_entry_ref)data;
+    
+    if (entry && --entry->refs < 1)
+        free(entry);
+}
+
+void tf_cache_lru_unlink(tf_cache_shard_ref shard, tf_cache_entry_ref entry) {
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        shard->lru_first = entry->next;
+    
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        shard->lru_last = entry->prev;
+    
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+void tf_cache_lru_push(tf_cache_shard_ref shard, tf_cache_entry_ref entry) {
+    entry->prev = NULL;
+    entry->next = shard->lru_first;
+    
+    if (shard->lru_first)
+        shard->lru_first->prev = entry;
+    else
+        shard->lru_last = entry;
+    
+    shard->lru_first = entry;
+}
+
+void tf_cache_shard_drop(tf_cache_shard_ref shard, tf_cache_entry_ref entry) {
+    tf_cache_lru_unlink(shard, entry);
+    tf_hash_remove(shard->entries, entry->data);
+    
+    TF_CACHE_STAT_SUB(shard, entries, 1);
+    TF_CACHE_STAT_SUB(shard, bytes, entry->size);
+    
+    // responses still sending it keep it around
+    tf_cache_entry_unref(entry);
+}
+
+tf_cache_shard_ref tf_cache_get_shard(const tf_cache_ref cache, const tf_index_t worker) {
+    return (cache ? cache->shards + (worker % cache->shard_count) : NULL);
+}
+
+//
+// public
+//
+
+tf_cache_ref tf_cache_init(const tf_index_t workers, const uint64_t max_bytes) {
+    if (max_bytes < 1)
+        return NULL;
+    
+    tf_cache_ref cache = tf_struct_alloc(tf_cache_s);
+    
+    cache->shard_count = (workers >= 1 ? workers : 1);
+    cache->shards = calloc(cache->shard_count, sizeof(struct tf_cache_shard_s));
+    
+    for (tf_index_t index = 0; index < cache->shard_count; index++) {
+        cache->shards[index].entries = tf_hash_init_empty();
+        cache->shards[index].max_bytes = max_bytes / cache->shard_count;
+    }
+    
+    return cache;
+}
+
+tf_cache_entry_ref tf_cache_lookup(tf_cache_ref cache, const tf_index_t worker,
+                                   const tf_str_view_t key) {
+    tf_cache_shard_ref shard = tf_cache_get_shard(cache, worker);
+    if (!shard)
+        return NULL;
+    
+    tf_cache_entry_ref entry = tf_hash_get_view(shard->entries, key);
+    
+    if (entry && tf_monotonic_ms() >= entry->expires_at) {
+        TF_CACHE_STAT_ADD(shard, expirations, 1);
+        
+        tf_cache_shard_drop(shard, entry);
+        entry = NULL;
+    }
+    
+    if (!entry) {
+        TF_CACHE_STAT_ADD(shard, misses, 1);
+        return NULL;
+    }
+    
+    TF_CACHE_STAT_ADD(shard, hits, 1);
+    
+    if (shard->lru_first != entry) {
+        tf_cache_lru_unlink(shard, entry);
+        tf_cache_lru_push(shard, entry);
+    }
+    
+    return entry;
+}
+
+tf_cache_entry_ref tf_cache_insert(tf_cache_ref cache, const tf_index_t worker,
+                                   const tf_str_view_t key, const char* etag,
+                                   const tf_str_view_t head, const tf_str_view_t body,
+                                   const tf_index_t ttl) {
+    tf_cache_shard_ref shard = tf_cache_get_shard(cache, worker);
+    
+    // the hash needs NUL-terminated keys
+    if (!shard || !etag || !key.data || key.length < 1 || !head.data ||
+        memchr(key.data, '\0', key.length))
+        return NULL;
+    
+    uint64_t size = sizeof(struct tf_cache_entry_s) + (uint64_t)key.length + 1 +
+                    head.length + body.length;
+    
+    if (size > shard->max_bytes)
+        return NULL;
+    
+    tf_cache_entry_ref entry = malloc((size_t)size);
+    if (!entry)
+        return NULL;
+    
+    bzero(entry, sizeof(struct tf_cache_entry_s));
+    
+    entry->expires_at = tf_monotonic_ms() + ttl;
+    entry->size = size;
+    entry->refs = 1;
+    entry->key_length = key.length;
+    entry->head_length = head.length;
+    entry->body_length = body.length;
+    snprintf(entry->etag, sizeof(entry->etag), "%s", etag);
+    
+    memcpy(entry->data, key.data, key.length);
+    entry->data[key.length] = '\0';
+    memcpy(entry->data + key.length + 1, head.data, head.length);
+    
+    if (body.length > 0)
+        memcpy(entry->data + key.length + 1 + head.length, body.data, body.length);
+    
+    tf_cache_entry_ref previous = tf_hash_get_view(shard->entries, key);
+    if (previous)
+        tf_cache_shard_drop(shard, previous);
+    
+    // make room first
+    while (shard->stats.bytes + size > shard->max_bytes && shard->lru_last) {
+        TF_CACHE_STAT_ADD(shard, evictions, 1);
+        tf_cache_shard_drop(shard, shard->lru_last);
+    }
+    
+    tf_hash_set(shard->entries, entry->data, entry, NULL);
+    tf_cache_lru_push(shard, entry);
+    
+    TF_CACHE_STAT_ADD(shard, inserts, 1);
+    TF_CACHE_STAT_ADD(shard, entries, 1);
+    TF_CACHE_STAT_ADD(shard, bytes, size);
+    
+    return entry;
+}
+
+void tf_cache_make_etag(const char* data, const tf_index_t length, char* result) {
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    
+    for (tf_index_t index = 0; index < length; index++) {
+        hash ^= (uint8_t)data[index];
+        hash *= 0x100000001b3ull;
+    }
+    
+    snprintf(result, TF_CACHE_ETAG_SIZE, "\"%016llx\"", (unsigned long long)hash);
+}
+
+const char* tf_cache_entry_get_etag(const tf_cache_entry_ref entry) {
+    return (entry ? entry->etag : NULL);
+}
+
+tf_str_view_t tf_cache_entry_get_head(const tf_cache_entry_ref entry) {
+    tf_str_view_t result = { NULL, 0 };
+    
+    if (entry) {
+        result.data = entry->data + entry->key_length + 1;
+        result.length = entry->head_length;
+    }
+    
+    return result;
+}
+
+tf_buffer_ref tf_cache_entry_append_body(tf_cache_entry_ref entry, tf_buffer_ref output) {
+    if (!entry || entry->body_length < 1)
+        return output;
+    
+    const char* body = entry->data + entry->key_length + 1 + entry->head_length;
+    
+    if (entry->body_length <= TF_CACHE_COPY_LIMIT)
+        return tf_buffer_chain_append(output, body, entry->body_length);
+    
+    tf_buffer_ref buffer = tf_buffer_acquire_external(body, entry->body_length,
+                                                      tf_cache_entry_unref, entry);
+    if (!buffer)
+        return output;
+    
+    entry->refs++;
+    
+    if (!output)
+        return buffer;
+    
+    tf_buffer_ref last = output;
+    while (tf_buffer_get_next(last))
+        last = tf_buffer_get_next(last);
+    
+    tf_buffer_set_next(last, buffer);
+    return output;
+}
+
+void tf_cache_get_stats(const tf_cache_ref cache, tf_cache_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    bzero(statsp, sizeof(tf_cache_stats_t));
+    
+    for (tf_index_t index = 0; cache && index < cache->shard_count; index++) {
+        const tf_cache_stats_t* stats = &cache->shards[index].stats;
+        
+        statsp->hits += __atomic_load_n(&stats->hits, __ATOMIC_RELAXED);
+        statsp->misses += __atomic_load_n(&stats->misses, __ATOMIC_RELAXED);
+        statsp->inserts += __atomic_load_n(&stats->inserts, __ATOMIC_RELAXED);
+        statsp->evictions += __atomic_load_n(&stats->evictions, __ATOMIC_RELAXED);
+        statsp->expirations += __atomic_load_n(&stats->expirations, __ATOMIC_RELAXED);
+        statsp->entries += __atomic_load_n(&stats->entries, __ATOMIC_RELAXED);
+        statsp->bytes += __atomic_load_n(&stats->bytes, __ATOMIC_RELAXED);
+    }
+}
+
+void tf_cache_release(tf_cache_ref cache) {
+    if (!cache)
+        return;
+    
+    for (tf_index_t index = 0; index < cache->shard_count; index++) {
+        tf_cache_shard_ref shard = cache->shards + index;
+        
+        while (shard->lru_first)
+            tf_cache_shard_drop(shard, shard->lru_first);
+        
+        tf_hash_release(shard->entries);
+    }
+    
+    free(cache->shards);
+    free(cache);
+}
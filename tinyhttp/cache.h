@@ -0,0 +1,88 @@
+//
+//  cache.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// response cache
+//
+// keeps whole serialized responses (head and body) so a hit is answered
+// by copying or referencing their bytes, without running the handler or
+// formatting anything
+//
+// one shard per worker, each only ever touched by its worker's thread,
+// so neither lookups nor inserts take a lock, a shard is an LRU list plus
+// a hash table bounded by its share of the byte budget, entries expire
+// after their TTL and are dropped when a lookup finds them expired
+//
+// entries are reference counted, output buffers still sending one keep
+// it alive after it has been evicted
+//
+
+/// "quoted" 64-bit hash in hex, NUL included
+#define TF_CACHE_ETAG_SIZE 19
+/// cached bodies up to this size are copied into the output, bigger ones
+/// are sent straight from the cache entry
+#define TF_CACHE_COPY_LIMIT 2048
+
+/// cache counters, summed over all the shards
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    // dropped to stay within the byte budget
+    uint64_t evictions;
+    // dropped because their TTL was over
+    uint64_t expirations;
+    // cached right now
+    uint64_t entries;
+    uint64_t bytes;
+} tf_cache_stats_t;
+
+/// max_bytes is the budget of all the shards, one per worker, together
+tf_cache_ref tf_cache_init(const tf_index_t workers, const uint64_t max_bytes);
+
+///
+/// live entry stored under the key on the worker's shard, NULL if there
+/// is none, the entry is only good until the next insert on that shard
+/// unless its body is referenced by a buffer (see tf_cache_entry_append_body)
+///
+tf_cache_entry_ref tf_cache_lookup(tf_cache_ref cache, const tf_index_t worker,
+                                   const tf_str_view_t key);
+
+///
+/// copies the response head (without the Connection header and the final
+/// CRLF, those differ by request) and body into a new entry, replacing the
+/// one stored under the key, returns NULL if the response is too big for
+/// the shard, same lifetime as lookup results otherwise
+///
+tf_cache_entry_ref tf_cache_insert(tf_cache_ref cache, const tf_index_t worker,
+                                   const tf_str_view_t key, const char* etag,
+                                   const tf_str_view_t head, const tf_str_view_t body,
+                                   const tf_index_t ttl);
+
+/// strong entity tag of the body, result has to hold TF_CACHE_ETAG_SIZE
+void tf_cache_make_etag(const char* data, const tf_index_t length, char* result);
+
+const char* tf_cache_entry_get_etag(const tf_cache_entry_ref entry);
+tf_str_view_t tf_cache_entry_get_head(const tf_cache_entry_ref entry);
+
+///
+/// appends the body to the output chain, a small one is copied, a big one
+/// goes in as a buffer referencing the entry, returns the chain head like
+/// tf_buffer_chain_append
+///
+tf_buffer_ref tf_cache_entry_append_body(tf_cache_entry_ref entry, tf_buffer_ref output);
+
+/// can be called from any thread
+void tf_cache_get_stats(const tf_cache_ref cache, tf_cache_stats_t* statsp);
+
+/// entries still referenced by buffers go away with the last of them
+void tf_cache_release(tf_cache_ref cache);
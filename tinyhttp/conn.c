@@ -0,0 +1,608 @@
+//
+//  conn.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "privutil.h"
+#include "tcp.h"
+#include "bufpool.h"
+#include "arena.h"
+#include "conn.h"
+
+//
+// private
+//
+
+/// initial amount of socket slots, grows on demand
+#define TF_CONN_TABLE_INITIAL_SLOTS 1024
+
+struct tf_conn_s {
+    tf_socket_t socket;
+    tf_index_t worker_id;
+    
+    // received, not yet consumed data, only held while there is some
+    tf_buffer_ref input;
+    
+    // queued, not yet sent data, output_offset bytes of the first buffer
+    // have been sent already
+    tf_buffer_ref output;
+    tf_buffer_ref output_tail;
+    tf_index_t output_offset;
+    tf_index_t output_length;
+    
+    // events currently registered with the poller
+    uint8_t poll_flags;
+    
+    tf_http_parser_t parser;
+    
+    // request-scoped allocations, created on first use and kept with the
+    // slab object (not the socket) so it's reused by later connections
+    tf_arena_ref arena;
+    
+    // monotonic, in milliseconds
+    uint64_t created_at;
+    uint64_t last_active_at;
+    
+    // armed by the TCP server for the deadline that currently applies
+    tf_timer_t timer;
+    tf_conn_timing_t timing;
+    // requests in flight with the io_uring backend
+    tf_conn_uring_t uring;
+    // deadline kind and time used while no output is pending
+    uint8_t read_timeout;
+    uint64_t read_deadline;
+    
+    uint8_t close_reason;
+    
+    // input bypasses the input buffer until splice_left bytes went there
+    int splice_fd;
+    uint64_t splice_left;
+    
+    // owned by the HTTP server, which forgets them on close
+    tf_data_ref deferred;
+    tf_data_ref stream;
+    tf_data_ref body;
+    // the client's token bucket, see admit.h
+    uint64_t client_key;
+    
+    tf_data_ref user_data;
+    tf_deallocator_t user_data_autorelease;
+    
+    // outgoing connections have their own, the server's is used otherwise
+    tf_tcp_callback_t callback;
+    tf_data_ref callback_meta;
+    
+    bool closing;
+    // the callback is told once the output queue runs low
+    bool wants_drain;
+    // outgoing, the handshake hasn't completed yet
+    bool connecting;
+    // no reading for now, see tf_tcp_set_paused
+    bool paused;
+    
+    // next free object in the slab, only valid while not in use
+    tf_conn_ref next_free;
+};
+
+struct tf_conn_table_s {
+    // socket number -> connection
+    tf_conn_ref* slots;
+    tf_index_t slot_count;
+    
+    // preallocated connection objects
+    tf_conn_ref slab;
+    tf_conn_ref free_list;
+    
+    tf_index_t count;
+    tf_index_t max_connections;
+};
+
+bool tf_conn_table_fit(tf_conn_table_ref table, tf_socket_t socket) {
+    if ((tf_index_t)socket < table->slot_count)
+        return true;
+    
+    tf_index_t slot_count = table->slot_count;
+    while (slot_count <= (tf_index_t)socket)
+        slot_count *= 2;
+    
+    tf_conn_ref* slots = realloc(table->slots, slot_count * sizeof(tf_conn_ref));
+    if (!slots)
+        return false;
+    
+    // zero out all the garbage
+    memset(slots + table->slot_count, 0,
+           (slot_count - table->slot_count) * sizeof(tf_conn_ref));
+    
+    table->slots = slots;
+    table->slot_count = slot_count;
+    
+    return true;
+}
+
+void tf_conn_update_output_tail(tf_conn_ref conn) {
+    if (!conn->output_tail)
+        conn->output_tail = conn->output;
+    
+    while (conn->output_tail && tf_buffer_get_next(conn->output_tail))
+        conn->output_tail = tf_buffer_get_next(conn->output_tail);
+}
+
+//
+// public
+//
+
+tf_conn_table_ref tf_conn_table_init(const tf_index_t max_connections) {
+    tf_conn_table_ref table = tf_struct_alloc(tf_conn_table_s);
+    
+    table->max_connections = (max_connections >= 1 ? max_connections : 1);
+    table->slot_count = TF_CONN_TABLE_INITIAL_SLOTS;
+    table->slots = calloc(table->slot_count, sizeof(tf_conn_ref));
+    table->slab = calloc(table->max_connections, sizeof(struct tf_conn_s));
+    
+    // chain all the objects into the free list
+    for (tf_index_t index = 0; index < table->max_connections; index++) {
+        table->slab[index].socket = -1;
+        table->slab[index].next_free = ((index + 1) < table->max_connections ?
+                                        table->slab + index + 1 : NULL);
+    }
+    
+    table->free_list = table->slab;
+    return table;
+}
+
+tf_conn_ref tf_conn_table_insert(tf_conn_table_ref table, tf_socket_t socket,
+                                 const tf_index_t worker_id) {
+    if (!table || socket < 0 || !table->free_list)
+        return NULL;
+    
+    if (!tf_conn_table_fit(table, socket) || table->slots[socket])
+        return NULL;
+    
+    tf_conn_ref conn = table->free_list;
+    table->free_list = conn->next_free;
+    
+    conn->socket = socket;
+    conn->worker_id = worker_id;
+    conn->next_free = NULL;
+    
+    tf_http_parser_init(&conn->parser, TF_HTTP_DEFAULT_MAX_HEAD_SIZE);
+    
+    conn->created_at = tf_monotonic_ms();
+    conn->last_active_at = conn->created_at;
+    
+    table->slots[socket] = conn;
+    table->count++;
+    
+    return conn;
+}
+
+tf_conn_ref tf_conn_table_get(const tf_conn_table_ref table, tf_socket_t socket) {
+    if (!table || socket < 0 || (tf_index_t)socket >= table->slot_count)
+        return NULL;
+    
+    return table->slots[socket];
+}
+
+void tf_conn_table_remove(tf_conn_table_ref table, tf_conn_ref conn) {
+    if (!table || !conn || conn->socket < 0)
+        return;
+    
+    if (table->slots[conn->socket] == conn) {
+        table->slots[conn->socket] = NULL;
+        table->count--;
+    }
+    
+    if (conn->user_data_autorelease)
+        conn->user_data_autorelease(conn->user_data);
+    
+    tf_buffer_release(conn->input);
+    tf_buffer_release(conn->output);
+    
+    // the arena stays, just empty
+    tf_arena_ref arena = conn->arena;
+    tf_arena_reset(arena);
+    
+    // back to the slab
+    bzero(conn, sizeof(struct tf_conn_s));
+    conn->arena = arena;
+    conn->socket = -1;
+    conn->next_free = table->free_list;
+    table->free_list = conn;
+}
+
+tf_index_t tf_conn_table_get_count(const tf_conn_table_ref table) {
+    return (table ? table->count : 0);
+}
+
+tf_index_t tf_conn_table_get_slot_count(const tf_conn_table_ref table) {
+    return (table ? table->slot_count : 0);
+}
+
+void tf_conn_table_release(tf_conn_table_ref table) {
+    if (!table)
+        return;
+    
+    for (tf_index_t index = 0; index < table->slot_count; index++) {
+        if (table->slots[index])
+            tf_conn_table_remove(table, table->slots[index]);
+    }
+    
+    for (tf_index_t index = 0; index < table->max_connections; index++)
+        tf_arena_release(table->slab[index].arena);
+    
+    free(table->slots);
+    free(table->slab);
+    free(table);
+}
+
+//
+// connection public
+//
+
+tf_socket_t tf_conn_get_socket(const tf_conn_ref conn) {
+    return (conn ? conn->socket : -1);
+}
+
+tf_index_t tf_conn_get_worker_id(const tf_conn_ref conn) {
+    return (conn ? conn->worker_id : 0);
+}
+
+char* tf_conn_get_input(const tf_conn_ref conn, tf_index_t* lengthp) {
+    TF_PTR_SET(lengthp, (conn ? tf_buffer_get_length(conn->input) : 0));
+    return (conn ? tf_buffer_get_data(conn->input) : NULL);
+}
+
+char* tf_conn_reserve_input(tf_conn_ref conn, const tf_index_t min_free,
+                            tf_index_t* freep) {
+    TF_PTR_SET(freep, 0);
+    
+    if (!conn)
+        return NULL;
+    
+    tf_index_t length = tf_buffer_get_length(conn->input);
+    
+    if (tf_buffer_get_free(conn->input) < min_free) {
+        if (length + min_free > TF_BUFPOOL_MAX_SIZE)
+            return NULL; // nobody is consuming the input
+        
+        tf_buffer_ref input = tf_buffer_reserve(conn->input, length + min_free);
+        if (!input)
+            return NULL;
+        
+        conn->input = input;
+    }
+    
+    TF_PTR_SET(freep, tf_buffer_get_free(conn->input));
+    return tf_buffer_get_data(conn->input) + length;
+}
+
+void tf_conn_commit_input(tf_conn_ref conn, const tf_index_t length) {
+    if (conn)
+        tf_buffer_set_length(conn->input, tf_buffer_get_length(conn->input) + length);
+}
+
+bool tf_conn_append_input(tf_conn_ref conn, const char* data,
+                          const tf_index_t length) {
+    tf_index_t available = 0;
+    char* space = tf_conn_reserve_input(conn, length, &available);
+    
+    if (!space || !data)
+        return false;
+    
+    memcpy(space, data, length);
+    tf_conn_commit_input(conn, length);
+    
+    return true;
+}
+
+void tf_conn_consume_input(tf_conn_ref conn, const tf_index_t length) {
+    if (!conn)
+        return;
+    
+    tf_index_t total = tf_buffer_get_length(conn->input);
+    tf_index_t left = (length < total ? total - length : 0);
+    
+    if (left < 1) {
+        // nothing pending, hand the buffer back to the pool
+        tf_buffer_release(conn->input);
+        conn->input = NULL;
+        
+        return;
+    }
+    
+    char* data = tf_buffer_get_data(conn->input);
+    
+    memmove(data, data + length, left);
+    tf_buffer_set_length(conn->input, left);
+}
+
+bool tf_conn_queue_output(tf_conn_ref conn, const char* data,
+                          const tf_index_t length) {
+    if (!conn || !data)
+        return false;
+    
+    if (length < 1)
+        return true;
+    
+    // pick up the chain where it ends, the last buffer is usually not full
+    tf_buffer_ref last = conn->output_tail;
+    tf_index_t before = tf_buffer_get_length(last);
+    tf_buffer_ref head = tf_buffer_chain_append(last, data, length);
+    
+    if (!conn->output)
+        conn->output = head;
+    
+    tf_index_t appended = tf_buffer_chain_get_length(last ? last : head) - before;
+    
+    conn->output_length += appended;
+    tf_conn_update_output_tail(conn);
+    
+    return (appended == length);
+}
+
+void tf_conn_queue_buffer(tf_conn_ref conn, tf_buffer_ref chain) {
+    if (!conn) {
+        tf_buffer_release(chain);
+        return;
+    }
+    
+    if (!chain)
+        return;
+    
+    if (conn->output_tail)
+        tf_buffer_set_next(conn->output_tail, chain);
+    else
+        conn->output = chain;
+    
+    conn->output_length += tf_buffer_chain_get_length(chain);
+    conn->output_tail = chain;
+    tf_conn_update_output_tail(conn);
+}
+
+tf_buffer_ref tf_conn_get_output(const tf_conn_ref conn, tf_index_t* offsetp) {
+    TF_PTR_SET(offsetp, (conn ? conn->output_offset : 0));
+    return (conn ? conn->output : NULL);
+}
+
+tf_index_t tf_conn_get_output_length(const tf_conn_ref conn) {
+    return (conn ? conn->output_length : 0);
+}
+
+void tf_conn_consume_output(tf_conn_ref conn, tf_index_t length) {
+    if (!conn)
+        return;
+    
+    if (length > conn->output_length)
+        length = conn->output_length;
+    
+    conn->output_length -= length;
+    
+    while (conn->output && length > 0) {
+        tf_index_t left = tf_buffer_get_length(conn->output) - conn->output_offset;
+        
+        if (length < left) {
+            conn->output_offset += length;
+            break;
+        }
+        
+        // the whole buffer is gone, hand it back to the pool
+        tf_buffer_ref sent = conn->output;
+        
+        conn->output = tf_buffer_get_next(sent);
+        conn->output_offset = 0;
+        length -= left;
+        
+        tf_buffer_set_next(sent, NULL);
+        tf_buffer_release(sent);
+    }
+    
+    // skip over empty buffers
+    while (conn->output && tf_buffer_get_length(conn->output) <= conn->output_offset) {
+        tf_buffer_ref sent = conn->output;
+        
+        conn->output = tf_buffer_get_next(sent);
+        conn->output_offset = 0;
+        
+        tf_buffer_set_next(sent, NULL);
+        tf_buffer_release(sent);
+    }
+    
+    if (!conn->output)
+        conn->output_tail = NULL;
+}
+
+uint8_t tf_conn_get_poll_flags(const tf_conn_ref conn) {
+    return (conn ? conn->poll_flags : 0);
+}
+
+void tf_conn_set_poll_flags(tf_conn_ref conn, const uint8_t flags) {
+    if (conn)
+        conn->poll_flags = flags;
+}
+
+tf_http_parser_t* tf_conn_get_parser(tf_conn_ref conn) {
+    return (conn ? &conn->parser : NULL);
+}
+
+tf_arena_ref tf_conn_get_arena(tf_conn_ref conn) {
+    if (!conn)
+        return NULL;
+    
+    if (!conn->arena)
+        conn->arena = tf_arena_init(TF_ARENA_DEFAULT_CHUNK_SIZE);
+    
+    return conn->arena;
+}
+
+void tf_conn_reset_arena(tf_conn_ref conn) {
+    if (conn)
+        tf_arena_reset(conn->arena);
+}
+
+uint64_t tf_conn_get_created_at(const tf_conn_ref conn) {
+    return (conn ? conn->created_at : 0);
+}
+
+uint64_t tf_conn_get_last_active_at(const tf_conn_ref conn) {
+    return (conn ? conn->last_active_at : 0);
+}
+
+void tf_conn_touch(tf_conn_ref conn) {
+    if (conn)
+        conn->last_active_at = tf_monotonic_ms();
+}
+
+tf_timer_t* tf_conn_get_timer(tf_conn_ref conn) {
+    return (conn ? &conn->timer : NULL);
+}
+
+tf_conn_timing_t* tf_conn_get_timing(tf_conn_ref conn) {
+    return (conn ? &conn->timing : NULL);
+}
+
+tf_conn_uring_t* tf_conn_get_uring(tf_conn_ref conn) {
+    return (conn ? &conn->uring : NULL);
+}
+
+uint8_t tf_conn_get_read_timeout(const tf_conn_ref conn, uint64_t* deadlinep) {
+    TF_PTR_SET(deadlinep, (conn ? conn->read_deadline : 0));
+    return (conn ? conn->read_timeout : 0);
+}
+
+void tf_conn_set_read_timeout(tf_conn_ref conn, const uint8_t timeout,
+                              const uint64_t deadline) {
+    if (!conn)
+        return;
+    
+    conn->read_timeout = timeout;
+    conn->read_deadline = deadline;
+}
+
+uint8_t tf_conn_get_close_reason(const tf_conn_ref conn) {
+    return (conn ? conn->close_reason : 0);
+}
+
+void tf_conn_set_close_reason(tf_conn_ref conn, const uint8_t reason) {
+    if (conn)
+        conn->close_reason = reason;
+}
+
+tf_data_ref tf_conn_get_deferred(const tf_conn_ref conn) {
+    return (conn ? conn->deferred : NULL);
+}
+
+void tf_conn_set_deferred(tf_conn_ref conn, tf_data_ref deferred) {
+    if (conn)
+        conn->deferred = deferred;
+}
+
+tf_data_ref tf_conn_get_stream(const tf_conn_ref conn) {
+    return (conn ? conn->stream : NULL);
+}
+
+void tf_conn_set_stream(tf_conn_ref conn, tf_data_ref stream) {
+    if (conn)
+        conn->stream = stream;
+}
+
+tf_data_ref tf_conn_get_body(const tf_conn_ref conn) {
+    return (conn ? conn->body : NULL);
+}
+
+void tf_conn_set_body(tf_conn_ref conn, tf_data_ref body) {
+    if (conn)
+        conn->body = body;
+}
+
+int tf_conn_get_splice(const tf_conn_ref conn, uint64_t* leftp) {
+    TF_PTR_SET(leftp, (conn ? conn->splice_left : 0));
+    return (conn ? conn->splice_fd : -1);
+}
+
+void tf_conn_set_splice(tf_conn_ref conn, const int fd, const uint64_t left) {
+    if (!conn)
+        return;
+    
+    conn->splice_fd = fd;
+    conn->splice_left = left;
+}
+
+uint64_t tf_conn_get_client_key(const tf_conn_ref conn) {
+    return (conn ? conn->client_key : 0);
+}
+
+void tf_conn_set_client_key(tf_conn_ref conn, const uint64_t key) {
+    if (conn)
+        conn->client_key = key;
+}
+
+bool tf_conn_wants_drain(const tf_conn_ref conn) {
+    return (conn ? conn->wants_drain : false);
+}
+
+void tf_conn_set_wants_drain(tf_conn_ref conn, const bool wants_drain) {
+    if (conn)
+        conn->wants_drain = wants_drain;
+}
+
+tf_data_ref tf_conn_get_user_data(const tf_conn_ref conn) {
+    return (conn ? conn->user_data : NULL);
+}
+
+void tf_conn_set_user_data(tf_conn_ref conn, tf_data_ref data,
+                           const tf_deallocator_t autorelease) {
+    if (!conn)
+        return;
+    
+    if (conn->user_data_autorelease && conn->user_data != data)
+        conn->user_data_autorelease(conn->user_data);
+    
+    conn->user_data = data;
+    conn->user_data_autorelease = autorelease;
+}
+
+tf_tcp_callback_t tf_conn_get_callback(const tf_conn_ref conn, tf_data_ref* metap) {
+    TF_PTR_SET(metap, (conn ? conn->callback_meta : NULL));
+    return (conn ? conn->callback : NULL);
+}
+
+void tf_conn_set_callback(tf_conn_ref conn, const tf_tcp_callback_t callback,
+                          tf_data_ref meta) {
+    if (!conn)
+        return;
+    
+    conn->callback = callback;
+    conn->callback_meta = meta;
+}
+
+bool tf_conn_is_connecting(const tf_conn_ref conn) {
+    return (conn ? conn->connecting : false);
+}
+
+void tf_conn_set_connecting(tf_conn_ref conn, const bool connecting) {
+    if (conn)
+        conn->connecting = connecting;
+}
+
+bool tf_conn_is_paused(const tf_conn_ref conn) {
+    return (conn ? conn->paused : false);
+}
+
+void tf_conn_set_paused(tf_conn_ref conn, const bool paused) {
+    if (conn)
+        conn->paused = paused;
+}
+
+void tf_conn_close(tf_conn_ref conn) {
+    if (conn)
+        conn->closing = true;
+}
+
+bool tf_conn_is_closing(const tf_conn_ref conn) {
+    return (conn ? conn->closing : true);
+}
@@ -0,0 +1,198 @@
+//
+//  conn.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "http.h"
+#include "timer.h"
+
+//
+// connection table
+//
+// connections are looked up directly by their socket number, the
+// connection objects themselves come from a preallocated slab with a free
+// list, so insert/get/remove are all O(1) and the slab size caps the
+// amount of simultaneous clients
+//
+
+tf_conn_table_ref tf_conn_table_init(const tf_index_t max_connections);
+
+/// takes a free connection object for the socket, NULL if the table is full
+tf_conn_ref tf_conn_table_insert(tf_conn_table_ref table, tf_socket_t socket,
+                                 const tf_index_t worker_id);
+/// returns the connection for the socket, NULL if unknown
+tf_conn_ref tf_conn_table_get(const tf_conn_table_ref table, tf_socket_t socket);
+/// releases all the per-connection state and returns the object to the slab
+/// (the socket itself is not closed)
+void tf_conn_table_remove(tf_conn_table_ref table, tf_conn_ref conn);
+
+tf_index_t tf_conn_table_get_count(const tf_conn_table_ref table);
+/// upper bound (exclusive) for socket numbers currently in the table
+tf_index_t tf_conn_table_get_slot_count(const tf_conn_table_ref table);
+
+void tf_conn_table_release(tf_conn_table_ref table);
+
+//
+// connection
+//
+
+tf_socket_t tf_conn_get_socket(const tf_conn_ref conn);
+tf_index_t tf_conn_get_worker_id(const tf_conn_ref conn);
+
+/// received data that has not been consumed yet
+char* tf_conn_get_input(const tf_conn_ref conn, tf_index_t* lengthp);
+
+///
+/// makes room for at least min_free more input bytes and returns where
+/// they go, the input buffer comes from the buffer pool and is grown
+/// into bigger size classes as needed, NULL if it cannot grow any further
+///
+char* tf_conn_reserve_input(tf_conn_ref conn, const tf_index_t min_free,
+                            tf_index_t* freep);
+/// marks the specified amount of reserved bytes as received
+void tf_conn_commit_input(tf_conn_ref conn, const tf_index_t length);
+bool tf_conn_append_input(tf_conn_ref conn, const char* data,
+                          const tf_index_t length);
+
+/// drops the specified amount of bytes from the front of the input, the
+/// input buffer goes back to the pool as soon as it's empty
+void tf_conn_consume_input(tf_conn_ref conn, const tf_index_t length);
+
+///
+/// output queue, sent in order by the TCP server whenever the socket can
+/// take more, so queueing never blocks
+///
+
+/// copies data to the end of the queue, false if it could not be queued
+/// completely
+bool tf_conn_queue_output(tf_conn_ref conn, const char* data,
+                          const tf_index_t length);
+/// takes ownership of a buffer chain and puts it at the end of the queue
+void tf_conn_queue_buffer(tf_conn_ref conn, tf_buffer_ref chain);
+
+/// first queued buffer, *offsetp bytes of it have been sent already
+tf_buffer_ref tf_conn_get_output(const tf_conn_ref conn, tf_index_t* offsetp);
+/// total amount of queued bytes that have not been sent yet
+tf_index_t tf_conn_get_output_length(const tf_conn_ref conn);
+/// drops the specified amount of sent bytes from the front of the queue
+void tf_conn_consume_output(tf_conn_ref conn, tf_index_t length);
+
+/// poller events currently registered for the socket (tf_poller_flags_t)
+uint8_t tf_conn_get_poll_flags(const tf_conn_ref conn);
+void tf_conn_set_poll_flags(tf_conn_ref conn, const uint8_t flags);
+
+/// request parser state for the request currently being received
+tf_http_parser_t* tf_conn_get_parser(tf_conn_ref conn);
+
+/// arena for everything that only lives as long as the current request,
+/// reset by the HTTP server once the response has been queued
+tf_arena_ref tf_conn_get_arena(tf_conn_ref conn);
+void tf_conn_reset_arena(tf_conn_ref conn);
+
+/// monotonic timestamps in milliseconds
+uint64_t tf_conn_get_created_at(const tf_conn_ref conn);
+uint64_t tf_conn_get_last_active_at(const tf_conn_ref conn);
+void tf_conn_touch(tf_conn_ref conn);
+
+/// deadline timer of the connection, owned by the TCP server's timer wheel
+tf_timer_t* tf_conn_get_timer(tf_conn_ref conn);
+
+/// timestamps behind the metrics (see metrics.h), monotonic nanoseconds
+typedef struct {
+    uint64_t accepted_at;
+    // output has been waiting to go out since, 0 while there is none
+    uint64_t queued_at;
+    bool first_byte_sent;
+} tf_conn_timing_t;
+
+tf_conn_timing_t* tf_conn_get_timing(tf_conn_ref conn);
+
+/// state of the io_uring backend (see tcp.c), unused with the poller
+typedef struct {
+    // tells completions for this connection from those for an earlier one
+    // on the same socket
+    uint32_t generation;
+    // linked sends in flight
+    tf_index_t sends;
+    // a multishot receive is armed, a cancellation for it is on the way
+    bool receiving;
+    bool cancelling;
+    // waiting for writability to continue with a file range
+    bool polling;
+} tf_conn_uring_t;
+
+tf_conn_uring_t* tf_conn_get_uring(tf_conn_ref conn);
+
+/// deadline applying while there is no output pending (tf_tcp_timeout_t),
+/// *deadlinep is 0 if there is none
+uint8_t tf_conn_get_read_timeout(const tf_conn_ref conn, uint64_t* deadlinep);
+void tf_conn_set_read_timeout(tf_conn_ref conn, const uint8_t timeout,
+                              const uint64_t deadline);
+
+/// why the connection is closed (tf_tcp_close_reason_t), meaningful in the
+/// TF_TCP_CONNECTION_CLOSE callback
+uint8_t tf_conn_get_close_reason(const tf_conn_ref conn);
+void tf_conn_set_close_reason(tf_conn_ref conn, const uint8_t reason);
+
+/// request being answered off the reactor (see tf_http_server_defer), the
+/// requests after it wait until it's done, NULL if there is none
+tf_data_ref tf_conn_get_deferred(const tf_conn_ref conn);
+void tf_conn_set_deferred(tf_conn_ref conn, tf_data_ref deferred);
+
+/// response being streamed (see tf_http_server_stream), the requests after
+/// it wait until it has ended, NULL if there is none
+tf_data_ref tf_conn_get_stream(const tf_conn_ref conn);
+void tf_conn_set_stream(tf_conn_ref conn, tf_data_ref stream);
+
+/// request body being received (see tf_http_server_receive_body), the
+/// input goes there before anything else, NULL if there is none
+tf_data_ref tf_conn_get_body(const tf_conn_ref conn);
+void tf_conn_set_body(tf_conn_ref conn, tf_data_ref body);
+
+/// descriptor the input is spliced into (see tf_tcp_set_splice), *leftp
+/// bytes to go, which is 0 while there is no splice target
+int tf_conn_get_splice(const tf_conn_ref conn, uint64_t* leftp);
+void tf_conn_set_splice(tf_conn_ref conn, const int fd, const uint64_t left);
+
+/// key of the client address the requests are rate limited by (see
+/// tf_admit_get_client_key), 0 until the HTTP server has looked it up
+uint64_t tf_conn_get_client_key(const tf_conn_ref conn);
+void tf_conn_set_client_key(tf_conn_ref conn, const uint64_t key);
+
+///
+/// asks for a TF_TCP_CONNECTION_DRAINED callback once less than
+/// TF_TCP_OUTPUT_LOW_WATER bytes are queued, the flag is cleared right
+/// before the call, so it has to be set again for the next one
+///
+bool tf_conn_wants_drain(const tf_conn_ref conn);
+void tf_conn_set_wants_drain(tf_conn_ref conn, const bool wants_drain);
+
+/// user data, released through autorelease (if any) on close
+tf_data_ref tf_conn_get_user_data(const tf_conn_ref conn);
+void tf_conn_set_user_data(tf_conn_ref conn, tf_data_ref data,
+                           const tf_deallocator_t autorelease);
+
+/// callback of an outgoing connection (see tf_tcp_connect) and its meta,
+/// NULL for connections that go to the server's callback
+tf_tcp_callback_t tf_conn_get_callback(const tf_conn_ref conn, tf_data_ref* metap);
+void tf_conn_set_callback(tf_conn_ref conn, const tf_tcp_callback_t callback,
+                          tf_data_ref meta);
+
+/// an outgoing connection waiting for its handshake, nothing is sent or
+/// read until it's done
+bool tf_conn_is_connecting(const tf_conn_ref conn);
+void tf_conn_set_connecting(tf_conn_ref conn, const bool connecting);
+
+/// reading is held off while set, see tf_tcp_set_paused
+bool tf_conn_is_paused(const tf_conn_ref conn);
+void tf_conn_set_paused(tf_conn_ref conn, const bool paused);
+
+/// asks the server to close the connection once the callback returns
+void tf_conn_close(tf_conn_ref conn);
+bool tf_conn_is_closing(const tf_conn_ref conn);
@@ -0,0 +1,571 @@
+//
+//  docroot.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#if defined(SYS_openat2)
+#include <linux/openat2.h>
+#endif
+#endif
+#include "privutil.h"
+#include "bufpool.h"
+#include "conn.h"
+#include "hash.h"
+#include "docroot.h"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+//
+// private
+//
+
+typedef struct tf_docroot_cache_s* tf_docroot_cache_ref;
+typedef struct tf_docroot_entry_s* tf_docroot_entry_ref;
+
+/// open file, shared by the cache and all the responses sending it
+struct tf_docroot_entry_s {
+    // relative to the root, also the cache key
+    char* path;
+    
+    int file;
+    uint64_t size;
+    // identity of the file, a change means it has to be opened again
+    dev_t device;
+    ino_t inode;
+    int64_t mtime_sec;
+    long mtime_nsec;
+    
+    const char* content_type;
+    // monotonic time of the last stat
+    uint64_t checked_at;
+    
+    // one for the cache (while cached) and one per queued response
+    tf_index_t refs;
+    bool cached;
+    
+    // LRU list, most recently used first
+    tf_docroot_entry_ref prev;
+    tf_docroot_entry_ref next;
+};
+
+/// per-worker cache, only ever touched by its worker's thread
+struct tf_docroot_cache_s {
+    tf_hash_ref entries;
+    tf_docroot_entry_ref lru_first;
+    tf_docroot_entry_ref lru_last;
+    tf_index_t count;
+    
+    tf_docroot_stats_t stats;
+};
+
+struct tf_docroot_s {
+    // document root directory, all the lookups are relative to it
+    int root;
+    
+    tf_docroot_cache_ref caches;
+    tf_index_t cache_count;
+    tf_index_t max_entries;
+};
+
+typedef struct {
+    const char* extension;
+    const char* content_type;
+} tf_docroot_mime_t;
+
+static const tf_docroot_mime_t tf_docroot_mime_types[] = {
+    { "html", "text/html; charset=UTF-8" },
+    { "htm", "text/html; charset=UTF-8" },
+    { "css", "text/css; charset=UTF-8" },
+    { "js", "text/javascript; charset=UTF-8" },
+    { "mjs", "text/javascript; charset=UTF-8" },
+    { "json", "application/json" },
+    { "txt", "text/plain; charset=UTF-8" },
+    { "xml", "application/xml" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "webp", "image/webp" },
+    { "ico", "image/x-icon" },
+    { "wasm", "application/wasm" },
+    { "pdf", "application/pdf" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "mp4", "video/mp4" },
+    { NULL, NULL }
+};
+
+#define TF_DOCROOT_STAT_ADD(cache, field) \
+    __atomic_store_n(&(cache)->stats.field, (cache)->stats.field + 1, __ATOMIC_RELAXED)
+#define TF_DOCROOT_STAT_SUB(cache, field) \
+    __atomic_store_n(&(cache)->stats.field, (cache)->stats.field - 1, __ATOMIC_RELAXED)
+
+int tf_docroot_hex_value(const char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    
+    return -1;
+}
+
+///
+/// percent-decodes the request path into result (relative, no leading
+/// slash), collapsing duplicate slashes, returns false for anything that
+/// is not a plain path below the root ("..", ".", NUL and so on)
+///
+bool tf_docroot_normalize(const tf_str_view_t path, char* result,
+                          const tf_index_t capacity) {
+    tf_index_t length = 0;
+    tf_index_t segment = 0; // start of the current segment in result
+    
+    if (path.length < 1 || path.data[0] != '/')
+        return false;
+    
+    for (tf_index_t index = 1; index <= path.length; index++) {
+        char c = (index < path.length ? path.data[index] : '/');
+        
+        if (c == '%' && index + 2 < path.length) {
+            int high = tf_docroot_hex_value(path.data[index + 1]);
+            int low = tf_docroot_hex_value(path.data[index + 2]);
+            
+            if (high < 0 || low < 0)
+                return false;
+            
+            c = (char)((high << 4) | low);
+            index += 2;
+            
+            // an encoded slash or NUL is never a plain path
+            if (c == '/' || c == '\0' || c == '\\')
+                return false;
+        } else if (c == '%' || c == '\\' || c == '\0')
+            return false;
+        
+        if (c == '/') {
+            tf_index_t segment_length = length - segment;
+            
+            if (segment_length == 0 && index < path.length)
+                continue; // "//"
+            
+            // dot segments are refused instead of being resolved
+            if ((segment_length == 1 && result[segment] == '.') ||
+                (segment_length == 2 && result[segment] == '.' &&
+                 result[segment + 1] == '.'))
+                return false;
+            
+            if (index == path.length)
+                break; // the one appended at the end
+        }
+        
+        if (length + 1 >= capacity)
+            return false;
+        
+        result[length++] = c;
+        
+        if (c == '/')
+            segment = length;
+    }
+    
+    result[length] = '\0';
+    return true;
+}
+
+void tf_docroot_entry_close(tf_docroot_entry_ref entry) {
+    if (entry->file >= 0)
+        close(entry->file);
+    
+    free(entry->path);
+    free(entry);
+}
+
+/// file buffer release callback, the last one closes the file
+void tf_docroot_entry_unref(void* data) {
+    tf_docroot_entry_ref entry = (tf_docroot_entry_ref)data;
+    
+    if (entry && --entry->refs < 1)
+        tf_docroot_entry_close(entry);
+}
+
+void tf_docroot_lru_unlink(tf_docroot_cache_ref cache, tf_docroot_entry_ref entry) {
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->lru_first = entry->next;
+    
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->lru_last = entry->prev;
+    
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+void tf_docroot_lru_push(tf_docroot_cache_ref cache, tf_docroot_entry_ref entry) {
+    entry->prev = NULL;
+    entry->next = cache->lru_first;
+    
+    if (cache->lru_first)
+        cache->lru_first->prev = entry;
+    else
+        cache->lru_last = entry;
+    
+    cache->lru_first = entry;
+}
+
+void tf_docroot_cache_drop(tf_docroot_cache_ref cache, tf_docroot_entry_ref entry) {
+    tf_docroot_lru_unlink(cache, entry);
+    tf_hash_remove(cache->entries, entry->path);
+    
+    cache->count--;
+    entry->cached = false;
+    TF_DOCROOT_STAT_SUB(cache, entries);
+    
+    // responses still sending it keep it open
+    tf_docroot_entry_unref(entry);
+}
+
+bool tf_docroot_entry_is_current(const tf_docroot_entry_ref entry,
+                                 const struct stat* st) {
+#if defined(__APPLE__)
+    int64_t mtime_sec = (int64_t)st->st_mtimespec.tv_sec;
+    long mtime_nsec = st->st_mtimespec.tv_nsec;
+#else
+    int64_t mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    long mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+    
+    return (entry->device == st->st_dev && entry->inode == st->st_ino &&
+            entry->size == (uint64_t)st->st_size && entry->mtime_sec == mtime_sec &&
+            entry->mtime_nsec == mtime_nsec);
+}
+
+///
+/// opens path (relative to the root, "" is the root itself) without
+/// following a symlink anywhere on the way, not just at the end, -1 if
+/// there is no such file or something on the way is a symlink
+///
+int tf_docroot_open_beneath(const int root, const char* path) {
+#if defined(__linux__) && defined(SYS_openat2)
+    struct open_how how = { .flags = O_RDONLY | O_CLOEXEC,
+                            .resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS };
+    int result = (int)syscall(SYS_openat2, root, (path[0] ? path : "."), &how, sizeof(how));
+    
+    // kernels before 5.6 walk it below
+    if (result >= 0 || errno != ENOSYS)
+        return result;
+#endif
+    
+    char component[TF_DOCROOT_MAX_PATH];
+    const char* start = path;
+    const char* slash;
+    int dir = root;
+    
+    // every directory on the way has to be a real one
+    while ((slash = strchr(start, '/')) != NULL) {
+        size_t length = (size_t)(slash - start);
+        
+        if (length >= sizeof(component)) {
+            if (dir != root)
+                close(dir);
+            
+            return -1;
+        }
+        
+        memcpy(component, start, length);
+        component[length] = '\0';
+        
+        int next = openat(dir, component, O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_DIRECTORY);
+        
+        if (dir != root)
+            close(dir);
+        
+        if (next < 0)
+            return -1;
+        
+        dir = next;
+        start = slash + 1;
+    }
+    
+    // a trailing slash leaves the directory itself
+    int file = openat(dir, (start[0] ? start : "."), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    
+    if (dir != root)
+        close(dir);
+    
+    return file;
+}
+
+/// opens the file (or the index file of the directory), NULL if there is
+/// no regular file
+tf_docroot_entry_ref tf_docroot_entry_open(tf_docroot_ref docroot, const char* path) {
+    int file = tf_docroot_open_beneath(docroot->root, path);
+    
+    if (file < 0)
+        return NULL;
+    
+    struct stat st;
+    
+    if (fstat(file, &st) < 0) {
+        close(file);
+        return NULL;
+    }
+    
+    bool directory = S_ISDIR(st.st_mode);
+    
+    if (directory) {
+        int index = openat(file, TF_DOCROOT_INDEX_FILE, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        
+        close(file);
+        file = index;
+        
+        if (file < 0 || fstat(file, &st) < 0) {
+            if (file >= 0)
+                close(file);
+            
+            return NULL;
+        }
+    }
+    
+    if (!S_ISREG(st.st_mode)) {
+        close(file);
+        return NULL;
+    }
+    
+    tf_docroot_entry_ref entry = tf_struct_alloc(tf_docroot_entry_s);
+    
+    entry->path = strdup(path);
+    entry->file = file;
+    entry->size = (uint64_t)st.st_size;
+    entry->device = st.st_dev;
+    entry->inode = st.st_ino;
+#if defined(__APPLE__)
+    entry->mtime_sec = (int64_t)st.st_mtimespec.tv_sec;
+    entry->mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+    entry->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    entry->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+    entry->checked_at = tf_monotonic_ms();
+    entry->refs = 1;
+    
+    // directories are served through their index file
+    entry->content_type = tf_docroot_get_content_type(directory ? TF_DOCROOT_INDEX_FILE :
+                                                      path);
+    return entry;
+}
+
+///
+/// returns a referenced entry for the path, from the cache if it's still
+/// valid there, NULL if there is no such file
+///
+tf_docroot_entry_ref tf_docroot_lookup(tf_docroot_ref docroot,
+                                       tf_docroot_cache_ref cache,
+                                       const char* path) {
+    tf_docroot_entry_ref entry = (cache ? tf_hash_get(cache->entries, path) : NULL);
+    
+    if (entry) {
+        uint64_t now = tf_monotonic_ms();
+        
+        if (now - entry->checked_at >= TF_DOCROOT_REVALIDATE_MS) {
+            struct stat st;
+            const char* target = (path[0] ? path : ".");
+            
+            // directories are cached by their own path, check the index
+            bool current = (fstatat(docroot->root, target, &st, AT_SYMLINK_NOFOLLOW) == 0);
+            if (current && S_ISDIR(st.st_mode)) {
+                char index_path[TF_DOCROOT_MAX_PATH + sizeof(TF_DOCROOT_INDEX_FILE) + 1];
+                
+                snprintf(index_path, sizeof(index_path), "%s%s%s", path,
+                         (path[0] && path[strlen(path) - 1] != '/' ? "/" : ""),
+                         TF_DOCROOT_INDEX_FILE);
+                current = (fstatat(docroot->root, index_path, &st, AT_SYMLINK_NOFOLLOW) == 0);
+            }
+            
+            if (current && tf_docroot_entry_is_current(entry, &st))
+                entry->checked_at = now;
+            else {
+                TF_DOCROOT_STAT_ADD(cache, invalidations);
+                
+                tf_docroot_cache_drop(cache, entry);
+                entry = NULL;
+            }
+        }
+    }
+    
+    if (entry) {
+        TF_DOCROOT_STAT_ADD(cache, hits);
+        
+        tf_docroot_lru_unlink(cache, entry);
+        tf_docroot_lru_push(cache, entry);
+        
+        entry->refs++;
+        return entry;
+    }
+    
+    if (cache)
+        TF_DOCROOT_STAT_ADD(cache, misses);
+    
+    entry = tf_docroot_entry_open(docroot, path);
+    if (!entry)
+        return NULL;
+    
+    if (!cache || docroot->max_entries < 1)
+        return entry; // uncached, the response holds the only reference
+    
+    // make room first
+    while (cache->count >= docroot->max_entries && cache->lru_last) {
+        TF_DOCROOT_STAT_ADD(cache, evictions);
+        tf_docroot_cache_drop(cache, cache->lru_last);
+    }
+    
+    tf_hash_set(cache->entries, entry->path, entry, NULL);
+    tf_docroot_lru_push(cache, entry);
+    
+    entry->cached = true;
+    entry->refs++;
+    
+    cache->count++;
+    TF_DOCROOT_STAT_ADD(cache, entries);
+    
+    return entry;
+}
+
+//
+// public
+//
+
+tf_docroot_ref tf_docroot_init(const char* root, const tf_index_t workers,
+                               const tf_index_t max_entries) {
+    if (!root)
+        return NULL;
+    
+    int directory = open(root, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (directory < 0) {
+        TF_LOG_ERROR("cannot open document root %s, errno = %s", root, strerror(errno));
+        return NULL;
+    }
+    
+    tf_docroot_ref docroot = tf_struct_alloc(tf_docroot_s);
+    
+    docroot->root = directory;
+    docroot->max_entries = max_entries;
+    docroot->cache_count = (workers >= 1 ? workers : 1);
+    docroot->caches = calloc(docroot->cache_count, sizeof(struct tf_docroot_cache_s));
+    
+    for (tf_index_t index = 0; index < docroot->cache_count; index++)
+        docroot->caches[index].entries = tf_hash_init_empty();
+    
+    return docroot;
+}
+
+bool tf_docroot_handle(tf_docroot_ref docroot, tf_conn_ref conn,
+                       const tf_http_request_t* request,
+                       tf_http_response_t* response) {
+    if (!docroot || !request || !response)
+        return false;
+    
+    if (!tf_str_view_equals(request->method, "GET") &&
+        !tf_str_view_equals(request->method, "HEAD")) {
+        response->status = 405;
+        return true;
+    }
+    
+    char path[TF_DOCROOT_MAX_PATH];
+    
+    if (!tf_docroot_normalize(request->path, path, sizeof(path))) {
+        response->status = 400;
+        return true;
+    }
+    
+    tf_docroot_cache_ref cache = docroot->caches +
+                                 (tf_conn_get_worker_id(conn) % docroot->cache_count);
+    tf_docroot_entry_ref entry = tf_docroot_lookup(docroot, cache, path);
+    
+    if (!entry)
+        return false;
+    
+    // buffer lengths are tf_index_t
+    if (entry->size <= (tf_index_t)-1)
+        response->file = tf_buffer_acquire_file(entry->file, 0, (tf_index_t)entry->size,
+                                                tf_docroot_entry_unref, entry);
+    
+    if (!response->file) {
+        tf_docroot_entry_unref(entry);
+        
+        response->status = 500;
+        return true;
+    }
+    
+    response->status = 200;
+    response->content_type = entry->content_type;
+    
+    return true;
+}
+
+const char* tf_docroot_get_content_type(const char* path) {
+    const char* dot = (path ? strrchr(path, '.') : NULL);
+    
+    if (dot && !strchr(dot, '/')) {
+        for (tf_index_t index = 0; tf_docroot_mime_types[index].extension; index++) {
+            if (strcasecmp(dot + 1, tf_docroot_mime_types[index].extension) == 0)
+                return tf_docroot_mime_types[index].content_type;
+        }
+    }
+    
+    return "application/octet-stream";
+}
+
+void tf_docroot_get_stats(const tf_docroot_ref docroot, tf_docroot_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    bzero(statsp, sizeof(tf_docroot_stats_t));
+    
+    for (tf_index_t index = 0; docroot && index < docroot->cache_count; index++) {
+        const tf_docroot_stats_t* stats = &docroot->caches[index].stats;
+        
+        statsp->hits += __atomic_load_n(&stats->hits, __ATOMIC_RELAXED);
+        statsp->misses += __atomic_load_n(&stats->misses, __ATOMIC_RELAXED);
+        statsp->invalidations += __atomic_load_n(&stats->invalidations, __ATOMIC_RELAXED);
+        statsp->evictions += __atomic_load_n(&stats->evictions, __ATOMIC_RELAXED);
+        statsp->entries += __atomic_load_n(&stats->entries, __ATOMIC_RELAXED);
+    }
+}
+
+void tf_docroot_release(tf_docroot_ref docroot) {
+    if (!docroot)
+        return;
+    
+    for (tf_index_t index = 0; index < docroot->cache_count; index++) {
+        tf_docroot_cache_ref cache = docroot->caches + index;
+        
+        while (cache->lru_first)
+            tf_docroot_cache_drop(cache, cache->lru_first);
+        
+        tf_hash_release(cache->entries);
+    }
+    
+    close(docroot->root);
+    
+    free(docroot->caches);
+    free(docroot);
+}
@@ -0,0 +1,73 @@
+//
+//  docroot.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "http.h"
+#include "server.h"
+
+//
+// static files from a document root
+//
+// request paths are decoded and normalized, anything trying to get out
+// of the root is refused and symlinks are never followed (neither the
+// file nor a directory on the way), files are sent with sendfile() via
+// the output queue
+//
+// open descriptors and stat results are kept in a bounded LRU cache, one
+// per worker so there is no locking, cached entries are only re-checked
+// (one stat call) when they are older than TF_DOCROOT_REVALIDATE_MS
+//
+
+/// longest request path that is looked up
+#define TF_DOCROOT_MAX_PATH 1024
+/// how long a cached stat result is trusted, in milliseconds
+#define TF_DOCROOT_REVALIDATE_MS 1000
+/// served for paths ending with a slash
+#define TF_DOCROOT_INDEX_FILE "index.html"
+
+/// cache counters, summed over all the workers
+typedef struct {
+    // requests served from the cache without any syscall
+    uint64_t hits;
+    // requests that had to open the file
+    uint64_t misses;
+    // cached entries dropped because the file changed or went away
+    uint64_t invalidations;
+    // cached entries dropped to make room
+    uint64_t evictions;
+    // entries in all the caches right now
+    uint64_t entries;
+} tf_docroot_stats_t;
+
+///
+/// serves files below root, workers is the amount of server workers (one
+/// cache each), max_entries is the cache size per worker (0 disables the
+/// cache, every request opens the file then)
+///
+tf_docroot_ref tf_docroot_init(const char* root, const tf_index_t workers,
+                               const tf_index_t max_entries);
+
+///
+/// fills the response with the requested file, returns false if there is
+/// no such file (the response is left alone then so the caller may try
+/// something else), bad paths and methods other than GET/HEAD are
+/// answered with an error status
+///
+bool tf_docroot_handle(tf_docroot_ref docroot, tf_conn_ref conn,
+                       const tf_http_request_t* request,
+                       tf_http_response_t* response);
+
+/// Content-Type for the file name, based on its extension
+const char* tf_docroot_get_content_type(const char* path);
+
+void tf_docroot_get_stats(const tf_docroot_ref docroot, tf_docroot_stats_t* statsp);
+
+/// must only be called once no more responses are in flight
+void tf_docroot_release(tf_docroot_ref docroot);
@@ -9,89 +9,323 @@
 #include <stdlib.h>
 #include <string.h>
 #include "privutil.h"
+#include "arena.h"
 #include "hash.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TF_HASH_USE_SSE2 1
+#endif
+
 //
 // private
 //
 
-/// internally-used linked list-behaving hash item
-typedef struct tf_item_s* tf_item_ref;
-struct tf_item_s {
-    // item label, required value
-    char* key;
+/// control bytes, full slots store the 7 lower bits of their key hash
+#define TF_HASH_CTRL_EMPTY ((int8_t)-128)
+#define TF_HASH_CTRL_DELETED ((int8_t)-2)
+
+/// slots probed at once, one SSE2 register worth of control bytes
+#define TF_HASH_GROUP_WIDTH 16
+/// smallest table, a single group
+#define TF_HASH_MIN_CAPACITY TF_HASH_GROUP_WIDTH
+
+/// keys up to this length (without the NUL) are stored inside the slot
+#define TF_HASH_INLINE_KEY_SIZE 23
+
+typedef struct {
+    // long keys live on the heap, short ones inline
+    char* heap_key;
+    char inline_key[TF_HASH_INLINE_KEY_SIZE + 1];
+    tf_index_t key_length;
     
     // must be not NULL
-    void* value;
-    // optional, points to a deallocator method for the specified
-    // value
+    tf_data_ref value;
+    // optional, points to a deallocator method for the specified value
     tf_deallocator_t autorelease;
-    
-    // if NULL, this means that we are at the end of the hash
-    tf_item_ref next;
-};
+} tf_hash_slot_t;
 
 struct tf_hash_s {
-    tf_item_ref first;
-    // this one is used for iterating over hashes
-    tf_item_ref iterator;
+    // capacity control bytes, one per slot
+    int8_t* ctrl;
+    tf_hash_slot_t* slots;
+    
+    // always a power of two and a multiple of the group width
+    tf_index_t capacity;
+    tf_index_t count;
+    // tombstones left by removals, they take up space until the next rehash
+    tf_index_t deleted;
+    
+    // if set, all the memory comes from there and goes away with it
+    tf_arena_ref arena;
+    
+    // backs the tf_hash_iter_* calls that keep their state in the hash
+    tf_hash_iter_t iterator;
 };
 
-tf_item_ref tf_item_init(tf_item_ref previous, const char* key,
-                         tf_data_ref data, const tf_deallocator_t dlc) {
-    tf_item_ref result = tf_struct_alloc(tf_item_s);
-    
-    // fill in the fields
-    result->key = strdup(key);
-    result->value = data;
-    result->autorelease = dlc;
+uint64_t tf_hash_read64(const char* data) {
+    uint64_t result;
+    memcpy(&result, data, sizeof(result));
     
-    // organize previous item to point to this new one if specified
-    if (previous)
-        previous->next = result;
+    return result;
+}
+
+uint64_t tf_hash_read32(const char* data) {
+    uint32_t result;
+    memcpy(&result, data, sizeof(result));
     
     return result;
 }
 
-tf_item_ref tf_item_find_by_key(tf_item_ref base, const char* key,
-                                tf_item_ref* lastp) {
-    if (!base)
-        return NULL;
+uint64_t tf_hash_mix(const uint64_t hash, const uint64_t chunk) {
+    uint64_t result = (hash ^ chunk) * 0x9fb21c651e98df25ull;
+    return result ^ (result >> 29);
+}
+
+uint64_t tf_hash_bytes(const char* data, const tf_index_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+    
+    if (length >= 8) {
+        // 8 bytes at a time, the last chunk overlaps the previous one
+        // instead of going byte by byte
+        for (tf_index_t offset = 0; offset + 8 < length; offset += 8)
+            hash = tf_hash_mix(hash, tf_hash_read64(data + offset));
+        
+        hash = tf_hash_mix(hash, tf_hash_read64(data + length - 8));
+    } else if (length >= 4)
+        hash = tf_hash_mix(hash, tf_hash_read32(data) |
+                                 (tf_hash_read32(data + length - 4) << 32));
+    else if (length > 0)
+        hash = tf_hash_mix(hash, (uint64_t)(uint8_t)data[0] |
+                                 ((uint64_t)(uint8_t)data[length / 2] << 8) |
+                                 ((uint64_t)(uint8_t)data[length - 1] << 16));
     
-    TF_PTR_SET(lastp, base);
-    tf_item_ref current = base;
+    // final avalanche, the low 7 bits end up in the control bytes
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
     
-    while (current) {
-        if (strcmp(current->key, key) == 0)
+    return hash;
+}
+
+tf_data_ref tf_hash_mem_alloc(const tf_hash_ref hash, const tf_index_t size) {
+    return (hash->arena ? tf_arena_alloc(hash->arena, size) : malloc(size));
+}
+
+void tf_hash_mem_free(const tf_hash_ref hash, tf_data_ref data) {
+    // arena memory is only reclaimed by resetting the arena
+    if (!hash->arena)
+        free(data);
+}
+
+const char* tf_hash_slot_get_key(const tf_hash_slot_t* slot) {
+    return (slot->heap_key ? slot->heap_key : slot->inline_key);
+}
+
+/// bit n is set if control byte n of the group equals value
+uint16_t tf_hash_group_match(const int8_t* group, const int8_t value) {
+#ifdef TF_HASH_USE_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+    uint16_t mask = 0;
+    
+    for (tf_index_t index = 0; index < TF_HASH_GROUP_WIDTH; index++) {
+        if (group[index] == value)
+            mask |= (uint16_t)(1u << index);
+    }
+    
+    return mask;
+#endif
+}
+
+/// bit n is set if slot n of the group is empty or deleted
+uint16_t tf_hash_group_match_free(const int8_t* group) {
+#ifdef TF_HASH_USE_SSE2
+    // both special values have the sign bit set, full slots don't
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint16_t)_mm_movemask_epi8(ctrl);
+#else
+    uint16_t mask = 0;
+    
+    for (tf_index_t index = 0; index < TF_HASH_GROUP_WIDTH; index++) {
+        if (group[index] < 0)
+            mask |= (uint16_t)(1u << index);
+    }
+    
+    return mask;
+#endif
+}
+
+tf_index_t tf_hash_lowest_bit(const uint16_t mask) {
+    return (tf_index_t)__builtin_ctz(mask);
+}
+
+///
+/// finds the slot holding the key, returns capacity if there is none,
+/// groups are probed in a triangular sequence which visits each of them
+/// once as the group count is a power of two
+///
+tf_index_t tf_hash_find(const tf_hash_ref hash, const char* key,
+                        const tf_index_t length, const uint64_t hashed) {
+    if (hash->capacity < 1)
+        return 0;
+    
+    tf_index_t group_mask = (hash->capacity / TF_HASH_GROUP_WIDTH) - 1;
+    tf_index_t group = (tf_index_t)(hashed >> 7) & group_mask;
+    int8_t tag = (int8_t)(hashed & 0x7f);
+    
+    for (tf_index_t step = 1; step <= group_mask + 1; step++) {
+        const int8_t* ctrl = hash->ctrl + (group * TF_HASH_GROUP_WIDTH);
+        
+        for (uint16_t match = tf_hash_group_match(ctrl, tag); match;
+             match &= (uint16_t)(match - 1)) {
+            tf_index_t index = (group * TF_HASH_GROUP_WIDTH) + tf_hash_lowest_bit(match);
+            const tf_hash_slot_t* slot = hash->slots + index;
+            
+            if (slot->key_length == length &&
+                memcmp(tf_hash_slot_get_key(slot), key, length) == 0)
+                return index;
+        }
+        
+        // the key would have been put into the first group with room
+        if (tf_hash_group_match(ctrl, TF_HASH_CTRL_EMPTY))
             break;
         
-        TF_PTR_SET(lastp, current);
-        current = current->next;
+        group = (group + step) & group_mask;
     }
     
-    return current;
+    return hash->capacity;
 }
 
-void tf_item_set_in_tree(tf_item_ref* basep, const char* key, tf_data_ref vv,
-                         const tf_deallocator_t dlc) {
-    if (!basep || !key || !vv)
-        return; // all these need to be valid
+/// first empty or deleted slot on the probe sequence for the hash
+tf_index_t tf_hash_find_free(const tf_hash_ref hash, const uint64_t hashed) {
+    tf_index_t group_mask = (hash->capacity / TF_HASH_GROUP_WIDTH) - 1;
+    tf_index_t group = (tf_index_t)(hashed >> 7) & group_mask;
     
-    if (*basep) {
-        tf_item_ref last = NULL;
-        tf_item_ref wrk = tf_item_find_by_key(*basep, key, &last);
+    for (tf_index_t step = 1; ; step++) {
+        uint16_t free_mask = tf_hash_group_match_free(hash->ctrl +
+                                                      (group * TF_HASH_GROUP_WIDTH));
         
-        if (wrk) {
-            // existing item, need to clean its contents first
-            if (wrk->autorelease)
-                wrk->autorelease(wrk->value);
-            
-            wrk->value = vv;
-            wrk->autorelease = dlc;
-        } else
-            wrk = tf_item_init(last, key, vv, dlc);
+        // never loops forever, the load factor keeps some slots free
+        if (free_mask)
+            return (group * TF_HASH_GROUP_WIDTH) + tf_hash_lowest_bit(free_mask);
+        
+        group = (group + step) & group_mask;
+    }
+}
+
+bool tf_hash_resize(tf_hash_ref hash, const tf_index_t capacity) {
+    int8_t* ctrl = tf_hash_mem_alloc(hash, capacity);
+    tf_hash_slot_t* slots = tf_hash_mem_alloc(hash, capacity * sizeof(tf_hash_slot_t));
+    
+    if (!ctrl || !slots) {
+        tf_hash_mem_free(hash, ctrl);
+        tf_hash_mem_free(hash, slots);
+        
+        return false;
+    }
+    
+    memset(ctrl, TF_HASH_CTRL_EMPTY, capacity);
+    
+    int8_t* old_ctrl = hash->ctrl;
+    tf_hash_slot_t* old_slots = hash->slots;
+    tf_index_t old_capacity = hash->capacity;
+    
+    hash->ctrl = ctrl;
+    hash->slots = slots;
+    hash->capacity = capacity;
+    hash->deleted = 0;
+    
+    // move every live slot over, dropping all the tombstones
+    for (tf_index_t index = 0; index < old_capacity; index++) {
+        if (old_ctrl[index] < 0)
+            continue;
+        
+        const tf_hash_slot_t* slot = old_slots + index;
+        uint64_t hashed = tf_hash_bytes(tf_hash_slot_get_key(slot), slot->key_length);
+        tf_index_t target = tf_hash_find_free(hash, hashed);
+        
+        hash->ctrl[target] = (int8_t)(hashed & 0x7f);
+        hash->slots[target] = *slot;
+    }
+    
+    tf_hash_mem_free(hash, old_ctrl);
+    tf_hash_mem_free(hash, old_slots);
+    
+    return true;
+}
+
+/// grows (or just cleans up) the table if one more item would push it
+/// past 7/8 full
+bool tf_hash_reserve_one(tf_hash_ref hash) {
+    if (hash->capacity > 0 &&
+        (hash->count + hash->deleted + 1) * 8 <= hash->capacity * 7)
+        return true;
+    
+    tf_index_t capacity = (hash->capacity > 0 ? hash->capacity : TF_HASH_MIN_CAPACITY);
+    
+    // rehashing in place is enough if most of the used space is tombstones
+    while ((hash->count + 1) * 8 > capacity * 7 / 2)
+        capacity *= 2;
+    
+    return tf_hash_resize(hash, capacity);
+}
+
+void tf_hash_slot_clear(const tf_hash_ref hash, tf_hash_slot_t* slot) {
+    if (slot->autorelease)
+        slot->autorelease(slot->value);
+    
+    tf_hash_mem_free(hash, slot->heap_key);
+    bzero(slot, sizeof(tf_hash_slot_t));
+}
+
+bool tf_hash_set_n(tf_hash_ref hash, const char* key, const tf_index_t length,
+                   tf_data_ref value, const tf_deallocator_t autorelease) {
+    uint64_t hashed = tf_hash_bytes(key, length);
+    tf_index_t index = tf_hash_find(hash, key, length, hashed);
+    
+    if (index < hash->capacity) {
+        // existing item, need to clean its contents first
+        tf_hash_slot_t* slot = hash->slots + index;
+        
+        if (slot->autorelease && slot->value != value)
+            slot->autorelease(slot->value);
+        
+        slot->value = value;
+        slot->autorelease = autorelease;
+        
+        return true;
+    }
+    
+    if (!tf_hash_reserve_one(hash))
+        return false;
+    
+    index = tf_hash_find_free(hash, hashed);
+    tf_hash_slot_t* slot = hash->slots + index;
+    
+    bzero(slot, sizeof(tf_hash_slot_t));
+    
+    if (length > TF_HASH_INLINE_KEY_SIZE) {
+        slot->heap_key = tf_hash_mem_alloc(hash, length + 1);
+        if (!slot->heap_key)
+            return false;
+        
+        memcpy(slot->heap_key, key, length);
+        slot->heap_key[length] = '\0';
     } else
-        TF_PTR_SET(basep, tf_item_init(NULL, key, vv, dlc))
+        memcpy(slot->inline_key, key, length);
+    
+    slot->key_length = length;
+    slot->value = value;
+    slot->autorelease = autorelease;
+    
+    if (hash->ctrl[index] == TF_HASH_CTRL_DELETED)
+        hash->deleted--;
+    
+    hash->ctrl[index] = (int8_t)(hashed & 0x7f);
+    hash->count++;
+    
+    return true;
 }
 
 //
@@ -103,13 +337,23 @@ tf_hash_ref tf_hash_init_empty() {
     return hash;
 }
 
+tf_hash_ref tf_hash_init_in_arena(tf_arena_ref arena) {
+    if (!arena)
+        return tf_hash_init_empty();
+    
+    tf_hash_ref hash = tf_arena_struct_alloc(arena, tf_hash_s);
+    if (hash)
+        hash->arena = arena;
+    
+    return hash;
+}
+
 bool tf_hash_set(tf_hash_ref hash, const char* key, tf_data_ref value,
                  const tf_deallocator_t autorelease) {
     if (!hash || !key || strlen(key) < 1 || !value)
         return false; // invalid params
     
-    tf_item_set_in_tree(&hash->first, key, value, autorelease);
-    return true;
+    return tf_hash_set_n(hash, key, (tf_index_t)strlen(key), value, autorelease);
 }
 
 bool tf_hash_has(const tf_hash_ref hash, const char* key) {
@@ -120,66 +364,132 @@ bool tf_hash_has(const tf_hash_ref hash, const char* key) {
 }
 
 tf_data_ref tf_hash_get(const tf_hash_ref hash, const char* key) {
-    if (!hash || !hash->first || !key)
+    if (!key)
+        return NULL;
+    
+    tf_str_view_t view = { key, (tf_index_t)strlen(key) };
+    return tf_hash_get_view(hash, view);
+}
+
+tf_data_ref tf_hash_get_view(const tf_hash_ref hash, const tf_str_view_t key) {
+    if (!hash || hash->count < 1 || !key.data)
         return NULL; // empty hash or invalid params
     
-    tf_item_ref wrk = tf_item_find_by_key(hash->first, key, NULL);
-    return (wrk ? wrk->value : NULL);
+    tf_index_t index = tf_hash_find(hash, key.data, key.length,
+                                    tf_hash_bytes(key.data, key.length));
+    return (index < hash->capacity ? hash->slots[index].value : NULL);
 }
 
-void tf_hash_iter_reset(tf_hash_ref hash) {
-    if (hash)
-        hash->iterator = NULL;
+bool tf_hash_remove(tf_hash_ref hash, const char* key) {
+    if (!hash || hash->count < 1 || !key)
+        return false;
+    
+    tf_index_t length = (tf_index_t)strlen(key);
+    tf_index_t index = tf_hash_find(hash, key, length, tf_hash_bytes(key, length));
+    
+    if (index >= hash->capacity)
+        return false;
+    
+    tf_hash_slot_clear(hash, hash->slots + index);
+    hash->count--;
+    
+    // lookups only stop at groups with an empty slot, so the slot may only
+    // become empty again if its group has one already
+    const int8_t* group = hash->ctrl + (index - (index % TF_HASH_GROUP_WIDTH));
+    
+    if (tf_hash_group_match(group, TF_HASH_CTRL_EMPTY))
+        hash->ctrl[index] = TF_HASH_CTRL_EMPTY;
+    else {
+        hash->ctrl[index] = TF_HASH_CTRL_DELETED;
+        hash->deleted++;
+    }
+    
+    return true;
 }
 
-bool tf_hash_iter_next(tf_hash_ref hash) {
-    // TODO: rewrite and optimize
+tf_index_t tf_hash_get_count(const tf_hash_ref hash) {
+    return (hash ? hash->count : 0);
+}
+
+void tf_hash_iter_init(const tf_hash_ref hash, tf_hash_iter_t* iter) {
+    if (!iter)
+        return;
+    
+    iter->hash = hash;
+    iter->position = 0;
+    iter->current = NULL;
+}
+
+bool tf_hash_iter_step(tf_hash_iter_t* iter, const char** keyp,
+                       tf_data_ref* valuep) {
+    if (!iter || !iter->hash)
+        return false;
+    
+    const tf_hash_ref hash = iter->hash;
     
-    if (hash) {
-        if (hash->iterator)
-            hash->iterator = hash->iterator->next;
-        else
-            hash->iterator = hash->first;
+    while (iter->position < hash->capacity) {
+        tf_index_t index = iter->position++;
         
-        if (!hash->iterator)
-            return false;
+        if (hash->ctrl[index] < 0)
+            continue;
+        
+        iter->current = hash->slots + index;
+        
+        TF_PTR_SET(keyp, tf_hash_slot_get_key(hash->slots + index));
+        TF_PTR_SET(valuep, hash->slots[index].value);
         
         return true;
     }
     
+    iter->current = NULL;
+    return false;
+}
+
+void tf_hash_iter_reset(tf_hash_ref hash) {
+    if (hash)
+        tf_hash_iter_init(hash, &hash->iterator);
+}
+
+bool tf_hash_iter_next(tf_hash_ref hash) {
+    if (!hash)
+        return false;
+    
+    if (!hash->iterator.hash)
+        tf_hash_iter_reset(hash);
+    
+    if (tf_hash_iter_step(&hash->iterator, NULL, NULL))
+        return true;
+    
+    // past the end the next call starts over, as it always has
+    hash->iterator.hash = NULL;
     return false;
 }
 
 const char* tf_hash_iter_get_key(tf_hash_ref hash) {
-    return ((hash && hash->iterator) ? hash->iterator->key : NULL);
+    if (!hash || !hash->iterator.current)
+        return NULL;
+    
+    return tf_hash_slot_get_key((const tf_hash_slot_t*)hash->iterator.current);
 }
 
 tf_data_ref tf_hash_iter_get_value(tf_hash_ref hash) {
-    return ((hash && hash->iterator) ? hash->iterator->value : NULL);
+    if (!hash || !hash->iterator.current)
+        return NULL;
+    
+    return ((const tf_hash_slot_t*)hash->iterator.current)->value;
 }
 
 void tf_hash_release(tf_hash_ref hash) {
     if (!hash)
         return;
     
-    tf_hash_iter_reset(hash);
-    
     // deallocate all items
-    tf_item_ref current = hash->first;
-    while (current) {
-        tf_item_ref next = current->next;
-        
-        if (current->autorelease)
-            current->autorelease(current->value);
-        
-        free(current->key);
-        free(current);
-        
-        current = next;
+    for (tf_index_t index = 0; index < hash->capacity; index++) {
+        if (hash->ctrl[index] >= 0)
+            tf_hash_slot_clear(hash, hash->slots + index);
     }
     
-    free(hash);
+    tf_hash_mem_free(hash, hash->ctrl);
+    tf_hash_mem_free(hash, hash->slots);
+    tf_hash_mem_free(hash, hash);
 }
-
-
-
@@ -10,7 +10,28 @@
 
 #include "types.h"
 
+//
+// string-keyed hash table
+//
+// open addressing with SSE2 group probing (Swiss table layout), short keys
+// are stored inline, lookups never modify the table so any number of
+// threads may read it at once as long as nobody writes
+//
+
+/// external iterator, any number of them can walk the same hash, adding or
+/// removing items invalidates all of them
+typedef struct {
+    tf_hash_ref hash;
+    tf_index_t position;
+    // slot returned by the last step
+    const void* current;
+} tf_hash_iter_t;
+
 tf_hash_ref tf_hash_init_empty(void);
+/// hash with all of its memory (table, long keys) taken from the arena,
+/// resetting the arena drops it, releasing it before that is only needed
+/// to run the autoreleases
+tf_hash_ref tf_hash_init_in_arena(tf_arena_ref arena);
 
 /// adds or modifies value stored in the hash under the specified key
 bool tf_hash_set(tf_hash_ref hash, const char* key, tf_data_ref value,
@@ -20,10 +41,26 @@ bool tf_hash_set(tf_hash_ref hash, const char* key, tf_data_ref value,
 bool tf_hash_has(const tf_hash_ref hash, const char* key);
 /// retreives the value with the specified value from the hash
 tf_data_ref tf_hash_get(const tf_hash_ref hash, const char* key);
+/// same, for keys that are not NUL-terminated
+tf_data_ref tf_hash_get_view(const tf_hash_ref hash, const tf_str_view_t key);
+
+/// removes (and autoreleases) the value, false if there was none
+bool tf_hash_remove(tf_hash_ref hash, const char* key);
+
+tf_index_t tf_hash_get_count(const tf_hash_ref hash);
 
 //
 // hash iteration
 //
+
+void tf_hash_iter_init(const tf_hash_ref hash, tf_hash_iter_t* iter);
+/// moves to the next item and returns it through keyp/valuep (both may be
+/// NULL), false once all the items have been visited
+bool tf_hash_iter_step(tf_hash_iter_t* iter, const char** keyp,
+                       tf_data_ref* valuep);
+
+/// iteration with the state kept inside the hash itself, not safe to use
+/// from more than one place at a time, prefer tf_hash_iter_init
 void tf_hash_iter_reset(tf_hash_ref hash);
 bool tf_hash_iter_next(tf_hash_ref hash);
 const char* tf_hash_iter_get_key(tf_hash_ref hash);
@@ -0,0 +1,73 @@
+//
+//  header.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <string.h>
+#include "header.h"
+#include "header_table.h"
+
+//
+// private
+//
+
+static const char* tf_http_header_names[TF_HTTP_HEADER_COUNT] = {
+    NULL,
+#define TF_HTTP_HEADER(id, name) name,
+#include "header.def"
+#undef TF_HTTP_HEADER
+};
+
+static const uint8_t tf_http_header_lengths[TF_HTTP_HEADER_COUNT] = {
+    0,
+#define TF_HTTP_HEADER(id, name) sizeof(name) - 1,
+#include "header.def"
+#undef TF_HTTP_HEADER
+};
+
+//
+// public
+//
+
+tf_http_header_id_t tf_http_header_lookup(const char* name, const tf_index_t length) {
+    if (!name || length < TF_HTTP_HEADER_MIN_LENGTH || length > TF_HTTP_HEADER_MAX_LENGTH)
+        return TF_HTTP_HEADER_UNKNOWN;
+    
+    uint32_t slot = (tf_http_header_get_key(name, length) *
+                     TF_HTTP_HEADER_MULTIPLIER) >> TF_HTTP_HEADER_SHIFT;
+    tf_http_header_id_t id = (tf_http_header_id_t)tf_http_header_slots[slot];
+    
+    // the only name that can be there, if it's not this one it's unknown
+    if (tf_http_header_lengths[id] != length)
+        return TF_HTTP_HEADER_UNKNOWN;
+    
+    const char* known = tf_http_header_names[id];
+    tf_index_t index = 0;
+    
+    // the known names only have lowercase letters, digits and '-', which
+    // all have 0x20 set, so ORing it in lowercases the name and only makes
+    // control characters (never part of a token) equal to digits and '-'
+    for (; index + 8 <= length; index += 8) {
+        uint64_t word, expected;
+        
+        memcpy(&word, name + index, 8);
+        memcpy(&expected, known + index, 8);
+        
+        if ((word | 0x2020202020202020ull) != expected)
+            return TF_HTTP_HEADER_UNKNOWN;
+    }
+    
+    for (; index < length; index++) {
+        if ((name[index] | 0x20) != known[index])
+            return TF_HTTP_HEADER_UNKNOWN;
+    }
+    
+    return id;
+}
+
+const char* tf_http_header_get_name(const tf_http_header_id_t id) {
+    return (id < TF_HTTP_HEADER_COUNT ? tf_http_header_names[id] : NULL);
+}
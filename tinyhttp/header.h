@@ -0,0 +1,46 @@
+//
+//  header.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// well-known request header names (header.def) mapped to small integer ids
+//
+// the mapping is a perfect hash made at build time (tools/header_gen.c):
+// four bytes of the name and its length pick a slot that holds the only id
+// the name can have, a single comparison tells whether it's really that one
+//
+
+typedef enum {
+    // not in header.def
+    TF_HTTP_HEADER_UNKNOWN,
+#define TF_HTTP_HEADER(id, name) TF_HTTP_HEADER_##id,
+#include "header.def"
+#undef TF_HTTP_HEADER
+    TF_HTTP_HEADER_COUNT
+} tf_http_header_id_t;
+
+/// what the perfect hash is computed from, names shorter than 2 bytes are
+/// never well-known and must not get here
+static inline uint32_t tf_http_header_get_key(const char* name, const tf_index_t length) {
+    // ORing in 0x20 lowercases letters, anything else it changes can only
+    // make an unknown name collide, which the comparison sorts out
+    return (((uint32_t)length << 24) |
+            ((uint32_t)((uint8_t)name[0] | 0x20) << 16) |
+            ((uint32_t)((uint8_t)name[length - 2] | 0x20) << 8) |
+            (uint32_t)((uint8_t)name[length - 1] | 0x20));
+}
+
+/// case-insensitive, TF_HTTP_HEADER_UNKNOWN for anything not in header.def,
+/// the name has to be a token (RFC 9110) as header names are
+tf_http_header_id_t tf_http_header_lookup(const char* name, const tf_index_t length);
+
+/// lowercase name of a well-known header, NULL for TF_HTTP_HEADER_UNKNOWN
+const char* tf_http_header_get_name(const tf_http_header_id_t id);
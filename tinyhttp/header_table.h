@@ -0,0 +1,32 @@
+//
+//  header_table.h
+//  tinyhttp
+//
+//  Made by tools/header_gen.c from header.def, do not edit.
+//
+
+#pragma once
+
+#define TF_HTTP_HEADER_MIN_LENGTH 2
+#define TF_HTTP_HEADER_MAX_LENGTH 30
+#define TF_HTTP_HEADER_MULTIPLIER 3916041109u
+#define TF_HTTP_HEADER_SHIFT 24
+
+static const uint8_t tf_http_header_slots[256] = {
+    0, 0, 0, 45, 0, 64, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
+    0, 17, 0, 0, 0, 65, 69, 0, 0, 41, 58, 0, 0, 0, 0, 0,
+    0, 52, 0, 0, 2, 66, 32, 40, 0, 33, 0, 0, 0, 0, 0, 0,
+    0, 38, 0, 0, 0, 0, 63, 0, 0, 0, 0, 10, 0, 30, 0, 0,
+    0, 0, 53, 0, 0, 14, 0, 68, 0, 48, 0, 0, 0, 39, 28, 0,
+    0, 0, 0, 0, 0, 26, 0, 47, 0, 46, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 42, 0, 0, 0, 0, 0, 7, 0, 0, 29,
+    0, 0, 62, 0, 0, 0, 0, 36, 0, 55, 0, 0, 0, 0, 51, 11,
+    16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 15, 57, 20, 0,
+    0, 0, 0, 12, 0, 67, 0, 0, 0, 3, 22, 56, 0, 0, 70, 59,
+    0, 35, 0, 0, 0, 5, 0, 43, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 54, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 31, 61,
+    0, 49, 0, 0, 0, 0, 0, 9, 0, 0, 0, 0, 0, 18, 0, 0,
+    13, 37, 44, 0, 0, 0, 25, 0, 0, 0, 0, 0, 0, 50, 27, 4,
+    0, 60, 23, 8, 0, 0, 0, 0, 34, 0, 0, 0, 0, 6, 0, 0,
+    0, 0, 19, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 24, 21, 0
+};
@@ -0,0 +1,639 @@
+//
+//  http.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <string.h>
+#include <strings.h>
+#include "privutil.h"
+#include "scan.h"
+#include "http.h"
+
+//
+// private
+//
+
+typedef enum {
+    // skipping stray CRLFs in front of the request line
+    TF_HTTP_STATE_START,
+    TF_HTTP_STATE_METHOD,
+    TF_HTTP_STATE_PATH,
+    TF_HTTP_STATE_QUERY,
+    TF_HTTP_STATE_VERSION,
+    TF_HTTP_STATE_REQUEST_LINE_LF,
+    // either the next header name or the empty line
+    TF_HTTP_STATE_HEADER_START,
+    TF_HTTP_STATE_HEADER_NAME,
+    // skipping whitespace after the colon
+    TF_HTTP_STATE_HEADER_VALUE_START,
+    TF_HTTP_STATE_HEADER_VALUE,
+    TF_HTTP_STATE_HEADER_LF,
+    TF_HTTP_STATE_HEAD_END_LF,
+    TF_HTTP_STATE_DONE,
+    TF_HTTP_STATE_ERROR
+} tf_http_state_t;
+
+/// RFC 9110 tchar lookup table for the ASCII range
+static const uint8_t tf_http_token_chars[128] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0
+};
+
+#define TF_HTTP_IS_TOKEN(c) ((c) < 128 && tf_http_token_chars[(c)])
+/// visible ASCII or obs-text, used for the request target
+#define TF_HTTP_IS_TARGET(c) ((c) > 0x20 && (c) != 0x7f)
+/// field-value characters, HTAB, SP, VCHAR or obs-text
+#define TF_HTTP_IS_VALUE(c) ((c) == '\t' || ((c) >= 0x20 && (c) != 0x7f))
+
+#define TF_HTTP_SPAN_END(span, parser, pos) \
+{ \
+    (span).offset = (parser)->mark; \
+    (span).length = (pos) - (parser)->mark; \
+}
+
+tf_str_view_t tf_http_span_to_view(const char* buffer, const tf_http_span_t span) {
+    tf_str_view_t result = { buffer + span.offset, span.length };
+    return result;
+}
+
+bool tf_http_finish_version(tf_http_parser_t* parser, const char* buffer,
+                            const tf_index_t pos) {
+    TF_HTTP_SPAN_END(parser->version, parser, pos)
+    
+    // only HTTP/1.0 and HTTP/1.1 are supported
+    const char* version = buffer + parser->version.offset;
+    
+    return (parser->version.length == 8 && memcmp(version, "HTTP/1.", 7) == 0 &&
+            (version[7] == '0' || version[7] == '1'));
+}
+
+void tf_http_finish_value(tf_http_parser_t* parser, const char* buffer,
+                          const tf_index_t pos) {
+    tf_index_t end = pos;
+    
+    // trailing whitespace is not part of the value
+    while (end > parser->mark && (buffer[end - 1] == ' ' || buffer[end - 1] == '\t'))
+        end--;
+    
+    TF_HTTP_SPAN_END(parser->header_values[parser->header_count], parser, end)
+    parser->header_count++;
+}
+
+void tf_http_fill_request(const tf_http_parser_t* parser, const char* buffer,
+                          const tf_index_t head_length,
+                          tf_http_request_t* request) {
+    request->method = tf_http_span_to_view(buffer, parser->method);
+    request->path = tf_http_span_to_view(buffer, parser->path);
+    request->query = tf_http_span_to_view(buffer, parser->query);
+    request->version = tf_http_span_to_view(buffer, parser->version);
+    request->version_minor = (uint8_t)(buffer[parser->version.offset + 7] - '0');
+    
+    bzero(request->known_headers, sizeof(request->known_headers));
+    
+    for (tf_index_t index = 0; index < parser->header_count; index++) {
+        tf_http_header_t* header = request->headers + index;
+        
+        header->name = tf_http_span_to_view(buffer, parser->header_names[index]);
+        header->value = tf_http_span_to_view(buffer, parser->header_values[index]);
+        header->id = tf_http_header_lookup(header->name.data, header->name.length);
+        
+        // the first one counts, as with the plain lookup
+        if (header->id != TF_HTTP_HEADER_UNKNOWN && !request->known_headers[header->id])
+            request->known_headers[header->id] = (uint8_t)(index + 1);
+    }
+    
+    request->header_count = parser->header_count;
+    request->head_length = head_length;
+}
+
+/// a Content-Length value, false unless it's all digits and sane
+bool tf_http_parse_content_length(const tf_str_view_t value, uint64_t* lengthp) {
+    uint64_t length = 0;
+    
+    if (value.length < 1 || value.length > 18)
+        return false; // empty or way too big
+    
+    for (tf_index_t index = 0; index < value.length; index++) {
+        if (value.data[index] < '0' || value.data[index] > '9')
+            return false;
+        
+        length = (length * 10) + (uint64_t)(value.data[index] - '0');
+    }
+    
+    *lengthp = length;
+    return true;
+}
+
+/// whether the target from the mark up to end (where c ends it) is one a
+/// server takes: a path (origin-form) or, for OPTIONS only, "*" on its own
+bool tf_http_is_origin_target(const tf_http_parser_t* parser, const char* buffer,
+                              const tf_index_t end, const uint8_t c) {
+    if (end <= parser->mark)
+        return false;
+    
+    if (buffer[parser->mark] == '/')
+        return true;
+    
+    return (buffer[parser->mark] == '*' && end == parser->mark + 1 && c == ' ' &&
+            parser->method.length == 7 &&
+            memcmp(buffer + parser->method.offset, "OPTIONS", 7) == 0);
+}
+
+/// end of the run of bytes the state just goes over, where it has to look
+/// at a byte again
+tf_index_t tf_http_parser_skip(const tf_http_parser_t* parser, const char* buffer,
+                               const tf_index_t pos, const tf_index_t limit) {
+    switch (parser->state) {
+        case TF_HTTP_STATE_PATH:
+            return tf_scan_skip(TF_SCAN_PATH, buffer, pos, limit);
+        case TF_HTTP_STATE_QUERY:
+        case TF_HTTP_STATE_VERSION:
+            return tf_scan_skip(TF_SCAN_TARGET, buffer, pos, limit);
+        case TF_HTTP_STATE_HEADER_NAME:
+            return tf_scan_skip(TF_SCAN_TOKEN, buffer, pos, limit);
+        case TF_HTTP_STATE_HEADER_VALUE:
+            return tf_scan_skip(TF_SCAN_VALUE, buffer, pos, limit);
+        default:
+            return pos;
+    }
+}
+
+//
+// public
+//
+
+void tf_http_parser_init(tf_http_parser_t* parser, const tf_index_t max_head_size) {
+    if (!parser)
+        return;
+    
+    bzero(parser, sizeof(tf_http_parser_t));
+    parser->max_head_size = (max_head_size > 0 ? max_head_size :
+                                                 TF_HTTP_DEFAULT_MAX_HEAD_SIZE);
+}
+
+void tf_http_parser_reset(tf_http_parser_t* parser) {
+    if (parser)
+        tf_http_parser_init(parser, parser->max_head_size);
+}
+
+tf_http_parse_status_t tf_http_parser_execute(tf_http_parser_t* parser,
+                                              const char* buffer,
+                                              const tf_index_t length,
+                                              tf_http_request_t* requestp) {
+    if (!parser || !buffer || parser->state == TF_HTTP_STATE_ERROR)
+        return TF_HTTP_PARSE_ERROR;
+    
+    tf_index_t pos = parser->position;
+    const tf_index_t limit = (length < parser->max_head_size ? length :
+                                                               parser->max_head_size);
+    
+    for (; pos < length && parser->state != TF_HTTP_STATE_DONE; pos++) {
+        // paths, names and values are skipped over in bulk, the switch
+        // only sees the byte that ends them
+        pos = tf_http_parser_skip(parser, buffer, pos, limit);
+        
+        if (pos >= length)
+            break;
+        if (pos >= parser->max_head_size)
+            return TF_HTTP_PARSE_TOO_LARGE;
+        
+        const uint8_t c = (uint8_t)buffer[pos];
+        
+        switch (parser->state) {
+            case TF_HTTP_STATE_START:
+                if (c == '\r' || c == '\n')
+                    break;
+                
+                parser->mark = pos;
+                parser->state = TF_HTTP_STATE_METHOD;
+                // fall through
+            case TF_HTTP_STATE_METHOD: {
+                if (c == ' ' && pos > parser->mark) {
+                    TF_HTTP_SPAN_END(parser->method, parser, pos)
+                    
+                    parser->mark = pos + 1;
+                    parser->state = TF_HTTP_STATE_PATH;
+                } else if (!TF_HTTP_IS_TOKEN(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_PATH: {
+                if (c == ' ' || c == '?') {
+                    if (!tf_http_is_origin_target(parser, buffer, pos, c)) {
+                        parser->state = TF_HTTP_STATE_ERROR;
+                        break;
+                    }
+                    
+                    TF_HTTP_SPAN_END(parser->path, parser, pos)
+                    
+                    // zero-length query by default, right after the path
+                    parser->query.offset = pos;
+                    parser->query.length = 0;
+                    
+                    parser->mark = pos + 1;
+                    parser->state = (c == '?' ? TF_HTTP_STATE_QUERY :
+                                                TF_HTTP_STATE_VERSION);
+                } else if (!TF_HTTP_IS_TARGET(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_QUERY: {
+                if (c == ' ') {
+                    TF_HTTP_SPAN_END(parser->query, parser, pos)
+                    
+                    parser->mark = pos + 1;
+                    parser->state = TF_HTTP_STATE_VERSION;
+                } else if (!TF_HTTP_IS_TARGET(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_VERSION: {
+                if (c == '\r' || c == '\n') {
+                    if (!tf_http_finish_version(parser, buffer, pos))
+                        parser->state = TF_HTTP_STATE_ERROR;
+                    else
+                        parser->state = (c == '\r' ? TF_HTTP_STATE_REQUEST_LINE_LF :
+                                                     TF_HTTP_STATE_HEADER_START);
+                } else if (!TF_HTTP_IS_TARGET(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_REQUEST_LINE_LF:
+            case TF_HTTP_STATE_HEADER_LF: {
+                parser->state = (c == '\n' ? TF_HTTP_STATE_HEADER_START :
+                                             TF_HTTP_STATE_ERROR);
+                break;
+            }
+            case TF_HTTP_STATE_HEADER_START: {
+                if (c == '\r')
+                    parser->state = TF_HTTP_STATE_HEAD_END_LF;
+                else if (c == '\n')
+                    parser->state = TF_HTTP_STATE_DONE;
+                else if (TF_HTTP_IS_TOKEN(c)) {
+                    // obsolete line folding (leading whitespace) is rejected
+                    // here as well, as it is not a token char
+                    if (parser->header_count >= TF_HTTP_MAX_HEADERS)
+                        return TF_HTTP_PARSE_TOO_LARGE;
+                    
+                    parser->mark = pos;
+                    parser->state = TF_HTTP_STATE_HEADER_NAME;
+                } else
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_HEADER_NAME: {
+                if (c == ':') {
+                    TF_HTTP_SPAN_END(parser->header_names[parser->header_count],
+                                     parser, pos)
+                    parser->state = TF_HTTP_STATE_HEADER_VALUE_START;
+                } else if (!TF_HTTP_IS_TOKEN(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_HEADER_VALUE_START:
+                if (c == ' ' || c == '\t')
+                    break;
+                
+                parser->mark = pos;
+                parser->state = TF_HTTP_STATE_HEADER_VALUE;
+                // fall through
+            case TF_HTTP_STATE_HEADER_VALUE: {
+                if (c == '\r' || c == '\n') {
+                    tf_http_finish_value(parser, buffer, pos);
+                    parser->state = (c == '\r' ? TF_HTTP_STATE_HEADER_LF :
+                                                 TF_HTTP_STATE_HEADER_START);
+                } else if (!TF_HTTP_IS_VALUE(c))
+                    parser->state = TF_HTTP_STATE_ERROR;
+                
+                break;
+            }
+            case TF_HTTP_STATE_HEAD_END_LF: {
+                parser->state = (c == '\n' ? TF_HTTP_STATE_DONE :
+                                             TF_HTTP_STATE_ERROR);
+                break;
+            }
+            default:
+                break;
+        }
+        
+        if (parser->state == TF_HTTP_STATE_ERROR) {
+            TF_LOG_DEBUG("malformed request, offending byte 0x%02x at %u", c, pos);
+            return TF_HTTP_PARSE_ERROR;
+        }
+    }
+    
+    parser->position = pos;
+    
+    if (parser->state != TF_HTTP_STATE_DONE)
+        return TF_HTTP_PARSE_INCOMPLETE;
+    
+    if (requestp)
+        tf_http_fill_request(parser, buffer, pos, requestp);
+    
+    return TF_HTTP_PARSE_DONE;
+}
+
+tf_str_view_t tf_http_request_get_header(const tf_http_request_t* request,
+                                         const char* name) {
+    tf_str_view_t result = { NULL, 0 };
+    
+    if (!request || !name)
+        return result;
+    
+    tf_http_header_id_t id = tf_http_header_lookup(name, (tf_index_t)strlen(name));
+    
+    if (id != TF_HTTP_HEADER_UNKNOWN)
+        return tf_http_request_get_known_header(request, id);
+    
+    // the well-known ones cannot match
+    for (tf_index_t index = 0; index < request->header_count; index++) {
+        if (request->headers[index].id == TF_HTTP_HEADER_UNKNOWN &&
+            tf_str_view_equals_nocase(request->headers[index].name, name))
+            return request->headers[index].value;
+    }
+    
+    return result;
+}
+
+tf_str_view_t tf_http_request_get_known_header(const tf_http_request_t* request,
+                                               const tf_http_header_id_t id) {
+    tf_str_view_t result = { NULL, 0 };
+    
+    if (!request || id <= TF_HTTP_HEADER_UNKNOWN || id >= TF_HTTP_HEADER_COUNT ||
+        !request->known_headers[id])
+        return result;
+    
+    return request->headers[request->known_headers[id] - 1].value;
+}
+
+bool tf_http_request_get_content_length(const tf_http_request_t* request,
+                                        uint64_t* lengthp) {
+    TF_PTR_SET(lengthp, 0);
+    
+    if (!request || !request->known_headers[TF_HTTP_HEADER_CONTENT_LENGTH])
+        return true; // no body
+    
+    uint64_t length = 0;
+    bool seen = false;
+    
+    // repeats have to agree, an upstream may read another one than we do
+    for (tf_index_t index = request->known_headers[TF_HTTP_HEADER_CONTENT_LENGTH] - 1;
+         index < request->header_count; index++) {
+        uint64_t other = 0;
+        
+        if (request->headers[index].id != TF_HTTP_HEADER_CONTENT_LENGTH)
+            continue;
+        
+        if (!tf_http_parse_content_length(request->headers[index].value, &other) ||
+            (seen && other != length))
+            return false;
+        
+        length = other;
+        seen = true;
+    }
+    
+    TF_PTR_SET(lengthp, length);
+    return true;
+}
+
+bool tf_http_request_wants_keep_alive(const tf_http_request_t* request) {
+    if (!request)
+        return false;
+    
+    tf_str_view_t connection = tf_http_request_get_known_header(request,
+                                                                TF_HTTP_HEADER_CONNECTION);
+    
+    if (request->version_minor >= 1)
+        return !tf_http_header_has_token(connection, "close");
+    
+    return tf_http_header_has_token(connection, "keep-alive");
+}
+
+bool tf_http_header_has_token(const tf_str_view_t value, const char* token) {
+    if (!value.data || !token)
+        return false;
+    
+    tf_index_t start = 0;
+    
+    while (start < value.length) {
+        tf_index_t end = start;
+        while (end < value.length && value.data[end] != ',')
+            end++;
+        
+        // trim the optional whitespace around the element
+        tf_index_t first = start, last = end;
+        while (first < last && (value.data[first] == ' ' || value.data[first] == '\t'))
+            first++;
+        while (last > first && (value.data[last - 1] == ' ' || value.data[last - 1] == '\t'))
+            last--;
+        
+        tf_str_view_t element = { value.data + first, last - first };
+        if (tf_str_view_equals_nocase(element, token))
+            return true;
+        
+        start = end + 1;
+    }
+    
+    return false;
+}
+
+bool tf_http_header_matches_etag(const tf_str_view_t value, const char* etag) {
+    if (!value.data || !etag)
+        return false;
+    
+    tf_index_t etag_length = (tf_index_t)strlen(etag);
+    tf_index_t start = 0;
+    
+    while (start < value.length) {
+        tf_index_t end = start;
+        while (end < value.length && value.data[end] != ',')
+            end++;
+        
+        tf_index_t first = start, last = end;
+        while (first < last && (value.data[first] == ' ' || value.data[first] == '\t'))
+            first++;
+        while (last > first && (value.data[last - 1] == ' ' || value.data[last - 1] == '\t'))
+            last--;
+        
+        // weak comparison, W/"x" matches "x"
+        if (last - first > 2 && value.data[first] == 'W' && value.data[first + 1] == '/')
+            first += 2;
+        
+        if ((last - first == 1 && value.data[first] == '*') ||
+            (last - first == etag_length &&
+             memcmp(value.data + first, etag, etag_length) == 0))
+            return true;
+        
+        start = end + 1;
+    }
+    
+    return false;
+}
+
+//
+// chunked bodies public
+//
+
+tf_http_parse_status_t tf_http_chunked_feed(tf_http_chunked_t* chunked, const char c,
+                                            const uint64_t max_size) {
+    switch (chunked->state) {
+        case TF_HTTP_CHUNKED_SIZE: {
+            int digit = -1;
+            
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                digit = (c | 0x20) - 'a' + 10;
+            
+            if (digit >= 0) {
+                if (++chunked->line >= TF_HTTP_CHUNKED_MAX_LINE)
+                    break;
+                
+                // refused as soon as it's clear the chunk won't fit
+                if (chunked->left > (max_size >> 4) ||
+                    (chunked->left << 4) + (uint64_t)digit > max_size)
+                    return TF_HTTP_PARSE_TOO_LARGE;
+                
+                chunked->left = (chunked->left << 4) + (uint64_t)digit;
+                return TF_HTTP_PARSE_INCOMPLETE;
+            }
+            
+            if (chunked->line < 1)
+                break; // no size at all
+            
+            if (c == ';' || c == ' ' || c == '\t') {
+                chunked->state = TF_HTTP_CHUNKED_EXTENSION;
+                return TF_HTTP_PARSE_INCOMPLETE;
+            }
+            
+            if (c != '\r')
+                break;
+            
+            chunked->state = TF_HTTP_CHUNKED_SIZE_LF;
+            return TF_HTTP_PARSE_INCOMPLETE;
+        }
+        case TF_HTTP_CHUNKED_EXTENSION:
+            if (c == '\r')
+                chunked->state = TF_HTTP_CHUNKED_SIZE_LF;
+            else if (c == '\n' || ++chunked->line >= TF_HTTP_CHUNKED_MAX_LINE)
+                break;
+            
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_SIZE_LF:
+            if (c != '\n')
+                break;
+            
+            // the last chunk has no payload, a trailer may follow it
+            chunked->line = 0;
+            chunked->state = (chunked->left > 0 ? TF_HTTP_CHUNKED_DATA :
+                              TF_HTTP_CHUNKED_TRAILER);
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_DATA_CR:
+            if (c != '\r')
+                break;
+            
+            chunked->state = TF_HTTP_CHUNKED_DATA_LF;
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_DATA_LF:
+            if (c != '\n')
+                break;
+            
+            chunked->line = 0;
+            chunked->state = TF_HTTP_CHUNKED_SIZE;
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_TRAILER:
+            if (c == '\n')
+                break;
+            
+            // trailer fields are not used for anything
+            chunked->line = 1;
+            chunked->state = (c == '\r' ? TF_HTTP_CHUNKED_END_LF :
+                              TF_HTTP_CHUNKED_TRAILER_LINE);
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_TRAILER_LINE:
+            if (c == '\n')
+                chunked->state = TF_HTTP_CHUNKED_TRAILER;
+            else if (++chunked->line >= TF_HTTP_CHUNKED_MAX_LINE)
+                break;
+            
+            return TF_HTTP_PARSE_INCOMPLETE;
+        case TF_HTTP_CHUNKED_END_LF:
+            if (c != '\n')
+                break;
+            
+            chunked->state = TF_HTTP_CHUNKED_DONE;
+            return TF_HTTP_PARSE_DONE;
+        default:
+            break;
+    }
+    
+    return TF_HTTP_PARSE_ERROR;
+}
+
+//
+// responses public
+//
+
+const char* tf_http_status_get_reason(const uint16_t status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 414: return "URI Too Long";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default:
+            return "Unknown";
+    }
+}
+
+//
+// string views public
+//
+
+bool tf_str_view_equals(const tf_str_view_t view, const char* str) {
+    if (!view.data || !str)
+        return false;
+    
+    return (strlen(str) == view.length && memcmp(view.data, str, view.length) == 0);
+}
+
+bool tf_str_view_equals_nocase(const tf_str_view_t view, const char* str) {
+    if (!view.data || !str)
+        return false;
+    
+    return (strlen(str) == view.length &&
+            strncasecmp(view.data, str, view.length) == 0);
+}
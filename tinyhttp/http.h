@@ -0,0 +1,192 @@
+//
+//  http.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "header.h"
+
+//
+// incremental HTTP/1.x request parser
+//
+// the parser never copies anything, all the parsed request components are
+// views into the buffer that was passed to tf_http_parser_execute, so they
+// are only valid as long as that buffer is neither freed nor moved
+//
+
+/// max amount of headers in a single request
+#define TF_HTTP_MAX_HEADERS 64
+/// default limit for the request line + headers size
+#define TF_HTTP_DEFAULT_MAX_HEAD_SIZE 8192
+
+/// single request header
+typedef struct {
+    tf_str_view_t name;
+    tf_str_view_t value;
+    // TF_HTTP_HEADER_UNKNOWN unless the name is in header.def
+    tf_http_header_id_t id;
+} tf_http_header_t;
+
+/// parsed request head
+typedef struct {
+    tf_str_view_t method;
+    // request target without the query string
+    tf_str_view_t path;
+    // query string without the leading '?', empty if none
+    tf_str_view_t query;
+    // full protocol version string, like "HTTP/1.1"
+    tf_str_view_t version;
+    // 0 for HTTP/1.0, 1 for HTTP/1.1
+    uint8_t version_minor;
+    
+    tf_http_header_t headers[TF_HTTP_MAX_HEADERS];
+    tf_index_t header_count;
+    // index + 1 of the first header with each well-known name, 0 if there
+    // is none, so looking those up doesn't go through the headers
+    uint8_t known_headers[TF_HTTP_HEADER_COUNT];
+    
+    // size of the request line + headers + the empty line
+    tf_index_t head_length;
+} tf_http_request_t;
+
+typedef enum {
+    // need more data
+    TF_HTTP_PARSE_INCOMPLETE,
+    // the whole request head has been parsed
+    TF_HTTP_PARSE_DONE,
+    // malformed request
+    TF_HTTP_PARSE_ERROR,
+    // request head exceeds the configured limits
+    TF_HTTP_PARSE_TOO_LARGE
+} tf_http_parse_status_t;
+
+/// offset + length pair, views are only made once the head is complete
+typedef struct {
+    tf_index_t offset;
+    tf_index_t length;
+} tf_http_span_t;
+
+/// resumable parser state, can be embedded into any per-connection struct
+typedef struct {
+    // current state machine state and the next byte to look at
+    uint8_t state;
+    tf_index_t position;
+    // start of the token currently being parsed
+    tf_index_t mark;
+    
+    tf_http_span_t method;
+    tf_http_span_t path;
+    tf_http_span_t query;
+    tf_http_span_t version;
+    
+    tf_http_span_t header_names[TF_HTTP_MAX_HEADERS];
+    tf_http_span_t header_values[TF_HTTP_MAX_HEADERS];
+    tf_index_t header_count;
+    
+    // configured limit, see TF_HTTP_DEFAULT_MAX_HEAD_SIZE
+    tf_index_t max_head_size;
+} tf_http_parser_t;
+
+void tf_http_parser_init(tf_http_parser_t* parser, const tf_index_t max_head_size);
+/// prepares the parser for the next request, keeps the configured limits
+void tf_http_parser_reset(tf_http_parser_t* parser);
+
+///
+/// continues parsing the request head, buffer must start at the same
+/// byte as in all the previous calls since the last reset and may only
+/// have grown since then
+///
+/// on TF_HTTP_PARSE_DONE, requestp is filled with views into buffer
+///
+tf_http_parse_status_t tf_http_parser_execute(tf_http_parser_t* parser,
+                                              const char* buffer,
+                                              const tf_index_t length,
+                                              tf_http_request_t* requestp);
+
+/// case-insensitive header lookup, returns an empty view if not found
+tf_str_view_t tf_http_request_get_header(const tf_http_request_t* request,
+                                         const char* name);
+/// same for a well-known header, a single load
+tf_str_view_t tf_http_request_get_known_header(const tf_http_request_t* request,
+                                               const tf_http_header_id_t id);
+
+/// body size announced by Content-Length (0 if there is none), returns
+/// false if the header is malformed or repeated with another value
+bool tf_http_request_get_content_length(const tf_http_request_t* request,
+                                        uint64_t* lengthp);
+
+/// whether the request wants the connection to stay open afterwards,
+/// HTTP/1.1 defaults to keep-alive, HTTP/1.0 has to ask for it
+bool tf_http_request_wants_keep_alive(const tf_http_request_t* request);
+
+/// case-insensitive lookup of a token in a comma-separated header value,
+/// like "close" in "Connection: Upgrade, close"
+bool tf_http_header_has_token(const tf_str_view_t value, const char* token);
+
+/// whether an If-None-Match value ("*" or a list of entity tags, weak or
+/// not) matches etag (quotes included), weak comparison as RFC 9110 wants
+bool tf_http_header_matches_etag(const tf_str_view_t value, const char* etag);
+
+//
+// chunked bodies
+//
+
+/// longest chunk size, extension or trailer line taken
+#define TF_HTTP_CHUNKED_MAX_LINE 4096
+
+/// where a chunked body is, the framing is looked at one byte at a time
+typedef enum {
+    // hex digits of the chunk size
+    TF_HTTP_CHUNKED_SIZE,
+    // chunk extensions up to the CR, ignored
+    TF_HTTP_CHUNKED_EXTENSION,
+    TF_HTTP_CHUNKED_SIZE_LF,
+    // payload, left bytes of it
+    TF_HTTP_CHUNKED_DATA,
+    TF_HTTP_CHUNKED_DATA_CR,
+    TF_HTTP_CHUNKED_DATA_LF,
+    // start of a trailer line, an empty one ends the body
+    TF_HTTP_CHUNKED_TRAILER,
+    TF_HTTP_CHUNKED_TRAILER_LINE,
+    TF_HTTP_CHUNKED_END_LF,
+    TF_HTTP_CHUNKED_DONE
+} tf_http_chunked_state_t;
+
+/// resumable chunk framing state (RFC 9112, 7.1), zeroed to start
+typedef struct {
+    // tf_http_chunked_state_t
+    uint8_t state;
+    // payload bytes still to come in the current chunk
+    uint64_t left;
+    // bytes of the current size, extension or trailer line
+    tf_index_t line;
+} tf_http_chunked_t;
+
+///
+/// takes one byte of the framing, in any state but TF_HTTP_CHUNKED_DATA
+/// (the caller goes over the payload and moves on to
+/// TF_HTTP_CHUNKED_DATA_CR once none is left), TF_HTTP_PARSE_DONE once the
+/// body is complete, TF_HTTP_PARSE_TOO_LARGE for a chunk longer than
+/// max_size, TF_HTTP_PARSE_ERROR for malformed framing
+///
+tf_http_parse_status_t tf_http_chunked_feed(tf_http_chunked_t* chunked, const char c,
+                                            const uint64_t max_size);
+
+//
+// responses
+//
+
+/// standard reason phrase for the status code, "Unknown" if unknown
+const char* tf_http_status_get_reason(const uint16_t status);
+
+//
+// string views
+//
+
+bool tf_str_view_equals(const tf_str_view_t view, const char* str);
+bool tf_str_view_equals_nocase(const tf_str_view_t view, const char* str);
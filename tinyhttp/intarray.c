@@ -31,7 +31,7 @@ bool tf_int_array_autoextend_if_necessary(tf_int_array_ref array) {
     if (!array)
         return false;
     
-    TF_LOG("autoextend called");
+    TF_LOG_DEBUG("autoextend called");
     
     if ((array->count + 1) >= array->capacity) {
         if (!array->autoextend)
@@ -41,7 +41,7 @@ bool tf_int_array_autoextend_if_necessary(tf_int_array_ref array) {
         array->capacity += 5;
         array->raw = realloc(array->raw, array->capacity * sizeof(int));
         
-        TF_LOG("new capacity = %u, raw = %p", array->capacity, array->raw);
+        TF_LOG_DEBUG("new capacity = %u, raw = %p", array->capacity, array->raw);
         
         // zero out all the garbage
         memset(array->raw + array->count, 0, array->capacity - array->count - 1);
@@ -79,15 +79,15 @@ tf_int_array_ref tf_int_array_init(const tf_index_t capacity,
     array->raw = calloc(array->capacity, sizeof(int));
     array->autoextend = autoextend;
     
-    TF_LOG("array created, raw = %p, capacity = %u, count = %u", array->raw,
-                                                                 array->capacity,
-                                                                 array->count);
+    TF_LOG_DEBUG("array created, raw = %p, capacity = %u, count = %u", array->raw,
+                                                                       array->capacity,
+                                                                       array->count);
     return array;
 }
 
 bool tf_int_array_push(tf_int_array_ref array, const int value) {
     if (tf_int_array_autoextend_if_necessary(array)) {
-        TF_LOG("autoextend success");
+        TF_LOG_DEBUG("autoextend success");
         
         array->raw[array->count++] = value;
         return true;
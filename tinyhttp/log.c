@@ -0,0 +1,370 @@
+//
+//  log.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "privutil.h"
+#include "log.h"
+
+//
+// private
+//
+
+#define TF_LOG_RING_MASK (TF_LOG_RING_SIZE - 1)
+/// how long the writer lets messages pile up while they keep coming
+#define TF_LOG_BATCH_MS 10
+/// most rings written out with a single writev
+#define TF_LOG_BATCH_RINGS 31
+
+static const char* tf_log_level_names[] = { "NONE", "ERROR", "WARN", "INFO", "DEBUG" };
+
+///
+/// single producer (the owning thread), single consumer (whoever holds
+/// tf_log_lock) byte ring, head and tail only ever grow, lines are
+/// published as a whole by moving head
+///
+typedef struct tf_log_ring_s* tf_log_ring_ref;
+struct tf_log_ring_s {
+    // written by the owner only
+    uint64_t head;
+    // last tail the owner has seen, saves it a shared cache line per message
+    uint64_t cached_tail;
+    char head_pad[48];
+    
+    // written by the consumer only
+    uint64_t tail;
+    char tail_pad[56];
+    
+    // the owner thread is gone, freed by the consumer once empty
+    bool retired;
+    // all the rings, under tf_log_lock
+    tf_log_ring_ref next;
+    
+    char data[TF_LOG_RING_SIZE];
+};
+
+static __thread tf_log_ring_ref tf_log_ring;
+
+// serializes consuming the rings, guards the ring list and the output
+static pthread_mutex_t tf_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tf_log_wakeup = PTHREAD_COND_INITIALIZER;
+static tf_log_ring_ref tf_log_rings;
+static int tf_log_output = STDERR_FILENO;
+
+static pthread_key_t tf_log_ring_key;
+static pthread_once_t tf_log_once = PTHREAD_ONCE_INIT;
+static pthread_t tf_log_writer;
+// no writer thread, every message is written out right away
+static bool tf_log_sync;
+// the writer is about to sleep until woken up
+static bool tf_log_writer_idle;
+
+static uint64_t tf_log_dropped;
+// last dropped count written out, under tf_log_lock
+static uint64_t tf_log_dropped_reported;
+
+/// writes everything out, gives up on errors since there is nowhere to report them
+void tf_log_write_all(const int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            
+            return;
+        }
+        
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+}
+
+/// writes out what the rings hold, frees retired empty rings, to be called
+/// with tf_log_lock held, returns the amount of bytes written
+uint64_t tf_log_drain(void) {
+    struct iovec iov[TF_LOG_BATCH_RINGS * 2 + 1];
+    tf_log_ring_ref rings[TF_LOG_BATCH_RINGS];
+    uint64_t heads[TF_LOG_BATCH_RINGS];
+    bool retired[TF_LOG_BATCH_RINGS];
+    char notice[64];
+    uint64_t total = 0;
+    
+    tf_log_ring_ref ring = tf_log_rings;
+    
+    do {
+        int count = 0;
+        tf_index_t batch = 0;
+        
+        uint64_t dropped = __atomic_load_n(&tf_log_dropped, __ATOMIC_RELAXED);
+        if (dropped != tf_log_dropped_reported) {
+            int length = snprintf(notice, sizeof(notice), "[WARN/log] %llu messages dropped\n",
+                                  (unsigned long long)(dropped - tf_log_dropped_reported));
+            
+            iov[count].iov_base = notice;
+            iov[count++].iov_len = (size_t)length;
+            tf_log_dropped_reported = dropped;
+        }
+        
+        for (; ring && batch < TF_LOG_BATCH_RINGS; ring = ring->next) {
+            // before head, so nothing published after it is missed
+            bool gone = __atomic_load_n(&ring->retired, __ATOMIC_ACQUIRE);
+            uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            uint64_t tail = ring->tail;
+            
+            if (head == tail && !gone)
+                continue;
+            
+            tf_index_t offset = (tf_index_t)(tail & TF_LOG_RING_MASK);
+            tf_index_t length = (tf_index_t)(head - tail);
+            tf_index_t first = TF_LOG_RING_SIZE - offset;
+            
+            if (first > length)
+                first = length;
+            
+            if (first > 0) {
+                iov[count].iov_base = ring->data + offset;
+                iov[count++].iov_len = first;
+            }
+            
+            if (length > first) {
+                iov[count].iov_base = ring->data;
+                iov[count++].iov_len = length - first;
+            }
+            
+            rings[batch] = ring;
+            heads[batch] = head;
+            retired[batch++] = gone;
+            
+            total += length;
+        }
+        
+        tf_log_write_all(tf_log_output, iov, count);
+        
+        for (tf_index_t index = 0; index < batch; index++) {
+            __atomic_store_n(&rings[index]->tail, heads[index], __ATOMIC_RELEASE);
+            
+            if (!retired[index])
+                continue;
+            
+            for (tf_log_ring_ref* link = &tf_log_rings; *link; link = &(*link)->next) {
+                if (*link == rings[index]) {
+                    *link = rings[index]->next;
+                    break;
+                }
+            }
+            
+            free(rings[index]);
+        }
+    } while (ring);
+    
+    return total;
+}
+
+void* tf_log_writer_run(void* unused) {
+    (void)(unused);
+    
+    pthread_mutex_lock(&tf_log_lock);
+    
+    while (true) {
+        if (tf_log_drain() > 0) {
+            // busy, let the next batch pile up unless a ring fills up meanwhile
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            
+            deadline.tv_nsec += TF_LOG_BATCH_MS * 1000000l;
+            if (deadline.tv_nsec >= 1000000000l) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000l;
+            }
+            
+            pthread_cond_timedwait(&tf_log_wakeup, &tf_log_lock, &deadline);
+            continue;
+        }
+        
+        __atomic_store_n(&tf_log_writer_idle, true, __ATOMIC_SEQ_CST);
+        
+        // whatever was published before the flag became visible
+        if (tf_log_drain() > 0) {
+            __atomic_store_n(&tf_log_writer_idle, false, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        
+        while (__atomic_load_n(&tf_log_writer_idle, __ATOMIC_SEQ_CST))
+            pthread_cond_wait(&tf_log_wakeup, &tf_log_lock);
+    }
+    
+    return NULL;
+}
+
+void tf_log_ring_retire(void* ring) {
+    __atomic_store_n(&((tf_log_ring_ref)ring)->retired, true, __ATOMIC_RELEASE);
+    tf_log_ring = NULL;
+    
+    if (tf_log_sync)
+        tf_log_flush();
+}
+
+void tf_log_start(void) {
+    pthread_key_create(&tf_log_ring_key, tf_log_ring_retire);
+    
+    // the writer must not take any signals meant for the process
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    
+    tf_log_sync = (pthread_create(&tf_log_writer, NULL, tf_log_writer_run, NULL) != 0);
+    
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    
+    if (!tf_log_sync)
+        pthread_detach(tf_log_writer);
+    
+    atexit(tf_log_flush);
+}
+
+tf_log_ring_ref tf_log_get_ring(void) {
+    if (tf_log_ring)
+        return tf_log_ring;
+    
+    pthread_once(&tf_log_once, tf_log_start);
+    
+    tf_log_ring_ref ring = tf_struct_alloc(tf_log_ring_s);
+    if (!ring)
+        return NULL;
+    
+    pthread_mutex_lock(&tf_log_lock);
+    ring->next = tf_log_rings;
+    tf_log_rings = ring;
+    pthread_mutex_unlock(&tf_log_lock);
+    
+    pthread_setspecific(tf_log_ring_key, ring);
+    tf_log_ring = ring;
+    
+    return ring;
+}
+
+//
+// public
+//
+
+void tf_log(const uint8_t level, const char* fn, const tf_index_t line,
+            const char* fnn, const char* fmt, ...) {
+    char text[TF_LOG_LINE_MAX];
+    int length = snprintf(text, sizeof(text) - 1, "[%s/%s/%u/%s] ",
+                          tf_log_level_names[level <= TF_LOG_LEVEL_DEBUG ? level : 0],
+                          fn, line, fnn);
+    tf_index_t used = (tf_index_t)(length < 0 ? 0 : length);
+    
+    if (used > sizeof(text) - 2)
+        used = sizeof(text) - 2;
+    
+    va_list vl;
+    va_start(vl, fmt);
+    length = vsnprintf(text + used, sizeof(text) - 1 - used, fmt, vl);
+    va_end(vl);
+    
+    used += (tf_index_t)(length < 0 ? 0 : length);
+    
+    if (used > sizeof(text) - 2)
+        used = sizeof(text) - 2;
+    
+    text[used++] = '\n';
+    
+    tf_log_ring_ref ring = tf_log_get_ring();
+    if (!ring) {
+        __atomic_add_fetch(&tf_log_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    
+    uint64_t head = ring->head;
+    
+    if (head + used - ring->cached_tail > TF_LOG_RING_SIZE) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        
+        // warnings and errors are worth waiting for, the rest is not
+        if (head + used - ring->cached_tail > TF_LOG_RING_SIZE &&
+            level <= TF_LOG_LEVEL_WARN) {
+            tf_log_flush();
+            ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        }
+        
+        if (head + used - ring->cached_tail > TF_LOG_RING_SIZE) {
+            __atomic_add_fetch(&tf_log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    
+    tf_index_t offset = (tf_index_t)(head & TF_LOG_RING_MASK);
+    tf_index_t first = TF_LOG_RING_SIZE - offset;
+    
+    if (first > used)
+        first = used;
+    
+    memcpy(ring->data + offset, text, first);
+    memcpy(ring->data, text + first, used - first);
+    
+    __atomic_store_n(&ring->head, head + used, __ATOMIC_SEQ_CST);
+    
+    if (tf_log_sync) {
+        tf_log_flush();
+        return;
+    }
+    
+    // past half full the writer shouldn't wait for the batch to fill up
+    bool filling = ((head - ring->cached_tail) < TF_LOG_RING_SIZE / 2 &&
+                    (head + used - ring->cached_tail) >= TF_LOG_RING_SIZE / 2);
+    
+    // only swapped when set, the flag stays a read-shared cache line otherwise
+    if (__atomic_load_n(&tf_log_writer_idle, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&tf_log_writer_idle, false, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&tf_log_lock);
+        pthread_cond_signal(&tf_log_wakeup);
+        pthread_mutex_unlock(&tf_log_lock);
+    } else if (filling && pthread_mutex_trylock(&tf_log_lock) == 0) {
+        // busy means the writer is at it already
+        pthread_cond_signal(&tf_log_wakeup);
+        pthread_mutex_unlock(&tf_log_lock);
+    }
+}
+
+void tf_log_set_output(const int fd) {
+    pthread_mutex_lock(&tf_log_lock);
+    
+    // what was logged so far still goes to the previous one
+    tf_log_drain();
+    tf_log_output = fd;
+    
+    pthread_mutex_unlock(&tf_log_lock);
+}
+
+void tf_log_flush(void) {
+    pthread_mutex_lock(&tf_log_lock);
+    tf_log_drain();
+    pthread_mutex_unlock(&tf_log_lock);
+}
+
+uint64_t tf_log_get_dropped_count(void) {
+    return __atomic_load_n(&tf_log_dropped, __ATOMIC_RELAXED);
+}
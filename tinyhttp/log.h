@@ -0,0 +1,76 @@
+//
+//  log.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// asynchronous logger
+//
+// messages above TF_LOG_LEVEL are compiled out entirely (their arguments
+// are not even evaluated), the others are formatted by the calling thread
+// into its own lock-free ring buffer and written out in batches by a
+// background thread, a thread never waits for the output unless its ring
+// is full and the message is an error or a warning, anything less is
+// dropped and counted then
+//
+// whatever is still buffered is written out at exit
+//
+
+#define TF_LOG_LEVEL_NONE 0
+#define TF_LOG_LEVEL_ERROR 1
+#define TF_LOG_LEVEL_WARN 2
+#define TF_LOG_LEVEL_INFO 3
+#define TF_LOG_LEVEL_DEBUG 4
+
+#ifndef TF_LOG_LEVEL
+#ifdef DEBUG
+#define TF_LOG_LEVEL TF_LOG_LEVEL_DEBUG
+#else
+#define TF_LOG_LEVEL TF_LOG_LEVEL_INFO
+#endif
+#endif
+
+/// bytes buffered per logging thread
+#define TF_LOG_RING_SIZE 65536
+/// longer messages are cut
+#define TF_LOG_LINE_MAX 1024
+
+#ifndef __FILE_NAME__
+// only clang has this
+#define __FILE_NAME__ __FILE__
+#endif
+
+/// use the TF_LOG_* macros instead
+void tf_log(const uint8_t level, const char* fn, const tf_index_t line,
+            const char* fnn, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 5, 6)))
+#endif
+    ;
+
+#define TF_LOG_AT(level, ...) \
+do { \
+    if ((level) <= TF_LOG_LEVEL) \
+        tf_log((level), __FILE_NAME__, __LINE__, __FUNCTION__, __VA_ARGS__); \
+} while (0)
+
+#define TF_LOG_ERROR(...) TF_LOG_AT(TF_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define TF_LOG_WARN(...) TF_LOG_AT(TF_LOG_LEVEL_WARN, __VA_ARGS__)
+#define TF_LOG_INFO(...) TF_LOG_AT(TF_LOG_LEVEL_INFO, __VA_ARGS__)
+#define TF_LOG_DEBUG(...) TF_LOG_AT(TF_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/// where the messages go, stderr by default
+void tf_log_set_output(const int fd);
+
+/// writes out everything logged so far by all the threads, blocks until done
+void tf_log_flush(void);
+
+/// messages dropped because a ring was full
+uint64_t tf_log_get_dropped_count(void);
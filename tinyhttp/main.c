@@ -7,48 +7,442 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "arena.h"
+#include "conn.h"
+#include "docroot.h"
+#include "http.h"
+#include "log.h"
+#include "proxy.h"
+#include "router.h"
+#include "server.h"
 #include "tcp.h"
 
-void tinyhttp_listen(tf_tcp_ref server,
-                     tf_tcp_connection_type_t ctype,
-                     tf_data_ref const rdt,
-                     const tf_index_t rdl,
-                     tf_socket_t lsock,
-                     tf_data_ref meta) {
-    (void)(meta);
+static const char tinyhttp_hello[] = "hello";
+static const char tinyhttp_not_found[] = "not found";
+static const char tinyhttp_no_pool[] = "no thread pool";
+static const char tinyhttp_bad_name[] = "bad file name";
+/// open files cached per worker with --root
+#define TINYHTTP_DOCROOT_CACHE_SIZE 1024
+/// longest nap /sleep/:ms takes
+#define TINYHTTP_MAX_SLEEP_MS 10000
+/// how long greetings are served from the response cache with --cache
+#define TINYHTTP_HELLO_CACHE_TTL_MS 60000
+/// most lines /count/:n streams
+#define TINYHTTP_MAX_COUNT 100000000
+/// longest file name /upload/:name takes
+#define TINYHTTP_MAX_UPLOAD_NAME 255
+/// connections per worker, clients and upstreams together, with --upstream
+#define TINYHTTP_PROXY_MAX_CONNECTIONS 1024
+
+/// where /count/:n is at
+typedef struct {
+    unsigned long next;
+    unsigned long last;
+} tinyhttp_count_t;
+
+void tinyhttp_hello_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           const tf_router_match_t* match,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
     (void)(server);
+    (void)(request);
+    (void)(meta);
     
-    switch (ctype) {
-        case TF_TCP_CONNECTION_NEW: {
-            printf("New connection from socket %d\n", lsock);
-            break;
-        }
-        case TF_TCP_CONNECTION_CONTINUE: {
-            printf("Raw input (%u bytes):\n%s\n", rdl, rdt);
-            
-            const char* msg = "HTTP/1.0 200 OK\r\nContent-Type: text/html; charset=UTF-8\r\nServer: tinyhttp\r\nContent-Length: 5\r\n\r\nhello";
-            
-            tf_socket_send_data(lsock, (const tf_data_ref)msg, (tf_index_t)strlen(msg));
-        }
-        case TF_TCP_CONNECTION_CLOSE: {
-            printf("Goodbye from %d\n", lsock);
+    tf_str_view_t name;
+    
+    // the same for everyone, no need to call us again for a while
+    response->cache_ttl = TINYHTTP_HELLO_CACHE_TTL_MS;
+    
+    if (!tf_router_match_get_param(match, "name", &name)) {
+        response->body.data = tinyhttp_hello;
+        response->body.length = (tf_index_t)(sizeof(tinyhttp_hello) - 1);
+        return;
+    }
+    
+    // lives until the response has been queued
+    char* body = tf_arena_alloc(tf_conn_get_arena(conn), name.length + 8);
+    
+    if (!body) {
+        response->status = 500;
+        return;
+    }
+    
+    int length = sprintf(body, "hello, %.*s", (int)name.length, name.data);
+    
+    response->body.data = body;
+    response->body.length = (tf_index_t)length;
+}
+
+/// runs on a pool thread, stands for anything that would block a worker
+void tinyhttp_sleep_run(const tf_http_request_t* request,
+                        tf_http_response_t* response,
+                        tf_arena_ref arena,
+                        tf_data_ref meta) {
+    (void)(request);
+    
+    long milliseconds = (long)(uintptr_t)meta;
+    struct timespec pause = { milliseconds / 1000, (milliseconds % 1000) * 1000000l };
+    
+    nanosleep(&pause, NULL);
+    
+    char* body = tf_arena_alloc(arena, 32);
+    
+    if (!body) {
+        response->status = 500;
+        return;
+    }
+    
+    int length = snprintf(body, 32, "slept %ld ms", milliseconds);
+    
+    response->body.data = body;
+    response->body.length = (tf_index_t)length;
+}
+
+void tinyhttp_sleep_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           const tf_router_match_t* match,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(request);
+    (void)(meta);
+    
+    tf_str_view_t value;
+    long milliseconds = 0;
+    
+    if (tf_router_match_get_param(match, "ms", &value))
+        milliseconds = strtol(value.data, NULL, 10);
+    
+    if (milliseconds < 0 || milliseconds > TINYHTTP_MAX_SLEEP_MS)
+        milliseconds = TINYHTTP_MAX_SLEEP_MS;
+    
+    if (!tf_http_server_defer(server, conn, tinyhttp_sleep_run,
+                              (tf_data_ref)(uintptr_t)milliseconds)) {
+        response->status = 503;
+        response->body.data = tinyhttp_no_pool;
+        response->body.length = (tf_index_t)(sizeof(tinyhttp_no_pool) - 1);
+    }
+}
+
+/// one line per number, as many as fit
+tf_index_t tinyhttp_count_produce(char* buffer, const tf_index_t capacity, bool* endp,
+                                  tf_data_ref meta) {
+    tinyhttp_count_t* count = (tinyhttp_count_t*)meta;
+    tf_index_t length = 0;
+    
+    while (count->next <= count->last) {
+        char line[24];
+        int llen = snprintf(line, sizeof(line), "%lu\n", count->next);
+        
+        if (length + (tf_index_t)llen > capacity)
             break;
-        }
+        
+        memcpy(buffer + length, line, (size_t)llen);
+        length += (tf_index_t)llen;
+        count->next++;
+    }
+    
+    *endp = (count->next > count->last);
+    return length;
+}
+
+void tinyhttp_count_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           const tf_router_match_t* match,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(meta);
+    
+    tf_str_view_t value;
+    long last = 0;
+    
+    if (tf_router_match_get_param(match, "n", &value))
+        last = strtol(value.data, NULL, 10);
+    
+    if (last < 0 || last > TINYHTTP_MAX_COUNT)
+        last = TINYHTTP_MAX_COUNT;
+    
+    // generated while it goes out, never as a whole
+    tf_http_stream_ref stream = tf_http_server_stream(server, conn, request);
+    tinyhttp_count_t* count = malloc(sizeof(tinyhttp_count_t));
+    
+    if (!stream || !count) {
+        free(count);
+        tf_http_stream_end(stream);
+        
+        response->status = 500;
+        return;
+    }
+    
+    count->next = 1;
+    count->last = (unsigned long)last;
+    
+    response->content_type = "text/plain; charset=UTF-8";
+    tf_http_stream_set_producer(stream, tinyhttp_count_produce, count, free);
+}
+
+/// the upload is in (or failed), meta is the file it went into
+void tinyhttp_upload_complete(const tf_http_request_t* request,
+                              const uint16_t error,
+                              tf_http_response_t* response,
+                              tf_arena_ref arena,
+                              tf_data_ref meta) {
+    (void)(request);
+    
+    int fd = (int)(intptr_t)meta;
+    off_t size = lseek(fd, 0, SEEK_CUR);
+    
+    close(fd);
+    
+    if (error > 0)
+        return;
+    
+    char* body = tf_arena_alloc(arena, 48);
+    
+    // stored either way, the size is just a nicety
+    response->status = 201;
+    
+    if (body) {
+        response->body.data = body;
+        response->body.length = (tf_index_t)snprintf(body, 48, "stored %lld bytes",
+                                                     (long long)size);
+    }
+}
+
+void tinyhttp_upload_handle(tf_http_server_ref server,
+                            tf_conn_ref conn,
+                            const tf_http_request_t* request,
+                            const tf_router_match_t* match,
+                            tf_http_response_t* response,
+                            tf_data_ref meta) {
+    tf_str_view_t name = { NULL, 0 };
+    tf_router_match_get_param(match, "name", &name);
+    
+    // stays inside the upload directory, no hidden files either
+    if (name.length < 1 || name.length > TINYHTTP_MAX_UPLOAD_NAME || name.data[0] == '.' ||
+        memchr(name.data, '/', name.length) || memchr(name.data, '\0', name.length)) {
+        response->status = 400;
+        response->body.data = tinyhttp_bad_name;
+        response->body.length = (tf_index_t)(sizeof(tinyhttp_bad_name) - 1);
+        return;
+    }
+    
+    const char* directory = (const char*)meta;
+    char* path = tf_arena_alloc(tf_conn_get_arena(conn),
+                                (tf_index_t)(strlen(directory) + name.length + 2));
+    
+    if (!path) {
+        response->status = 500;
+        return;
+    }
+    
+    sprintf(path, "%s/%.*s", directory, (int)name.length, name.data);
+    
+    // a symlink planted in the directory is not written through
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, 0644);
+    tf_http_body_ref body = (fd >= 0 ?
+                             tf_http_server_receive_body(server, conn, request,
+                                                         tinyhttp_upload_complete,
+                                                         (tf_data_ref)(intptr_t)fd) :
+                             NULL);
+    
+    if (!body) {
+        if (fd >= 0)
+            close(fd);
+        
+        response->status = 500;
+        return;
+    }
+    
+    // spliced straight from the socket where possible
+    tf_http_body_set_file(body, fd);
+}
+
+void tinyhttp_file_handle(tf_http_server_ref server,
+                          tf_conn_ref conn,
+                          const tf_http_request_t* request,
+                          const tf_router_match_t* match,
+                          tf_http_response_t* response,
+                          tf_data_ref meta) {
+    (void)(server);
+    (void)(match);
+    
+    if (!tf_docroot_handle((tf_docroot_ref)meta, conn, request, response)) {
+        response->status = 404;
+        response->body.data = tinyhttp_not_found;
+        response->body.length = (tf_index_t)(sizeof(tinyhttp_not_found) - 1);
     }
 }
 
+void tinyhttp_proxy_handle(tf_http_server_ref server,
+                           tf_conn_ref conn,
+                           const tf_http_request_t* request,
+                           const tf_router_match_t* match,
+                           tf_http_response_t* response,
+                           tf_data_ref meta) {
+    (void)(match);
+    
+    tf_proxy_handle(server, conn, request, response, meta);
+}
+
+void tinyhttp_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    TF_LOG_INFO("%.*s %.*s (%u headers, socket %d, worker %u)",
+                (int)request->method.length, request->method.data,
+                (int)request->path.length, request->path.data, request->header_count,
+                tf_conn_get_socket(conn), tf_conn_get_worker_id(conn));
+    
+    tf_router_dispatch(server, conn, request, response, meta);
+}
+
 int main(const int argc, const char** argv) {
-    (void)(argc);
-    (void)(argv);
+    tf_index_t workers = 1;
+    const char* root = NULL;
+    const char* metrics = "/metrics";
+    bool uring = false;
+    tf_index_t pool = 0;
+    uint64_t cache = 0;
+    const char* uploads = NULL;
+    uint64_t max_body = TF_HTTP_SERVER_DEFAULT_MAX_BODY_SIZE;
+    const char* upstreams[TF_PROXY_MAX_UPSTREAMS];
+    tf_index_t upstream_count = 0;
+    tf_index_t max_idle = TF_PROXY_DEFAULT_MAX_IDLE;
+    tf_tcp_listen_options_t listen_options;
+    tf_admit_options_t admit_options;
+    
+    tf_tcp_get_default_listen_options(&listen_options);
+    tf_admit_get_default_options(&admit_options);
+    
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "--workers") == 0 && (index + 1) < argc)
+            workers = (tf_index_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--root") == 0 && (index + 1) < argc)
+            root = argv[++index];
+        else if (strcmp(argv[index], "--metrics") == 0 && (index + 1) < argc)
+            metrics = argv[++index];
+        else if (strcmp(argv[index], "--no-metrics") == 0)
+            metrics = NULL;
+        else if (strcmp(argv[index], "--uring") == 0)
+            uring = true;
+        else if (strcmp(argv[index], "--pool") == 0 && (index + 1) < argc)
+            pool = (tf_index_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--cache") == 0 && (index + 1) < argc)
+            cache = strtoull(argv[++index], NULL, 10);
+        else if (strcmp(argv[index], "--backlog") == 0 && (index + 1) < argc)
+            listen_options.backlog = atoi(argv[++index]);
+        else if (strcmp(argv[index], "--defer-accept") == 0 && (index + 1) < argc)
+            listen_options.defer_accept = atoi(argv[++index]);
+        else if (strcmp(argv[index], "--fastopen") == 0 && (index + 1) < argc)
+            listen_options.fastopen = atoi(argv[++index]);
+        else if (strcmp(argv[index], "--rate") == 0 && (index + 1) < argc)
+            admit_options.client_rate = (uint32_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--burst") == 0 && (index + 1) < argc)
+            admit_options.client_burst = (uint32_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--max-concurrency") == 0 && (index + 1) < argc)
+            admit_options.max_concurrency = (tf_index_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--max-queue-delay") == 0 && (index + 1) < argc)
+            admit_options.max_queue_delay = (tf_index_t)atoi(argv[++index]);
+        else if (strcmp(argv[index], "--uploads") == 0 && (index + 1) < argc)
+            uploads = argv[++index];
+        else if (strcmp(argv[index], "--max-body") == 0 && (index + 1) < argc)
+            max_body = strtoull(argv[++index], NULL, 10);
+        else if (strcmp(argv[index], "--upstream") == 0 && (index + 1) < argc &&
+                 upstream_count < TF_PROXY_MAX_UPSTREAMS)
+            upstreams[upstream_count++] = argv[++index];
+        else if (strcmp(argv[index], "--max-idle") == 0 && (index + 1) < argc)
+            max_idle = (tf_index_t)atoi(argv[++index]);
+        else {
+            fprintf(stderr, "Usage: %s [--workers N] [--root DIR] [--metrics PATH | "
+                    "--no-metrics] [--uring] [--pool N] [--cache BYTES] [--backlog N] "
+                    "[--defer-accept SECONDS] [--fastopen N] [--rate N] [--burst N] "
+                    "[--max-concurrency N] [--max-queue-delay MS] [--uploads DIR] "
+                    "[--max-body BYTES] [--upstream ADDRESS]... [--max-idle N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    
+    tf_docroot_ref docroot = NULL;
+    
+    if (root) {
+        docroot = tf_docroot_init(root, workers, TINYHTTP_DOCROOT_CACHE_SIZE);
+        
+        if (!docroot) {
+            fprintf(stderr, "Cannot serve %s, exiting...\n", root);
+            return 1;
+        }
+    }
+    
+    // the upstream connections count against the same limit as clients
+    tf_http_server_ref server = tf_http_server_init(TF_TCP_IP_LISTEN_ANY, 5643,
+                                                    (upstream_count > 0 ?
+                                                     TINYHTTP_PROXY_MAX_CONNECTIONS : 3),
+                                                    workers);
+    tf_proxy_ref proxy = NULL;
+    
+    if (server && upstream_count > 0) {
+        proxy = tf_proxy_init(server);
+        
+        for (tf_index_t index = 0; index < upstream_count; index++) {
+            if (!tf_proxy_add_upstream(proxy, upstreams[index])) {
+                fprintf(stderr, "Cannot proxy to %s, exiting...\n", upstreams[index]);
+                return 1;
+            }
+        }
+        
+        tf_proxy_set_max_idle(proxy, max_idle);
+    }
+    
+    tf_router_ref router = tf_router_init();
+    
+    tf_router_add(router, "GET", "/hello/:name", tinyhttp_hello_handle, NULL);
+    tf_router_add(router, "GET", "/sleep/:ms", tinyhttp_sleep_handle, NULL);
+    tf_router_add(router, "GET", "/count/:n", tinyhttp_count_handle, NULL);
+    
+    if (uploads)
+        tf_router_add(router, "PUT", "/upload/:name", tinyhttp_upload_handle,
+                      (tf_data_ref)uploads);
+    
+    // everything the routes above don't take goes upstream, any method
+    if (proxy)
+        tf_router_add(router, NULL, "/*path", tinyhttp_proxy_handle, proxy);
+    else if (docroot)
+        tf_router_add(router, "GET", "/*path", tinyhttp_file_handle, docroot);
+    else
+        tf_router_add(router, "GET", "/", tinyhttp_hello_handle, NULL);
+    
+    tf_router_build(router);
+    
+    tf_http_server_set_metrics_path(server, metrics);
+    tf_http_server_set_pool_size(server, pool);
+    tf_http_server_set_cache(server, cache, NULL);
+    tf_http_server_set_admission(server, &admit_options);
+    tf_http_server_set_max_body_size(server, max_body);
+    tf_tcp_set_listen_options(tf_http_server_get_tcp(server), &listen_options);
     
-    tf_tcp_ref tcp = tf_tcp_init(TF_TCP_IP_LISTEN_ANY, 5643, 3);
+    // falls back to the poller on its own if io_uring is not available
+    if (uring)
+        tf_tcp_set_backend(tf_http_server_get_tcp(server), TF_TCP_BACKEND_URING);
     
-    if (!tcp || !tf_tcp_listen(tcp, tinyhttp_listen, NULL)) {
+    if (!server || !tf_http_server_listen(server, tinyhttp_handle, router)) {
         perror("Failed to init, exiting...");
         return 1;
     }
     
-    tf_tcp_release(tcp);
+    tf_http_server_release(server);
+    tf_proxy_release(proxy);
+    tf_router_release(router);
+    tf_docroot_release(docroot);
     return 0;
 }
@@ -0,0 +1,425 @@
+//
+//  metrics.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "privutil.h"
+#include "bufpool.h"
+#include "cache.h"
+#include "pool.h"
+#include "tcp.h"
+#include "metrics.h"
+
+//
+// private
+//
+
+/// smallest histogram bound exported, 256 ns
+#define TF_METRICS_MIN_EXPORTED_BITS 8
+
+struct tf_metrics_s {
+    // allocated one by one, so no two workers share a cache line
+    tf_metrics_worker_t** workers;
+    tf_index_t worker_count;
+    
+    // NULL unless requests can be deferred
+    tf_pool_ref pool;
+    // NULL unless responses are cached
+    tf_cache_ref cache;
+};
+
+// only the owner writes, relaxed stores are plain moves readers can't tear
+#define TF_METRICS_ADD(field, value) \
+    __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+#define TF_METRICS_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+typedef struct {
+    tf_metrics_histogram_t histogram;
+    const char* name;
+    const char* help;
+} tf_metrics_histogram_info_t;
+
+static const tf_metrics_histogram_info_t tf_metrics_histograms[] = {
+    { TF_METRICS_ACCEPT_TO_FIRST_BYTE, "tinyhttp_accept_to_first_byte_seconds",
+      "Time from accepting a connection to sending its first response byte." },
+    { TF_METRICS_PARSE, "tinyhttp_request_parse_seconds",
+      "Time spent in the parser call that completed a request head." },
+    { TF_METRICS_HANDLER, "tinyhttp_handler_seconds",
+      "Time spent in the request handler." },
+    { TF_METRICS_WRITE_DRAIN, "tinyhttp_write_drain_seconds",
+      "Time from queueing responses until the client has taken all of them." },
+    { TF_METRICS_POOL_WAIT, "tinyhttp_pool_wait_seconds",
+      "Time deferred requests waited for a pool thread." }
+};
+
+/// formatted text so far, length keeps counting past the capacity
+typedef struct {
+    char* buffer;
+    tf_index_t capacity;
+    tf_index_t length;
+} tf_metrics_text_t;
+
+void tf_metrics_append(tf_metrics_text_t* text, const char* fmt, ...) {
+    char* target = NULL;
+    size_t space = 0;
+    
+    if (text->length < text->capacity) {
+        target = text->buffer + text->length;
+        space = text->capacity - text->length;
+    }
+    
+    va_list vl;
+    va_start(vl, fmt);
+    int length = vsnprintf(target, space, fmt, vl);
+    va_end(vl);
+    
+    if (length > 0)
+        text->length += (tf_index_t)length;
+}
+
+void tf_metrics_append_counter(tf_metrics_text_t* text, const char* name,
+                               const char* help, const char* type,
+                               const uint64_t value) {
+    tf_metrics_append(text, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name,
+                      type, name, (unsigned long long)value);
+}
+
+void tf_metrics_append_histogram(tf_metrics_text_t* text,
+                                 const tf_metrics_histogram_info_t* info,
+                                 const tf_histogram_t* histogram) {
+    const char* name = info->name;
+    uint64_t total = 0;
+    
+    tf_metrics_append(text, "# HELP %s %s\n# TYPE %s histogram\n", name, info->help,
+                      name);
+    
+    // the bucket bounds only line up with every power of two, which is
+    // plenty of resolution for a scrape
+    for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++) {
+        total += histogram->buckets[bucket];
+        
+        if (bucket < TF_HISTOGRAM_SUB_BUCKETS * (TF_METRICS_MIN_EXPORTED_BITS -
+                                                  TF_HISTOGRAM_SUB_BITS) ||
+            (bucket % TF_HISTOGRAM_SUB_BUCKETS) != TF_HISTOGRAM_SUB_BUCKETS - 1)
+            continue;
+        
+        tf_metrics_append(text, "%s_bucket{le=\"%.9g\"} %llu\n", name,
+                          (double)tf_histogram_get_upper_bound(bucket) / 1e9,
+                          (unsigned long long)total);
+    }
+    
+    tf_metrics_append(text, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9g\n%s_count %llu\n",
+                      name, (unsigned long long)total, name,
+                      (double)histogram->sum / 1e9, name, (unsigned long long)total);
+}
+
+//
+// public
+//
+
+tf_index_t tf_histogram_get_bucket(const uint64_t value) {
+    // buckets hold (lower, upper], hence the - 1
+    uint64_t rest = (value > 0 ? value - 1 : 0);
+    
+    if (rest >= (1ull << TF_HISTOGRAM_MAX_BITS))
+        rest = (1ull << TF_HISTOGRAM_MAX_BITS) - 1;
+    
+    if (rest < TF_HISTOGRAM_SUB_BUCKETS)
+        return (tf_index_t)rest;
+    
+    tf_index_t shift = (tf_index_t)(63 - __builtin_clzll(rest)) - TF_HISTOGRAM_SUB_BITS;
+    
+    return (shift + 1) * TF_HISTOGRAM_SUB_BUCKETS +
+           (tf_index_t)((rest >> shift) & (TF_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+void tf_histogram_record(tf_histogram_t* histogram, const uint64_t value) {
+    tf_index_t bucket = tf_histogram_get_bucket(value);
+    
+    TF_METRICS_ADD(histogram->buckets[bucket], 1);
+    TF_METRICS_ADD(histogram->sum, value);
+}
+
+void tf_histogram_merge(tf_histogram_t* target, const tf_histogram_t* source) {
+    for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++)
+        target->buckets[bucket] += TF_METRICS_LOAD(source->buckets[bucket]);
+    
+    target->sum += TF_METRICS_LOAD(source->sum);
+}
+
+uint64_t tf_histogram_get_upper_bound(const tf_index_t bucket) {
+    if (bucket < TF_HISTOGRAM_SUB_BUCKETS)
+        return bucket + 1;
+    
+    tf_index_t shift = bucket / TF_HISTOGRAM_SUB_BUCKETS - 1;
+    tf_index_t sub = bucket % TF_HISTOGRAM_SUB_BUCKETS;
+    
+    return (uint64_t)(TF_HISTOGRAM_SUB_BUCKETS + sub + 1) << shift;
+}
+
+uint64_t tf_histogram_get_quantile(const tf_histogram_t* histogram, const double quantile) {
+    uint64_t total = 0;
+    
+    for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++)
+        total += histogram->buckets[bucket];
+    
+    if (total < 1)
+        return 0;
+    
+    uint64_t rank = (uint64_t)(quantile * (double)total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    
+    uint64_t seen = 0;
+    
+    for (tf_index_t bucket = 0; bucket < TF_HISTOGRAM_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        
+        if (seen >= rank)
+            return tf_histogram_get_upper_bound(bucket);
+    }
+    
+    return tf_histogram_get_upper_bound(TF_HISTOGRAM_BUCKETS - 1);
+}
+
+tf_metrics_ref tf_metrics_init(const tf_index_t workers) {
+    tf_metrics_ref metrics = tf_struct_alloc(tf_metrics_s);
+    
+    metrics->worker_count = (workers >= 1 ? workers : 1);
+    metrics->workers = calloc(metrics->worker_count, sizeof(tf_metrics_worker_t*));
+    
+    for (tf_index_t index = 0; index < metrics->worker_count; index++)
+        metrics->workers[index] = calloc(1, sizeof(tf_metrics_worker_t));
+    
+    return metrics;
+}
+
+void tf_metrics_count(tf_metrics_ref metrics, const tf_index_t worker,
+                      const tf_metrics_counter_t counter, const uint64_t value) {
+    if (metrics && worker < metrics->worker_count && counter < TF_METRICS_COUNTER_COUNT)
+        TF_METRICS_ADD(metrics->workers[worker]->counters[counter], value);
+}
+
+void tf_metrics_count_close(tf_metrics_ref metrics, const tf_index_t worker,
+                            const tf_tcp_close_reason_t reason) {
+    if (metrics && worker < metrics->worker_count && reason < TF_TCP_CLOSE_REASON_COUNT)
+        TF_METRICS_ADD(metrics->workers[worker]->closed[reason], 1);
+}
+
+void tf_metrics_count_response(tf_metrics_ref metrics, const tf_index_t worker,
+                               const uint16_t status) {
+    tf_index_t class = status / 100;
+    
+    if (metrics && worker < metrics->worker_count && class >= 1 &&
+        class <= TF_METRICS_STATUS_CLASSES)
+        TF_METRICS_ADD(metrics->workers[worker]->responses[class - 1], 1);
+}
+
+void tf_metrics_record(tf_metrics_ref metrics, const tf_index_t worker,
+                       const tf_metrics_histogram_t histogram, const uint64_t value) {
+    if (metrics && worker < metrics->worker_count && histogram < TF_METRICS_HISTOGRAM_COUNT)
+        tf_histogram_record(&metrics->workers[worker]->histograms[histogram], value);
+}
+
+void tf_metrics_record_request(tf_metrics_ref metrics, const tf_index_t worker,
+                               const uint64_t parse, const uint64_t handler,
+                               const uint16_t status) {
+    if (!metrics || worker >= metrics->worker_count)
+        return;
+    
+    tf_metrics_worker_t* own = metrics->workers[worker];
+    tf_index_t class = status / 100;
+    
+    tf_histogram_record(&own->histograms[TF_METRICS_PARSE], parse);
+    tf_histogram_record(&own->histograms[TF_METRICS_HANDLER], handler);
+    TF_METRICS_ADD(own->counters[TF_METRICS_REQUESTS], 1);
+    
+    if (class >= 1 && class <= TF_METRICS_STATUS_CLASSES)
+        TF_METRICS_ADD(own->responses[class - 1], 1);
+}
+
+void tf_metrics_set_pool(tf_metrics_ref metrics, tf_pool_ref pool) {
+    if (metrics)
+        metrics->pool = pool;
+}
+
+void tf_metrics_set_cache(tf_metrics_ref metrics, tf_cache_ref cache) {
+    if (metrics)
+        metrics->cache = cache;
+}
+
+void tf_metrics_get_totals(const tf_metrics_ref metrics, tf_metrics_worker_t* totalsp) {
+    if (!totalsp)
+        return;
+    
+    bzero(totalsp, sizeof(tf_metrics_worker_t));
+    
+    if (!metrics)
+        return;
+    
+    for (tf_index_t index = 0; index < metrics->worker_count; index++) {
+        tf_metrics_worker_t* worker = metrics->workers[index];
+        
+        for (tf_index_t counter = 0; counter < TF_METRICS_COUNTER_COUNT; counter++)
+            totalsp->counters[counter] += TF_METRICS_LOAD(worker->counters[counter]);
+        
+        for (tf_index_t reason = 0; reason < TF_TCP_CLOSE_REASON_COUNT; reason++)
+            totalsp->closed[reason] += TF_METRICS_LOAD(worker->closed[reason]);
+        
+        for (tf_index_t class = 0; class < TF_METRICS_STATUS_CLASSES; class++)
+            totalsp->responses[class] += TF_METRICS_LOAD(worker->responses[class]);
+        
+        for (tf_index_t histogram = 0; histogram < TF_METRICS_HISTOGRAM_COUNT; histogram++)
+            tf_histogram_merge(&totalsp->histograms[histogram], &worker->histograms[histogram]);
+    }
+}
+
+tf_index_t tf_metrics_format(const tf_metrics_ref metrics, char* buffer,
+                             const tf_index_t capacity) {
+    tf_metrics_text_t text = { buffer, capacity, 0 };
+    
+    // ~10 KiB, too much for a reactor thread's stack
+    tf_metrics_worker_t* totals = malloc(sizeof(tf_metrics_worker_t));
+    if (!totals)
+        return 0;
+    
+    tf_metrics_get_totals(metrics, totals);
+    
+    uint64_t* counters = totals->counters;
+    uint64_t closed = 0;
+    
+    for (tf_index_t reason = 0; reason < TF_TCP_CLOSE_REASON_COUNT; reason++)
+        closed += totals->closed[reason];
+    
+    tf_metrics_append_counter(&text, "tinyhttp_connections_accepted_total",
+                              "Connections accepted.", "counter",
+                              counters[TF_METRICS_CONNECTIONS_ACCEPTED]);
+    tf_metrics_append_counter(&text, "tinyhttp_connections_rejected_total",
+                              "Connections dropped right after accepting them.", "counter",
+                              counters[TF_METRICS_CONNECTIONS_REJECTED]);
+    tf_metrics_append_counter(&text, "tinyhttp_connections_open",
+                              "Connections currently open.", "gauge",
+                              counters[TF_METRICS_CONNECTIONS_ACCEPTED] - closed);
+    
+    tf_metrics_append(&text, "# HELP tinyhttp_connections_closed_total Connections closed "
+                      "by reason.\n# TYPE tinyhttp_connections_closed_total counter\n");
+    
+    for (tf_index_t reason = 0; reason < TF_TCP_CLOSE_REASON_COUNT; reason++)
+        tf_metrics_append(&text, "tinyhttp_connections_closed_total{reason=\"%s\"} %llu\n",
+                          tf_tcp_close_reason_get_name((tf_tcp_close_reason_t)reason),
+                          (unsigned long long)totals->closed[reason]);
+    
+    tf_metrics_append_counter(&text, "tinyhttp_requests_total", "Requests handled.",
+                              "counter", counters[TF_METRICS_REQUESTS]);
+    tf_metrics_append_counter(&text, "tinyhttp_requests_deferred_total",
+                              "Requests answered by the thread pool.", "counter",
+                              counters[TF_METRICS_REQUESTS_DEFERRED]);
+    tf_metrics_append_counter(&text, "tinyhttp_requests_throttled_total",
+                              "Requests refused by the per-client rate limit.", "counter",
+                              counters[TF_METRICS_REQUESTS_THROTTLED]);
+    tf_metrics_append_counter(&text, "tinyhttp_requests_shed_total",
+                              "Requests refused under load.", "counter",
+                              counters[TF_METRICS_REQUESTS_SHED]);
+    
+    tf_metrics_append(&text, "# HELP tinyhttp_responses_total Responses by status class."
+                      "\n# TYPE tinyhttp_responses_total counter\n");
+    
+    for (tf_index_t class = 0; class < TF_METRICS_STATUS_CLASSES; class++)
+        tf_metrics_append(&text, "tinyhttp_responses_total{code=\"%uxx\"} %llu\n", class + 1,
+                          (unsigned long long)totals->responses[class]);
+    
+    tf_metrics_append_counter(&text, "tinyhttp_received_bytes_total",
+                              "Bytes read from clients.", "counter",
+                              counters[TF_METRICS_BYTES_RECEIVED]);
+    tf_metrics_append_counter(&text, "tinyhttp_sent_bytes_total", "Bytes sent to clients.",
+                              "counter", counters[TF_METRICS_BYTES_SENT]);
+    
+    for (tf_index_t index = 0; index < TF_METRICS_HISTOGRAM_COUNT; index++) {
+        const tf_metrics_histogram_info_t* info = tf_metrics_histograms + index;
+        tf_metrics_append_histogram(&text, info, &totals->histograms[info->histogram]);
+    }
+    
+    tf_bufpool_stats_t pool;
+    tf_bufpool_get_stats(&pool);
+    
+    tf_metrics_append_counter(&text, "tinyhttp_bufpool_hits_total",
+                              "Buffers handed out from the pool.", "counter", pool.hits);
+    tf_metrics_append_counter(&text, "tinyhttp_bufpool_misses_total",
+                              "Buffers that had to be allocated.", "counter", pool.misses);
+    tf_metrics_append_counter(&text, "tinyhttp_bufpool_outstanding_buffers",
+                              "Buffers currently in use.", "gauge",
+                              pool.outstanding_buffers);
+    tf_metrics_append_counter(&text, "tinyhttp_bufpool_outstanding_bytes",
+                              "Bytes of buffers currently in use.", "gauge",
+                              pool.outstanding_bytes);
+    
+    if (metrics && metrics->pool) {
+        tf_pool_stats_t jobs;
+        tf_pool_get_stats(metrics->pool, &jobs);
+        
+        tf_metrics_append_counter(&text, "tinyhttp_pool_threads", "Thread pool size.",
+                                  "gauge", jobs.threads);
+        tf_metrics_append_counter(&text, "tinyhttp_pool_queued_jobs",
+                                  "Jobs waiting for a pool thread.", "gauge", jobs.queued);
+        tf_metrics_append_counter(&text, "tinyhttp_pool_running_jobs",
+                                  "Jobs being run by pool threads.", "gauge", jobs.running);
+        tf_metrics_append_counter(&text, "tinyhttp_pool_completed_total",
+                                  "Jobs run by the pool.", "counter", jobs.completed);
+        tf_metrics_append_counter(&text, "tinyhttp_pool_stolen_total",
+                                  "Jobs taken from another pool thread's queue.", "counter",
+                                  jobs.stolen);
+        tf_metrics_append_counter(&text, "tinyhttp_pool_rejected_total",
+                                  "Jobs refused because the pool queues were full.",
+                                  "counter", jobs.rejected);
+    }
+    
+    if (metrics && metrics->cache) {
+        tf_cache_stats_t cache;
+        tf_cache_get_stats(metrics->cache, &cache);
+        
+        tf_metrics_append_counter(&text, "tinyhttp_cache_hits_total",
+                                  "Requests answered from the response cache.", "counter",
+                                  cache.hits);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_misses_total",
+                                  "Cacheable requests not found in the response cache.",
+                                  "counter", cache.misses);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_inserts_total",
+                                  "Responses stored in the response cache.", "counter",
+                                  cache.inserts);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_evictions_total",
+                                  "Cached responses dropped to make room.", "counter",
+                                  cache.evictions);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_expirations_total",
+                                  "Cached responses dropped after their TTL.", "counter",
+                                  cache.expirations);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_entries",
+                                  "Responses in the response cache.", "gauge", cache.entries);
+        tf_metrics_append_counter(&text, "tinyhttp_cache_bytes",
+                                  "Memory taken by the response cache.", "gauge", cache.bytes);
+    }
+    
+    tf_metrics_append_counter(&text, "tinyhttp_log_dropped_total",
+                              "Log messages dropped because a log buffer was full.",
+                              "counter", tf_log_get_dropped_count());
+    
+    free(totals);
+    return text.length;
+}
+
+void tf_metrics_release(tf_metrics_ref metrics) {
+    if (!metrics)
+        return;
+    
+    for (tf_index_t index = 0; index < metrics->worker_count; index++)
+        free(metrics->workers[index]);
+    
+    free(metrics->workers);
+    free(metrics);
+}
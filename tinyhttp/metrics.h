@@ -0,0 +1,131 @@
+//
+//  metrics.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// server metrics
+//
+// every worker records into its own counters and histograms, only the
+// owner ever writes them (plain relaxed stores, no locks, no atomic
+// read-modify-writes), readers add up all the workers at once
+//
+// histograms are log-linear like HdrHistogram: every power of two is split
+// into TF_HISTOGRAM_SUB_BUCKETS buckets, so a bucket is never wider than
+// 1/TF_HISTOGRAM_SUB_BUCKETS of the values it holds, whatever their size
+//
+
+#define TF_HISTOGRAM_SUB_BITS 3
+#define TF_HISTOGRAM_SUB_BUCKETS (1 << TF_HISTOGRAM_SUB_BITS)
+/// bigger values are counted as 2^TF_HISTOGRAM_MAX_BITS (18 minutes in ns)
+#define TF_HISTOGRAM_MAX_BITS 40
+#define TF_HISTOGRAM_BUCKETS ((TF_HISTOGRAM_MAX_BITS - TF_HISTOGRAM_SUB_BITS + 1) * \
+                              TF_HISTOGRAM_SUB_BUCKETS)
+
+/// bucket i holds the values above the upper bound of bucket i - 1 up to
+/// and including its own, see tf_histogram_get_upper_bound
+typedef struct {
+    uint64_t buckets[TF_HISTOGRAM_BUCKETS];
+    // the count is the sum of the buckets, not kept to save a store
+    uint64_t sum;
+} tf_histogram_t;
+
+/// single writer only
+void tf_histogram_record(tf_histogram_t* histogram, const uint64_t value);
+/// adds source to target, source may be written to meanwhile
+void tf_histogram_merge(tf_histogram_t* target, const tf_histogram_t* source);
+
+/// bucket the value is counted in
+tf_index_t tf_histogram_get_bucket(const uint64_t value);
+uint64_t tf_histogram_get_upper_bound(const tf_index_t bucket);
+/// upper bound of the bucket holding the given quantile (0...1), 0 if empty
+uint64_t tf_histogram_get_quantile(const tf_histogram_t* histogram, const double quantile);
+
+/// timings, all of them in nanoseconds
+typedef enum {
+    // connection accepted until the first response byte went out
+    TF_METRICS_ACCEPT_TO_FIRST_BYTE,
+    // parser call that completed a request head
+    TF_METRICS_PARSE,
+    // request handler call
+    TF_METRICS_HANDLER,
+    // responses queued until the client took all of them
+    TF_METRICS_WRITE_DRAIN,
+    // deferred request queued until a pool thread picked it up
+    TF_METRICS_POOL_WAIT,
+    TF_METRICS_HISTOGRAM_COUNT
+} tf_metrics_histogram_t;
+
+typedef enum {
+    TF_METRICS_CONNECTIONS_ACCEPTED,
+    // accepted, but the worker could not take them
+    TF_METRICS_CONNECTIONS_REJECTED,
+    TF_METRICS_REQUESTS,
+    // answered by the thread pool (see tf_http_server_defer)
+    TF_METRICS_REQUESTS_DEFERRED,
+    // refused by the per-client rate limit (see admit.h)
+    TF_METRICS_REQUESTS_THROTTLED,
+    // refused with the server at its concurrency cap or after waiting too
+    // long for the pool
+    TF_METRICS_REQUESTS_SHED,
+    TF_METRICS_BYTES_RECEIVED,
+    TF_METRICS_BYTES_SENT,
+    TF_METRICS_COUNTER_COUNT
+} tf_metrics_counter_t;
+
+/// response status classes, 1xx to 5xx
+#define TF_METRICS_STATUS_CLASSES 5
+
+/// one set of everything per worker
+typedef struct {
+    uint64_t counters[TF_METRICS_COUNTER_COUNT];
+    uint64_t closed[TF_TCP_CLOSE_REASON_COUNT];
+    uint64_t responses[TF_METRICS_STATUS_CLASSES];
+    
+    tf_histogram_t histograms[TF_METRICS_HISTOGRAM_COUNT];
+} tf_metrics_worker_t;
+
+tf_metrics_ref tf_metrics_init(const tf_index_t workers);
+
+/// recording, only to be called from the given worker's thread
+void tf_metrics_count(tf_metrics_ref metrics, const tf_index_t worker,
+                      const tf_metrics_counter_t counter, const uint64_t value);
+void tf_metrics_count_close(tf_metrics_ref metrics, const tf_index_t worker,
+                            const tf_tcp_close_reason_t reason);
+void tf_metrics_count_response(tf_metrics_ref metrics, const tf_index_t worker,
+                               const uint16_t status);
+void tf_metrics_record(tf_metrics_ref metrics, const tf_index_t worker,
+                       const tf_metrics_histogram_t histogram, const uint64_t value);
+/// everything a handled request adds, parse and handler timings, the request
+/// and its response status, in one go
+void tf_metrics_record_request(tf_metrics_ref metrics, const tf_index_t worker,
+                               const uint64_t parse, const uint64_t handler,
+                               const uint16_t status);
+
+/// thread pool whose queue depth and job counts go into tf_metrics_format,
+/// has to outlive the metrics
+void tf_metrics_set_pool(tf_metrics_ref metrics, tf_pool_ref pool);
+
+/// response cache whose hit/miss counters and size go into
+/// tf_metrics_format, has to outlive the metrics
+void tf_metrics_set_cache(tf_metrics_ref metrics, tf_cache_ref cache);
+
+/// sums of all the workers, can be called from any thread
+void tf_metrics_get_totals(const tf_metrics_ref metrics, tf_metrics_worker_t* totalsp);
+
+///
+/// all the metrics (buffer pool, thread pool, response cache and logger included) in the Prometheus text
+/// exposition format, returns the length of the whole text like snprintf
+/// does, only writes as much of it as fits into capacity
+///
+tf_index_t tf_metrics_format(const tf_metrics_ref metrics, char* buffer,
+                             const tf_index_t capacity);
+
+void tf_metrics_release(tf_metrics_ref metrics);
@@ -0,0 +1,268 @@
+//
+//  poller.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "privutil.h"
+#include "poller.h"
+
+#ifdef TF_POLLER_EPOLL
+#include <sys/epoll.h>
+#else
+#include <sys/select.h>
+#endif
+
+//
+// private
+//
+
+struct tf_poller_s {
+#ifdef TF_POLLER_EPOLL
+    // epoll instance descriptor
+    int epoll_desc;
+    // scratch buffer for epoll_wait
+    struct epoll_event raw_events[TF_POLLER_MAX_EVENTS];
+#else
+    // sockets tracked for reading/writing
+    fd_set read_descs;
+    fd_set write_descs;
+    // sockets added and not removed yet, whatever their flags, a paused
+    // socket waits for nothing but is still tracked
+    fd_set added_descs;
+    
+    // highest tracked socket, -1 if none
+    tf_socket_t max_socket;
+#endif
+};
+
+#ifdef TF_POLLER_EPOLL
+
+uint32_t tf_poller_flags_to_epoll(const uint32_t flags) {
+    // always edge-triggered, peer hangups are reported as readability so
+    // that the read path sees the EOF
+    uint32_t result = EPOLLET | EPOLLRDHUP;
+    
+    if (flags & TF_POLLER_READABLE)
+        result |= EPOLLIN;
+    if (flags & TF_POLLER_WRITABLE)
+        result |= EPOLLOUT;
+    
+    return result;
+}
+
+bool tf_poller_ctl(tf_poller_ref poller, const int op, tf_socket_t socket,
+                   const uint32_t flags) {
+    struct epoll_event ev;
+    bzero(&ev, sizeof(struct epoll_event));
+    
+    ev.events = tf_poller_flags_to_epoll(flags);
+    ev.data.fd = socket;
+    
+    if (epoll_ctl(poller->epoll_desc, op, socket, &ev) < 0) {
+        TF_LOG_WARN("epoll_ctl(%d) failed for socket %d, errno = %s", op, socket,
+                    strerror(errno));
+        return false;
+    }
+    
+    return true;
+}
+
+#else
+
+void tf_poller_set_flags(tf_poller_ref poller, tf_socket_t socket,
+                         const uint32_t flags) {
+    if (flags & TF_POLLER_READABLE)
+        FD_SET(socket, &poller->read_descs);
+    else
+        FD_CLR(socket, &poller->read_descs);
+    
+    if (flags & TF_POLLER_WRITABLE)
+        FD_SET(socket, &poller->write_descs);
+    else
+        FD_CLR(socket, &poller->write_descs);
+}
+
+#endif
+
+//
+// public
+//
+
+tf_poller_ref tf_poller_init(void) {
+    tf_poller_ref poller = tf_struct_alloc(tf_poller_s);
+    
+#ifdef TF_POLLER_EPOLL
+    poller->epoll_desc = epoll_create1(EPOLL_CLOEXEC);
+    
+    if (poller->epoll_desc < 0) {
+        TF_LOG_ERROR("epoll_create1 failed, errno = %s", strerror(errno));
+        
+        free(poller);
+        return NULL;
+    }
+#else
+    FD_ZERO(&poller->read_descs);
+    FD_ZERO(&poller->write_descs);
+    FD_ZERO(&poller->added_descs);
+    poller->max_socket = -1;
+#endif
+    
+    return poller;
+}
+
+bool tf_poller_add(tf_poller_ref poller, tf_socket_t socket,
+                   const uint32_t flags) {
+    if (!poller || socket < 0)
+        return false;
+    
+#ifdef TF_POLLER_EPOLL
+    return tf_poller_ctl(poller, EPOLL_CTL_ADD, socket, flags);
+#else
+    if (socket >= FD_SETSIZE) {
+        TF_LOG_WARN("socket %d does not fit into fd_set (FD_SETSIZE = %d)", socket,
+                    FD_SETSIZE);
+        return false;
+    }
+    
+    tf_poller_set_flags(poller, socket, flags);
+    FD_SET(socket, &poller->added_descs);
+    poller->max_socket = tf_keep_greater(poller->max_socket, socket);
+    
+    return true;
+#endif
+}
+
+bool tf_poller_modify(tf_poller_ref poller, tf_socket_t socket,
+                      const uint32_t flags) {
+    if (!poller || socket < 0)
+        return false;
+    
+#ifdef TF_POLLER_EPOLL
+    return tf_poller_ctl(poller, EPOLL_CTL_MOD, socket, flags);
+#else
+    if (socket > poller->max_socket || !FD_ISSET(socket, &poller->added_descs))
+        return false; // never added
+    
+    tf_poller_set_flags(poller, socket, flags);
+    return true;
+#endif
+}
+
+bool tf_poller_remove(tf_poller_ref poller, tf_socket_t socket) {
+    if (!poller || socket < 0)
+        return false;
+    
+#ifdef TF_POLLER_EPOLL
+    return tf_poller_ctl(poller, EPOLL_CTL_DEL, socket, 0);
+#else
+    if (socket > poller->max_socket || !FD_ISSET(socket, &poller->added_descs))
+        return false;
+    
+    tf_poller_set_flags(poller, socket, 0);
+    FD_CLR(socket, &poller->added_descs);
+    
+    // shrink the scan range if the topmost socket went away
+    while (poller->max_socket >= 0 && !FD_ISSET(poller->max_socket, &poller->added_descs))
+        poller->max_socket--;
+    
+    return true;
+#endif
+}
+
+int tf_poller_wait(tf_poller_ref poller, tf_poller_event_t* events,
+                   const tf_index_t max_events, const int timeout_ms) {
+    if (!poller || !events || max_events < 1)
+        return -1;
+    
+#ifdef TF_POLLER_EPOLL
+    int limit = (int)((max_events < TF_POLLER_MAX_EVENTS) ? max_events :
+                                                            TF_POLLER_MAX_EVENTS);
+    int count = epoll_wait(poller->epoll_desc, poller->raw_events, limit,
+                           timeout_ms);
+    
+    if (count < 0)
+        return (errno == EINTR ? 0 : -1);
+    
+    for (int index = 0; index < count; index++) {
+        uint32_t raw = poller->raw_events[index].events;
+        uint32_t flags = 0;
+        
+        if (raw & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            flags |= TF_POLLER_READABLE;
+        if (raw & EPOLLOUT)
+            flags |= TF_POLLER_WRITABLE;
+        if (raw & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            flags |= TF_POLLER_HANGUP;
+        
+        events[index].socket = poller->raw_events[index].data.fd;
+        events[index].flags = flags;
+    }
+    
+    return count;
+#else
+    // select() modifies the sets in place, so work on copies
+    fd_set rdescs = poller->read_descs;
+    fd_set wdescs = poller->write_descs;
+    
+    struct timeval tv;
+    struct timeval* tvp = NULL;
+    
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        tvp = &tv;
+    }
+    
+    int ready = select(poller->max_socket + 1, &rdescs, &wdescs, NULL, tvp);
+    if (ready < 0)
+        return (errno == EINTR ? 0 : -1);
+    
+    int count = 0;
+    
+    for (tf_socket_t socket = 0; socket <= poller->max_socket && ready > 0 &&
+                                 count < (int)max_events; socket++) {
+        uint32_t flags = 0;
+        
+        if (FD_ISSET(socket, &rdescs))
+            flags |= TF_POLLER_READABLE;
+        if (FD_ISSET(socket, &wdescs))
+            flags |= TF_POLLER_WRITABLE;
+        
+        if (flags) {
+            events[count].socket = socket;
+            events[count].flags = flags;
+            
+            count++;
+            ready--;
+        }
+    }
+    
+    return count;
+#endif
+}
+
+const char* tf_poller_get_backend_name(void) {
+#ifdef TF_POLLER_EPOLL
+    return "epoll";
+#else
+    return "select";
+#endif
+}
+
+void tf_poller_release(tf_poller_ref poller) {
+    if (!poller)
+        return;
+    
+#ifdef TF_POLLER_EPOLL
+    close(poller->epoll_desc);
+#endif
+    
+    free(poller);
+}
@@ -0,0 +1,62 @@
+//
+//  poller.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// readiness notification backend
+//
+// epoll (edge-triggered) is used on Linux, select() everywhere else or
+// when TF_POLLER_USE_SELECT is defined at compile time
+//
+
+#if defined(__linux__) && !defined(TF_POLLER_USE_SELECT)
+#define TF_POLLER_EPOLL 1
+#endif
+
+/// max amount of events returned by a single tf_poller_wait call
+#define TF_POLLER_MAX_EVENTS 256
+
+/// wait forever in tf_poller_wait
+#define TF_POLLER_WAIT_FOREVER -1
+
+/// single readiness event
+typedef struct {
+    tf_socket_t socket;
+    // combination of tf_poller_flags_t
+    uint32_t flags;
+} tf_poller_event_t;
+
+tf_poller_ref tf_poller_init(void);
+
+/// starts tracking the specified socket, returns false if the backend
+/// cannot handle it (for example, select() and sockets >= FD_SETSIZE)
+bool tf_poller_add(tf_poller_ref poller, tf_socket_t socket,
+                   const uint32_t flags);
+/// changes the set of events the specified socket is tracked for
+bool tf_poller_modify(tf_poller_ref poller, tf_socket_t socket,
+                      const uint32_t flags);
+/// stops tracking the specified socket, must be called before close()
+bool tf_poller_remove(tf_poller_ref poller, tf_socket_t socket);
+
+///
+/// waits for readiness events, returns the amount of events written to
+/// the events array (0 on timeout) or -1 on failure
+///
+/// with the epoll backend events are edge-triggered, so the caller must
+/// read/accept until EAGAIN before waiting again
+///
+int tf_poller_wait(tf_poller_ref poller, tf_poller_event_t* events,
+                   const tf_index_t max_events, const int timeout_ms);
+
+/// human-readable name of the compiled-in backend
+const char* tf_poller_get_backend_name(void);
+
+void tf_poller_release(tf_poller_ref poller);
@@ -0,0 +1,418 @@
+//
+//  pool.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#include "privutil.h"
+#include "pool.h"
+
+//
+// private
+//
+
+#define TF_POOL_QUEUE_MASK (TF_POOL_QUEUE_SIZE - 1)
+
+struct tf_mailbox_s {
+    // posted tasks, newest first
+    tf_task_t* head;
+    // the owner has been woken up and hasn't run the tasks yet
+    bool signalled;
+    
+    // readable end, the same as the writable one for an eventfd
+    int descriptor;
+    int wakeup;
+};
+
+/// bounded FIFO of one pool thread, padded so neighbours don't share lines
+typedef struct {
+    pthread_mutex_t lock;
+    tf_index_t head;
+    tf_index_t tail;
+    tf_pool_job_t* jobs[TF_POOL_QUEUE_SIZE];
+    char pad[64];
+} tf_pool_queue_t;
+
+typedef struct tf_pool_thread_s* tf_pool_thread_ref;
+struct tf_pool_thread_s {
+    tf_pool_ref pool;
+    tf_index_t id;
+    
+    pthread_t thread;
+    bool started;
+};
+
+struct tf_pool_s {
+    tf_pool_queue_t* queues;
+    tf_pool_thread_ref threads;
+    tf_index_t thread_count;
+    // next queue to submit to
+    tf_index_t next;
+    
+    // jobs in all the queues, decides whether a thread may go to sleep
+    uint64_t pending;
+    uint64_t running;
+    // threads about to sleep or sleeping, written under lock
+    tf_index_t sleepers;
+    bool stopping;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t stolen;
+    uint64_t rejected;
+};
+
+bool tf_pool_queue_push(tf_pool_queue_t* queue, tf_pool_job_t* job) {
+    bool pushed = false;
+    
+    pthread_mutex_lock(&queue->lock);
+    
+    if (queue->tail - queue->head < TF_POOL_QUEUE_SIZE) {
+        queue->jobs[queue->tail++ & TF_POOL_QUEUE_MASK] = job;
+        pushed = true;
+    }
+    
+    pthread_mutex_unlock(&queue->lock);
+    return pushed;
+}
+
+tf_pool_job_t* tf_pool_queue_pop(tf_pool_queue_t* queue) {
+    tf_pool_job_t* job = NULL;
+    
+    // peeking saves the lock on empty queues, a miss is caught by pending
+    if (__atomic_load_n(&queue->head, __ATOMIC_RELAXED) ==
+        __atomic_load_n(&queue->tail, __ATOMIC_RELAXED))
+        return NULL;
+    
+    pthread_mutex_lock(&queue->lock);
+    
+    if (queue->head != queue->tail)
+        job = queue->jobs[queue->head++ & TF_POOL_QUEUE_MASK];
+    
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+/// the oldest job of the thread's own queue, of the others' otherwise
+tf_pool_job_t* tf_pool_take(tf_pool_ref pool, const tf_index_t id) {
+    tf_pool_job_t* job = tf_pool_queue_pop(pool->queues + id);
+    
+    for (tf_index_t offset = 1; !job && offset < pool->thread_count; offset++) {
+        job = tf_pool_queue_pop(pool->queues + (id + offset) % pool->thread_count);
+        
+        if (job)
+            __atomic_add_fetch(&pool->stolen, 1, __ATOMIC_RELAXED);
+    }
+    
+    if (job)
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    
+    return job;
+}
+
+void tf_pool_run_job(tf_pool_ref pool, tf_pool_job_t* job) {
+    __atomic_add_fetch(&pool->running, 1, __ATOMIC_RELAXED);
+    
+    job->started_at = tf_monotonic_ns();
+    job->run(job->data);
+    job->finished_at = tf_monotonic_ns();
+    
+    __atomic_sub_fetch(&pool->running, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->completed, 1, __ATOMIC_RELAXED);
+    
+    // the job may be gone right after this
+    if (job->mailbox)
+        tf_mailbox_post(job->mailbox, &job->complete);
+}
+
+void* tf_pool_thread_run(void* arg) {
+    tf_pool_thread_ref thread = (tf_pool_thread_ref)arg;
+    tf_pool_ref pool = thread->pool;
+    
+    while (true) {
+        tf_pool_job_t* job = tf_pool_take(pool, thread->id);
+        
+        if (job) {
+            tf_pool_run_job(pool, job);
+            continue;
+        }
+        
+        pthread_mutex_lock(&pool->lock);
+        
+        // announced before looking at pending, a submitter either sees the
+        // sleeper or the sleeper sees its job
+        __atomic_store_n(&pool->sleepers, pool->sleepers + 1, __ATOMIC_SEQ_CST);
+        
+        while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) < 1 && !pool->stopping)
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        
+        __atomic_store_n(&pool->sleepers, pool->sleepers - 1, __ATOMIC_SEQ_CST);
+        
+        bool done = (pool->stopping && __atomic_load_n(&pool->pending,
+                                                       __ATOMIC_SEQ_CST) < 1);
+        
+        pthread_mutex_unlock(&pool->lock);
+        
+        if (done)
+            break;
+    }
+    
+    return NULL;
+}
+
+//
+// public
+//
+
+tf_mailbox_ref tf_mailbox_init(void) {
+    tf_mailbox_ref mailbox = tf_struct_alloc(tf_mailbox_s);
+    if (!mailbox)
+        return NULL;
+    
+#if defined(__linux__)
+    mailbox->descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mailbox->wakeup = mailbox->descriptor;
+    
+    if (mailbox->descriptor < 0) {
+        free(mailbox);
+        return NULL;
+    }
+#else
+    int ends[2];
+    
+    if (pipe(ends) < 0) {
+        free(mailbox);
+        return NULL;
+    }
+    
+    for (tf_index_t index = 0; index < 2; index++) {
+        fcntl(ends[index], F_SETFL, fcntl(ends[index], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(ends[index], F_SETFD, FD_CLOEXEC);
+    }
+    
+    mailbox->descriptor = ends[0];
+    mailbox->wakeup = ends[1];
+#endif
+    
+    return mailbox;
+}
+
+void tf_mailbox_post(tf_mailbox_ref mailbox, tf_task_t* task) {
+    tf_task_t* head = __atomic_load_n(&mailbox->head, __ATOMIC_RELAXED);
+    
+    do {
+        task->next = head;
+    } while (!__atomic_compare_exchange_n(&mailbox->head, &head, task, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    
+    // a single write per batch, the owner clears the flag before taking
+    // the list, so whatever comes in after that writes again
+    if (__atomic_load_n(&mailbox->signalled, __ATOMIC_SEQ_CST) ||
+        __atomic_exchange_n(&mailbox->signalled, true, __ATOMIC_SEQ_CST))
+        return;
+    
+#if defined(__linux__)
+    uint64_t one = 1;
+#else
+    char one = 1;
+#endif
+    
+    // a full pipe is readable anyway
+    while (write(mailbox->wakeup, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+int tf_mailbox_get_descriptor(const tf_mailbox_ref mailbox) {
+    return (mailbox ? mailbox->descriptor : -1);
+}
+
+tf_index_t tf_mailbox_run(tf_mailbox_ref mailbox) {
+    char drain[64];
+    tf_index_t count = 0;
+    
+    // an eventfd is reset by a single read, a pipe until it's empty
+    while (read(mailbox->descriptor, drain, sizeof(drain)) > 0 &&
+           mailbox->descriptor != mailbox->wakeup);
+    
+    __atomic_store_n(&mailbox->signalled, false, __ATOMIC_SEQ_CST);
+    
+    tf_task_t* task = __atomic_exchange_n(&mailbox->head, NULL, __ATOMIC_SEQ_CST);
+    tf_task_t* ordered = NULL;
+    
+    // newest first, reversed into posting order
+    while (task) {
+        tf_task_t* next = task->next;
+        
+        task->next = ordered;
+        ordered = task;
+        task = next;
+    }
+    
+    while (ordered) {
+        tf_task_t* next = ordered->next;
+        
+        // the task may free itself
+        ordered->run(ordered->data);
+        ordered = next;
+        count++;
+    }
+    
+    return count;
+}
+
+void tf_mailbox_release(tf_mailbox_ref mailbox) {
+    if (!mailbox)
+        return;
+    
+    if (mailbox->wakeup != mailbox->descriptor)
+        close(mailbox->wakeup);
+    
+    close(mailbox->descriptor);
+    free(mailbox);
+}
+
+tf_pool_ref tf_pool_init(const tf_index_t threads) {
+    if (threads < 1)
+        return NULL;
+    
+    tf_pool_ref pool = tf_struct_alloc(tf_pool_s);
+    if (!pool)
+        return NULL;
+    
+    pool->queues = calloc(threads, sizeof(tf_pool_queue_t));
+    pool->threads = calloc(threads, sizeof(struct tf_pool_thread_s));
+    
+    if (!pool->queues || !pool->threads) {
+        free(pool->queues);
+        free(pool->threads);
+        free(pool);
+        
+        return NULL;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+    
+    for (tf_index_t index = 0; index < threads; index++)
+        pthread_mutex_init(&pool->queues[index].lock, NULL);
+    
+    // the pool threads must not take any signals meant for the process
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    
+    for (tf_index_t index = 0; index < threads; index++) {
+        tf_pool_thread_ref thread = pool->threads + pool->thread_count;
+        
+        thread->pool = pool;
+        thread->id = pool->thread_count;
+        
+        if (pthread_create(&thread->thread, NULL, tf_pool_thread_run, thread) != 0) {
+            TF_LOG_WARN("Cannot start pool thread %u, continuing without it", index);
+            continue;
+        }
+        
+        thread->started = true;
+        pool->thread_count++;
+    }
+    
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    
+    if (pool->thread_count < 1) {
+        tf_pool_release(pool);
+        return NULL;
+    }
+    
+    return pool;
+}
+
+bool tf_pool_submit(tf_pool_ref pool, tf_pool_job_t* job) {
+    if (!pool || !job || !job->run)
+        return false;
+    
+    tf_index_t first = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+    bool queued = false;
+    
+    job->queued_at = tf_monotonic_ns();
+    job->started_at = 0;
+    job->finished_at = 0;
+    
+    // the next queue in turn, any other one if that's full
+    for (tf_index_t offset = 0; !queued && offset < pool->thread_count; offset++)
+        queued = tf_pool_queue_push(pool->queues + (first + offset) % pool->thread_count,
+                                    job);
+    
+    if (!queued) {
+        __atomic_add_fetch(&pool->rejected, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    
+    __atomic_add_fetch(&pool->submitted, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    
+    // the lock is only taken while some thread is idle
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wakeup);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    
+    return true;
+}
+
+void tf_pool_get_stats(const tf_pool_ref pool, tf_pool_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    bzero(statsp, sizeof(tf_pool_stats_t));
+    
+    if (!pool)
+        return;
+    
+    statsp->threads = pool->thread_count;
+    statsp->queued = __atomic_load_n(&pool->pending, __ATOMIC_RELAXED);
+    statsp->running = __atomic_load_n(&pool->running, __ATOMIC_RELAXED);
+    statsp->submitted = __atomic_load_n(&pool->submitted, __ATOMIC_RELAXED);
+    statsp->completed = __atomic_load_n(&pool->completed, __ATOMIC_RELAXED);
+    statsp->stolen = __atomic_load_n(&pool->stolen, __ATOMIC_RELAXED);
+    statsp->rejected = __atomic_load_n(&pool->rejected, __ATOMIC_RELAXED);
+}
+
+void tf_pool_release(tf_pool_ref pool) {
+    if (!pool)
+        return;
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for (tf_index_t index = 0; index < pool->thread_count; index++) {
+        if (pool->threads[index].started)
+            pthread_join(pool->threads[index].thread, NULL);
+    }
+    
+    for (tf_index_t index = 0; index < pool->thread_count; index++)
+        pthread_mutex_destroy(&pool->queues[index].lock);
+    
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->lock);
+    
+    free(pool->queues);
+    free(pool->threads);
+    free(pool);
+}
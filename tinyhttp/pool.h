@@ -0,0 +1,100 @@
+//
+//  pool.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// thread pool for work that would block a reactor
+//
+// every pool thread has a bounded queue of its own, jobs are spread over
+// the queues round-robin, a thread takes the oldest job of its own queue
+// first and steals the oldest one of another queue otherwise, so a single
+// slow job never holds up the ones queued behind it while some thread is
+// idle
+//
+// a finished job is handed back to whoever submitted it through a mailbox:
+// a lock-free multi-producer single-consumer list of tasks plus a
+// descriptor (eventfd on Linux, a pipe elsewhere) that becomes readable
+// once something has been posted, for the owner's event loop to watch
+//
+
+/// jobs each pool thread queue can hold
+#define TF_POOL_QUEUE_SIZE 1024
+
+typedef void (*tf_task_function_t)(tf_data_ref);
+
+/// something to be run on the mailbox owner's thread, owned by the poster
+typedef struct tf_task_s tf_task_t;
+struct tf_task_s {
+    tf_task_function_t run;
+    tf_data_ref data;
+    
+    // used by the mailbox while the task is posted
+    tf_task_t* next;
+};
+
+tf_mailbox_ref tf_mailbox_init(void);
+
+/// can be called from any thread, the owner is only woken up once until
+/// it runs what's been posted
+void tf_mailbox_post(tf_mailbox_ref mailbox, tf_task_t* task);
+
+/// readable whenever there are posted tasks, never to be read from directly
+int tf_mailbox_get_descriptor(const tf_mailbox_ref mailbox);
+
+/// owner thread only, runs everything posted so far in the order it was
+/// posted, returns how many tasks were run
+tf_index_t tf_mailbox_run(tf_mailbox_ref mailbox);
+
+/// tasks still posted are not run
+void tf_mailbox_release(tf_mailbox_ref mailbox);
+
+/// unit of work, owned by the submitter and has to stay around until
+/// complete has been run (or run has returned if there's no mailbox)
+typedef struct {
+    // runs on a pool thread
+    tf_task_function_t run;
+    tf_data_ref data;
+    
+    // posted here right after run, not at all if NULL
+    tf_mailbox_ref mailbox;
+    tf_task_t complete;
+    
+    // monotonic nanoseconds, set by the pool
+    uint64_t queued_at;
+    uint64_t started_at;
+    uint64_t finished_at;
+} tf_pool_job_t;
+
+/// pool state, read without stopping anything so only roughly consistent
+typedef struct {
+    tf_index_t threads;
+    // jobs waiting in the queues and jobs being run right now
+    uint64_t queued;
+    uint64_t running;
+    
+    uint64_t submitted;
+    uint64_t completed;
+    // taken from another thread's queue
+    uint64_t stolen;
+    // refused because the queues were full
+    uint64_t rejected;
+} tf_pool_stats_t;
+
+/// starts the specified amount of threads, NULL if none of them could be
+tf_pool_ref tf_pool_init(const tf_index_t threads);
+
+/// queues the job, false if every queue is full, never blocks
+bool tf_pool_submit(tf_pool_ref pool, tf_pool_job_t* job);
+
+void tf_pool_get_stats(const tf_pool_ref pool, tf_pool_stats_t* statsp);
+
+/// runs what's still queued, then stops and joins all the threads
+void tf_pool_release(tf_pool_ref pool);
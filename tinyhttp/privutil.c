@@ -8,27 +8,11 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "privutil.h"
 
 #undef tf_struct_alloc
 
-void tf_log(const char* fn, const tf_index_t line, const char* fnn,
-            const char* fmt, ...) {
-#ifndef DEBUG
-#error "Too unstable to be undebugged"
-    return;
-#endif
-    
-    fprintf(stderr, "[DEBUG/%s/%u/%s] ", fn, line, fnn);
-    
-    va_list vl;
-    va_start(vl, fmt);
-    vfprintf(stderr, fmt, vl);
-    va_end(vl);
-    
-    fprintf(stderr, "%c", '\n');
-}
-
 tf_data_ref tf_struct_alloc(const tf_index_t size) {
     tf_data_ref result = malloc(size);
     bzero(result, size);
@@ -39,3 +23,17 @@ tf_data_ref tf_struct_alloc(const tf_index_t size) {
 int tf_keep_greater(const int v1, const int v2) {
     return ((v1 >= v2) ? v1 : v2);
 }
+
+uint64_t tf_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
+}
+
+uint64_t tf_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
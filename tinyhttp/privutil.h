@@ -8,19 +8,8 @@
 
 #pragma once
 
-#include <stdio.h>
-#include <stdarg.h>
 #include "types.h"
-
-void tf_log(const char* fn, const tf_index_t line, const char* fnn,
-            const char* fmt, ...);
-
-#ifndef __FILE_NAME__
-// only clang has this
-#define __FILE_NAME__ __FILE__
-#endif
-
-#define TF_LOG(...) tf_log(__FILE_NAME__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#include "log.h"
 
 tf_data_ref tf_struct_alloc(const tf_index_t size);
 
@@ -34,3 +23,8 @@ tf_data_ref tf_struct_alloc(const tf_index_t size);
 }
 
 int tf_keep_greater(const int v1, const int v2);
+
+/// monotonic clock in milliseconds
+uint64_t tf_monotonic_ms(void);
+/// same in nanoseconds, for timings
+uint64_t tf_monotonic_ns(void);
@@ -0,0 +1,1377 @@
+//
+//  proxy.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "privutil.h"
+#include "arena.h"
+#include "conn.h"
+#include "tcp.h"
+#include "proxy.h"
+
+/// request head bytes the proxy may add to the client's: the version,
+/// Host, X-Forwarded-For and Transfer-Encoding or Content-Length
+#define TF_PROXY_REQUEST_EXTRA 256
+/// what a response gathers before it's written to the client, so its head
+/// goes out together with the start of its body
+#define TF_PROXY_STAGING_SIZE (TF_PROXY_MAX_RESPONSE_HEAD + 16 * 1024)
+/// longest header name a Connection header is checked for
+#define TF_PROXY_MAX_TOKEN 64
+
+typedef struct tf_proxy_link_s* tf_proxy_link_ref;
+typedef struct tf_proxy_exchange_s* tf_proxy_exchange_ref;
+
+/// where the response is, for a body also how it's framed
+typedef enum {
+    // the status line and headers are still coming
+    TF_PROXY_RESPONSE_HEAD,
+    // Content-Length bytes
+    TF_PROXY_RESPONSE_LENGTH,
+    TF_PROXY_RESPONSE_CHUNKED,
+    // everything until the upstream closes the connection
+    TF_PROXY_RESPONSE_CLOSE,
+    TF_PROXY_RESPONSE_DONE
+} tf_proxy_response_state_t;
+
+/// what the proxy needs to know of an upstream's response head, views
+/// into the input
+typedef struct {
+    uint16_t status;
+    // 0 for HTTP/1.0, 1 for HTTP/1.1
+    uint8_t version_minor;
+    // the status line after the version, like " 200 OK"
+    tf_str_view_t status_rest;
+    tf_str_view_t connection;
+    tf_str_view_t transfer_encoding;
+    tf_str_view_t content_length;
+    // status line + headers + the empty line
+    tf_index_t length;
+} tf_proxy_response_head_t;
+
+typedef struct {
+    tf_tcp_address_t address;
+    // Host of the requests that come without one
+    char* name;
+    // exchanges in flight on all the workers
+    tf_index_t outstanding;
+} tf_proxy_upstream_t;
+
+/// per-worker part of the proxy, only ever touched by its worker's thread
+typedef struct {
+    // idle connections to each upstream, most recently used first
+    tf_proxy_link_ref idle[TF_PROXY_MAX_UPSTREAMS];
+    tf_index_t idle_count[TF_PROXY_MAX_UPSTREAMS];
+    // where the search for the least busy upstream starts next
+    tf_index_t next_upstream;
+    
+    // TF_PROXY_STAGING_SIZE bytes
+    char* staging;
+    tf_index_t staged;
+    
+    tf_proxy_stats_t stats;
+} tf_proxy_shard_t;
+
+struct tf_proxy_s {
+    tf_http_server_ref server;
+    tf_tcp_ref tcp;
+    
+    tf_proxy_upstream_t upstreams[TF_PROXY_MAX_UPSTREAMS];
+    tf_index_t upstream_count;
+    tf_index_t max_idle;
+    
+    tf_proxy_shard_t* shards;
+    tf_index_t shard_count;
+};
+
+/// connection to an upstream, the meta of its callback
+struct tf_proxy_link_s {
+    tf_proxy_ref proxy;
+    tf_conn_ref conn;
+    tf_index_t upstream;
+    tf_index_t worker;
+    
+    // NULL while idle
+    tf_proxy_exchange_ref exchange;
+    
+    // idle list of its upstream
+    tf_proxy_link_ref prev;
+    tf_proxy_link_ref next;
+    bool idle;
+    
+    // has been pooled before, the upstream may have closed it since
+    bool reused;
+    // inside its own callback, the TCP server flushes it afterwards
+    bool dispatching;
+};
+
+/// one request on its way to an upstream and its response on the way back
+struct tf_proxy_exchange_s {
+    tf_proxy_ref proxy;
+    tf_index_t worker;
+    tf_index_t upstream;
+    
+    // the client connection, only used while its body comes in
+    tf_conn_ref client;
+    // NULL once ended
+    tf_http_stream_ref stream;
+    // NULL once complete, or if the request has none
+    tf_http_body_ref body;
+    // NULL once given back
+    tf_proxy_link_ref link;
+    // callbacks running for the exchange, it stays around until they return
+    tf_index_t holds;
+    
+    // the client's side
+    bool http10;
+    bool head_only;
+    bool keep_alive;
+    // the body goes upstream with chunk framing of its own
+    bool chunked_request;
+    // all of the request has been queued for the upstream
+    bool request_sent;
+    // copy of an idempotent request without a body, sent once more on a
+    // new connection if a pooled one turns out to be closed, NULL once the
+    // response starts
+    char* retry;
+    tf_index_t retry_length;
+    
+    // the upstream's side, tf_proxy_response_state_t
+    uint8_t state;
+    tf_http_chunked_t chunked;
+    uint64_t left;
+    // HTTP/1.0 clients get chunked bodies without the framing
+    bool dechunk;
+    // the upstream keeps the connection after the response
+    bool reusable;
+    // the response head has gone to the client
+    bool responded;
+};
+
+// relaxed stores are plain moves, other threads may only read the values
+#define TF_PROXY_STAT_ADD(shard, field) \
+    __atomic_store_n(&(shard)->stats.field, (shard)->stats.field + 1, __ATOMIC_RELAXED)
+
+void tf_proxy_exchange_fail(tf_proxy_exchange_ref exchange, const uint16_t status);
+
+//
+// private
+//
+
+bool tf_proxy_append(char* buffer, tf_index_t* lengthp, const tf_index_t capacity,
+                     const char* data, const tf_index_t length) {
+    if (*lengthp + length > capacity)
+        return false;
+    
+    memcpy(buffer + *lengthp, data, length);
+    *lengthp += length;
+    
+    return true;
+}
+
+/// the line at *positionp without its line break, *positionp moves past
+/// it, false if there's no complete line
+bool tf_proxy_next_line(const char* data, const tf_index_t length, tf_index_t* positionp,
+                        tf_str_view_t* linep) {
+    tf_index_t position = *positionp;
+    const char* newline = (position < length ?
+                           memchr(data + position, '\n', length - position) : NULL);
+    
+    if (!newline)
+        return false;
+    
+    tf_index_t end = (tf_index_t)(newline - data);
+    
+    *positionp = end + 1;
+    
+    if (end > position && data[end - 1] == '\r')
+        end--;
+    
+    linep->data = data + position;
+    linep->length = end - position;
+    
+    return true;
+}
+
+/// name and value (without the whitespace around it) of a header line,
+/// false if it isn't one
+bool tf_proxy_split_header(const tf_str_view_t line, tf_str_view_t* namep,
+                           tf_str_view_t* valuep) {
+    const char* colon = (line.length > 0 ? memchr(line.data, ':', line.length) : NULL);
+    
+    if (!colon || colon == line.data)
+        return false;
+    
+    tf_index_t name = (tf_index_t)(colon - line.data);
+    tf_index_t first = name + 1, last = line.length;
+    
+    // whitespace around the name (obs-fold included) is how messages get
+    // smuggled past whoever reads them differently
+    if (line.data[0] == ' ' || line.data[0] == '\t' ||
+        line.data[name - 1] == ' ' || line.data[name - 1] == '\t')
+        return false;
+    
+    while (first < last && (line.data[first] == ' ' || line.data[first] == '\t'))
+        first++;
+    while (last > first && (line.data[last - 1] == ' ' || line.data[last - 1] == '\t'))
+        last--;
+    
+    namep->data = line.data;
+    namep->length = name;
+    valuep->data = line.data + first;
+    valuep->length = last - first;
+    
+    return true;
+}
+
+/// whether a header stays on its hop: the hop-by-hop ones and any the
+/// Connection header names
+bool tf_proxy_is_hop_by_hop(const tf_http_header_id_t id, const tf_str_view_t name,
+                            const tf_str_view_t connection) {
+    switch (id) {
+        case TF_HTTP_HEADER_CONNECTION:
+        case TF_HTTP_HEADER_KEEP_ALIVE:
+        case TF_HTTP_HEADER_PROXY_CONNECTION:
+        case TF_HTTP_HEADER_TE:
+        case TF_HTTP_HEADER_UPGRADE:
+            return true;
+        default:
+            break;
+    }
+    
+    char token[TF_PROXY_MAX_TOKEN];
+    
+    if (!connection.data || name.length >= sizeof(token))
+        return false;
+    
+    memcpy(token, name.data, name.length);
+    token[name.length] = '\0';
+    
+    return tf_http_header_has_token(connection, token);
+}
+
+/// whether the method may be sent again without doing anything twice (RFC
+/// 9110 §9.2.2), the upstream may have acted on a request before it closed
+bool tf_proxy_is_idempotent(const tf_str_view_t method) {
+    return (tf_str_view_equals(method, "GET") || tf_str_view_equals(method, "HEAD") ||
+            tf_str_view_equals(method, "OPTIONS") || tf_str_view_equals(method, "TRACE") ||
+            tf_str_view_equals(method, "PUT") || tf_str_view_equals(method, "DELETE"));
+}
+
+/// whether the last transfer coding is chunked, which frames the body
+bool tf_proxy_is_chunked(const tf_str_view_t encoding) {
+    tf_index_t first = encoding.length;
+    
+    while (first > 0 && encoding.data[first - 1] != ',')
+        first--;
+    while (first < encoding.length &&
+           (encoding.data[first] == ' ' || encoding.data[first] == '\t'))
+        first++;
+    
+    tf_str_view_t last = { encoding.data + first, encoding.length - first };
+    return tf_str_view_equals_nocase(last, "chunked");
+}
+
+bool tf_proxy_parse_length(const tf_str_view_t value, uint64_t* lengthp) {
+    uint64_t length = 0;
+    
+    // 18 digits can't overflow
+    if (value.length < 1 || value.length > 18)
+        return false;
+    
+    for (tf_index_t index = 0; index < value.length; index++) {
+        if (value.data[index] < '0' || value.data[index] > '9')
+            return false;
+        
+        length = length * 10 + (uint64_t)(value.data[index] - '0');
+    }
+    
+    *lengthp = length;
+    return true;
+}
+
+///
+/// reads the response head at the start of data, TF_HTTP_PARSE_INCOMPLETE
+/// until all of it is there, TF_HTTP_PARSE_TOO_LARGE once it's longer than
+/// TF_PROXY_MAX_RESPONSE_HEAD
+///
+tf_http_parse_status_t tf_proxy_parse_head(const char* data, const tf_index_t length,
+                                           tf_proxy_response_head_t* headp) {
+    tf_index_t position = 0;
+    tf_str_view_t line;
+    tf_http_parse_status_t incomplete = (length >= TF_PROXY_MAX_RESPONSE_HEAD ?
+                                         TF_HTTP_PARSE_TOO_LARGE :
+                                         TF_HTTP_PARSE_INCOMPLETE);
+    
+    bzero(headp, sizeof(tf_proxy_response_head_t));
+    
+    if (!tf_proxy_next_line(data, length, &position, &line))
+        return incomplete;
+    
+    // HTTP/1.x 200[ reason]
+    const char* status = line.data;
+    
+    if (line.length < 12 || memcmp(status, "HTTP/1.", 7) != 0 ||
+        status[7] < '0' || status[7] > '9' || status[8] != ' ' ||
+        status[9] < '1' || status[9] > '5' || status[10] < '0' || status[10] > '9' ||
+        status[11] < '0' || status[11] > '9' || (line.length > 12 && status[12] != ' '))
+        return TF_HTTP_PARSE_ERROR;
+    
+    headp->version_minor = (uint8_t)(status[7] - '0');
+    headp->status = (uint16_t)((status[9] - '0') * 100 + (status[10] - '0') * 10 +
+                               (status[11] - '0'));
+    headp->status_rest.data = status + 8;
+    headp->status_rest.length = line.length - 8;
+    
+    while (true) {
+        if (!tf_proxy_next_line(data, length, &position, &line))
+            return incomplete;
+        
+        if (position > TF_PROXY_MAX_RESPONSE_HEAD)
+            return TF_HTTP_PARSE_TOO_LARGE;
+        
+        if (line.length < 1)
+            break;
+        
+        tf_str_view_t name, value;
+        
+        if (!tf_proxy_split_header(line, &name, &value))
+            return TF_HTTP_PARSE_ERROR;
+        
+        switch (tf_http_header_lookup(name.data, name.length)) {
+            case TF_HTTP_HEADER_CONNECTION:
+                headp->connection = value;
+                break;
+            case TF_HTTP_HEADER_TRANSFER_ENCODING:
+                headp->transfer_encoding = value;
+                break;
+            case TF_HTTP_HEADER_CONTENT_LENGTH:
+                // two lengths would leave it to the client which one counts
+                if (headp->content_length.data &&
+                    (headp->content_length.length != value.length ||
+                     memcmp(headp->content_length.data, value.data, value.length) != 0))
+                    return TF_HTTP_PARSE_ERROR;
+                
+                headp->content_length = value;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    headp->length = position;
+    return TF_HTTP_PARSE_DONE;
+}
+
+///
+/// the request head that goes upstream, in the client connection's arena:
+/// HTTP/1.1 whatever the client spoke, without the hop-by-hop headers, with
+/// a Host if there was none, the client address added to X-Forwarded-For
+/// and a single Content-Length of body_length (the one the server went by)
+/// if the client sent any, NULL if there is no memory
+///
+char* tf_proxy_format_request(const tf_proxy_exchange_ref exchange, tf_conn_ref conn,
+                              const tf_http_request_t* request, const uint64_t body_length,
+                              tf_index_t* lengthp) {
+    const char* host = exchange->proxy->upstreams[exchange->upstream].name;
+    char* client = tf_socket_get_client_ip(tf_conn_get_socket(conn), NULL);
+    tf_str_view_t connection = tf_http_request_get_known_header(request,
+                                                                TF_HTTP_HEADER_CONNECTION);
+    tf_index_t capacity = (request->method.length + request->path.length +
+                           request->query.length + (tf_index_t)strlen(host) +
+                           (client ? (tf_index_t)strlen(client) : 0) + TF_PROXY_REQUEST_EXTRA);
+    
+    for (tf_index_t index = 0; index < request->header_count; index++)
+        capacity += request->headers[index].name.length + request->headers[index].value.length + 4;
+    
+    char* head = tf_arena_alloc(tf_conn_get_arena(conn), capacity);
+    tf_index_t length = 0;
+    bool has_host = false;
+    bool has_length = false;
+    bool forwarded = false;
+    
+    if (!head) {
+        free(client);
+        return NULL;
+    }
+    
+    // the capacity covers all of it
+    tf_proxy_append(head, &length, capacity, request->method.data, request->method.length);
+    tf_proxy_append(head, &length, capacity, " ", 1);
+    tf_proxy_append(head, &length, capacity, request->path.data, request->path.length);
+    
+    if (request->query.length > 0) {
+        tf_proxy_append(head, &length, capacity, "?", 1);
+        tf_proxy_append(head, &length, capacity, request->query.data, request->query.length);
+    }
+    
+    tf_proxy_append(head, &length, capacity, " HTTP/1.1\r\n", 11);
+    
+    for (tf_index_t index = 0; index < request->header_count; index++) {
+        const tf_http_header_t* header = &request->headers[index];
+        
+        has_length = (has_length || header->id == TF_HTTP_HEADER_CONTENT_LENGTH);
+        
+        // the body is framed anew, nobody upstream is asked to continue,
+        // the client's addresses are merged below
+        if (header->id == TF_HTTP_HEADER_TRANSFER_ENCODING ||
+            header->id == TF_HTTP_HEADER_CONTENT_LENGTH ||
+            header->id == TF_HTTP_HEADER_EXPECT ||
+            header->id == TF_HTTP_HEADER_X_FORWARDED_FOR ||
+            tf_proxy_is_hop_by_hop(header->id, header->name, connection))
+            continue;
+        
+        has_host = (has_host || header->id == TF_HTTP_HEADER_HOST);
+        
+        tf_proxy_append(head, &length, capacity, header->name.data, header->name.length);
+        tf_proxy_append(head, &length, capacity, ": ", 2);
+        tf_proxy_append(head, &length, capacity, header->value.data, header->value.length);
+        tf_proxy_append(head, &length, capacity, "\r\n", 2);
+    }
+    
+    if (!has_host) {
+        tf_proxy_append(head, &length, capacity, "Host: ", 6);
+        tf_proxy_append(head, &length, capacity, host, (tf_index_t)strlen(host));
+        tf_proxy_append(head, &length, capacity, "\r\n", 2);
+    }
+    
+    if (exchange->chunked_request)
+        tf_proxy_append(head, &length, capacity, "Transfer-Encoding: chunked\r\n", 28);
+    else if (has_length) {
+        char line[48];
+        int llen = snprintf(line, sizeof(line), "Content-Length: %llu\r\n",
+                            (unsigned long long)body_length);
+        
+        tf_proxy_append(head, &length, capacity, line, (tf_index_t)llen);
+    }
+    
+    tf_proxy_append(head, &length, capacity, "X-Forwarded-For: ", 17);
+    
+    for (tf_index_t index = 0; index < request->header_count; index++) {
+        const tf_http_header_t* header = &request->headers[index];
+        
+        if (header->id != TF_HTTP_HEADER_X_FORWARDED_FOR)
+            continue;
+        
+        if (forwarded)
+            tf_proxy_append(head, &length, capacity, ", ", 2);
+        
+        tf_proxy_append(head, &length, capacity, header->value.data, header->value.length);
+        forwarded = true;
+    }
+    
+    if (client) {
+        if (forwarded)
+            tf_proxy_append(head, &length, capacity, ", ", 2);
+        
+        tf_proxy_append(head, &length, capacity, client, (tf_index_t)strlen(client));
+        forwarded = true;
+    }
+    
+    // nothing to forward after all, the header is dropped again
+    if (!forwarded)
+        length -= 17;
+    else
+        tf_proxy_append(head, &length, capacity, "\r\n", 2);
+    
+    tf_proxy_append(head, &length, capacity, "\r\n", 2);
+    
+    free(client);
+    
+    *lengthp = length;
+    return head;
+}
+
+///
+/// the response head the client gets: HTTP/1.1 and the upstream's status,
+/// its headers without the hop-by-hop ones (and the framing, if it's taken
+/// off), with a Connection header of the client's own, 0 if it doesn't
+/// fit into capacity
+///
+tf_index_t tf_proxy_format_response(const tf_proxy_exchange_ref exchange, const char* data,
+                                    const tf_proxy_response_head_t* head,
+                                    const bool keep_alive, char* buffer,
+                                    const tf_index_t capacity) {
+    bool framed = (head->transfer_encoding.data != NULL);
+    tf_index_t position = 0;
+    tf_index_t length = 0;
+    tf_str_view_t line;
+    
+    // the status line has been read already
+    tf_proxy_next_line(data, head->length, &position, &line);
+    
+    if (!tf_proxy_append(buffer, &length, capacity, "HTTP/1.1", 8) ||
+        !tf_proxy_append(buffer, &length, capacity, head->status_rest.data,
+                         head->status_rest.length) ||
+        !tf_proxy_append(buffer, &length, capacity, "\r\n", 2))
+        return 0;
+    
+    while (tf_proxy_next_line(data, head->length, &position, &line) && line.length > 0) {
+        tf_str_view_t name, value;
+        
+        tf_proxy_split_header(line, &name, &value);
+        
+        tf_http_header_id_t id = tf_http_header_lookup(name.data, name.length);
+        
+        // Transfer-Encoding wins over Content-Length (RFC 9112)
+        if (tf_proxy_is_hop_by_hop(id, name, head->connection) ||
+            (id == TF_HTTP_HEADER_CONTENT_LENGTH && framed) ||
+            (exchange->dechunk && (id == TF_HTTP_HEADER_TRANSFER_ENCODING ||
+                                   id == TF_HTTP_HEADER_TRAILER)))
+            continue;
+        
+        if (!tf_proxy_append(buffer, &length, capacity, line.data, line.length) ||
+            !tf_proxy_append(buffer, &length, capacity, "\r\n", 2))
+            return 0;
+    }
+    
+    const char* end = "\r\n";
+    
+    if (!keep_alive)
+        end = "Connection: close\r\n\r\n";
+    else if (exchange->http10)
+        end = "Connection: keep-alive\r\n\r\n";
+    
+    return (tf_proxy_append(buffer, &length, capacity, end, (tf_index_t)strlen(end)) ?
+            length : 0);
+}
+
+tf_index_t tf_proxy_pick_upstream(tf_proxy_ref proxy, tf_proxy_shard_t* shard) {
+    tf_index_t count = proxy->upstream_count;
+    tf_index_t best = shard->next_upstream % count;
+    tf_index_t best_load = __atomic_load_n(&proxy->upstreams[best].outstanding,
+                                           __ATOMIC_RELAXED);
+    
+    for (tf_index_t offset = 1; offset < count && best_load > 0; offset++) {
+        tf_index_t upstream = (shard->next_upstream + offset) % count;
+        tf_index_t load = __atomic_load_n(&proxy->upstreams[upstream].outstanding,
+                                          __ATOMIC_RELAXED);
+        
+        if (load < best_load) {
+            best = upstream;
+            best_load = load;
+        }
+    }
+    
+    // the next tie goes to the one after
+    shard->next_upstream = best + 1;
+    return best;
+}
+
+//
+// connection pool
+//
+
+void tf_proxy_link_pool(tf_proxy_link_ref link) {
+    tf_proxy_shard_t* shard = link->proxy->shards + link->worker;
+    tf_proxy_link_ref first = shard->idle[link->upstream];
+    
+    link->prev = NULL;
+    link->next = first;
+    link->idle = true;
+    link->reused = true;
+    
+    if (first)
+        first->prev = link;
+    
+    shard->idle[link->upstream] = link;
+    shard->idle_count[link->upstream]++;
+}
+
+void tf_proxy_link_unpool(tf_proxy_link_ref link) {
+    tf_proxy_shard_t* shard = link->proxy->shards + link->worker;
+    
+    if (!link->idle)
+        return;
+    
+    if (link->prev)
+        link->prev->next = link->next;
+    else
+        shard->idle[link->upstream] = link->next;
+    
+    if (link->next)
+        link->next->prev = link->prev;
+    
+    link->prev = NULL;
+    link->next = NULL;
+    link->idle = false;
+    shard->idle_count[link->upstream]--;
+}
+
+/// sends what has been queued, unless the TCP server is about to
+void tf_proxy_link_flush(tf_proxy_link_ref link) {
+    if (!link->dispatching)
+        tf_tcp_resume(link->proxy->tcp, link->conn);
+}
+
+void tf_proxy_link_callback(tf_tcp_ref tcp,
+                            tf_tcp_connection_type_t ctype,
+                            tf_data_ref const data,
+                            const tf_index_t length,
+                            tf_conn_ref conn,
+                            tf_index_t worker,
+                            tf_data_ref meta);
+
+/// the most recently used idle connection to the upstream, or a new one
+/// unless fresh is set, NULL if none can be opened
+tf_proxy_link_ref tf_proxy_link_acquire(tf_proxy_ref proxy, const tf_index_t worker,
+                                        const tf_index_t upstream, const bool fresh) {
+    tf_proxy_shard_t* shard = proxy->shards + worker;
+    tf_proxy_link_ref link = (fresh ? NULL : shard->idle[upstream]);
+    
+    if (link) {
+        tf_proxy_link_unpool(link);
+        TF_PROXY_STAT_ADD(shard, reuses);
+        
+        return link;
+    }
+    
+    link = tf_struct_alloc(tf_proxy_link_s);
+    if (!link)
+        return NULL;
+    
+    link->proxy = proxy;
+    link->upstream = upstream;
+    link->worker = worker;
+    link->conn = tf_tcp_connect(proxy->tcp, worker, &proxy->upstreams[upstream].address,
+                                tf_proxy_link_callback, link);
+    
+    if (!link->conn) {
+        TF_LOG_WARN("cannot connect to upstream %s", proxy->upstreams[upstream].name);
+        
+        free(link);
+        return NULL;
+    }
+    
+    TF_PROXY_STAT_ADD(shard, connects);
+    return link;
+}
+
+//
+// exchanges
+//
+
+void tf_proxy_exchange_enter(tf_proxy_exchange_ref exchange) {
+    exchange->holds++;
+}
+
+/// frees the exchange once neither a callback nor the stream, the body
+/// or the upstream connection refer to it anymore
+void tf_proxy_exchange_leave(tf_proxy_exchange_ref exchange) {
+    if (--exchange->holds > 0 || exchange->stream || exchange->body || exchange->link)
+        return;
+    
+    free(exchange->retry);
+    free(exchange);
+}
+
+/// the exchange is done with its upstream connection, which goes back to
+/// the pool if reusable is set and there's room for it, is closed otherwise
+void tf_proxy_exchange_release_link(tf_proxy_exchange_ref exchange, const bool reusable) {
+    tf_proxy_link_ref link = exchange->link;
+    tf_proxy_ref proxy = exchange->proxy;
+    
+    if (!link)
+        return;
+    
+    tf_proxy_shard_t* shard = proxy->shards + link->worker;
+    
+    exchange->link = NULL;
+    link->exchange = NULL;
+    __atomic_sub_fetch(&proxy->upstreams[link->upstream].outstanding, 1, __ATOMIC_RELAXED);
+    
+    if (reusable && shard->idle_count[link->upstream] < proxy->max_idle &&
+        !tf_conn_is_closing(link->conn)) {
+        tf_proxy_link_pool(link);
+        
+        // the upstream may close it whenever it likes, so do we
+        tf_tcp_set_paused(proxy->tcp, link->conn, false);
+        tf_tcp_set_read_timeout(proxy->tcp, link->conn, TF_TCP_TIMEOUT_IDLE, true);
+        return;
+    }
+    
+    tf_conn_close(link->conn);
+    tf_proxy_link_flush(link);
+}
+
+///
+/// sends the request head (or the copy for a retry) over a pooled or, if
+/// fresh is set, a new upstream connection, the exchange fails with 502 if
+/// there is none
+///
+void tf_proxy_exchange_send(tf_proxy_exchange_ref exchange, const char* head,
+                            const tf_index_t length, const bool fresh) {
+    tf_proxy_ref proxy = exchange->proxy;
+    tf_proxy_link_ref link = tf_proxy_link_acquire(proxy, exchange->worker,
+                                                   exchange->upstream, fresh);
+    
+    if (!link) {
+        tf_proxy_exchange_fail(exchange, 502);
+        return;
+    }
+    
+    link->exchange = exchange;
+    exchange->link = link;
+    __atomic_add_fetch(&proxy->upstreams[exchange->upstream].outstanding, 1,
+                       __ATOMIC_RELAXED);
+    
+    if (!tf_conn_queue_output(link->conn, head, length)) {
+        tf_proxy_exchange_fail(exchange, 502);
+        return;
+    }
+    
+    // the upstream gets as long to answer as a handler would
+    tf_tcp_set_read_timeout(proxy->tcp, link->conn, TF_TCP_TIMEOUT_HANDLER, true);
+    tf_proxy_link_flush(link);
+}
+
+///
+/// answers status in place of the upstream if the response hasn't started
+/// yet, cuts the response off otherwise, the upstream connection is closed
+/// either way, a request body still coming in goes nowhere
+///
+void tf_proxy_exchange_fail(tf_proxy_exchange_ref exchange, const uint16_t status) {
+    tf_proxy_shard_t* shard = exchange->proxy->shards + exchange->worker;
+    tf_http_stream_ref stream = exchange->stream;
+    
+    tf_proxy_exchange_release_link(exchange, false);
+    
+    if (!stream)
+        return;
+    
+    exchange->stream = NULL;
+    
+    // the rest of the body would be taken for the next request
+    bool close = (exchange->responded || !exchange->keep_alive || exchange->body);
+    
+    if (!exchange->responded) {
+        char head[128];
+        int length = snprintf(head, sizeof(head),
+                              "HTTP/1.1 %u %s\r\nContent-Length: 0\r\n%s\r\n",
+                              status, tf_http_status_get_reason(status),
+                              (close ? "Connection: close\r\n" :
+                               (exchange->http10 ? "Connection: keep-alive\r\n" : "")));
+        
+        TF_PROXY_STAT_ADD(shard, failures);
+        tf_http_stream_write(stream, head, (tf_index_t)length);
+    }
+    
+    if (close)
+        tf_http_stream_set_close(stream);
+    
+    tf_http_stream_end(stream);
+}
+
+/// the response is all in, the upstream connection goes back to the pool
+/// if nothing else came with it (clean) and the upstream keeps it
+void tf_proxy_exchange_complete(tf_proxy_exchange_ref exchange, const bool clean) {
+    tf_http_stream_ref stream = exchange->stream;
+    
+    tf_proxy_exchange_release_link(exchange, (clean && exchange->reusable &&
+                                              exchange->request_sent));
+    
+    exchange->stream = NULL;
+    
+    // the rest of the request body would be taken for the next request
+    if (exchange->body)
+        tf_http_stream_set_close(stream);
+    
+    tf_http_stream_end(stream);
+}
+
+/// queues data for the client in the worker's staging buffer, which goes
+/// out in one write, false if the client is gone
+bool tf_proxy_flush_staged(tf_proxy_exchange_ref exchange, tf_proxy_shard_t* shard) {
+    tf_index_t staged = shard->staged;
+    
+    shard->staged = 0;
+    return (staged < 1 || tf_http_stream_write(exchange->stream, shard->staging, staged));
+}
+
+bool tf_proxy_emit(tf_proxy_exchange_ref exchange, tf_proxy_shard_t* shard,
+                   const char* data, const tf_index_t length) {
+    if (length < 1)
+        return true;
+    
+    if (shard->staged + length <= TF_PROXY_STAGING_SIZE) {
+        memcpy(shard->staging + shard->staged, data, length);
+        shard->staged += length;
+        return true;
+    }
+    
+    // big pieces go out on their own
+    return (tf_proxy_flush_staged(exchange, shard) &&
+            tf_http_stream_write(exchange->stream, data, length));
+}
+
+///
+/// takes the response head at the start of data and stages the client's
+/// version of it (1xx heads are skipped), *lengthp is how much of data it
+/// was, TF_HTTP_PARSE_ERROR or TF_HTTP_PARSE_TOO_LARGE if the upstream
+/// cannot be relayed
+///
+tf_http_parse_status_t tf_proxy_exchange_start(tf_proxy_exchange_ref exchange,
+                                               tf_proxy_shard_t* shard,
+                                               const char* data, const tf_index_t length,
+                                               tf_index_t* lengthp) {
+    tf_proxy_response_head_t head;
+    tf_http_parse_status_t status = tf_proxy_parse_head(data, length, &head);
+    
+    if (status != TF_HTTP_PARSE_DONE)
+        return status;
+    
+    *lengthp = head.length;
+    
+    // nothing can be relayed after switching protocols
+    if (head.status == 101)
+        return TF_HTTP_PARSE_ERROR;
+    
+    // interim, the response follows
+    if (head.status < 200)
+        return TF_HTTP_PARSE_DONE;
+    
+    tf_proxy_response_state_t state = TF_PROXY_RESPONSE_CLOSE;
+    
+    if (exchange->head_only || head.status == 204 || head.status == 304)
+        state = TF_PROXY_RESPONSE_DONE;
+    else if (head.transfer_encoding.data)
+        state = (tf_proxy_is_chunked(head.transfer_encoding) ? TF_PROXY_RESPONSE_CHUNKED :
+                 TF_PROXY_RESPONSE_CLOSE);
+    else if (head.content_length.data) {
+        if (!tf_proxy_parse_length(head.content_length, &exchange->left))
+            return TF_HTTP_PARSE_ERROR;
+        
+        state = (exchange->left > 0 ? TF_PROXY_RESPONSE_LENGTH : TF_PROXY_RESPONSE_DONE);
+    }
+    
+    exchange->state = state;
+    exchange->dechunk = (exchange->http10 && state == TF_PROXY_RESPONSE_CHUNKED);
+    exchange->reusable = (state != TF_PROXY_RESPONSE_CLOSE &&
+                          (head.version_minor > 0 ?
+                           !tf_http_header_has_token(head.connection, "close") :
+                           tf_http_header_has_token(head.connection, "keep-alive")));
+    
+    // a body without a length can only end with the connection
+    bool keep_alive = (exchange->keep_alive && state != TF_PROXY_RESPONSE_CLOSE &&
+                       !exchange->dechunk);
+    tf_index_t formatted = tf_proxy_format_response(exchange, data, &head, keep_alive,
+                                                    shard->staging + shard->staged,
+                                                    TF_PROXY_STAGING_SIZE - shard->staged);
+    
+    if (formatted < 1)
+        return TF_HTTP_PARSE_TOO_LARGE;
+    
+    shard->staged += formatted;
+    
+    if (!keep_alive)
+        tf_http_stream_set_close(exchange->stream);
+    
+    // once the client has seen a byte, nothing may be sent again
+    exchange->responded = true;
+    free(exchange->retry);
+    exchange->retry = NULL;
+    
+    return TF_HTTP_PARSE_DONE;
+}
+
+///
+/// stages the response body at the start of data for the client, as much
+/// of it as belongs to the response, returns how much of data it was, *okp
+/// is cleared if the exchange has failed
+///
+tf_index_t tf_proxy_exchange_relay(tf_proxy_exchange_ref exchange, tf_proxy_shard_t* shard,
+                                   const char* data, const tf_index_t length, bool* okp) {
+    tf_http_chunked_t* chunked = &exchange->chunked;
+    tf_index_t position = 0;
+    
+    if (exchange->state == TF_PROXY_RESPONSE_LENGTH) {
+        position = (exchange->left < length ? (tf_index_t)exchange->left : length);
+        exchange->left -= position;
+        
+        if (exchange->left < 1)
+            exchange->state = TF_PROXY_RESPONSE_DONE;
+    } else if (exchange->state == TF_PROXY_RESPONSE_CLOSE)
+        position = length;
+    
+    // the framing is followed to know where the body ends, the chunks go
+    // through as they are unless the client is HTTP/1.0
+    while (exchange->state == TF_PROXY_RESPONSE_CHUNKED && position < length) {
+        if (chunked->state == TF_HTTP_CHUNKED_DATA) {
+            tf_index_t take = (chunked->left < length - position ? (tf_index_t)chunked->left :
+                               length - position);
+            
+            if (exchange->dechunk && !tf_proxy_emit(exchange, shard, data + position, take)) {
+                tf_proxy_exchange_fail(exchange, 502);
+                *okp = false;
+                return length;
+            }
+            
+            position += take;
+            chunked->left -= take;
+            
+            if (chunked->left < 1)
+                chunked->state = TF_HTTP_CHUNKED_DATA_CR;
+            
+            continue;
+        }
+        
+        tf_http_parse_status_t status = tf_http_chunked_feed(chunked, data[position++],
+                                                             UINT64_MAX);
+        
+        if (status == TF_HTTP_PARSE_DONE)
+            exchange->state = TF_PROXY_RESPONSE_DONE;
+        else if (status != TF_HTTP_PARSE_INCOMPLETE) {
+            TF_LOG_DEBUG("bad chunk framing from upstream %s",
+                         exchange->proxy->upstreams[exchange->upstream].name);
+            
+            tf_proxy_exchange_fail(exchange, 502);
+            *okp = false;
+            return length;
+        }
+    }
+    
+    if (!exchange->dechunk && !tf_proxy_emit(exchange, shard, data, position)) {
+        tf_proxy_exchange_fail(exchange, 502);
+        *okp = false;
+        return length;
+    }
+    
+    return position;
+}
+
+/// holds the upstream off while the client has a lot of the response
+/// queued, the drain handler takes it on again
+void tf_proxy_client_drained(tf_http_stream_ref stream, tf_data_ref meta) {
+    tf_proxy_exchange_ref exchange = (tf_proxy_exchange_ref)meta;
+    (void)(stream);
+    
+    if (exchange->link)
+        tf_tcp_set_paused(exchange->proxy->tcp, exchange->link->conn, false);
+}
+
+/// relays what the upstream has sent so far
+void tf_proxy_link_receive(tf_proxy_link_ref link) {
+    tf_proxy_ref proxy = link->proxy;
+    tf_proxy_exchange_ref exchange = link->exchange;
+    tf_proxy_shard_t* shard = proxy->shards + link->worker;
+    tf_conn_ref conn = link->conn;
+    tf_index_t length = 0;
+    char* input = tf_conn_get_input(conn, &length);
+    tf_index_t consumed = 0;
+    bool ok = true;
+    
+    // an idle connection has nothing to say, whatever it is can't be trusted
+    if (!exchange) {
+        tf_conn_consume_input(conn, length);
+        tf_conn_close(conn);
+        return;
+    }
+    
+    shard->staged = 0;
+    
+    while (exchange->state == TF_PROXY_RESPONSE_HEAD) {
+        tf_index_t head = 0;
+        tf_http_parse_status_t status = tf_proxy_exchange_start(exchange, shard,
+                                                                input + consumed,
+                                                                length - consumed, &head);
+        
+        if (status == TF_HTTP_PARSE_INCOMPLETE)
+            break;
+        
+        if (status != TF_HTTP_PARSE_DONE) {
+            TF_LOG_WARN("bad response head from upstream %s",
+                        proxy->upstreams[link->upstream].name);
+            
+            tf_proxy_exchange_fail(exchange, 502);
+            ok = false;
+            break;
+        }
+        
+        consumed += head;
+    }
+    
+    if (ok && exchange->state != TF_PROXY_RESPONSE_HEAD &&
+        exchange->state != TF_PROXY_RESPONSE_DONE)
+        consumed += tf_proxy_exchange_relay(exchange, shard, input + consumed,
+                                            length - consumed, &ok);
+    
+    // a connection that goes back to the pool starts out empty
+    tf_conn_consume_input(conn, (ok ? consumed : length));
+    
+    if (!ok)
+        return;
+    
+    // one write for the head and as much of the body as there is
+    if (!tf_proxy_flush_staged(exchange, shard)) {
+        tf_proxy_exchange_fail(exchange, 502);
+        return;
+    }
+    
+    if (exchange->state == TF_PROXY_RESPONSE_DONE) {
+        tf_proxy_exchange_complete(exchange, consumed == length);
+        return;
+    }
+    
+    if (exchange->state == TF_PROXY_RESPONSE_HEAD)
+        return;
+    
+    // restarted by every read from now on
+    tf_tcp_set_read_timeout(proxy->tcp, conn, TF_TCP_TIMEOUT_BODY, false);
+    
+    if (tf_http_stream_get_queued(exchange->stream) >= TF_TCP_OUTPUT_HIGH_WATER) {
+        tf_tcp_set_paused(proxy->tcp, conn, true);
+        tf_http_stream_set_drain_handler(exchange->stream, tf_proxy_client_drained, exchange);
+    }
+}
+
+///
+/// the upstream connection is gone, its exchange (if any) is sent again
+/// if it can be, completes if its body was to end this way, fails
+/// otherwise
+///
+void tf_proxy_link_closed(tf_proxy_link_ref link) {
+    tf_proxy_ref proxy = link->proxy;
+    tf_proxy_exchange_ref exchange = link->exchange;
+    uint8_t reason = tf_conn_get_close_reason(link->conn);
+    
+    tf_proxy_link_unpool(link);
+    
+    if (!exchange)
+        return;
+    
+    exchange->link = NULL;
+    link->exchange = NULL;
+    __atomic_sub_fetch(&proxy->upstreams[link->upstream].outstanding, 1, __ATOMIC_RELAXED);
+    
+    if (exchange->state == TF_PROXY_RESPONSE_CLOSE && reason == TF_TCP_CLOSE_PEER) {
+        tf_proxy_exchange_complete(exchange, false);
+        return;
+    }
+    
+    // a pooled connection the upstream closed before it got the request
+    if (exchange->retry && link->reused &&
+        (reason == TF_TCP_CLOSE_PEER || reason == TF_TCP_CLOSE_ERROR)) {
+        char* retry = exchange->retry;
+        
+        exchange->retry = NULL;
+        TF_PROXY_STAT_ADD(proxy->shards + exchange->worker, retries);
+        
+        tf_proxy_exchange_send(exchange, retry, exchange->retry_length, true);
+        free(retry);
+        return;
+    }
+    
+    tf_proxy_exchange_fail(exchange, (reason >= TF_TCP_CLOSE_TIMEOUT_HEADER ? 504 : 502));
+}
+
+void tf_proxy_link_callback(tf_tcp_ref tcp,
+                            tf_tcp_connection_type_t ctype,
+                            tf_data_ref const data,
+                            const tf_index_t length,
+                            tf_conn_ref conn,
+                            tf_index_t worker,
+                            tf_data_ref meta) {
+    (void)(data);
+    (void)(length);
+    (void)(conn);
+    (void)(worker);
+    
+    tf_proxy_link_ref link = (tf_proxy_link_ref)meta;
+    tf_proxy_exchange_ref exchange = link->exchange;
+    
+    if (exchange)
+        tf_proxy_exchange_enter(exchange);
+    
+    link->dispatching = true;
+    
+    switch (ctype) {
+        case TF_TCP_CONNECTION_CONTINUE:
+            tf_proxy_link_receive(link);
+            break;
+        case TF_TCP_CONNECTION_DRAINED:
+            // the upstream takes the request body again, so does the proxy
+            if (exchange && exchange->body)
+                tf_tcp_set_paused(tcp, exchange->client, false);
+            break;
+        case TF_TCP_CONNECTION_CLOSE:
+            tf_proxy_link_closed(link);
+            break;
+        default:
+            break;
+    }
+    
+    link->dispatching = false;
+    
+    if (ctype == TF_TCP_CONNECTION_CLOSE)
+        free(link);
+    
+    if (exchange)
+        tf_proxy_exchange_leave(exchange);
+}
+
+//
+// request bodies
+//
+
+bool tf_proxy_body_receive(const char* data, const tf_index_t length, tf_data_ref meta) {
+    tf_proxy_exchange_ref exchange = (tf_proxy_exchange_ref)meta;
+    tf_proxy_link_ref link = exchange->link;
+    
+    // the response is over already, the rest goes nowhere
+    if (!link || length < 1)
+        return true;
+    
+    tf_conn_ref conn = link->conn;
+    bool queued = true;
+    
+    if (exchange->chunked_request) {
+        char size[16];
+        int slen = snprintf(size, sizeof(size), "%x\r\n", length);
+        
+        queued = (tf_conn_queue_output(conn, size, (tf_index_t)slen) &&
+                  tf_conn_queue_output(conn, data, length) &&
+                  tf_conn_queue_output(conn, "\r\n", 2));
+    } else
+        queued = tf_conn_queue_output(conn, data, length);
+    
+    tf_proxy_exchange_enter(exchange);
+    
+    if (!queued)
+        tf_proxy_exchange_fail(exchange, 502);
+    else {
+        // the client waits until the upstream takes what it has sent
+        if (tf_conn_get_output_length(conn) >= TF_TCP_OUTPUT_HIGH_WATER) {
+            tf_tcp_set_paused(exchange->proxy->tcp, exchange->client, true);
+            tf_conn_set_wants_drain(conn, true);
+        }
+        
+        tf_proxy_link_flush(link);
+    }
+    
+    tf_proxy_exchange_leave(exchange);
+    return true;
+}
+
+void tf_proxy_body_complete(const tf_http_request_t* request,
+                            const uint16_t error,
+                            tf_http_response_t* response,
+                            tf_arena_ref arena,
+                            tf_data_ref meta) {
+    (void)(request);
+    (void)(response);
+    (void)(arena);
+    
+    tf_proxy_exchange_ref exchange = (tf_proxy_exchange_ref)meta;
+    tf_proxy_link_ref link = exchange->link;
+    
+    tf_proxy_exchange_enter(exchange);
+    exchange->body = NULL;
+    
+    // the client gets the error if there's no response yet, the upstream
+    // a cut off request
+    if (error > 0)
+        tf_proxy_exchange_fail(exchange, error);
+    else if (link) {
+        if (exchange->chunked_request)
+            tf_conn_queue_output(link->conn, "0\r\n\r\n", 5);
+        
+        exchange->request_sent = true;
+        tf_proxy_link_flush(link);
+    }
+    
+    tf_proxy_exchange_leave(exchange);
+}
+
+//
+// public
+//
+
+tf_proxy_ref tf_proxy_init(tf_http_server_ref server) {
+    tf_tcp_ref tcp = tf_http_server_get_tcp(server);
+    if (!tcp)
+        return NULL;
+    
+    tf_proxy_ref proxy = tf_struct_alloc(tf_proxy_s);
+    if (!proxy)
+        return NULL;
+    
+    proxy->server = server;
+    proxy->tcp = tcp;
+    proxy->max_idle = TF_PROXY_DEFAULT_MAX_IDLE;
+    proxy->shard_count = tf_tcp_get_worker_count(tcp);
+    proxy->shards = calloc(proxy->shard_count, sizeof(tf_proxy_shard_t));
+    
+    bool ready = (proxy->shards != NULL);
+    
+    for (tf_index_t index = 0; ready && index < proxy->shard_count; index++) {
+        proxy->shards[index].staging = malloc(TF_PROXY_STAGING_SIZE);
+        ready = (proxy->shards[index].staging != NULL);
+    }
+    
+    if (!ready) {
+        tf_proxy_release(proxy);
+        return NULL;
+    }
+    
+    return proxy;
+}
+
+bool tf_proxy_add_upstream(tf_proxy_ref proxy, const char* address) {
+    if (!proxy || !address || proxy->upstream_count >= TF_PROXY_MAX_UPSTREAMS)
+        return false;
+    
+    tf_proxy_upstream_t* upstream = &proxy->upstreams[proxy->upstream_count];
+    
+    if (!tf_tcp_address_parse(address, &upstream->address))
+        return false;
+    
+    // "host:port" is a Host header as it is, a socket path is not
+    upstream->name = strdup(strncmp(address, "unix:", 5) == 0 ? "localhost" : address);
+    if (!upstream->name)
+        return false;
+    
+    upstream->outstanding = 0;
+    proxy->upstream_count++;
+    
+    return true;
+}
+
+void tf_proxy_set_max_idle(tf_proxy_ref proxy, const tf_index_t max_idle) {
+    if (proxy)
+        proxy->max_idle = max_idle;
+}
+
+void tf_proxy_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta) {
+    tf_proxy_ref proxy = (tf_proxy_ref)meta;
+    
+    if (!proxy || proxy->upstream_count < 1) {
+        response->status = 502;
+        return;
+    }
+    
+    tf_proxy_exchange_ref exchange = tf_struct_alloc(tf_proxy_exchange_s);
+    uint64_t length = 0;
+    
+    if (!exchange) {
+        response->status = 500;
+        return;
+    }
+    
+    tf_http_request_get_content_length(request, &length);
+    
+    tf_index_t worker = tf_conn_get_worker_id(conn);
+    tf_proxy_shard_t* shard = proxy->shards + worker;
+    
+    exchange->proxy = proxy;
+    exchange->worker = worker;
+    exchange->upstream = tf_proxy_pick_upstream(proxy, shard);
+    exchange->client = conn;
+    exchange->http10 = (request->version_minor < 1);
+    exchange->head_only = tf_str_view_equals(request->method, "HEAD");
+    exchange->keep_alive = tf_http_request_wants_keep_alive(request);
+    // the server takes nothing but chunked
+    exchange->chunked_request =
+        (tf_http_request_get_known_header(request, TF_HTTP_HEADER_TRANSFER_ENCODING).data != NULL);
+    
+    tf_index_t head_length = 0;
+    char* head = tf_proxy_format_request(exchange, conn, request, length, &head_length);
+    
+    exchange->stream = (head ? tf_http_server_relay(server, conn, request) : NULL);
+    
+    if (!exchange->stream) {
+        free(exchange);
+        response->status = 500;
+        return;
+    }
+    
+    tf_proxy_exchange_enter(exchange);
+    TF_PROXY_STAT_ADD(shard, requests);
+    
+    if (exchange->chunked_request || length > 0) {
+        exchange->body = tf_http_server_receive_body(server, conn, request,
+                                                     tf_proxy_body_complete, exchange);
+        
+        if (!exchange->body) {
+            tf_proxy_exchange_fail(exchange, 500);
+            tf_proxy_exchange_leave(exchange);
+            return;
+        }
+        
+        tf_http_body_set_handler(exchange->body, tf_proxy_body_receive);
+        
+        // the client has been told to wait for it, nobody upstream will
+        // tell it to go on (a body in already hasn't waited)
+        tf_str_view_t expect = tf_http_request_get_known_header(request, TF_HTTP_HEADER_EXPECT);
+        
+        if (!exchange->http10 && tf_str_view_equals_nocase(expect, "100-continue") &&
+            (exchange->chunked_request || length > TF_HTTP_SERVER_MAX_BUFFERED_BODY))
+            tf_http_stream_write(exchange->stream, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+    } else {
+        exchange->request_sent = true;
+        
+        if (tf_proxy_is_idempotent(request->method)) {
+            exchange->retry = malloc(head_length);
+            exchange->retry_length = head_length;
+            
+            if (exchange->retry)
+                memcpy(exchange->retry, head, head_length);
+        }
+    }
+    
+    tf_proxy_exchange_send(exchange, head, head_length, false);
+    tf_proxy_exchange_leave(exchange);
+}
+
+void tf_proxy_get_stats(const tf_proxy_ref proxy, tf_proxy_stats_t* statsp) {
+    if (!statsp)
+        return;
+    
+    bzero(statsp, sizeof(tf_proxy_stats_t));
+    
+    for (tf_index_t index = 0; proxy && index < proxy->shard_count; index++) {
+        const tf_proxy_stats_t* stats = &proxy->shards[index].stats;
+        
+        statsp->requests += __atomic_load_n(&stats->requests, __ATOMIC_RELAXED);
+        statsp->connects += __atomic_load_n(&stats->connects, __ATOMIC_RELAXED);
+        statsp->reuses += __atomic_load_n(&stats->reuses, __ATOMIC_RELAXED);
+        statsp->retries += __atomic_load_n(&stats->retries, __ATOMIC_RELAXED);
+        statsp->failures += __atomic_load_n(&stats->failures, __ATOMIC_RELAXED);
+    }
+}
+
+void tf_proxy_release(tf_proxy_ref proxy) {
+    if (!proxy)
+        return;
+    
+    // the connections went with the server, only the idle links are left
+    for (tf_index_t index = 0; proxy->shards && index < proxy->shard_count; index++) {
+        tf_proxy_shard_t* shard = &proxy->shards[index];
+        
+        for (tf_index_t upstream = 0; upstream < proxy->upstream_count; upstream++) {
+            while (shard->idle[upstream]) {
+                tf_proxy_link_ref link = shard->idle[upstream];
+                
+                shard->idle[upstream] = link->next;
+                free(link);
+            }
+        }
+        
+        free(shard->staging);
+    }
+    
+    for (tf_index_t index = 0; index < proxy->upstream_count; index++)
+        free(proxy->upstreams[index].name);
+    
+    free(proxy->shards);
+    free(proxy);
+}
@@ -0,0 +1,84 @@
+//
+//  proxy.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "server.h"
+
+//
+// reverse proxy
+//
+// a handler that passes the requests it gets on to a set of upstream
+// servers (TCP or Unix sockets) and relays their responses back, both
+// bodies go through piece by piece as they arrive and each side is held
+// off (see tf_tcp_set_paused) while the other doesn't keep up, so neither
+// is ever held in memory as a whole
+//
+// every worker keeps its own pool of idle keep-alive connections to each
+// upstream, a request takes the most recently used one (or opens a new
+// one) and gives it back once the response is complete, the upstream with
+// the fewest requests in flight across all the workers gets the request,
+// ties go round-robin
+//
+// requests go upstream as HTTP/1.1 without their hop-by-hop headers and
+// with the client address added to X-Forwarded-For, responses come back
+// with the framing the upstream chose, HTTP/1.0 clients get chunked ones
+// without the chunks and end with the connection
+//
+
+/// most upstreams a proxy may have
+#define TF_PROXY_MAX_UPSTREAMS 64
+/// default amount of idle connections kept per upstream and worker
+#define TF_PROXY_DEFAULT_MAX_IDLE 32
+/// longest upstream response head taken (status line and headers)
+#define TF_PROXY_MAX_RESPONSE_HEAD 16384
+
+/// proxy counters, summed over all the workers
+typedef struct {
+    uint64_t requests;
+    // upstream connections opened
+    uint64_t connects;
+    // requests sent over a pooled connection
+    uint64_t reuses;
+    // idempotent requests sent again on a new connection after a pooled
+    // one turned out to be closed
+    uint64_t retries;
+    // answered with 502 or 504 by the proxy itself
+    uint64_t failures;
+} tf_proxy_stats_t;
+
+/// NULL if there is no memory, server has to be the one the handler runs on
+tf_proxy_ref tf_proxy_init(tf_http_server_ref server);
+
+/// adds an upstream (see tf_tcp_address_parse), false if address cannot
+/// be read or there are TF_PROXY_MAX_UPSTREAMS already, to be called
+/// before the server listens
+bool tf_proxy_add_upstream(tf_proxy_ref proxy, const char* address);
+
+/// idle connections kept per upstream and worker, 0 opens a new connection
+/// for every request
+void tf_proxy_set_max_idle(tf_proxy_ref proxy, const tf_index_t max_idle);
+
+///
+/// a tf_http_handler_t with the proxy as its meta: relays the request to
+/// an upstream, answers 502 if none can be reached (504 if it doesn't
+/// answer in time) and closes the client connection if the upstream
+/// breaks off in the middle of the response
+///
+void tf_proxy_handle(tf_http_server_ref server,
+                     tf_conn_ref conn,
+                     const tf_http_request_t* request,
+                     tf_http_response_t* response,
+                     tf_data_ref meta);
+
+/// can be called from any thread
+void tf_proxy_get_stats(const tf_proxy_ref proxy, tf_proxy_stats_t* statsp);
+
+/// to be called once the server has been released
+void tf_proxy_release(tf_proxy_ref proxy);
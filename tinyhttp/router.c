@@ -0,0 +1,588 @@
+//
+//  router.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "privutil.h"
+#include "router.h"
+
+//
+// private
+//
+
+/// longest pattern, label lengths are 16 bits in the built tree
+#define TF_ROUTER_MAX_PATTERN 65535
+
+/// route as it was added
+typedef struct {
+    // NULL for any method
+    char* method;
+    // owns the capture names
+    char* pattern;
+    
+    tf_router_handler_t handler;
+    tf_data_ref meta;
+    
+    tf_str_view_t names[TF_ROUTER_MAX_PARAMS];
+    tf_index_t param_count;
+} tf_router_route_t;
+
+/// growable list of route indices
+typedef struct {
+    tf_index_t* items;
+    tf_index_t count;
+} tf_router_list_t;
+
+typedef struct tf_router_tree_node_s* tf_router_tree_node_ref;
+
+/// node of the tree routes are added to, only walked when building
+struct tf_router_tree_node_s {
+    char* label;
+    tf_index_t label_length;
+    
+    // static children, their labels start with distinct bytes
+    tf_router_tree_node_ref* children;
+    tf_index_t child_count;
+    // ":name" child
+    tf_router_tree_node_ref param;
+    
+    // routes ending here, and the ones with a "*name" tail starting here
+    tf_router_list_t routes;
+    tf_router_list_t wildcards;
+};
+
+/// built route, what the matcher needs of a tf_router_route_t
+typedef struct {
+    const char* method;
+    tf_router_handler_t handler;
+    tf_data_ref meta;
+    const tf_str_view_t* names;
+} tf_router_target_t;
+
+/// built node, two per cache line
+typedef struct {
+    // into labels
+    uint32_t label;
+    // children are next to each other starting here, their first label
+    // bytes are next to each other in child_chars
+    uint32_t first_child;
+    uint32_t child_chars;
+    // 0 if none, the root is never a child
+    uint32_t param_child;
+    // into targets
+    uint32_t targets;
+    uint32_t wildcard_targets;
+    
+    uint16_t label_length;
+    uint16_t child_count;
+    uint16_t target_count;
+    uint16_t wildcard_count;
+} tf_router_node_t;
+
+struct tf_router_s {
+    tf_router_route_t* routes;
+    tf_index_t route_count;
+    
+    tf_router_tree_node_ref root;
+    
+    // built tree, NULL until tf_router_build
+    tf_router_node_t* nodes;
+    tf_index_t node_count;
+    char* labels;
+    char* child_chars;
+    tf_router_target_t* targets;
+};
+
+void tf_router_list_push(tf_router_list_t* list, const tf_index_t item) {
+    list->items = realloc(list->items, (list->count + 1) * sizeof(tf_index_t));
+    list->items[list->count++] = item;
+}
+
+tf_router_tree_node_ref tf_router_tree_node_init(const char* label,
+                                                 const tf_index_t length) {
+    tf_router_tree_node_ref node = tf_struct_alloc(tf_router_tree_node_s);
+    
+    node->label = strndup(label, length);
+    node->label_length = length;
+    
+    return node;
+}
+
+void tf_router_tree_node_release(tf_router_tree_node_ref node) {
+    if (!node)
+        return;
+    
+    for (tf_index_t index = 0; index < node->child_count; index++)
+        tf_router_tree_node_release(node->children[index]);
+    
+    tf_router_tree_node_release(node->param);
+    
+    free(node->children);
+    free(node->routes.items);
+    free(node->wildcards.items);
+    free(node->label);
+    free(node);
+}
+
+/// walks/extends the tree along static text, returns the node it ends at
+tf_router_tree_node_ref tf_router_tree_insert_static(tf_router_tree_node_ref node,
+                                                     const char* text,
+                                                     tf_index_t length) {
+    while (length > 0) {
+        tf_router_tree_node_ref* slot = NULL;
+        
+        for (tf_index_t index = 0; index < node->child_count; index++) {
+            if (node->children[index]->label[0] == text[0]) {
+                slot = node->children + index;
+                break;
+            }
+        }
+        
+        if (!slot) {
+            tf_router_tree_node_ref child = tf_router_tree_node_init(text, length);
+            
+            node->children = realloc(node->children, (node->child_count + 1) *
+                                     sizeof(tf_router_tree_node_ref));
+            node->children[node->child_count++] = child;
+            
+            return child;
+        }
+        
+        tf_router_tree_node_ref child = *slot;
+        tf_index_t common = 0;
+        
+        while (common < child->label_length && common < length &&
+               child->label[common] == text[common])
+            common++;
+        
+        // the new text branches off inside the label, split it
+        if (common < child->label_length) {
+            tf_router_tree_node_ref middle = tf_router_tree_node_init(child->label, common);
+            
+            memmove(child->label, child->label + common, child->label_length - common + 1);
+            child->label_length -= common;
+            
+            middle->children = malloc(sizeof(tf_router_tree_node_ref));
+            middle->children[0] = child;
+            middle->child_count = 1;
+            
+            *slot = middle;
+            child = middle;
+        }
+        
+        node = child;
+        text += common;
+        length -= common;
+    }
+    
+    return node;
+}
+
+/// false if the list already has a route for the method
+bool tf_router_list_accepts(const tf_router_ref router, const tf_router_list_t* list,
+                            const char* method) {
+    for (tf_index_t index = 0; index < list->count; index++) {
+        const char* existing = router->routes[list->items[index]].method;
+        
+        if ((!existing && !method) || (existing && method && strcmp(existing, method) == 0))
+            return false;
+    }
+    
+    return true;
+}
+
+/// parses the pattern of the route and adds it to the tree
+bool tf_router_tree_insert(tf_router_ref router, const tf_index_t route_index) {
+    tf_router_route_t* route = router->routes + route_index;
+    tf_router_tree_node_ref node = router->root;
+    const char* pattern = route->pattern;
+    const char* current = pattern;
+    bool wildcard = false;
+    
+    while (*current && !wildcard) {
+        // captures only start segments
+        bool segment_start = (current > pattern && current[-1] == '/');
+        
+        if (segment_start && (*current == ':' || *current == '*')) {
+            if (route->param_count >= TF_ROUTER_MAX_PARAMS)
+                return false;
+            
+            const char* end = (*current == ':' ? strchr(current, '/') : NULL);
+            if (!end)
+                end = current + strlen(current);
+            
+            route->names[route->param_count].data = current + 1;
+            route->names[route->param_count].length = (tf_index_t)(end - current - 1);
+            route->param_count++;
+            
+            if (*current == '*') {
+                wildcard = true;
+                continue;
+            }
+            
+            if (!node->param)
+                node->param = tf_router_tree_node_init("", 0);
+            
+            node = node->param;
+            current = end;
+            continue;
+        }
+        
+        const char* end = current + 1;
+        while (*end && !((*end == ':' || *end == '*') && end[-1] == '/'))
+            end++;
+        
+        node = tf_router_tree_insert_static(node, current, (tf_index_t)(end - current));
+        current = end;
+    }
+    
+    tf_router_list_t* list = (wildcard ? &node->wildcards : &node->routes);
+    
+    if (!tf_router_list_accepts(router, list, route->method))
+        return false;
+    
+    tf_router_list_push(list, route_index);
+    return true;
+}
+
+void tf_router_tree_count(const tf_router_tree_node_ref node, tf_index_t* nodesp,
+                          tf_index_t* label_bytesp, tf_index_t* targetsp) {
+    *nodesp += 1;
+    *label_bytesp += node->label_length;
+    *targetsp += node->routes.count + node->wildcards.count;
+    
+    for (tf_index_t index = 0; index < node->child_count; index++)
+        tf_router_tree_count(node->children[index], nodesp, label_bytesp, targetsp);
+    
+    if (node->param)
+        tf_router_tree_count(node->param, nodesp, label_bytesp, targetsp);
+}
+
+uint32_t tf_router_copy_targets(tf_router_ref router, const tf_router_list_t* list,
+                                tf_index_t* offsetp) {
+    uint32_t first = (uint32_t)*offsetp;
+    
+    for (tf_index_t index = 0; index < list->count; index++) {
+        const tf_router_route_t* route = router->routes + list->items[index];
+        tf_router_target_t* target = router->targets + (*offsetp)++;
+        
+        target->method = route->method;
+        target->handler = route->handler;
+        target->meta = route->meta;
+        target->names = route->names;
+    }
+    
+    return first;
+}
+
+void tf_router_clear_built(tf_router_ref router) {
+    free(router->nodes);
+    free(router->labels);
+    free(router->child_chars);
+    free(router->targets);
+    
+    router->nodes = NULL;
+    router->labels = NULL;
+    router->child_chars = NULL;
+    router->targets = NULL;
+    router->node_count = 0;
+}
+
+/// picks the target for the method, HEAD falls back to GET
+bool tf_router_pick(const tf_router_ref router, const uint32_t first,
+                    const uint16_t count, const tf_str_view_t method,
+                    tf_router_match_t* match, bool* path_matchedp) {
+    if (count < 1)
+        return false;
+    
+    *path_matchedp = true;
+    
+    const tf_router_target_t* targets = router->targets + first;
+    const tf_router_target_t* found = NULL;
+    const tf_router_target_t* fallback = NULL;
+    bool head = tf_str_view_equals(method, "HEAD");
+    
+    for (uint16_t index = 0; index < count && !found; index++) {
+        if (!targets[index].method)
+            fallback = targets + index;
+        else if (tf_str_view_equals(method, targets[index].method))
+            found = targets + index;
+        else if (head && strcmp(targets[index].method, "GET") == 0)
+            fallback = targets + index;
+    }
+    
+    if (!found)
+        found = fallback;
+    
+    if (!found)
+        return false;
+    
+    match->handler = found->handler;
+    match->meta = found->meta;
+    
+    for (tf_index_t index = 0; index < match->param_count; index++)
+        match->params[index].name = found->names[index];
+    
+    return true;
+}
+
+///
+/// matches the rest of the path starting at the node (whose label has
+/// already been matched), static children first, then the capture, then
+/// the wildcard, backtracking if a branch leads nowhere
+///
+bool tf_router_walk(const tf_router_ref router, const uint32_t index,
+                    const tf_str_view_t method, const tf_str_view_t path,
+                    const tf_index_t position, tf_router_match_t* match,
+                    bool* path_matchedp) {
+    const tf_router_node_t* node = router->nodes + index;
+    
+    if (position == path.length &&
+        tf_router_pick(router, node->targets, node->target_count, method, match,
+                       path_matchedp))
+        return true;
+    
+    if (position < path.length && node->child_count > 0) {
+        const char* chars = router->child_chars + node->child_chars;
+        const char* hit = memchr(chars, path.data[position], node->child_count);
+        
+        if (hit) {
+            uint32_t child_index = node->first_child + (uint32_t)(hit - chars);
+            const tf_router_node_t* child = router->nodes + child_index;
+            
+            if (child->label_length <= path.length - position &&
+                memcmp(router->labels + child->label, path.data + position,
+                       child->label_length) == 0 &&
+                tf_router_walk(router, child_index, method, path,
+                               position + child->label_length, match, path_matchedp))
+                return true;
+        }
+    }
+    
+    tf_index_t saved = match->param_count;
+    
+    if (saved >= TF_ROUTER_MAX_PARAMS)
+        return false;
+    
+    if (position < path.length && node->param_child) {
+        const char* slash = memchr(path.data + position, '/', path.length - position);
+        tf_index_t end = (slash ? (tf_index_t)(slash - path.data) : path.length);
+        
+        // captures are never empty
+        if (end > position) {
+            match->params[saved].value.data = path.data + position;
+            match->params[saved].value.length = end - position;
+            match->param_count = saved + 1;
+            
+            if (tf_router_walk(router, node->param_child, method, path, end, match,
+                               path_matchedp))
+                return true;
+            
+            match->param_count = saved;
+        }
+    }
+    
+    if (node->wildcard_count > 0) {
+        match->params[saved].value.data = path.data + position;
+        match->params[saved].value.length = path.length - position;
+        match->param_count = saved + 1;
+        
+        if (tf_router_pick(router, node->wildcard_targets, node->wildcard_count, method,
+                           match, path_matchedp))
+            return true;
+        
+        match->param_count = saved;
+    }
+    
+    return false;
+}
+
+//
+// public
+//
+
+tf_router_ref tf_router_init(void) {
+    tf_router_ref router = tf_struct_alloc(tf_router_s);
+    
+    router->root = tf_router_tree_node_init("", 0);
+    return router;
+}
+
+bool tf_router_add(tf_router_ref router, const char* method, const char* pattern,
+                   tf_router_handler_t handler, tf_data_ref meta) {
+    if (!router || !pattern || pattern[0] != '/' || !handler ||
+        strlen(pattern) > TF_ROUTER_MAX_PATTERN)
+        return false;
+    
+    router->routes = realloc(router->routes, (router->route_count + 1) *
+                             sizeof(tf_router_route_t));
+    
+    tf_router_route_t* route = router->routes + router->route_count;
+    bzero(route, sizeof(tf_router_route_t));
+    
+    route->method = (method ? strdup(method) : NULL);
+    route->pattern = strdup(pattern);
+    route->handler = handler;
+    route->meta = meta;
+    
+    if (!tf_router_tree_insert(router, router->route_count)) {
+        TF_LOG_WARN("cannot add route %s %s", (method ? method : "*"), pattern);
+        
+        free(route->method);
+        free(route->pattern);
+        return false;
+    }
+    
+    router->route_count++;
+    
+    // has to be built again
+    tf_router_clear_built(router);
+    return true;
+}
+
+bool tf_router_build(tf_router_ref router) {
+    if (!router)
+        return false;
+    
+    tf_router_clear_built(router);
+    
+    tf_index_t node_count = 0;
+    tf_index_t label_bytes = 0;
+    tf_index_t target_count = 0;
+    
+    tf_router_tree_count(router->root, &node_count, &label_bytes, &target_count);
+    
+    // breadth-first, so the children of every node end up next to each other
+    tf_router_tree_node_ref* queue = malloc(node_count * sizeof(tf_router_tree_node_ref));
+    
+    router->nodes = calloc(node_count, sizeof(tf_router_node_t));
+    router->labels = malloc(label_bytes + 1);
+    router->child_chars = malloc(node_count);
+    router->targets = calloc(target_count + 1, sizeof(tf_router_target_t));
+    router->node_count = node_count;
+    
+    tf_index_t tail = 1;
+    tf_index_t label_offset = 0;
+    tf_index_t char_offset = 0;
+    tf_index_t target_offset = 0;
+    
+    queue[0] = router->root;
+    
+    for (tf_index_t index = 0; index < node_count; index++) {
+        tf_router_tree_node_ref source = queue[index];
+        tf_router_node_t* node = router->nodes + index;
+        
+        node->label = (uint32_t)label_offset;
+        node->label_length = (uint16_t)source->label_length;
+        memcpy(router->labels + label_offset, source->label, source->label_length);
+        label_offset += source->label_length;
+        
+        node->first_child = (uint32_t)tail;
+        node->child_chars = (uint32_t)char_offset;
+        node->child_count = (uint16_t)source->child_count;
+        
+        for (tf_index_t child = 0; child < source->child_count; child++) {
+            router->child_chars[char_offset++] = source->children[child]->label[0];
+            queue[tail++] = source->children[child];
+        }
+        
+        if (source->param) {
+            node->param_child = (uint32_t)tail;
+            queue[tail++] = source->param;
+        }
+        
+        node->target_count = (uint16_t)source->routes.count;
+        node->targets = tf_router_copy_targets(router, &source->routes, &target_offset);
+        node->wildcard_count = (uint16_t)source->wildcards.count;
+        node->wildcard_targets = tf_router_copy_targets(router, &source->wildcards,
+                                                        &target_offset);
+    }
+    
+    free(queue);
+    return true;
+}
+
+tf_router_result_t tf_router_match(const tf_router_ref router,
+                                   const tf_str_view_t method,
+                                   const tf_str_view_t path,
+                                   tf_router_match_t* match) {
+    if (!router || !router->nodes || !match)
+        return TF_ROUTER_NOT_FOUND;
+    
+    bool path_matched = false;
+    
+    match->handler = NULL;
+    match->meta = NULL;
+    match->param_count = 0;
+    
+    if (tf_router_walk(router, 0, method, path, 0, match, &path_matched))
+        return TF_ROUTER_FOUND;
+    
+    return (path_matched ? TF_ROUTER_METHOD_NOT_ALLOWED : TF_ROUTER_NOT_FOUND);
+}
+
+bool tf_router_match_get_param(const tf_router_match_t* match, const char* name,
+                               tf_str_view_t* valuep) {
+    if (!match || !name)
+        return false;
+    
+    for (tf_index_t index = 0; index < match->param_count; index++) {
+        if (tf_str_view_equals(match->params[index].name, name)) {
+            TF_PTR_SET(valuep, match->params[index].value);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void tf_router_dispatch(tf_http_server_ref server,
+                        tf_conn_ref conn,
+                        const tf_http_request_t* request,
+                        tf_http_response_t* response,
+                        tf_data_ref meta) {
+    tf_router_match_t match;
+    
+    switch (tf_router_match((tf_router_ref)meta, request->method, request->path, &match)) {
+        case TF_ROUTER_FOUND:
+            match.handler(server, conn, request, &match, response, match.meta);
+            break;
+        
+        case TF_ROUTER_METHOD_NOT_ALLOWED:
+            response->status = 405;
+            break;
+        
+        default:
+            response->status = 404;
+            break;
+    }
+}
+
+tf_index_t tf_router_get_route_count(const tf_router_ref router) {
+    return (router ? router->route_count : 0);
+}
+
+tf_index_t tf_router_get_node_count(const tf_router_ref router) {
+    return (router ? router->node_count : 0);
+}
+
+void tf_router_release(tf_router_ref router) {
+    if (!router)
+        return;
+    
+    tf_router_clear_built(router);
+    tf_router_tree_node_release(router->root);
+    
+    for (tf_index_t index = 0; index < router->route_count; index++) {
+        free(router->routes[index].method);
+        free(router->routes[index].pattern);
+    }
+    
+    free(router->routes);
+    free(router);
+}
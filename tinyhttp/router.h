@@ -0,0 +1,119 @@
+//
+//  router.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "http.h"
+#include "server.h"
+
+//
+// request router
+//
+// handlers are registered per method and path pattern, patterns are made
+// of static text, ":name" segments capturing one path segment and a
+// trailing "*name" capturing the rest of the path, for example:
+//
+//   /users/:id/posts/:post
+//   /static/*path
+//
+// the patterns are built into a radix tree laid out in one flat array
+// (children of a node are next to each other, their first bytes in a
+// separate array so picking a child touches one cache line), matching
+// walks the tree once per request without allocating, static segments
+// win over captures, captures over the trailing wildcard
+//
+
+/// most captures a single pattern may have
+#define TF_ROUTER_MAX_PARAMS 8
+
+/// one capture of a matched route, views into the pattern and the path
+typedef struct {
+    tf_str_view_t name;
+    tf_str_view_t value;
+} tf_router_param_t;
+
+typedef struct tf_router_match_s tf_router_match_t;
+
+///
+/// route handler
+/// Arguments:
+/// - HTTP server instance
+/// - client connection (see conn.h)
+/// - parsed request, the views are only valid during the call
+/// - matched route with its captures
+/// - response to fill in
+/// - data given when the route was added
+///
+typedef void (*tf_router_handler_t)(tf_http_server_ref,
+                                    tf_conn_ref,
+                                    const tf_http_request_t*,
+                                    const tf_router_match_t*,
+                                    tf_http_response_t*,
+                                    tf_data_ref);
+
+struct tf_router_match_s {
+    tf_router_handler_t handler;
+    tf_data_ref meta;
+    
+    tf_router_param_t params[TF_ROUTER_MAX_PARAMS];
+    tf_index_t param_count;
+};
+
+typedef enum {
+    TF_ROUTER_FOUND,
+    // no pattern matches the path
+    TF_ROUTER_NOT_FOUND,
+    // the path matches but not for this method
+    TF_ROUTER_METHOD_NOT_ALLOWED
+} tf_router_result_t;
+
+tf_router_ref tf_router_init(void);
+
+///
+/// adds a route, method NULL matches any method (HEAD falls back to the GET
+/// handler by itself), returns false for malformed patterns and for routes
+/// that were already added
+///
+bool tf_router_add(tf_router_ref router, const char* method, const char* pattern,
+                   tf_router_handler_t handler, tf_data_ref meta);
+
+///
+/// builds the lookup tree from all the routes added so far, must be called
+/// before matching and again after adding more routes
+///
+bool tf_router_build(tf_router_ref router);
+
+///
+/// finds the route for the request, fills in match unless the result is
+/// TF_ROUTER_NOT_FOUND, can be called from any amount of threads at once
+///
+tf_router_result_t tf_router_match(const tf_router_ref router,
+                                   const tf_str_view_t method,
+                                   const tf_str_view_t path,
+                                   tf_router_match_t* match);
+
+/// value of the named capture, false if the route has no such capture
+bool tf_router_match_get_param(const tf_router_match_t* match, const char* name,
+                               tf_str_view_t* valuep);
+
+///
+/// tf_http_handler_t calling the matching route handler, the router has to
+/// be passed as the handler meta, answers with 404/405 if nothing matches
+///
+void tf_router_dispatch(tf_http_server_ref server,
+                        tf_conn_ref conn,
+                        const tf_http_request_t* request,
+                        tf_http_response_t* response,
+                        tf_data_ref meta);
+
+tf_index_t tf_router_get_route_count(const tf_router_ref router);
+/// nodes in the built tree
+tf_index_t tf_router_get_node_count(const tf_router_ref router);
+
+void tf_router_release(tf_router_ref router);
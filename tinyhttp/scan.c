@@ -0,0 +1,275 @@
+//
+//  scan.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <string.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TF_SCAN_X86 1
+#include <immintrin.h>
+#endif
+#include "privutil.h"
+#include "scan.h"
+
+//
+// private
+//
+
+/// nibble lookup tables of a class, a byte belongs to it if the entries
+/// for its low and its high nibble have a bit in common
+typedef struct {
+    uint8_t low[16];
+    uint8_t high[16];
+} tf_scan_tables_t;
+
+typedef tf_index_t (*tf_scan_kernel_fn_t)(const tf_scan_class_t, const char*,
+                                          tf_index_t, const tf_index_t);
+
+/// a bit per class for each byte, for the scalar kernel and the tails
+static uint8_t tf_scan_bytes[256];
+static tf_scan_tables_t tf_scan_tables[TF_SCAN_CLASS_COUNT];
+
+static pthread_once_t tf_scan_once = PTHREAD_ONCE_INIT;
+/// tf_scan_kernel_t in use, -1 until the tables have been built
+static int tf_scan_active = -1;
+
+bool tf_scan_is_member(const tf_scan_class_t class, const uint8_t c) {
+    switch (class) {
+        case TF_SCAN_TOKEN:
+            return ((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') ||
+                    (c != '\0' && strchr("!#$%&'*+-.^_`|~", c)));
+        case TF_SCAN_VALUE:
+            return (c == '\t' || (c >= 0x20 && c != 0x7f));
+        case TF_SCAN_PATH:
+            return (c > 0x20 && c != 0x7f && c != '?');
+        case TF_SCAN_TARGET:
+            return (c > 0x20 && c != 0x7f);
+        default:
+            return false;
+    }
+}
+
+///
+/// high nibbles with the same set of low nibbles in the class share a bit,
+/// so a class can be told apart this way as long as there are no more than
+/// 8 different sets (the ones above have 3 to 6)
+///
+void tf_scan_build_tables(const tf_scan_class_t class, tf_scan_tables_t* tables) {
+    uint16_t sets[8];
+    tf_index_t set_count = 0;
+    
+    bzero(tables, sizeof(tf_scan_tables_t));
+    
+    for (uint8_t high = 0; high < 16; high++) {
+        uint16_t set = 0;
+        
+        for (uint8_t low = 0; low < 16; low++) {
+            if (tf_scan_is_member(class, (uint8_t)((high << 4) | low)))
+                set |= (uint16_t)(1 << low);
+        }
+        
+        if (set == 0)
+            continue;
+        
+        tf_index_t bit = 0;
+        while (bit < set_count && sets[bit] != set)
+            bit++;
+        
+        if (bit == set_count && set_count < 8)
+            sets[set_count++] = set;
+        
+        tables->high[high] = (uint8_t)(1 << bit);
+        
+        for (uint8_t low = 0; low < 16; low++) {
+            if (set & (1 << low))
+                tables->low[low] |= (uint8_t)(1 << bit);
+        }
+    }
+}
+
+tf_index_t tf_scan_skip_scalar(const tf_scan_class_t class, const char* data,
+                               tf_index_t pos, const tf_index_t end) {
+    const uint8_t bit = (uint8_t)(1 << class);
+    
+    while (pos < end && (tf_scan_bytes[(uint8_t)data[pos]] & bit))
+        pos++;
+    
+    return pos;
+}
+
+#ifdef TF_SCAN_X86
+
+// compiled for the instruction sets they need no matter what the build
+// targets, they're only called once CPUID has said so
+
+/// bit mask of the 16 bytes at data that are not of the class
+static inline __attribute__((target("sse4.2"), always_inline))
+unsigned tf_scan_outside_16(const tf_scan_tables_t* tables, const char* data) {
+    const __m128i low = _mm_loadu_si128((const __m128i*)tables->low);
+    const __m128i high = _mm_loadu_si128((const __m128i*)tables->high);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    
+    __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+    __m128i lows = _mm_shuffle_epi8(low, _mm_and_si128(bytes, nibble));
+    __m128i highs = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+    
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lows, highs),
+                                                      _mm_setzero_si128()));
+}
+
+__attribute__((target("sse4.2")))
+tf_index_t tf_scan_skip_sse42(const tf_scan_class_t class, const char* data,
+                              tf_index_t pos, const tf_index_t end) {
+    const tf_scan_tables_t* tables = tf_scan_tables + class;
+    
+    for (; pos + 16 <= end; pos += 16) {
+        unsigned outside = tf_scan_outside_16(tables, data + pos);
+        
+        if (outside)
+            return pos + (tf_index_t)__builtin_ctz(outside);
+    }
+    
+    return tf_scan_skip_scalar(class, data, pos, end);
+}
+
+__attribute__((target("avx2")))
+tf_index_t tf_scan_skip_avx2(const tf_scan_class_t class, const char* data,
+                             tf_index_t pos, const tf_index_t end) {
+    const tf_scan_tables_t* tables = tf_scan_tables + class;
+    
+    if (pos + 32 <= end) {
+        // the shuffles look up within each 128-bit lane, so both get the tables
+        const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)
+                                                                        tables->low));
+        const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)
+                                                                         tables->high));
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        
+        for (; pos + 32 <= end; pos += 32) {
+            __m256i bytes = _mm256_loadu_si256((const __m256i*)(data + pos));
+            __m256i lows = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+            __m256i highs = _mm256_shuffle_epi8(high,
+                                                _mm256_and_si256(_mm256_srli_epi16(bytes, 4),
+                                                                 nibble));
+            unsigned outside = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_and_si256(lows, highs), zero));
+            
+            if (outside)
+                return pos + (tf_index_t)__builtin_ctz(outside);
+        }
+    }
+    
+    // a last half-width step (VEX encoded here, no switching back to SSE)
+    // before going byte by byte
+    if (pos + 16 <= end) {
+        unsigned outside = tf_scan_outside_16(tables, data + pos);
+        
+        if (outside)
+            return pos + (tf_index_t)__builtin_ctz(outside);
+        
+        pos += 16;
+    }
+    
+    return tf_scan_skip_scalar(class, data, pos, end);
+}
+
+static const tf_scan_kernel_fn_t tf_scan_kernels[TF_SCAN_KERNEL_COUNT] = {
+    tf_scan_skip_scalar,
+    tf_scan_skip_sse42,
+    tf_scan_skip_avx2
+};
+
+#else
+
+static const tf_scan_kernel_fn_t tf_scan_kernels[TF_SCAN_KERNEL_COUNT] = {
+    tf_scan_skip_scalar,
+    tf_scan_skip_scalar,
+    tf_scan_skip_scalar
+};
+
+#endif
+
+void tf_scan_setup(void) {
+    for (tf_index_t class = 0; class < TF_SCAN_CLASS_COUNT; class++) {
+        tf_scan_build_tables((tf_scan_class_t)class, tf_scan_tables + class);
+        
+        for (tf_index_t c = 0; c < 256; c++) {
+            if (tf_scan_is_member((tf_scan_class_t)class, (uint8_t)c))
+                tf_scan_bytes[c] |= (uint8_t)(1 << class);
+        }
+    }
+    
+    tf_scan_kernel_t kernel = TF_SCAN_KERNEL_AVX2;
+    while (kernel > TF_SCAN_KERNEL_SCALAR && !tf_scan_kernel_is_supported(kernel))
+        kernel--;
+    
+    TF_LOG_DEBUG("scanning with the %s kernel", tf_scan_kernel_get_name(kernel));
+    
+    // publishes the tables as well
+    __atomic_store_n(&tf_scan_active, (int)kernel, __ATOMIC_RELEASE);
+}
+
+int tf_scan_get_active(void) {
+    int kernel = __atomic_load_n(&tf_scan_active, __ATOMIC_ACQUIRE);
+    
+    if (kernel < 0) {
+        pthread_once(&tf_scan_once, tf_scan_setup);
+        kernel = __atomic_load_n(&tf_scan_active, __ATOMIC_ACQUIRE);
+    }
+    
+    return kernel;
+}
+
+//
+// public
+//
+
+tf_index_t tf_scan_skip(const tf_scan_class_t class, const char* data,
+                        const tf_index_t start, const tf_index_t end) {
+    if (!data || start >= end || class >= TF_SCAN_CLASS_COUNT)
+        return start;
+    
+    return tf_scan_kernels[tf_scan_get_active()](class, data, start, end);
+}
+
+tf_scan_kernel_t tf_scan_get_kernel(void) {
+    return (tf_scan_kernel_t)tf_scan_get_active();
+}
+
+const char* tf_scan_kernel_get_name(const tf_scan_kernel_t kernel) {
+    switch (kernel) {
+        case TF_SCAN_KERNEL_SCALAR: return "scalar";
+        case TF_SCAN_KERNEL_SSE42: return "sse4.2";
+        case TF_SCAN_KERNEL_AVX2: return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+bool tf_scan_kernel_is_supported(const tf_scan_kernel_t kernel) {
+#ifdef TF_SCAN_X86
+    __builtin_cpu_init();
+    
+    if (kernel == TF_SCAN_KERNEL_SSE42)
+        return __builtin_cpu_supports("sse4.2");
+    if (kernel == TF_SCAN_KERNEL_AVX2)
+        return __builtin_cpu_supports("avx2");
+#endif
+    
+    return (kernel == TF_SCAN_KERNEL_SCALAR);
+}
+
+bool tf_scan_set_kernel(const tf_scan_kernel_t kernel) {
+    if (!tf_scan_kernel_is_supported(kernel))
+        return false;
+    
+    tf_scan_get_active();
+    __atomic_store_n(&tf_scan_active, (int)kernel, __ATOMIC_RELEASE);
+    
+    return true;
+}
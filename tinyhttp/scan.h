@@ -0,0 +1,61 @@
+//
+//  scan.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// byte class scanning for the request parser
+//
+// skips runs of bytes that all belong to one class (header name, header
+// value, request target) and stops at the first one that doesn't, which
+// is either the delimiter the parser is looking for (colon, CR, space...)
+// or an invalid byte, so finding line ends and validating the bytes
+// before them is one and the same pass
+//
+// the x86 kernels classify 16 (SSE4.2) or 32 (AVX2) bytes at a time
+// through two 16-entry lookup tables indexed by the low and high nibble of
+// each byte, the best one the CPU has is picked on first use, everything
+// else falls back to a 256-entry table walked byte by byte
+//
+
+typedef enum {
+    // RFC 9110 tchar, header names and the method
+    TF_SCAN_TOKEN,
+    // field-value characters, HTAB, SP, VCHAR or obs-text
+    TF_SCAN_VALUE,
+    // request target characters except for '?', the path
+    TF_SCAN_PATH,
+    // request target characters, visible ASCII or obs-text, the query
+    TF_SCAN_TARGET,
+    TF_SCAN_CLASS_COUNT
+} tf_scan_class_t;
+
+typedef enum {
+    TF_SCAN_KERNEL_SCALAR,
+    TF_SCAN_KERNEL_SSE42,
+    TF_SCAN_KERNEL_AVX2,
+    TF_SCAN_KERNEL_COUNT
+} tf_scan_kernel_t;
+
+/// position of the first byte in [start, end) not of the class, end if
+/// there is none
+tf_index_t tf_scan_skip(const tf_scan_class_t class, const char* data,
+                        const tf_index_t start, const tf_index_t end);
+
+/// kernel tf_scan_skip uses
+tf_scan_kernel_t tf_scan_get_kernel(void);
+const char* tf_scan_kernel_get_name(const tf_scan_kernel_t kernel);
+
+/// whether the CPU can run the kernel
+bool tf_scan_kernel_is_supported(const tf_scan_kernel_t kernel);
+
+/// switches all the threads to another kernel (for benchmarks), false if
+/// the CPU cannot run it
+bool tf_scan_set_kernel(const tf_scan_kernel_t kernel);
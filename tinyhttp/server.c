@@ -0,0 +1,1774 @@
+//
+//  server.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "privutil.h"
+#include "admit.h"
+#include "arena.h"
+#include "bufpool.h"
+#include "cache.h"
+#include "conn.h"
+#include "metrics.h"
+#include "pool.h"
+#include "tcp.h"
+#include "server.h"
+
+//
+// private
+//
+
+/// space for a formatted response head
+#define TF_HTTP_SERVER_MAX_RESPONSE_HEAD 512
+/// room for counters growing between measuring the metrics text and
+/// writing it
+#define TF_HTTP_SERVER_METRICS_SLACK 1024
+/// longest response cache key (path, query and vary header values),
+/// requests with longer ones are not cached
+#define TF_HTTP_SERVER_MAX_CACHE_KEY 2048
+/// request headers the response cache key can include
+#define TF_HTTP_SERVER_MAX_VARY 8
+
+struct tf_http_server_s {
+    tf_tcp_ref tcp;
+    
+    // set by tf_http_server_listen
+    tf_http_handler_t handler;
+    tf_data_ref handler_meta;
+    
+    // answered by the server itself, NULL if disabled
+    char* metrics_path;
+    
+    // for deferred requests, started by tf_http_server_listen if pool_size
+    // is set
+    tf_index_t pool_size;
+    tf_pool_ref pool;
+    
+    // started by tf_http_server_listen if cache_size is set
+    uint64_t cache_size;
+    tf_cache_ref cache;
+    // the Vary header value, NULL if none, and the header names in it
+    char* vary;
+    char* vary_names[TF_HTTP_SERVER_MAX_VARY];
+    tf_index_t vary_count;
+    
+    // started by tf_http_server_listen if any of the options is set
+    tf_admit_options_t admit_options;
+    tf_admit_ref admit;
+    
+    // longest request body taken, see tf_http_server_set_max_body_size
+    uint64_t max_body_size;
+};
+
+/// request answered by the thread pool, lives in its own arena
+typedef struct tf_http_deferred_s* tf_http_deferred_ref;
+struct tf_http_deferred_s {
+    tf_http_server_ref server;
+    // NULL once the connection is gone, the response is dropped then
+    tf_conn_ref conn;
+    tf_arena_ref arena;
+    
+    tf_http_deferred_handler_t handler;
+    tf_data_ref meta;
+    
+    // views into a copy of the request kept in the arena
+    tf_http_request_t request;
+    tf_http_response_t response;
+    bool keep_alive;
+    bool http10;
+    bool head_only;
+    // waited too long for a pool thread, refused without the handler
+    bool shed;
+    
+    // parser call that completed the request, in nanoseconds
+    uint64_t parse;
+    tf_pool_job_t job;
+};
+
+/// response streamed piece by piece, see tf_http_server_stream
+struct tf_http_stream_s {
+    tf_http_server_ref server;
+    // NULL once the connection is gone or the response is complete
+    tf_conn_ref conn;
+    
+    // written by the handler, goes out after the head
+    tf_buffer_ref pending;
+    // the head has been queued
+    bool attached;
+    // called from inside the TCP callback, the output goes out after it
+    bool dispatching;
+    bool ended;
+    
+    tf_http_producer_t producer;
+    tf_data_ref producer_meta;
+    tf_deallocator_t producer_release;
+    
+    // told once the queued output goes down, asked for each time
+    tf_http_drain_handler_t drain;
+    tf_data_ref drain_meta;
+    
+    // HTTP/1.0 bodies can't be chunked, they end with the connection
+    bool chunked;
+    bool keep_alive;
+    bool head_only;
+    // the writes are the whole response, head and framing included, see
+    // tf_http_server_relay
+    bool raw;
+};
+
+/// request body received after its handler, lives in its own arena
+struct tf_http_body_s {
+    tf_http_server_ref server;
+    tf_conn_ref conn;
+    tf_arena_ref arena;
+    
+    // NULL if nobody wants the body, it's skipped then and the response
+    // has gone out already
+    tf_http_body_complete_t complete;
+    tf_http_body_handler_t handler;
+    tf_data_ref meta;
+    // -1 unless the body goes into a file
+    int fd;
+    
+    // views into a copy of the request head kept in the arena
+    tf_http_request_t request;
+    bool keep_alive;
+    bool http10;
+    bool head_only;
+    
+    bool chunked;
+    // the response is relayed while the body arrives, complete only learns
+    // how it went
+    bool relayed;
+    // a body with a Content-Length is all TF_HTTP_CHUNKED_DATA, left is
+    // what's still to come of the whole of it then
+    tf_http_chunked_t framing;
+    uint64_t received;
+    uint64_t max_length;
+    // the TCP server splices the payload into fd
+    bool splicing;
+    // 0 while all is well, the status the request fails with otherwise
+    uint16_t error;
+    
+    // parser call that completed the request and when the handler was
+    // called, in nanoseconds
+    uint64_t parse;
+    uint64_t started_at;
+};
+
+///
+/// refusals sent before a request is parsed, so nothing else is known about
+/// it and the connection cannot go on after them
+///
+static const char tf_http_server_throttled[] =
+    "HTTP/1.1 429 Too Many Requests\r\nServer: tinyhttp\r\nContent-Length: 0\r\n"
+    "Retry-After: 1\r\nConnection: close\r\n\r\n";
+static const char tf_http_server_shed[] =
+    "HTTP/1.1 503 Service Unavailable\r\nServer: tinyhttp\r\nContent-Length: 0\r\n"
+    "Retry-After: 1\r\nConnection: close\r\n\r\n";
+
+/// fixed-width chunk size line, so producers can write right behind it
+#define TF_HTTP_STREAM_CHUNK_HEAD 10
+static const char tf_http_stream_last_chunk[] = "0\r\n\r\n";
+
+/// end of a response head, the Connection header (if any) and the empty line
+const char* tf_http_server_get_head_end(const bool keep_alive, const bool http10) {
+    // HTTP/1.1 connections stay open by default, HTTP/1.0 ones only if
+    // the client asked for it and hears it back
+    if (!keep_alive)
+        return "Connection: close\r\n\r\n";
+    
+    return (http10 ? "Connection: keep-alive\r\n\r\n" : "\r\n");
+}
+
+///
+/// formats the response head up to the Connection header, with ETag and
+/// Vary headers if they are not NULL, returns its length, 0 if it doesn't
+/// fit (never happens unless the content type is insane)
+///
+tf_index_t tf_http_server_format_head(char* head, const tf_index_t capacity,
+                                      const tf_http_response_t* response,
+                                      const char* etag, const char* vary) {
+    int hlen = snprintf(head, capacity,
+                        "HTTP/1.1 %u %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Server: tinyhttp\r\n"
+                        "Content-Length: %u\r\n"
+                        "%s%s%s"
+                        "%s%s%s",
+                        response->status, tf_http_status_get_reason(response->status),
+                        (response->content_type ? response->content_type :
+                         "text/html; charset=UTF-8"),
+                        (response->file ? tf_buffer_get_length(response->file) :
+                         response->body.length),
+                        (etag ? "ETag: " : ""), (etag ? etag : ""), (etag ? "\r\n" : ""),
+                        (vary ? "Vary: " : ""), (vary ? vary : ""), (vary ? "\r\n" : ""));
+    
+    return ((hlen < 0 || hlen >= (int)capacity) ? 0 : (tf_index_t)hlen);
+}
+
+tf_buffer_ref tf_http_server_append_response(tf_buffer_ref output,
+                                             const tf_http_response_t* response,
+                                             const bool keep_alive,
+                                             const bool http10,
+                                             const bool head_only) {
+    const char* end = tf_http_server_get_head_end(keep_alive, http10);
+    char head[TF_HTTP_SERVER_MAX_RESPONSE_HEAD];
+    tf_index_t hlen = tf_http_server_format_head(head, sizeof(head), response, NULL, NULL);
+    
+    output = tf_buffer_chain_append(output, head, hlen);
+    output = tf_buffer_chain_append(output, end, (tf_index_t)strlen(end));
+    
+    if (response->file) {
+        if (head_only || !output) {
+            tf_buffer_release(response->file);
+            return output;
+        }
+        
+        // goes out right after the head, straight from the file
+        tf_buffer_ref last = output;
+        while (tf_buffer_get_next(last))
+            last = tf_buffer_get_next(last);
+        
+        tf_buffer_set_next(last, response->file);
+        return output;
+    }
+    
+    if (!head_only && response->body.data && response->body.length > 0)
+        output = tf_buffer_chain_append(output, response->body.data,
+                                        response->body.length);
+    
+    return output;
+}
+
+tf_buffer_ref tf_http_server_append_error(tf_http_server_ref server,
+                                          tf_conn_ref conn,
+                                          tf_buffer_ref output,
+                                          const uint16_t status) {
+    tf_http_response_t response = { status, NULL, { NULL, 0 }, NULL, true, 0 };
+    
+    tf_metrics_count_response(tf_tcp_get_metrics(server->tcp),
+                              tf_conn_get_worker_id(conn), status);
+    
+    return tf_http_server_append_response(output, &response, false, false, false);
+}
+
+bool tf_http_server_is_metrics_request(const tf_http_server_ref server,
+                                       const tf_http_request_t* request) {
+    return (server->metrics_path &&
+            (tf_str_view_equals(request->method, "GET") ||
+             tf_str_view_equals(request->method, "HEAD")) &&
+            tf_str_view_equals(request->path, server->metrics_path));
+}
+
+void tf_http_server_handle_metrics(tf_http_server_ref server, tf_conn_ref conn,
+                                   tf_http_response_t* response) {
+    tf_metrics_ref metrics = tf_tcp_get_metrics(server->tcp);
+    tf_index_t capacity = tf_metrics_format(metrics, NULL, 0) +
+                          TF_HTTP_SERVER_METRICS_SLACK;
+    char* text = tf_arena_alloc(tf_conn_get_arena(conn), capacity);
+    
+    if (!text) {
+        response->status = 500;
+        return;
+    }
+    
+    tf_index_t length = tf_metrics_format(metrics, text, capacity);
+    
+    response->content_type = "text/plain; version=0.0.4; charset=utf-8";
+    response->body.data = text;
+    response->body.length = (length < capacity ? length : capacity - 1);
+}
+
+/// appends length bytes to the key being built, false if they don't fit
+bool tf_http_server_key_append(char* key, tf_index_t* lengthp, const tf_index_t capacity,
+                               const char* data, const tf_index_t length) {
+    if (*lengthp + length > capacity)
+        return false;
+    
+    if (length > 0)
+        memcpy(key + *lengthp, data, length);
+    
+    *lengthp += length;
+    return true;
+}
+
+///
+/// response cache key of the request in key, an empty view if the request
+/// cannot be answered from the cache (no cache, not a GET/HEAD, a body,
+/// too long a key)
+///
+tf_str_view_t tf_http_server_get_cache_key(const tf_http_server_ref server,
+                                           const tf_http_request_t* request,
+                                           const bool has_body,
+                                           char* key, const tf_index_t capacity) {
+    tf_str_view_t result = { key, 0 };
+    
+    if (!server->cache || has_body ||
+        (!tf_str_view_equals(request->method, "GET") &&
+         !tf_str_view_equals(request->method, "HEAD")))
+        return result;
+    
+    tf_index_t length = 0;
+    tf_str_view_t host = tf_http_request_get_known_header(request, TF_HTTP_HEADER_HOST);
+    
+    // every virtual host (or upstream host behind a proxy) has its own
+    bool fits = (tf_http_server_key_append(key, &length, capacity, host.data, host.length) &&
+                 tf_http_server_key_append(key, &length, capacity, "\n", 1) &&
+                 tf_http_server_key_append(key, &length, capacity, request->path.data,
+                                           request->path.length));
+    
+    if (fits && request->query.length > 0)
+        fits = (tf_http_server_key_append(key, &length, capacity, "?", 1) &&
+                tf_http_server_key_append(key, &length, capacity, request->query.data,
+                                          request->query.length));
+    
+    // a missing header and an empty one are the same thing here
+    for (tf_index_t index = 0; fits && index < server->vary_count; index++) {
+        tf_str_view_t value = tf_http_request_get_header(request, server->vary_names[index]);
+        
+        fits = (tf_http_server_key_append(key, &length, capacity, "\n", 1) &&
+                tf_http_server_key_append(key, &length, capacity, value.data, value.length));
+    }
+    
+    result.length = (fits ? length : 0);
+    return result;
+}
+
+/// caches the response the handler produced, NULL if that didn't work out
+tf_cache_entry_ref tf_http_server_store_response(tf_http_server_ref server,
+                                                 const tf_index_t worker,
+                                                 const tf_str_view_t key,
+                                                 const tf_http_response_t* response) {
+    char etag[TF_CACHE_ETAG_SIZE];
+    tf_cache_make_etag(response->body.data, response->body.length, etag);
+    
+    char head[TF_HTTP_SERVER_MAX_RESPONSE_HEAD];
+    tf_str_view_t cached_head = { head, tf_http_server_format_head(head, sizeof(head),
+                                                                   response, etag,
+                                                                   server->vary) };
+    
+    if (cached_head.length < 1)
+        return NULL;
+    
+    return tf_cache_insert(server->cache, worker, key, etag, cached_head, response->body,
+                           response->cache_ttl);
+}
+
+///
+/// appends the cached response, or a 304 with its validators if
+/// not_modified is set, nothing is formatted but the Connection header
+/// and the 304 head
+///
+tf_buffer_ref tf_http_server_append_cached(const tf_http_server_ref server,
+                                           tf_buffer_ref output,
+                                           tf_cache_entry_ref entry,
+                                           const bool keep_alive,
+                                           const bool http10,
+                                           const bool head_only,
+                                           const bool not_modified) {
+    const char* end = tf_http_server_get_head_end(keep_alive, http10);
+    
+    if (not_modified) {
+        char head[TF_HTTP_SERVER_MAX_RESPONSE_HEAD];
+        int hlen = snprintf(head, sizeof(head),
+                            "HTTP/1.1 304 Not Modified\r\n"
+                            "Server: tinyhttp\r\n"
+                            "ETag: %s\r\n"
+                            "%s%s%s"
+                            "%s",
+                            tf_cache_entry_get_etag(entry),
+                            (server->vary ? "Vary: " : ""),
+                            (server->vary ? server->vary : ""),
+                            (server->vary ? "\r\n" : ""), end);
+        
+        if (hlen < 0 || hlen >= (int)sizeof(head))
+            hlen = 0;
+        
+        return tf_buffer_chain_append(output, head, (tf_index_t)hlen);
+    }
+    
+    tf_str_view_t head = tf_cache_entry_get_head(entry);
+    
+    output = tf_buffer_chain_append(output, head.data, head.length);
+    output = tf_buffer_chain_append(output, end, (tf_index_t)strlen(end));
+    
+    return (head_only ? output : tf_cache_entry_append_body(entry, output));
+}
+
+/// moves a view into bytes over to the same place in copy
+void tf_http_server_rebase_view(tf_str_view_t* view, const char* bytes,
+                                const tf_index_t length, const char* copy) {
+    if (view->data >= bytes && view->data <= bytes + length)
+        view->data = copy + (view->data - bytes);
+}
+
+/// runs on a pool thread
+void tf_http_server_run_deferred(tf_data_ref data) {
+    tf_http_deferred_ref deferred = (tf_http_deferred_ref)data;
+    tf_pool_job_t* job = &deferred->job;
+    
+    // the time it would take is better spent on a request that can still
+    // be answered in time
+    if (tf_admit_is_overdue(deferred->server->admit, job->queued_at, job->started_at)) {
+        deferred->response.status = 503;
+        deferred->response.close = true;
+        deferred->shed = true;
+        return;
+    }
+    
+    deferred->handler(&deferred->request, &deferred->response, deferred->arena,
+                      deferred->meta);
+}
+
+void tf_http_server_handle_input(tf_http_server_ref server, tf_conn_ref conn);
+
+/// appends chain to the end of output, returns the chain head
+tf_buffer_ref tf_http_server_chain_link(tf_buffer_ref output, tf_buffer_ref chain) {
+    if (!output)
+        return chain;
+    
+    tf_buffer_ref last = output;
+    while (tf_buffer_get_next(last))
+        last = tf_buffer_get_next(last);
+    
+    tf_buffer_set_next(last, chain);
+    return output;
+}
+
+void tf_http_stream_free(tf_http_stream_ref stream) {
+    tf_buffer_release(stream->pending);
+    
+    if (stream->producer_release)
+        stream->producer_release(stream->producer_meta);
+    
+    free(stream);
+}
+
+/// the stream is done with its connection, frees it unless the handler
+/// still has to end it
+void tf_http_stream_detach(tf_http_stream_ref stream) {
+    if (stream->conn)
+        tf_conn_set_stream(stream->conn, NULL);
+    
+    stream->conn = NULL;
+    
+    if (stream->ended || stream->producer)
+        tf_http_stream_free(stream);
+}
+
+/// response head of a streamed response up to the final CRLF
+tf_buffer_ref tf_http_stream_append_head(tf_http_stream_ref stream, tf_buffer_ref output,
+                                         const tf_http_response_t* response) {
+    const char* end = tf_http_server_get_head_end(stream->keep_alive, !stream->chunked);
+    char head[TF_HTTP_SERVER_MAX_RESPONSE_HEAD];
+    int hlen = snprintf(head, sizeof(head),
+                        "HTTP/1.1 %u %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Server: tinyhttp\r\n"
+                        "%s",
+                        response->status, tf_http_status_get_reason(response->status),
+                        (response->content_type ? response->content_type :
+                         "text/html; charset=UTF-8"),
+                        (stream->chunked ? "Transfer-Encoding: chunked\r\n" : ""));
+    
+    if (hlen < 0 || hlen >= (int)sizeof(head))
+        hlen = 0;
+    
+    output = tf_buffer_chain_append(output, head, (tf_index_t)hlen);
+    return tf_buffer_chain_append(output, end, (tf_index_t)strlen(end));
+}
+
+/// one piece of the body with its chunk framing
+tf_buffer_ref tf_http_stream_frame(const tf_http_stream_ref stream, tf_buffer_ref output,
+                                   const char* data, const tf_index_t length) {
+    char size[TF_HTTP_STREAM_CHUNK_HEAD + 1];
+    
+    if (stream->chunked) {
+        snprintf(size, sizeof(size), "%x\r\n", length);
+        output = tf_buffer_chain_append(output, size, (tf_index_t)strlen(size));
+    }
+    
+    output = tf_buffer_chain_append(output, data, length);
+    
+    return (stream->chunked ? tf_buffer_chain_append(output, "\r\n", 2) : output);
+}
+
+///
+/// queues the end of the body and lets the connection go on with the
+/// requests after it (if next_request is set, the caller does otherwise),
+/// the stream is gone afterwards unless the handler still has to end it
+///
+void tf_http_stream_finish(tf_http_stream_ref stream, const bool next_request) {
+    tf_http_server_ref server = stream->server;
+    tf_conn_ref conn = stream->conn;
+    bool keep_alive = stream->keep_alive;
+    
+    if (stream->chunked && !stream->head_only)
+        tf_conn_queue_output(conn, tf_http_stream_last_chunk,
+                             sizeof(tf_http_stream_last_chunk) - 1);
+    
+    tf_http_stream_detach(stream);
+    
+    if (!keep_alive)
+        tf_conn_close(conn);
+    else if (next_request)
+        tf_http_server_handle_input(server, conn);
+}
+
+///
+/// runs the producer until TF_HTTP_SERVER_STREAM_AHEAD bytes are queued or
+/// the body is complete, each piece goes into a pooled buffer of its own
+/// with the chunk framing around it
+///
+void tf_http_stream_produce(tf_http_stream_ref stream) {
+    tf_conn_ref conn = stream->conn;
+    tf_index_t head = (stream->chunked ? TF_HTTP_STREAM_CHUNK_HEAD : 0);
+    tf_index_t tail = (stream->chunked ? 2 : 0);
+    
+    stream->dispatching = true;
+    
+    while (!stream->ended && !tf_conn_is_closing(conn) &&
+           tf_conn_get_output_length(conn) < TF_HTTP_SERVER_STREAM_AHEAD) {
+        tf_buffer_ref buffer = tf_buffer_acquire(TF_HTTP_SERVER_STREAM_CHUNK + head + tail);
+        
+        if (!buffer) {
+            tf_conn_close(conn);
+            break;
+        }
+        
+        char* data = tf_buffer_get_data(buffer);
+        tf_index_t capacity = tf_buffer_get_capacity(buffer) - head - tail;
+        bool end = false;
+        tf_index_t length = stream->producer(data + head, capacity, &end,
+                                             stream->producer_meta);
+        
+        if (length > capacity)
+            length = capacity;
+        
+        if (length < 1) {
+            tf_buffer_release(buffer);
+            
+            // a truncated body must not look complete, so no last chunk
+            if (!end) {
+                TF_LOG_WARN("producer of socket %d returned nothing, closing",
+                            tf_conn_get_socket(conn));
+                
+                tf_conn_close(conn);
+                break;
+            }
+        } else {
+            if (stream->chunked) {
+                // zero-padded, the size line has to be exactly this long
+                char size[TF_HTTP_STREAM_CHUNK_HEAD + 1];
+                snprintf(size, sizeof(size), "%08x\r\n", length);
+                
+                memcpy(data, size, head);
+                memcpy(data + head + length, "\r\n", tail);
+            }
+            
+            tf_buffer_set_length(buffer, head + length + tail);
+            tf_conn_queue_buffer(conn, buffer);
+        }
+        
+        stream->ended = (stream->ended || end);
+    }
+    
+    stream->dispatching = false;
+    
+    if (tf_conn_is_closing(conn))
+        return; // the stream goes with the connection
+    
+    if (stream->ended)
+        tf_http_stream_finish(stream, true);
+    else
+        tf_conn_set_wants_drain(conn, true);
+}
+
+///
+/// queues the head of the response the handler has just started streaming
+/// and whatever it has written so far, returns true if the stream goes on
+/// after the handler
+///
+bool tf_http_stream_attach(tf_http_stream_ref stream, tf_http_response_t* response,
+                           tf_buffer_ref* outputp) {
+    tf_conn_ref conn = stream->conn;
+    tf_buffer_ref output = (stream->raw ? *outputp :
+                            tf_http_stream_append_head(stream, *outputp, response));
+    
+    stream->keep_alive = (stream->keep_alive && !response->close);
+    
+    if (stream->head_only)
+        tf_buffer_release(stream->pending);
+    else
+        output = tf_http_server_chain_link(output, stream->pending);
+    
+    stream->pending = NULL;
+    stream->attached = true;
+    stream->dispatching = false;
+    
+    // the body may come from a producer that hasn't been called yet
+    *outputp = output;
+    
+    if (stream->ended || stream->head_only) {
+        tf_conn_queue_buffer(conn, output);
+        *outputp = NULL;
+        
+        tf_http_stream_finish(stream, false);
+        return false;
+    }
+    
+    if (stream->producer || stream->drain)
+        tf_conn_set_wants_drain(conn, true);
+    
+    return true;
+}
+
+///
+/// starts receiving the body of request after its handler, the body is
+/// skipped unless the handler asks for it, NULL if there is no memory
+///
+tf_http_body_ref tf_http_body_init(tf_http_server_ref server, tf_conn_ref conn,
+                                   const tf_http_request_t* request, const bool chunked,
+                                   const uint64_t length) {
+    tf_arena_ref arena = tf_arena_init(TF_ARENA_DEFAULT_CHUNK_SIZE);
+    if (!arena)
+        return NULL;
+    
+    tf_http_body_ref body = tf_arena_struct_alloc(arena, tf_http_body_s);
+    
+    // stray CRLFs may come before the request line and the empty line
+    // after the last header, the views are what's in between
+    const char* start = request->method.data;
+    const char* end = request->version.data + request->version.length;
+    
+    for (tf_index_t index = 0; index < request->header_count; index++) {
+        const tf_http_header_t* header = &request->headers[index];
+        
+        if (header->value.data + header->value.length > end)
+            end = header->value.data + header->value.length;
+        if (header->name.data + header->name.length > end)
+            end = header->name.data + header->name.length;
+    }
+    
+    char* copy = (body ? tf_arena_alloc(arena, (tf_index_t)(end - start)) : NULL);
+    
+    if (!copy) {
+        tf_arena_release(arena);
+        return NULL;
+    }
+    
+    memcpy(copy, start, (size_t)(end - start));
+    
+    body->request = *request;
+    tf_http_request_t* own = &body->request;
+    tf_index_t span = (tf_index_t)(end - start);
+    
+    tf_http_server_rebase_view(&own->method, start, span, copy);
+    tf_http_server_rebase_view(&own->path, start, span, copy);
+    tf_http_server_rebase_view(&own->query, start, span, copy);
+    tf_http_server_rebase_view(&own->version, start, span, copy);
+    
+    for (tf_index_t index = 0; index < own->header_count; index++) {
+        tf_http_server_rebase_view(&own->headers[index].name, start, span, copy);
+        tf_http_server_rebase_view(&own->headers[index].value, start, span, copy);
+    }
+    
+    body->server = server;
+    body->conn = conn;
+    body->arena = arena;
+    body->fd = -1;
+    
+    body->keep_alive = tf_http_request_wants_keep_alive(request);
+    body->http10 = (request->version_minor < 1);
+    body->head_only = tf_str_view_equals(request->method, "HEAD");
+    
+    body->chunked = chunked;
+    body->framing.left = (chunked ? 0 : length);
+    body->framing.state = (chunked ? TF_HTTP_CHUNKED_SIZE :
+                           (length > 0 ? TF_HTTP_CHUNKED_DATA : TF_HTTP_CHUNKED_DONE));
+    body->max_length = server->max_body_size;
+    
+    tf_conn_set_body(conn, body);
+    return body;
+}
+
+/// hands a piece of the payload to the handler and the file, false if
+/// either of them didn't take it
+bool tf_http_body_deliver(tf_http_body_ref body, const char* data, const tf_index_t length) {
+    if (body->handler && !body->handler(data, length, body->meta))
+        return false;
+    
+    for (tf_index_t written = 0; body->fd >= 0 && written < length; ) {
+        ssize_t chunk = write(body->fd, data + written, length - written);
+        
+        if (chunk < 0 && errno == EINTR)
+            continue;
+        
+        if (chunk <= 0)
+            return false;
+        
+        written += (tf_index_t)chunk;
+    }
+    
+    return true;
+}
+
+/// one byte of the chunk framing, false if the body is malformed or too
+/// large, the error is set then
+bool tf_http_body_frame(tf_http_body_ref body, const char c) {
+    switch (tf_http_chunked_feed(&body->framing, c, body->max_length - body->received)) {
+        case TF_HTTP_PARSE_INCOMPLETE:
+        case TF_HTTP_PARSE_DONE:
+            return true;
+        case TF_HTTP_PARSE_TOO_LARGE:
+            body->error = 413;
+            return false;
+        default:
+            body->error = 400;
+            return false;
+    }
+}
+
+/// takes in as much of data as belongs to the body, returns how much that is
+tf_index_t tf_http_body_feed(tf_http_body_ref body, const char* data, const tf_index_t length) {
+    tf_index_t position = 0;
+    
+    tf_http_chunked_t* framing = &body->framing;
+    
+    while (position < length && framing->state != TF_HTTP_CHUNKED_DONE && body->error == 0) {
+        if (framing->state != TF_HTTP_CHUNKED_DATA) {
+            tf_http_body_frame(body, data[position++]);
+            continue;
+        }
+        
+        tf_index_t take = length - position;
+        if (framing->left < take)
+            take = (tf_index_t)framing->left;
+        
+        if (!tf_http_body_deliver(body, data + position, take))
+            body->error = 500;
+        
+        position += take;
+        framing->left -= take;
+        body->received += take;
+        
+        if (framing->left < 1)
+            framing->state = (body->chunked ? TF_HTTP_CHUNKED_DATA_CR : TF_HTTP_CHUNKED_DONE);
+    }
+    
+    return position;
+}
+
+///
+/// the body is complete or cannot be received: appends the response from
+/// the complete callback (if there is one) to output and lets the
+/// connection go on with the next request, the body is gone afterwards
+///
+tf_buffer_ref tf_http_body_finish(tf_http_body_ref body, tf_buffer_ref output) {
+    tf_http_server_ref server = body->server;
+    tf_conn_ref conn = body->conn;
+    
+    if (body->splicing)
+        tf_tcp_set_splice(server->tcp, conn, -1, 0);
+    
+    if (body->complete && body->relayed) {
+        tf_http_response_t response = { 200, NULL, { NULL, 0 }, NULL, false, 0 };
+        
+        // the response is on its way already, whatever comes back is ignored
+        body->complete(&body->request, body->error, &response, body->arena, body->meta);
+        tf_buffer_release(response.file);
+        
+        if (body->error > 0)
+            tf_conn_close(conn);
+    } else if (body->complete) {
+        tf_http_response_t response = { 200, NULL, { NULL, 0 }, NULL, false, 0 };
+        tf_metrics_ref metrics = tf_tcp_get_metrics(server->tcp);
+        tf_index_t worker = tf_conn_get_worker_id(conn);
+        
+        body->complete(&body->request, body->error, &response, body->arena, body->meta);
+        
+        if (body->error > 0) {
+            tf_buffer_release(response.file);
+            response = (tf_http_response_t){ body->error, NULL, { NULL, 0 }, NULL, true, 0 };
+        }
+        
+        tf_metrics_record_request(metrics, worker, body->parse,
+                                  tf_monotonic_ns() - body->started_at, response.status);
+        
+        bool keep_alive = (body->keep_alive && !response.close);
+        output = tf_http_server_append_response(output, &response, keep_alive, body->http10,
+                                                body->head_only);
+        
+        if (!keep_alive)
+            tf_conn_close(conn);
+    } else if (body->error > 0) {
+        // the response went out already, what follows can't be made sense of
+        tf_conn_close(conn);
+    }
+    
+    tf_conn_set_body(conn, NULL);
+    tf_arena_release(body->arena);
+    
+    return output;
+}
+
+///
+/// takes in what input has of the body, appends the response to *outputp
+/// once it's complete and returns how much of input was taken, the rest of
+/// a payload with nothing else in the way is spliced into its file
+///
+tf_index_t tf_http_body_receive(tf_http_body_ref body, const char* input,
+                                const tf_index_t length, tf_buffer_ref* outputp) {
+    tf_index_t consumed = tf_http_body_feed(body, input, length);
+    
+    if (body->framing.state == TF_HTTP_CHUNKED_DONE || body->error > 0) {
+        *outputp = tf_http_body_finish(body, *outputp);
+        return consumed;
+    }
+    
+    if (consumed == length && body->framing.state == TF_HTTP_CHUNKED_DATA && body->fd >= 0 &&
+        !body->handler && !body->splicing)
+        body->splicing = tf_tcp_set_splice(body->server->tcp, body->conn, body->fd,
+                                           body->framing.left);
+    
+    return consumed;
+}
+
+/// length bytes of the payload went into the file, none if that failed
+void tf_http_body_spliced(tf_http_body_ref body, const tf_index_t length) {
+    tf_http_server_ref server = body->server;
+    tf_conn_ref conn = body->conn;
+    
+    if (length < 1) {
+        body->splicing = false;
+        body->error = 500;
+    } else {
+        body->framing.left -= length;
+        body->received += length;
+        
+        // the chunk framing and whatever comes after go through the input
+        if (body->framing.left < 1) {
+            body->splicing = false;
+            body->framing.state = (body->chunked ? TF_HTTP_CHUNKED_DATA_CR :
+                                   TF_HTTP_CHUNKED_DONE);
+        }
+    }
+    
+    if (body->framing.state != TF_HTTP_CHUNKED_DONE && body->error < 1)
+        return;
+    
+    tf_buffer_ref output = tf_http_body_finish(body, NULL);
+    
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    if (output && timing->queued_at < 1)
+        timing->queued_at = tf_monotonic_ns();
+    
+    tf_conn_queue_buffer(conn, output);
+    
+    // sets the deadline for the next request
+    if (!tf_conn_is_closing(conn))
+        tf_http_server_handle_input(server, conn);
+}
+
+/// the connection is gone before the body is complete
+void tf_http_body_abandon(tf_http_body_ref body) {
+    tf_http_response_t response = { 200, NULL, { NULL, 0 }, NULL, false, 0 };
+    
+    // nobody is left to answer, but whatever the body went into is cleaned up
+    if (body->complete) {
+        body->complete(&body->request, 400, &response, body->arena, body->meta);
+        tf_buffer_release(response.file);
+    }
+    
+    tf_conn_set_body(body->conn, NULL);
+    tf_arena_release(body->arena);
+}
+
+///
+/// takes in what input has of the body of a request whose response is
+/// relayed meanwhile, a stream ended by the body's callbacks is finished
+/// right after them, returns how much of input was taken
+///
+tf_index_t tf_http_stream_receive_body(tf_http_stream_ref stream, tf_http_body_ref body,
+                                       const char* input, const tf_index_t length,
+                                       tf_buffer_ref* outputp) {
+    stream->dispatching = true;
+    
+    tf_index_t consumed = tf_http_body_receive(body, input, length, outputp);
+    
+    stream->dispatching = false;
+    
+    if (stream->ended)
+        tf_http_stream_finish(stream, false);
+    
+    return consumed;
+}
+
+/// back on the connection's worker through its mailbox
+void tf_http_server_complete_deferred(tf_data_ref data) {
+    tf_http_deferred_ref deferred = (tf_http_deferred_ref)data;
+    tf_http_server_ref server = deferred->server;
+    tf_conn_ref conn = deferred->conn;
+    tf_http_response_t* response = &deferred->response;
+    
+    tf_admit_leave(server->admit);
+    
+    if (!conn) {
+        tf_buffer_release(response->file);
+        tf_arena_release(deferred->arena);
+        return;
+    }
+    
+    tf_metrics_ref metrics = tf_tcp_get_metrics(server->tcp);
+    tf_index_t worker = tf_conn_get_worker_id(conn);
+    tf_pool_job_t* job = &deferred->job;
+    
+    tf_metrics_record(metrics, worker, TF_METRICS_POOL_WAIT, job->started_at - job->queued_at);
+    tf_metrics_count(metrics, worker, (deferred->shed ? TF_METRICS_REQUESTS_SHED :
+                                                        TF_METRICS_REQUESTS_DEFERRED), 1);
+    tf_metrics_record_request(metrics, worker, deferred->parse,
+                              job->finished_at - job->started_at, response->status);
+    
+    bool keep_alive = (deferred->keep_alive && !response->close);
+    tf_buffer_ref output = NULL;
+    
+    if (deferred->shed)
+        output = tf_buffer_chain_append(NULL, tf_http_server_shed,
+                                        sizeof(tf_http_server_shed) - 1);
+    else
+        output = tf_http_server_append_response(NULL, response, keep_alive,
+                                                deferred->http10, deferred->head_only);
+    
+    tf_conn_set_deferred(conn, NULL);
+    tf_arena_release(deferred->arena);
+    
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    if (output && timing->queued_at < 1)
+        timing->queued_at = tf_monotonic_ns();
+    
+    tf_conn_queue_buffer(conn, output);
+    
+    // requests pipelined behind this one have been waiting in the input
+    if (!keep_alive)
+        tf_conn_close(conn);
+    else
+        tf_http_server_handle_input(server, conn);
+    
+    tf_tcp_resume(server->tcp, conn);
+}
+
+///
+/// copies the request deferred by the handler (length bytes at bytes, head
+/// and body) into its arena and queues it, forgets it and returns false if
+/// that fails
+///
+bool tf_http_server_submit_deferred(tf_http_server_ref server, tf_conn_ref conn,
+                                    const tf_http_request_t* request,
+                                    const char* bytes, const tf_index_t length,
+                                    const uint64_t parse) {
+    tf_http_deferred_ref deferred = (tf_http_deferred_ref)tf_conn_get_deferred(conn);
+    char* copy = tf_arena_alloc(deferred->arena, (length > 0 ? length : 1));
+    
+    if (copy) {
+        memcpy(copy, bytes, length);
+        
+        deferred->request = *request;
+        tf_http_request_t* own = &deferred->request;
+        
+        tf_http_server_rebase_view(&own->method, bytes, length, copy);
+        tf_http_server_rebase_view(&own->path, bytes, length, copy);
+        tf_http_server_rebase_view(&own->query, bytes, length, copy);
+        tf_http_server_rebase_view(&own->version, bytes, length, copy);
+        
+        for (tf_index_t index = 0; index < own->header_count; index++) {
+            tf_http_server_rebase_view(&own->headers[index].name, bytes, length, copy);
+            tf_http_server_rebase_view(&own->headers[index].value, bytes, length, copy);
+        }
+        
+        deferred->keep_alive = tf_http_request_wants_keep_alive(request);
+        deferred->http10 = (request->version_minor < 1);
+        deferred->head_only = tf_str_view_equals(request->method, "HEAD");
+        deferred->parse = parse;
+        
+        deferred->job.run = tf_http_server_run_deferred;
+        deferred->job.data = deferred;
+        deferred->job.mailbox = tf_tcp_get_mailbox(server->tcp, tf_conn_get_worker_id(conn));
+        deferred->job.complete.run = tf_http_server_complete_deferred;
+        deferred->job.complete.data = deferred;
+    }
+    
+    // belongs to the pool from here on
+    if (copy && tf_pool_submit(server->pool, &deferred->job))
+        return true;
+    
+    tf_conn_set_deferred(conn, NULL);
+    tf_arena_release(deferred->arena);
+    
+    return false;
+}
+
+void tf_http_server_handle_input(tf_http_server_ref server, tf_conn_ref conn) {
+    tf_index_t length = 0;
+    char* input = tf_conn_get_input(conn, &length);
+    tf_http_parser_t* parser = tf_conn_get_parser(conn);
+    tf_metrics_ref metrics = tf_tcp_get_metrics(server->tcp);
+    tf_index_t worker = tf_conn_get_worker_id(conn);
+    uint64_t handled_at = 0;
+    
+    // all the responses to the requests in this batch are queued together
+    tf_buffer_ref output = NULL;
+    tf_index_t consumed = 0;
+    bool awaiting_body = false;
+    bool deferring = false;
+    bool streaming = false;
+    
+    // whatever comes after a deferred or streamed request waits for its
+    // response
+    if (tf_conn_get_deferred(conn))
+        return;
+    
+    tf_http_body_ref body = (tf_http_body_ref)tf_conn_get_body(conn);
+    tf_http_stream_ref relay = (tf_http_stream_ref)tf_conn_get_stream(conn);
+    
+    // only the body of a relayed request goes on meanwhile
+    if (relay && (!body || body->splicing))
+        return;
+    
+    // the rest of a body comes before the next request, none of it is in
+    // the input while it's spliced
+    if (relay)
+        consumed = tf_http_stream_receive_body(relay, body, input, length, &output);
+    else if (body && !body->splicing)
+        consumed = tf_http_body_receive(body, input, length, &output);
+    
+    // there may be several pipelined requests, answer them in order
+    while (consumed < length && !tf_conn_is_closing(conn) && !tf_conn_get_body(conn) &&
+           !tf_conn_get_stream(conn)) {
+        tf_http_request_t request;
+        uint64_t started_at = tf_monotonic_ns();
+        
+        // the start of a new request, nothing has been spent on it yet
+        if (server->admit && parser->position < 1) {
+            const char* refusal = NULL;
+            tf_index_t refusal_length = 0;
+            
+            if (tf_admit_is_saturated(server->admit)) {
+                tf_metrics_count(metrics, worker, TF_METRICS_REQUESTS_SHED, 1);
+                tf_metrics_count_response(metrics, worker, 503);
+                refusal = tf_http_server_shed;
+                refusal_length = sizeof(tf_http_server_shed) - 1;
+            }
+            else if (!tf_admit_take_token(server->admit, tf_conn_get_client_key(conn),
+                                          started_at)) {
+                tf_metrics_count(metrics, worker, TF_METRICS_REQUESTS_THROTTLED, 1);
+                tf_metrics_count_response(metrics, worker, 429);
+                refusal = tf_http_server_throttled;
+                refusal_length = sizeof(tf_http_server_throttled) - 1;
+            }
+            
+            if (refusal) {
+                output = tf_buffer_chain_append(output, refusal, refusal_length);
+                tf_conn_close(conn);
+                break;
+            }
+        }
+        
+        tf_http_parse_status_t status = tf_http_parser_execute(parser, input + consumed,
+                                                               length - consumed,
+                                                               &request);
+        
+        if (status == TF_HTTP_PARSE_INCOMPLETE)
+            break; // wait for more data
+        
+        uint64_t parsed_at = tf_monotonic_ns();
+        
+        if (status != TF_HTTP_PARSE_DONE) {
+            output = tf_http_server_append_error(server, conn, output,
+                                                 (status == TF_HTTP_PARSE_TOO_LARGE ?
+                                                  431 : 400));
+            tf_conn_close(conn);
+            break;
+        }
+        
+        uint64_t body_length = 0;
+        
+        if (!tf_http_request_get_content_length(&request, &body_length)) {
+            output = tf_http_server_append_error(server, conn, output, 400);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        tf_str_view_t encoding = tf_http_request_get_known_header(&request,
+                                                                  TF_HTTP_HEADER_TRANSFER_ENCODING);
+        bool chunked = (encoding.data != NULL);
+        
+        // chunked is the only coding taken, on its own
+        if (chunked && (!tf_http_header_has_token(encoding, "chunked") ||
+                        memchr(encoding.data, ',', encoding.length))) {
+            output = tf_http_server_append_error(server, conn, output, 501);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        // which one counts is up for interpretation, a classic for smuggling
+        if (chunked && tf_http_request_get_known_header(&request,
+                                                        TF_HTTP_HEADER_CONTENT_LENGTH).data) {
+            output = tf_http_server_append_error(server, conn, output, 400);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        if (body_length > server->max_body_size) {
+            output = tf_http_server_append_error(server, conn, output, 413);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        // small bodies are there before the handler runs, the others come
+        // after it, see tf_http_server_receive_body
+        bool streamed = (chunked || body_length > TF_HTTP_SERVER_MAX_BUFFERED_BODY);
+        tf_index_t buffered = (streamed ? 0 : (tf_index_t)body_length);
+        
+        // the whole request has to fit into the input buffer, with room
+        // for one more read
+        if (request.head_length + buffered > TF_BUFPOOL_MAX_SIZE - TF_TCP_MAX_PKT_SIZE) {
+            output = tf_http_server_append_error(server, conn, output, 413);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        if (consumed + request.head_length + buffered > length) {
+            awaiting_body = true;
+            break; // body is still on its way, the parser stays done till then
+        }
+        
+        // skipped unless the handler asks for it
+        if (streamed && !tf_http_body_init(server, conn, &request, chunked, body_length)) {
+            output = tf_http_server_append_error(server, conn, output, 500);
+            tf_conn_close(conn);
+            break;
+        }
+        
+        tf_http_response_t response = { 200, NULL, { NULL, 0 }, NULL, false, 0 };
+        char key_data[TF_HTTP_SERVER_MAX_CACHE_KEY];
+        tf_str_view_t key = { key_data, 0 };
+        tf_cache_entry_ref cached = NULL;
+        
+        if (tf_http_server_is_metrics_request(server, &request))
+            tf_http_server_handle_metrics(server, conn, &response);
+        else {
+            key = tf_http_server_get_cache_key(server, &request, body_length > 0 || chunked,
+                                               key_data, sizeof(key_data));
+            
+            if (key.length > 0)
+                cached = tf_cache_lookup(server->cache, worker, key);
+            
+            // a hit is answered without the handler
+            if (!cached) {
+                tf_admit_enter(server->admit);
+                server->handler(server, conn, &request, &response, server->handler_meta);
+                
+                // a deferred request is in flight until its response is back
+                if (!tf_conn_get_deferred(conn))
+                    tf_admit_leave(server->admit);
+            }
+        }
+        
+        handled_at = tf_monotonic_ns();
+        
+        if (tf_conn_get_deferred(conn)) {
+            // what the handler put into the response so far doesn't count
+            tf_buffer_release(response.file);
+            
+            if (tf_http_server_submit_deferred(server, conn, &request, input + consumed,
+                                               request.head_length + buffered,
+                                               parsed_at - started_at)) {
+                consumed += request.head_length + buffered;
+                tf_http_parser_reset(parser);
+                tf_conn_reset_arena(conn);
+                
+                deferring = true;
+                break;
+            }
+            
+            // every pool queue is full, better a quick no than a long wait
+            tf_admit_leave(server->admit);
+            response = (tf_http_response_t){ 503, NULL, { NULL, 0 }, NULL, false, 0 };
+        }
+        
+        body = (tf_http_body_ref)tf_conn_get_body(conn);
+        tf_http_stream_ref stream = (tf_http_stream_ref)tf_conn_get_stream(conn);
+        
+        // answered once the body is in, by its complete callback
+        if (body && body->complete && !stream) {
+            tf_buffer_release(response.file);
+            body->parse = parsed_at - started_at;
+            body->started_at = parsed_at;
+            
+            consumed += request.head_length;
+            tf_http_parser_reset(parser);
+            tf_conn_reset_arena(conn);
+            
+            consumed += tf_http_body_receive(body, input + consumed, length - consumed, &output);
+            continue;
+        }
+        
+        if (stream) {
+            tf_buffer_release(response.file);
+            tf_metrics_record_request(metrics, worker, parsed_at - started_at,
+                                      handled_at - parsed_at, response.status);
+            
+            // a relayed request's body goes on while the response comes back
+            consumed += request.head_length + (body ? 0 : buffered);
+            tf_http_parser_reset(parser);
+            tf_conn_reset_arena(conn);
+            
+            // queued right away, so the request after it sees them in order
+            streaming = tf_http_stream_attach(stream, &response, &output);
+            
+            if (streaming && body)
+                consumed += tf_http_stream_receive_body(stream, body, input + consumed,
+                                                        length - consumed, &output);
+            else if (body)
+                consumed += tf_http_body_receive(body, input + consumed, length - consumed,
+                                                 &output);
+            
+            streaming = (tf_conn_get_stream(conn) != NULL);
+            
+            if (streaming)
+                break;
+            
+            continue;
+        }
+        
+        bool head_only = tf_str_view_equals(request.method, "HEAD");
+        
+        // stored before it goes out, so its head is only formatted once,
+        // HEAD handlers may leave the body out so only GET ones count
+        if (!cached && key.length > 0 && !head_only && response.cache_ttl > 0 &&
+            response.status == 200 && !response.file)
+            cached = tf_http_server_store_response(server, worker, key, &response);
+        
+        tf_str_view_t if_none_match = tf_http_request_get_known_header(&request,
+                                                                       TF_HTTP_HEADER_IF_NONE_MATCH);
+        bool not_modified = (cached && tf_http_header_matches_etag(if_none_match,
+                                                                   tf_cache_entry_get_etag(cached)));
+        
+        tf_metrics_record_request(metrics, worker, parsed_at - started_at,
+                                  handled_at - parsed_at,
+                                  (not_modified ? 304 : response.status));
+        
+        bool keep_alive = (tf_http_request_wants_keep_alive(&request) &&
+                           !response.close);
+        
+        if (cached)
+            output = tf_http_server_append_cached(server, output, cached, keep_alive,
+                                                  request.version_minor < 1, head_only,
+                                                  not_modified);
+        else
+            output = tf_http_server_append_response(output, &response, keep_alive,
+                                                    request.version_minor < 1, head_only);
+        
+        consumed += request.head_length + buffered;
+        tf_http_parser_reset(parser);
+        
+        // the response has been copied out, request-scoped objects can go
+        tf_conn_reset_arena(conn);
+        
+        if (!keep_alive)
+            tf_conn_close(conn);
+        else if (body)
+            consumed += tf_http_body_receive(body, input + consumed, length - consumed, &output);
+    }
+    
+    // whatever is left is the beginning of the next request
+    tf_conn_consume_input(conn, consumed);
+    
+    // the head of a request has to arrive in one go, its body and the next
+    // request may take their time
+    if (awaiting_body || tf_conn_get_body(conn))
+        tf_tcp_set_read_timeout(server->tcp, conn, TF_TCP_TIMEOUT_BODY, true);
+    else if (deferring || streaming || tf_conn_get_stream(conn))
+        tf_tcp_set_read_timeout(server->tcp, conn, TF_TCP_TIMEOUT_HANDLER, true);
+    else if (consumed < length)
+        tf_tcp_set_read_timeout(server->tcp, conn, TF_TCP_TIMEOUT_HEADER, consumed > 0);
+    else
+        tf_tcp_set_read_timeout(server->tcp, conn, TF_TCP_TIMEOUT_IDLE, true);
+    
+    // requests pipelined behind a response that is still being made wait
+    // in the kernel instead of piling up in the input, a body being
+    // received is read on (its receiver may hold it off on its own)
+    if (tf_conn_get_deferred(conn) || (tf_conn_get_stream(conn) && !tf_conn_get_body(conn)))
+        tf_tcp_set_paused(server->tcp, conn, true);
+    else if (!tf_conn_get_body(conn))
+        tf_tcp_set_paused(server->tcp, conn, false);
+    
+    // the write drain time starts with the first response of the batch
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    if (output && timing->queued_at < 1)
+        timing->queued_at = (handled_at > 0 ? handled_at : tf_monotonic_ns());
+    
+    // sent by the TCP server as soon as the socket takes it
+    tf_conn_queue_buffer(conn, output);
+}
+
+void tf_http_server_tcp_callback(tf_tcp_ref tcp,
+                                 tf_tcp_connection_type_t ctype,
+                                 tf_data_ref const rdt,
+                                 const tf_index_t rdl,
+                                 tf_conn_ref conn,
+                                 tf_index_t worker,
+                                 tf_data_ref meta) {
+    (void)(tcp);
+    (void)(rdt);
+    (void)(worker);
+    
+    tf_http_server_ref server = (tf_http_server_ref)meta;
+    
+    // looked up once, the address doesn't change
+    if (ctype == TF_TCP_CONNECTION_NEW && server->admit)
+        tf_conn_set_client_key(conn, tf_admit_get_client_key(tf_conn_get_socket(conn)));
+    
+    // everything received so far is kept on the connection
+    if (ctype == TF_TCP_CONNECTION_CONTINUE)
+        tf_http_server_handle_input((tf_http_server_ref)meta, conn);
+    
+    tf_http_body_ref body = (tf_http_body_ref)tf_conn_get_body(conn);
+    
+    // the TCP server moved a piece of the body into its file
+    if (ctype == TF_TCP_CONNECTION_SPLICED && body)
+        tf_http_body_spliced(body, rdl);
+    
+    tf_http_stream_ref stream = (tf_http_stream_ref)tf_conn_get_stream(conn);
+    
+    // the producer of a streamed response tops up the output, a writer
+    // that held off gets going again
+    if (ctype == TF_TCP_CONNECTION_DRAINED && stream && stream->producer)
+        tf_http_stream_produce(stream);
+    else if (ctype == TF_TCP_CONNECTION_DRAINED && stream && stream->drain) {
+        tf_http_drain_handler_t drain = stream->drain;
+        
+        stream->drain = NULL;
+        drain(stream, stream->drain_meta);
+    }
+    
+    if (ctype != TF_TCP_CONNECTION_CLOSE)
+        return;
+    
+    // a pool thread may still be working on its request
+    tf_http_deferred_ref deferred = (tf_http_deferred_ref)tf_conn_get_deferred(conn);
+    if (deferred) {
+        deferred->conn = NULL;
+        tf_conn_set_deferred(conn, NULL);
+    }
+    
+    // its handler's writes fail from now on
+    if (stream)
+        tf_http_stream_detach(stream);
+    
+    if (body)
+        tf_http_body_abandon(body);
+}
+
+//
+// public
+//
+
+tf_http_server_ref tf_http_server_init(const char* ipv4a,
+                                       const tf_port_t port,
+                                       const tf_index_t max_clients,
+                                       const tf_index_t workers) {
+    tf_tcp_ref tcp = tf_tcp_init(ipv4a, port, max_clients, workers);
+    if (!tcp)
+        return NULL;
+    
+    tf_http_server_ref server = tf_struct_alloc(tf_http_server_s);
+    server->tcp = tcp;
+    
+    tf_admit_get_default_options(&server->admit_options);
+    server->max_body_size = TF_HTTP_SERVER_DEFAULT_MAX_BODY_SIZE;
+    
+    tf_tcp_set_timeout(tcp, TF_TCP_TIMEOUT_HEADER, TF_HTTP_SERVER_DEFAULT_HEADER_TIMEOUT);
+    tf_tcp_set_timeout(tcp, TF_TCP_TIMEOUT_BODY, TF_HTTP_SERVER_DEFAULT_BODY_TIMEOUT);
+    tf_tcp_set_timeout(tcp, TF_TCP_TIMEOUT_IDLE, TF_HTTP_SERVER_DEFAULT_IDLE_TIMEOUT);
+    tf_tcp_set_timeout(tcp, TF_TCP_TIMEOUT_WRITE, TF_HTTP_SERVER_DEFAULT_WRITE_TIMEOUT);
+    tf_tcp_set_timeout(tcp, TF_TCP_TIMEOUT_HANDLER, TF_HTTP_SERVER_DEFAULT_HANDLER_TIMEOUT);
+    
+    return server;
+}
+
+void tf_http_server_set_timeout(tf_http_server_ref server,
+                                const tf_tcp_timeout_t timeout,
+                                const tf_index_t length) {
+    if (server)
+        tf_tcp_set_timeout(server->tcp, timeout, length);
+}
+
+bool tf_http_server_listen(tf_http_server_ref server,
+                           const tf_http_handler_t handler,
+                           tf_data_ref meta) {
+    if (!server || !handler)
+        return false;
+    
+    server->handler = handler;
+    server->handler_meta = meta;
+    
+    if (server->pool_size > 0 && !server->pool) {
+        server->pool = tf_pool_init(server->pool_size);
+        
+        if (server->pool)
+            tf_metrics_set_pool(tf_tcp_get_metrics(server->tcp), server->pool);
+        else
+            TF_LOG_WARN("Cannot start the thread pool, requests won't be deferred");
+    }
+    
+    if (server->cache_size > 0 && !server->cache) {
+        server->cache = tf_cache_init(tf_tcp_get_worker_count(server->tcp),
+                                      server->cache_size);
+        tf_metrics_set_cache(tf_tcp_get_metrics(server->tcp), server->cache);
+    }
+    
+    if (!server->admit)
+        server->admit = tf_admit_init(&server->admit_options);
+    
+    return tf_tcp_listen(server->tcp, tf_http_server_tcp_callback, server);
+}
+
+void tf_http_server_set_metrics_path(tf_http_server_ref server, const char* path) {
+    if (!server)
+        return;
+    
+    free(server->metrics_path);
+    server->metrics_path = (path ? strdup(path) : NULL);
+}
+
+void tf_http_server_set_pool_size(tf_http_server_ref server, const tf_index_t threads) {
+    if (server)
+        server->pool_size = threads;
+}
+
+void tf_http_server_set_admission(tf_http_server_ref server,
+                                  const tf_admit_options_t* options) {
+    if (server && options)
+        server->admit_options = *options;
+}
+
+void tf_http_server_set_max_body_size(tf_http_server_ref server, const uint64_t max_bytes) {
+    if (server)
+        server->max_body_size = max_bytes;
+}
+
+void tf_http_server_set_cache(tf_http_server_ref server, const uint64_t max_bytes,
+                              const char* vary) {
+    if (!server)
+        return;
+    
+    server->cache_size = max_bytes;
+    
+    free(server->vary);
+    server->vary = NULL;
+    
+    for (tf_index_t index = 0; index < server->vary_count; index++)
+        free(server->vary_names[index]);
+    
+    server->vary_count = 0;
+    
+    if (!vary || max_bytes < 1)
+        return;
+    
+    // the names are looked up one by one, the value goes out as it is
+    const char* name = vary;
+    
+    while (*name && server->vary_count < TF_HTTP_SERVER_MAX_VARY) {
+        while (*name == ',' || *name == ' ' || *name == '\t')
+            name++;
+        
+        size_t length = strcspn(name, ", \t");
+        if (length > 0)
+            server->vary_names[server->vary_count++] = strndup(name, length);
+        
+        name += length;
+    }
+    
+    if (server->vary_count > 0)
+        server->vary = strdup(vary);
+}
+
+bool tf_http_server_defer(tf_http_server_ref server, tf_conn_ref conn,
+                          const tf_http_deferred_handler_t handler, tf_data_ref meta) {
+    if (!server || !server->pool || !conn || !handler || tf_conn_get_deferred(conn) ||
+        tf_conn_get_stream(conn) || tf_conn_get_body(conn))
+        return false;
+    
+    tf_arena_ref arena = tf_arena_init(TF_ARENA_DEFAULT_CHUNK_SIZE);
+    if (!arena)
+        return false;
+    
+    tf_http_deferred_ref deferred = tf_arena_struct_alloc(arena, tf_http_deferred_s);
+    if (!deferred) {
+        tf_arena_release(arena);
+        return false;
+    }
+    
+    deferred->server = server;
+    deferred->conn = conn;
+    deferred->arena = arena;
+    deferred->handler = handler;
+    deferred->meta = meta;
+    deferred->response.status = 200;
+    
+    // picked up by tf_http_server_handle_input once the handler returns
+    tf_conn_set_deferred(conn, deferred);
+    return true;
+}
+
+tf_http_stream_ref tf_http_server_stream(tf_http_server_ref server, tf_conn_ref conn,
+                                         const tf_http_request_t* request) {
+    if (!server || !conn || !request || tf_conn_get_deferred(conn) ||
+        tf_conn_get_stream(conn) || tf_conn_get_body(conn))
+        return NULL;
+    
+    tf_http_stream_ref stream = tf_struct_alloc(tf_http_stream_s);
+    if (!stream)
+        return NULL;
+    
+    stream->server = server;
+    stream->conn = conn;
+    stream->dispatching = true;
+    stream->chunked = (request->version_minor >= 1);
+    stream->keep_alive = (stream->chunked && tf_http_request_wants_keep_alive(request));
+    stream->head_only = tf_str_view_equals(request->method, "HEAD");
+    
+    // picked up by tf_http_server_handle_input once the handler returns
+    tf_conn_set_stream(conn, stream);
+    return stream;
+}
+
+tf_http_stream_ref tf_http_server_relay(tf_http_server_ref server, tf_conn_ref conn,
+                                        const tf_http_request_t* request) {
+    if (!server || !conn || !request || tf_conn_get_deferred(conn) ||
+        tf_conn_get_stream(conn))
+        return NULL;
+    
+    tf_http_stream_ref stream = tf_struct_alloc(tf_http_stream_s);
+    if (!stream)
+        return NULL;
+    
+    stream->server = server;
+    stream->conn = conn;
+    stream->dispatching = true;
+    stream->raw = true;
+    stream->keep_alive = tf_http_request_wants_keep_alive(request);
+    
+    // a body that comes after the handler doesn't hold the response back
+    tf_http_body_ref body = (tf_http_body_ref)tf_conn_get_body(conn);
+    if (body)
+        body->relayed = true;
+    
+    // picked up by tf_http_server_handle_input once the handler returns
+    tf_conn_set_stream(conn, stream);
+    return stream;
+}
+
+bool tf_http_stream_write(tf_http_stream_ref stream, const char* data,
+                          const tf_index_t length) {
+    if (!stream || (!data && length > 0))
+        return false;
+    
+    // a HEAD response has no body to write
+    if (stream->head_only)
+        return true;
+    
+    tf_conn_ref conn = stream->conn;
+    
+    if (!conn || stream->ended || stream->producer || tf_conn_is_closing(conn))
+        return false;
+    
+    // an empty chunk would end the body
+    if (length < 1)
+        return true;
+    
+    if (!stream->attached) {
+        stream->pending = tf_http_stream_frame(stream, stream->pending, data, length);
+        return true;
+    }
+    
+    tf_http_server_ref server = stream->server;
+    
+    tf_conn_queue_buffer(conn, tf_http_stream_frame(stream, NULL, data, length));
+    tf_tcp_set_read_timeout(server->tcp, conn, TF_TCP_TIMEOUT_HANDLER, true);
+    
+    // a write from a mailbox task or another connection's handler
+    if (!stream->dispatching)
+        tf_tcp_resume(server->tcp, conn);
+    
+    return true;
+}
+
+tf_index_t tf_http_stream_get_queued(const tf_http_stream_ref stream) {
+    if (!stream)
+        return 0;
+    
+    if (!stream->attached)
+        return tf_buffer_chain_get_length(stream->pending);
+    
+    return (stream->conn ? tf_conn_get_output_length(stream->conn) : 0);
+}
+
+void tf_http_stream_set_producer(tf_http_stream_ref stream,
+                                 const tf_http_producer_t producer,
+                                 tf_data_ref meta, const tf_deallocator_t release) {
+    if (!stream || !producer || stream->producer || stream->ended) {
+        if (release)
+            release(meta);
+        
+        return;
+    }
+    
+    stream->producer = producer;
+    stream->producer_meta = meta;
+    stream->producer_release = release;
+    
+    tf_conn_ref conn = stream->conn;
+    
+    // the head is out (or the client gone) already, nothing waits for it
+    if (!conn) {
+        tf_http_stream_free(stream);
+        return;
+    }
+    
+    // a HEAD response is complete with its head
+    if (stream->head_only) {
+        stream->ended = true;
+        return;
+    }
+    
+    // otherwise the first drain notification after the handler starts it
+    if (stream->attached && !stream->dispatching) {
+        tf_conn_set_wants_drain(conn, true);
+        tf_tcp_resume(stream->server->tcp, conn);
+    }
+}
+
+void tf_http_stream_set_drain_handler(tf_http_stream_ref stream,
+                                      const tf_http_drain_handler_t handler,
+                                      tf_data_ref meta) {
+    if (!stream)
+        return;
+    
+    stream->drain = handler;
+    stream->drain_meta = meta;
+    
+    // the next flush tells, before the handler returns attaching does
+    if (handler && stream->attached && stream->conn)
+        tf_conn_set_wants_drain(stream->conn, true);
+}
+
+void tf_http_stream_set_close(tf_http_stream_ref stream) {
+    if (stream)
+        stream->keep_alive = false;
+}
+
+void tf_http_stream_end(tf_http_stream_ref stream) {
+    if (!stream)
+        return;
+    
+    tf_conn_ref conn = stream->conn;
+    
+    // the client has gone or the response is complete already
+    if (!conn) {
+        tf_http_stream_free(stream);
+        return;
+    }
+    
+    stream->ended = true;
+    
+    // the server finishes it once the handler or the producer returns
+    if (!stream->attached || stream->dispatching)
+        return;
+    
+    tf_http_server_ref server = stream->server;
+    
+    tf_http_stream_finish(stream, true);
+    
+    tf_tcp_resume(server->tcp, conn);
+}
+
+tf_http_body_ref tf_http_server_receive_body(tf_http_server_ref server, tf_conn_ref conn,
+                                             const tf_http_request_t* request,
+                                             const tf_http_body_complete_t complete,
+                                             tf_data_ref meta) {
+    tf_http_stream_ref stream = (tf_http_stream_ref)tf_conn_get_stream(conn);
+    
+    if (!server || !conn || !request || !complete || tf_conn_get_deferred(conn) ||
+        (stream && !stream->raw))
+        return NULL;
+    
+    tf_http_body_ref body = (tf_http_body_ref)tf_conn_get_body(conn);
+    
+    // a body after the handler has one already, a buffered one gets it now
+    if (!body) {
+        uint64_t length = 0;
+        tf_http_request_get_content_length(request, &length);
+        
+        body = tf_http_body_init(server, conn, request, false, length);
+    }
+    
+    if (!body || body->complete)
+        return NULL;
+    
+    body->complete = complete;
+    body->meta = meta;
+    body->relayed = (stream != NULL);
+    
+    return body;
+}
+
+void tf_http_body_set_handler(tf_http_body_ref body, const tf_http_body_handler_t handler) {
+    if (body)
+        body->handler = handler;
+}
+
+void tf_http_body_set_file(tf_http_body_ref body, const int fd) {
+    if (body)
+        body->fd = fd;
+}
+
+uint64_t tf_http_body_get_received(const tf_http_body_ref body) {
+    return (body ? body->received : 0);
+}
+
+tf_tcp_ref tf_http_server_get_tcp(const tf_http_server_ref server) {
+    return (server ? server->tcp : NULL);
+}
+
+void tf_http_server_release(tf_http_server_ref server) {
+    if (!server)
+        return;
+    
+    // jobs still queued are run, their results never picked up
+    tf_metrics_set_pool(tf_tcp_get_metrics(server->tcp), NULL);
+    tf_pool_release(server->pool);
+    
+    tf_metrics_set_cache(tf_tcp_get_metrics(server->tcp), NULL);
+    tf_tcp_release(server->tcp);
+    
+    // entries still referenced by queued buffers went with the connections
+    tf_cache_release(server->cache);
+    tf_http_server_set_cache(server, 0, NULL);
+    
+    // nothing is in flight anymore
+    tf_admit_release(server->admit);
+    
+    free(server->metrics_path);
+    free(server);
+}
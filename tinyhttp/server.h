@@ -0,0 +1,346 @@
+//
+//  server.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+#include "http.h"
+#include "admit.h"
+
+//
+// HTTP/1.x server
+//
+// drives the request parser over the input of every connection, answers
+// pipelined requests in order and keeps connections open according to
+// their version and Connection headers
+//
+// handlers run on the worker that owns the connection, one that would
+// block it (disk I/O, heavy computation) can hand the request over to a
+// thread pool instead (see tf_http_server_defer), the worker goes on
+// with its other connections meanwhile
+//
+// a response can also be streamed (see tf_http_server_stream): the body
+// goes out with chunked encoding as it's written, or as a producer
+// callback makes it whenever the connection's output runs low, so a big
+// or slowly generated body never has to be kept in memory as a whole
+//
+// responses a handler marks as cacheable are kept fully serialized and
+// answer the same requests later on without calling the handler at all,
+// with an ETag, If-None-Match gets a 304 instead (see
+// tf_http_server_set_cache)
+//
+// small request bodies (Content-Length up to TF_HTTP_SERVER_MAX_BUFFERED_BODY)
+// are in before the handler is called, bigger and chunked ones arrive after
+// it, either way a handler that wants the body receives it piece by piece
+// or has it spliced into a file (see tf_http_server_receive_body), the
+// others are skipped, memory per request stays the same for any body size
+//
+
+/// default deadlines in milliseconds, see tf_tcp_timeout_t
+#define TF_HTTP_SERVER_DEFAULT_HEADER_TIMEOUT 10000
+#define TF_HTTP_SERVER_DEFAULT_BODY_TIMEOUT 30000
+#define TF_HTTP_SERVER_DEFAULT_IDLE_TIMEOUT 5000
+#define TF_HTTP_SERVER_DEFAULT_WRITE_TIMEOUT 30000
+#define TF_HTTP_SERVER_DEFAULT_HANDLER_TIMEOUT 30000
+
+/// streamed responses with a producer keep that much output queued
+#define TF_HTTP_SERVER_STREAM_AHEAD (128 * 1024)
+/// buffer size handed to producers
+#define TF_HTTP_SERVER_STREAM_CHUNK (16 * 1024)
+
+/// bigger request bodies are received after the handler has been called
+#define TF_HTTP_SERVER_MAX_BUFFERED_BODY (64 * 1024)
+/// default limit for request bodies, see tf_http_server_set_max_body_size
+#define TF_HTTP_SERVER_DEFAULT_MAX_BODY_SIZE (64 * 1024 * 1024)
+
+/// response to be filled in by the handler
+typedef struct {
+    // 200 unless changed
+    uint16_t status;
+    // defaults to text/html if NULL
+    const char* content_type;
+    // not copied until the handler returns, must outlive the call (the
+    // connection arena does)
+    tf_str_view_t body;
+    // file range to send instead of the body (see tf_buffer_acquire_file),
+    // owned by the server once set
+    tf_buffer_ref file;
+    // close the connection after this response
+    bool close;
+    // milliseconds the response may be served from the response cache
+    // (see tf_http_server_set_cache), only 200 responses to GET requests
+    // without a file are cached, 0 (the default) means never
+    tf_index_t cache_ttl;
+} tf_http_response_t;
+
+///
+/// HTTP request handler
+/// Arguments:
+/// - HTTP server instance
+/// - client connection (see conn.h)
+/// - parsed request, the views are only valid during the call
+/// - response to fill in
+/// - additional user-specified data that needs to be passed to the
+///   handler
+///
+typedef void (*tf_http_handler_t)(tf_http_server_ref,
+                                  tf_conn_ref,
+                                  const tf_http_request_t*,
+                                  tf_http_response_t*,
+                                  tf_data_ref);
+
+///
+/// deferred request handler, runs on a pool thread
+/// Arguments:
+/// - the request, a copy of it whose views stay valid during the call
+/// - response to fill in, 200 unless changed
+/// - arena for the response body and anything else the call needs, freed
+///   once the response has been queued
+/// - additional data passed to tf_http_server_defer
+///
+typedef void (*tf_http_deferred_handler_t)(const tf_http_request_t*,
+                                           tf_http_response_t*,
+                                           tf_arena_ref,
+                                           tf_data_ref);
+
+///
+/// pull-style body producer of a streamed response, runs on the
+/// connection's worker whenever its queued output runs low
+/// Arguments:
+/// - buffer to write the next piece of the body into
+/// - buffer size
+/// - to be set once the body is complete
+/// - additional data passed to tf_http_stream_set_producer
+/// Returns the amount of bytes written, nothing without setting the end
+/// flag counts as a failure and the connection is closed
+///
+typedef tf_index_t (*tf_http_producer_t)(char*,
+                                         const tf_index_t,
+                                         bool*,
+                                         tf_data_ref);
+
+///
+/// called on the connection's worker once the output queued by a stream
+/// has gone down, see tf_http_stream_set_drain_handler
+/// Arguments:
+/// - the stream
+/// - additional data passed to tf_http_stream_set_drain_handler
+///
+typedef void (*tf_http_drain_handler_t)(tf_http_stream_ref, tf_data_ref);
+
+///
+/// request body consumer, runs on the connection's worker for every piece
+/// of the body as it arrives (the chunk framing already taken off)
+/// Arguments:
+/// - the piece, only valid during the call
+/// - its size
+/// - additional data passed to tf_http_server_receive_body
+/// Returns false to give up on the body, the request fails with 500 then
+///
+typedef bool (*tf_http_body_handler_t)(const char*,
+                                       const tf_index_t,
+                                       tf_data_ref);
+
+///
+/// called on the connection's worker once the whole request body is in or
+/// it cannot be received, always exactly once
+/// Arguments:
+/// - the request, a copy of it whose views stay valid during the call
+/// - 0 if the body is complete, otherwise the status the request failed
+///   with (400 malformed or cut short, 413 too large, 500 not taken), the
+///   response is sent with that status and the connection closed then
+/// - response to fill in, 200 unless changed
+/// - arena for the response body, freed once the response has been queued
+/// - additional data passed to tf_http_server_receive_body
+///
+typedef void (*tf_http_body_complete_t)(const tf_http_request_t*,
+                                        const uint16_t,
+                                        tf_http_response_t*,
+                                        tf_arena_ref,
+                                        tf_data_ref);
+
+/// same arguments as for tf_tcp_init
+tf_http_server_ref tf_http_server_init(const char* ipv4a,
+                                       const tf_port_t port,
+                                       const tf_index_t max_clients,
+                                       const tf_index_t workers);
+
+/// overrides one of the TF_HTTP_SERVER_DEFAULT_*_TIMEOUT deadlines (see
+/// tf_tcp_set_timeout), 0 disables it
+void tf_http_server_set_timeout(tf_http_server_ref server,
+                                const tf_tcp_timeout_t timeout,
+                                const tf_index_t length);
+
+///
+/// answers GET/HEAD requests for path with all the metrics (see metrics.h)
+/// in the Prometheus text format instead of calling the handler, NULL
+/// turns it off again (the default), must be set before listening
+///
+void tf_http_server_set_metrics_path(tf_http_server_ref server, const char* path);
+
+///
+/// amount of threads answering deferred requests, 0 (the default) means
+/// requests cannot be deferred, must be set before listening
+///
+void tf_http_server_set_pool_size(tf_http_server_ref server, const tf_index_t threads);
+
+///
+/// caches responses with a cache_ttl in max_bytes of memory (split among
+/// the workers, least recently used ones go first), keyed by Host, path,
+/// query and the values of the comma-separated vary request headers (NULL if
+/// none), which also go out as the Vary header, must be set before
+/// listening, 0 turns it off again (the default)
+///
+/// the cached responses carry an ETag, requests whose If-None-Match
+/// matches it are answered with 304 Not Modified, responses to deferred
+/// requests are never cached
+///
+void tf_http_server_set_cache(tf_http_server_ref server, const uint64_t max_bytes,
+                              const char* vary);
+
+///
+/// limits on what gets served (see admit.h), must be set before listening,
+/// all off by default: requests over a client's rate are answered with
+/// 429 Too Many Requests, the ones over the concurrency cap or waiting too
+/// long for a pool thread with 503 Service Unavailable, both with
+/// Retry-After and the connection closed after them
+///
+void tf_http_server_set_admission(tf_http_server_ref server,
+                                  const tf_admit_options_t* options);
+
+///
+/// request bodies (Content-Length or chunked) longer than max_bytes are
+/// refused with 413 Payload Too Large, TF_HTTP_SERVER_DEFAULT_MAX_BODY_SIZE
+/// by default, must be set before listening
+///
+void tf_http_server_set_max_body_size(tf_http_server_ref server, const uint64_t max_bytes);
+
+///
+/// to be called from the handler: the request is answered by handler on a
+/// pool thread instead, whatever the handler put into its own response is
+/// ignored and its connection arena is gone by then, the response goes out
+/// from the connection's worker once the pool is done with it
+///
+/// the requests pipelined after it wait until then, the connection is
+/// closed if that takes longer than TF_TCP_TIMEOUT_HANDLER allows, returns
+/// false (so the handler answers right away) if there is no pool or the
+/// request body comes after the handler, if the pool is full the request
+/// is answered with 503 instead
+///
+bool tf_http_server_defer(tf_http_server_ref server, tf_conn_ref conn,
+                          const tf_http_deferred_handler_t handler, tf_data_ref meta);
+
+///
+/// to be called from the handler: the response is streamed, the status
+/// and content type come from the handler's response as usual, the body
+/// from tf_http_stream_write or a producer, whatever is in the response
+/// itself is ignored, the requests pipelined after it wait for its end
+///
+/// HTTP/1.1 bodies go out with chunked encoding, HTTP/1.0 ones end with
+/// the connection, HEAD requests only get the head (writes are dropped),
+/// returns NULL if the request is already being deferred or streamed or
+/// its body comes after the handler
+///
+/// the stream has to be ended with tf_http_stream_end unless a producer
+/// has been set, even if the client is gone by then, it's only used on
+/// the connection's worker (handler, producer, mailbox tasks)
+///
+tf_http_stream_ref tf_http_server_stream(tf_http_server_ref server, tf_conn_ref conn,
+                                         const tf_http_request_t* request);
+
+///
+/// to be called from the handler: like tf_http_server_stream, except that
+/// the writes are the whole response as it goes out, status line, headers
+/// and framing included, nothing is added to them, for responses that come
+/// from somewhere else ready-made (see proxy.h)
+///
+/// the request body may be received (see tf_http_server_receive_body)
+/// while the response is written, its complete callback only learns
+/// whether it made it, the connection is kept alive afterwards unless the
+/// request or tf_http_stream_set_close say otherwise
+///
+tf_http_stream_ref tf_http_server_relay(tf_http_server_ref server, tf_conn_ref conn,
+                                        const tf_http_request_t* request);
+
+///
+/// queues a piece of the body, outside the handler it goes out right away,
+/// the connection is closed if the next write takes longer than
+/// TF_TCP_TIMEOUT_HANDLER allows, returns false if the client is gone
+///
+bool tf_http_stream_write(tf_http_stream_ref stream, const char* data,
+                          const tf_index_t length);
+
+/// bytes written that the client hasn't taken yet, for writers that want
+/// to slow down instead of queueing more
+tf_index_t tf_http_stream_get_queued(const tf_http_stream_ref stream);
+
+///
+/// the rest of the body comes from producer, called as often as needed to
+/// keep TF_HTTP_SERVER_STREAM_AHEAD bytes queued, the stream belongs to the
+/// server from now on, release(meta) (if set) is called when it's gone
+///
+void tf_http_stream_set_producer(tf_http_stream_ref stream,
+                                 const tf_http_producer_t producer,
+                                 tf_data_ref meta, const tf_deallocator_t release);
+
+///
+/// handler is called once less than TF_TCP_OUTPUT_LOW_WATER bytes of the
+/// stream are queued, for writers that hold off while
+/// tf_http_stream_get_queued is high, it has to be set again for every
+/// call, NULL takes it back
+///
+void tf_http_stream_set_drain_handler(tf_http_stream_ref stream,
+                                      const tf_http_drain_handler_t handler,
+                                      tf_data_ref meta);
+
+/// the connection is closed once the response is complete
+void tf_http_stream_set_close(tf_http_stream_ref stream);
+
+/// completes the body, the stream is gone afterwards
+void tf_http_stream_end(tf_http_stream_ref stream);
+
+///
+/// to be called from the handler: the request body goes to the handler set
+/// by tf_http_body_set_handler or into the file set by tf_http_body_set_file
+/// (nowhere by default) as it arrives, the response comes from complete
+/// once it's in, whatever is in the handler's own response is ignored
+///
+/// a body that was in before the handler was called is handed over right
+/// after it, the requests pipelined after the request wait for its body,
+/// the connection is closed if it pauses for longer than
+/// TF_TCP_TIMEOUT_BODY allows, returns NULL if the request is already
+/// being deferred or streamed (relayed is fine, see tf_http_server_relay)
+///
+tf_http_body_ref tf_http_server_receive_body(tf_http_server_ref server, tf_conn_ref conn,
+                                             const tf_http_request_t* request,
+                                             const tf_http_body_complete_t complete,
+                                             tf_data_ref meta);
+
+/// the body goes to handler piece by piece, meta is the one passed to
+/// tf_http_server_receive_body
+void tf_http_body_set_handler(tf_http_body_ref body, const tf_http_body_handler_t handler);
+
+///
+/// the body is written into fd (a file or a blocking pipe, not closed by
+/// the server), where the TCP server can (see tf_tcp_set_splice) it's
+/// spliced there from the socket without being copied through user space
+///
+void tf_http_body_set_file(tf_http_body_ref body, const int fd);
+
+/// body bytes received so far
+uint64_t tf_http_body_get_received(const tf_http_body_ref body);
+
+/// blocks like tf_tcp_listen, the handler must be thread-safe if there
+/// is more than one worker
+bool tf_http_server_listen(tf_http_server_ref server,
+                           const tf_http_handler_t handler,
+                           tf_data_ref meta);
+
+tf_tcp_ref tf_http_server_get_tcp(const tf_http_server_ref server);
+
+void tf_http_server_release(tf_http_server_ref server);
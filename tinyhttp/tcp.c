@@ -11,34 +11,1243 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <stddef.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 #include "privutil.h"
-#include "intarray.h"
+#include "bufpool.h"
+#include "conn.h"
+#include "metrics.h"
+#include "poller.h"
+#include "pool.h"
+#include "timer.h"
+#include "uring.h"
 #include "tcp.h"
 
 //
 // private
 //
 
-struct tf_tcp_s {
-    // main TCP socket to listen on
+/// max amount of buffers handed to a single sendmsg
+#define TF_TCP_MAX_IOV 64
+
+#ifndef MSG_NOSIGNAL
+// not on Darwin, SO_NOSIGPIPE is set on the client sockets there instead
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+/// chunk size for copying files where there is no sendfile()
+#define TF_TCP_FILE_COPY_CHUNK 16384
+
+/// most bytes spliced at once, what a pipe holds by default
+#define TF_TCP_SPLICE_CHUNK 65536
+
+/// io_uring backend: prepared requests, provided receive buffers (a power
+/// of two) and their size, max linked sends per connection at a time
+#define TF_TCP_URING_ENTRIES 256
+#define TF_TCP_URING_BUFFER_COUNT 256
+#define TF_TCP_URING_BUFFER_SIZE 4096
+#define TF_TCP_URING_MAX_SENDS 16
+
+/// what an io_uring completion is for, kept in the lowest byte of its data
+typedef enum {
+    TF_TCP_URING_ACCEPT,
+    TF_TCP_URING_RECEIVE,
+    TF_TCP_URING_SEND,
+    TF_TCP_URING_POLL,
+    TF_TCP_URING_CANCEL,
+    // the worker's mailbox is readable
+    TF_TCP_URING_MAILBOX
+} tf_tcp_uring_op_t;
+
+/// single reactor, owns its listening socket, clients and event loop
+typedef struct tf_tcp_worker_s* tf_tcp_worker_ref;
+struct tf_tcp_worker_s {
+    // server this worker belongs to
+    tf_tcp_ref server;
+    // index of this worker, passed to the callback
+    tf_index_t id;
+    
+    // this worker's own listening socket (shared port via SO_REUSEPORT)
     tf_socket_t main_socket;
+    // client connections, indexed by socket
+    tf_conn_table_ref connections;
+    // readiness notifications for the main socket and all the clients
+    tf_poller_ref poller;
+    // completions instead, only with TF_TCP_BACKEND_URING
+    tf_uring_ref ring;
+    // last generation handed to a connection
+    uint32_t generation;
+    // tasks posted from other threads (finished pool jobs), run by this one
+    tf_mailbox_ref mailbox;
+    // spliced input passes through, shared by all the connections as it's
+    // emptied right away, opened on first use
+    int splice_pipe[2];
+    
+    // connection deadlines
+    tf_timer_wheel_ref timers;
+    // monotonic time taken right after each wait
+    uint64_t now;
+    
+    // thread running this worker, unused for worker 0
+    pthread_t thread;
+    bool thread_started;
+};
+
+struct tf_tcp_s {
     // IPv4 address to listen on
     struct sockaddr_in main_address;
     
-    // client sockets
-    tf_int_array_ref client_sockets;
-    // client socket descriptors
-    fd_set client_descs;
+    // reactors, one per core ideally
+    tf_tcp_worker_ref workers;
+    tf_index_t worker_count;
+    
+    // max client count (per worker)
+    tf_index_t max_clients;
+    // applied to each listening socket by tf_tcp_listen
+    tf_tcp_listen_options_t listen_options;
+    // in milliseconds by tf_tcp_timeout_t, 0 disables the deadline
+    tf_index_t timeouts[TF_TCP_TIMEOUT_COUNT];
+    // asked for, the poller is used if io_uring is not available
+    tf_tcp_backend_t backend;
+    
+    // recorded into by each worker for its own connections
+    tf_metrics_ref metrics;
+    
+    // set by tf_tcp_listen, shared by all the workers
+    tf_tcp_callback_t callback;
+    tf_data_ref callback_meta;
+};
+
+bool tf_socket_set_nonblocking(tf_socket_t socket) {
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0)
+        return false;
+    
+    return (fcntl(socket, F_SETFL, flags | O_NONBLOCK) >= 0);
+}
+
+/// one option of a listening socket, only logged if the system refuses it
+void tf_tcp_set_listen_option(tf_socket_t socket, const int level, const int option,
+                              const char* name, const int value) {
+    if (setsockopt(socket, level, option, &value, sizeof(value)) < 0)
+        TF_LOG_WARN("Cannot set %s on socket %d, errno = %s", name, socket,
+                    strerror(errno));
+}
+
+/// sets up the worker's listening socket and starts listening on it
+bool tf_tcp_worker_listen(tf_tcp_worker_ref worker) {
+    const tf_tcp_listen_options_t* options = &worker->server->listen_options;
+    tf_socket_t current = worker->main_socket;
+    
+    // accepted sockets inherit their buffer sizes, which have to be known
+    // before the handshake for the window scaling to take them into account
+    if (options->receive_buffer > 0)
+        tf_tcp_set_listen_option(current, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF",
+                                 options->receive_buffer);
+    if (options->send_buffer > 0)
+        tf_tcp_set_listen_option(current, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF",
+                                 options->send_buffer);
+    
+#ifdef TCP_DEFER_ACCEPT
+    if (options->defer_accept > 0)
+        tf_tcp_set_listen_option(current, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                                 "TCP_DEFER_ACCEPT", options->defer_accept);
+#endif
+    
+#ifdef TCP_FASTOPEN
+    if (options->fastopen > 0)
+        tf_tcp_set_listen_option(current, IPPROTO_TCP, TCP_FASTOPEN, "TCP_FASTOPEN",
+                                 options->fastopen);
+#endif
+    
+    if (listen(current, options->backlog) < 0) {
+        TF_LOG_ERROR("Listen failed, errno = %s, returning false", strerror(errno));
+        return false;
+    }
+    
+    return true;
+}
+
+bool tf_tcp_worker_init(tf_tcp_ref server, tf_tcp_worker_ref worker,
+                        const tf_index_t id) {
+    worker->server = server;
+    worker->id = id;
+    worker->splice_pipe[0] = -1;
+    worker->splice_pipe[1] = -1;
+    
+    worker->connections = tf_conn_table_init(server->max_clients);
+    
+    worker->now = tf_monotonic_ms();
+    worker->timers = tf_timer_wheel_init(worker->now);
+    
+    worker->poller = tf_poller_init();
+    if (!worker->poller)
+        return false;
+    
+    worker->mailbox = tf_mailbox_init();
+    if (!worker->mailbox)
+        return false;
+    
+    // initialize server socket
+    worker->main_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (worker->main_socket < 0)
+        return false;
+    
+    // accepts are drained until EAGAIN on each wakeup
+    if (!tf_socket_set_nonblocking(worker->main_socket))
+        return false;
+    
+    TF_LOG_DEBUG("worker %u, main_socket = %d", id, worker->main_socket);
+    
+    // we need to point to this while setting the REUSEADDR flag
+    int truev = 1;
+    setsockopt(worker->main_socket, SOL_SOCKET, SO_REUSEADDR, &truev, sizeof(truev));
+    
+#ifdef SO_REUSEPORT
+    // every worker binds the same port, the kernel spreads incoming
+    // connections between them
+    if (setsockopt(worker->main_socket, SOL_SOCKET, SO_REUSEPORT, &truev,
+                   sizeof(truev)) < 0)
+        return false;
+#endif
+    
+    // now bind the main socket
+    if (bind(worker->main_socket, (struct sockaddr*)&server->main_address,
+             sizeof(server->main_address)) < 0)
+        return false;
+    
+    return true;
+}
+
+void tf_tcp_worker_release(tf_tcp_worker_ref worker) {
+    // close all client connections if active
+    for (tf_index_t index = 0; index < tf_conn_table_get_slot_count(worker->connections);
+         index++) {
+        if (tf_conn_table_get(worker->connections, (tf_socket_t)index))
+            close((tf_socket_t)index);
+    }
+    
+    // cleanup with all the client-related stuff
+    tf_uring_release(worker->ring);
+    tf_timer_wheel_release(worker->timers);
+    tf_conn_table_release(worker->connections);
+    tf_poller_release(worker->poller);
+    tf_mailbox_release(worker->mailbox);
+    
+    for (int end = 0; end < 2; end++) {
+        if (worker->splice_pipe[end] >= 0)
+            close(worker->splice_pipe[end]);
+    }
+    
+    // close main socket too
+    if (worker->main_socket >= 0)
+        close(worker->main_socket);
+}
+
+/// a worker that cannot run: its listening socket goes, so the kernel
+/// stops handing it connections, and so does what it would have waited on
+void tf_tcp_worker_abandon(tf_tcp_worker_ref worker) {
+    if (worker->main_socket >= 0)
+        close(worker->main_socket);
+    
+    tf_uring_release(worker->ring);
+    tf_poller_release(worker->poller);
+    tf_mailbox_release(worker->mailbox);
+    
+    worker->main_socket = -1;
+    worker->ring = NULL;
+    worker->poller = NULL;
+    worker->mailbox = NULL;
+}
+
+/// hands an event to the connection's callback, the server's one unless
+/// the connection is an outgoing one with its own
+void tf_tcp_notify(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                   const tf_tcp_connection_type_t ctype,
+                   char* data, const tf_index_t length) {
+    tf_tcp_ref tcp = worker->server;
+    tf_data_ref meta = NULL;
+    tf_tcp_callback_t callback = tf_conn_get_callback(conn, &meta);
+    
+    if (!callback) {
+        callback = tcp->callback;
+        meta = tcp->callback_meta;
+    }
+    
+    callback(tcp, ctype, data, length, conn, worker->id, meta);
+}
+
+void tf_tcp_close_connection(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                             const tf_tcp_close_reason_t reason) {
+    tf_tcp_ref tcp = worker->server;
+    tf_socket_t current = tf_conn_get_socket(conn);
+    
+    tf_timer_wheel_cancel(worker->timers, tf_conn_get_timer(conn));
+    tf_conn_set_close_reason(conn, reason);
+    tf_metrics_count_close(tcp->metrics, worker->id, reason);
+    
+    tf_tcp_notify(worker, conn, TF_TCP_CONNECTION_CLOSE, NULL, 0);
+    
+    // close & forget the connection, with io_uring requests still in
+    // flight for it fail right away once the socket is shut down, their
+    // completions are told apart by the generation
+    if (worker->ring)
+        shutdown(current, SHUT_RDWR);
+    else
+        tf_poller_remove(worker->poller, current);
+    
+    tf_conn_table_remove(worker->connections, conn);
+    close(current);
+}
+
+/// whether the connection is read from, not before an outgoing one is
+/// connected, nor while it's paused or its peer doesn't take its output
+bool tf_tcp_wants_input(const tf_conn_ref conn) {
+    return (!tf_conn_is_closing(conn) && !tf_conn_is_connecting(conn) &&
+            !tf_conn_is_paused(conn) &&
+            tf_conn_get_output_length(conn) < TF_TCP_OUTPUT_HIGH_WATER);
+}
+
+bool tf_tcp_update_interest(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_index_t pending = tf_conn_get_output_length(conn);
+    uint8_t flags = 0;
+    
+    // stop reading from clients that don't take their responses
+    if (tf_tcp_wants_input(conn))
+        flags |= TF_POLLER_READABLE;
+    
+    // only ask for writability while there is something to write, or to
+    // learn that the handshake is over
+    if (pending > 0 || tf_conn_is_connecting(conn))
+        flags |= TF_POLLER_WRITABLE;
+    
+    if (flags == tf_conn_get_poll_flags(conn))
+        return true;
+    
+    if (!tf_poller_modify(worker->poller, tf_conn_get_socket(conn), flags))
+        return false;
+    
+    tf_conn_set_poll_flags(conn, flags);
+    return true;
+}
+
+///
+/// arms the connection's timer for the deadline that applies now, the
+/// write stall deadline while output is pending (restarted whenever the
+/// client takes some of it), the read deadline otherwise
+///
+void tf_tcp_update_timer(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                         const bool progress) {
+    tf_tcp_ref tcp = worker->server;
+    tf_timer_t* timer = tf_conn_get_timer(conn);
+    uint64_t deadline = 0;
+    uint8_t timeout = TF_TCP_TIMEOUT_WRITE;
+    
+    if (tf_conn_get_output_length(conn) > 0) {
+        // still stalled since the last progress
+        if (!progress && tf_timer_is_armed(timer) && timer->tag == timeout)
+            return;
+        
+        if (tcp->timeouts[timeout] > 0)
+            deadline = worker->now + tcp->timeouts[timeout];
+    } else
+        timeout = tf_conn_get_read_timeout(conn, &deadline);
+    
+    if (deadline < 1) {
+        tf_timer_wheel_cancel(worker->timers, timer);
+        return;
+    }
+    
+    if (tf_timer_is_armed(timer) && timer->tag == timeout && timer->expires_at == deadline)
+        return;
+    
+    timer->tag = timeout;
+    tf_timer_wheel_arm(worker->timers, timer, deadline);
+}
+
+void tf_tcp_start_read_timeout(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                               const tf_tcp_timeout_t timeout) {
+    tf_index_t length = worker->server->timeouts[timeout];
+    
+    tf_conn_set_read_timeout(conn, (uint8_t)timeout,
+                             (length > 0 ? worker->now + length : 0));
+}
+
+/// counts sent bytes, records the first byte and drained queue timings
+void tf_tcp_record_sent(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                        const uint64_t sent) {
+    tf_metrics_ref metrics = worker->server->metrics;
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    bool drained = (tf_conn_get_output_length(conn) < 1 && timing->queued_at > 0);
+    
+    tf_metrics_count(metrics, worker->id, TF_METRICS_BYTES_SENT, sent);
+    
+    if (timing->first_byte_sent && !drained)
+        return;
+    
+    uint64_t now = tf_monotonic_ns();
+    
+    if (!timing->first_byte_sent) {
+        tf_metrics_record(metrics, worker->id, TF_METRICS_ACCEPT_TO_FIRST_BYTE,
+                          now - timing->accepted_at);
+        timing->first_byte_sent = true;
+    }
+    
+    if (drained) {
+        tf_metrics_record(metrics, worker->id, TF_METRICS_WRITE_DRAIN,
+                          now - timing->queued_at);
+        timing->queued_at = 0;
+    }
+}
+
+///
+/// sends as much of the output queue as the socket takes, closes the
+/// connection on failure or once a closing connection is drained, returns
+/// false if the connection is gone
+///
+bool tf_tcp_write_pending(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    uint64_t total = 0;
+    
+    // the HTTP server stamps its responses itself, saves a clock read
+    if (timing->queued_at < 1 && tf_conn_get_output_length(conn) > 0)
+        timing->queued_at = tf_monotonic_ns();
+    
+    while (tf_conn_get_output_length(conn) > 0) {
+        tf_index_t offset = 0;
+        tf_buffer_ref output = tf_conn_get_output(conn, &offset);
+        tf_index_t sent = 0;
+        
+        if (!tf_socket_send_buffers(current, output, offset, &sent)) {
+            tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+            return false;
+        }
+        
+        if (sent < 1)
+            break; // socket buffer is full, wait until it's writable again
+        
+        tf_conn_consume_output(conn, sent);
+        tf_conn_touch(conn);
+        
+        total += sent;
+    }
+    
+    if (total > 0)
+        tf_tcp_record_sent(worker, conn, total);
+    
+    // everything has been said, time to go
+    if (tf_conn_is_closing(conn) && tf_conn_get_output_length(conn) < 1) {
+        tf_tcp_close_connection(worker, conn, tf_conn_get_close_reason(conn));
+        return false;
+    }
+    
+    if (!tf_tcp_update_interest(worker, conn)) {
+        TF_LOG_WARN("cannot update events of socket %d, closing", current);
+        
+        tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+        return false;
+    }
+    
+    tf_tcp_update_timer(worker, conn, total > 0);
+    return true;
+}
+
+uint64_t tf_tcp_uring_data(const tf_tcp_uring_op_t op, tf_socket_t socket,
+                           const uint32_t generation) {
+    return ((uint64_t)generation << 32) | ((uint64_t)(socket & 0xffffff) << 8) | op;
+}
+
+///
+/// keeps a multishot receive armed while the connection takes input and
+/// cancels it otherwise, the io_uring counterpart of tf_tcp_update_interest
+///
+bool tf_tcp_uring_update_receive(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    tf_conn_uring_t* state = tf_conn_get_uring(conn);
+    uint64_t data = tf_tcp_uring_data(TF_TCP_URING_RECEIVE, current, state->generation);
+    bool wanted = tf_tcp_wants_input(conn);
+    
+    // a receive being cancelled is armed again once its last completion is in
+    if (wanted && !state->receiving) {
+        if (!tf_uring_receive(worker->ring, current, data))
+            return false;
+        
+        state->receiving = true;
+    } else if (!wanted && state->receiving && !state->cancelling) {
+        if (!tf_uring_cancel(worker->ring, data,
+                             tf_tcp_uring_data(TF_TCP_URING_CANCEL, current,
+                                               state->generation)))
+            return false;
+        
+        state->cancelling = true;
+    }
+    
+    return true;
+}
+
+/// prepares linked sends for the memory buffers at the front of the output
+/// queue, returns how many, 0 on failure
+tf_index_t tf_tcp_uring_queue_sends(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    tf_index_t skip = 0;
+    tf_buffer_ref head = tf_conn_get_output(conn, &skip);
+    
+    const char* buffers[TF_TCP_URING_MAX_SENDS];
+    tf_index_t lengths[TF_TCP_URING_MAX_SENDS];
+    tf_index_t count = 0;
+    
+    // up to the next file range, that one goes out through sendfile()
+    for (tf_buffer_ref buffer = head; buffer && count < TF_TCP_URING_MAX_SENDS;
+         buffer = tf_buffer_get_next(buffer)) {
+        if (tf_buffer_get_file(buffer, NULL) >= 0)
+            break;
+        
+        tf_index_t length = tf_buffer_get_length(buffer);
+        
+        if (length <= skip) {
+            skip -= length;
+            continue;
+        }
+        
+        buffers[count] = tf_buffer_get_data(buffer) + skip;
+        lengths[count] = length - skip;
+        
+        count++;
+        skip = 0;
+    }
+    
+    // a chain split by a submission in between could go out of order
+    if (count < 1 || !tf_uring_reserve(worker->ring, count))
+        return 0;
+    
+    uint64_t data = tf_tcp_uring_data(TF_TCP_URING_SEND, current,
+                                      tf_conn_get_uring(conn)->generation);
+    
+    for (tf_index_t index = 0; index < count; index++)
+        tf_uring_send(worker->ring, current, buffers[index], lengths[index],
+                      index + 1 < count, data);
+    
+    return count;
+}
+
+///
+/// io_uring counterpart of tf_tcp_write_pending, the queued buffers go out
+/// as a chain of linked sends and the next chain is only prepared once the
+/// previous one has completed, so nothing overtakes anything, file ranges
+/// are sent right away or once the socket is writable
+///
+bool tf_tcp_uring_send_pending(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    tf_conn_timing_t* timing = tf_conn_get_timing(conn);
+    tf_conn_uring_t* state = tf_conn_get_uring(conn);
+    uint64_t total = 0;
+    
+    if (timing->queued_at < 1 && tf_conn_get_output_length(conn) > 0)
+        timing->queued_at = tf_monotonic_ns();
+    
+    // otherwise the completions pick up from there
+    while (state->sends < 1 && !state->polling && tf_conn_get_output_length(conn) > 0) {
+        tf_index_t offset = 0;
+        tf_buffer_ref output = tf_conn_get_output(conn, &offset);
+        
+        if (tf_buffer_get_file(output, NULL) < 0) {
+            state->sends = tf_tcp_uring_queue_sends(worker, conn);
+            
+            if (state->sends < 1) {
+                TF_LOG_WARN("cannot queue sends for socket %d, closing", current);
+                
+                tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+                return false;
+            }
+            
+            break;
+        }
+        
+        tf_index_t sent = 0;
+        
+        if (!tf_socket_send_buffers(current, output, offset, &sent)) {
+            tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+            return false;
+        }
+        
+        if (sent < 1) {
+            // socket buffer is full, continue once it's writable again
+            if (!tf_uring_poll_writable(worker->ring, current,
+                                        tf_tcp_uring_data(TF_TCP_URING_POLL, current,
+                                                          state->generation))) {
+                tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+                return false;
+            }
+            
+            state->polling = true;
+            break;
+        }
+        
+        tf_conn_consume_output(conn, sent);
+        tf_conn_touch(conn);
+        
+        total += sent;
+    }
+    
+    if (total > 0)
+        tf_tcp_record_sent(worker, conn, total);
+    
+    // everything has been said, time to go
+    if (tf_conn_is_closing(conn) && tf_conn_get_output_length(conn) < 1) {
+        tf_tcp_close_connection(worker, conn, tf_conn_get_close_reason(conn));
+        return false;
+    }
+    
+    if (!tf_tcp_uring_update_receive(worker, conn)) {
+        TF_LOG_WARN("cannot update receiving on socket %d, closing", current);
+        
+        tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+        return false;
+    }
+    
+    tf_tcp_update_timer(worker, conn, total > 0);
+    return true;
+}
+
+///
+/// sends whatever has been queued with the worker's backend, lets the
+/// callback top up the queue as long as it wants to once it runs low,
+/// returns false if the connection is gone
+///
+bool tf_tcp_flush(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    // nothing goes out before the handshake is done
+    if (tf_conn_is_connecting(conn)) {
+        if (tf_conn_is_closing(conn)) {
+            tf_tcp_close_connection(worker, conn, tf_conn_get_close_reason(conn));
+            return false;
+        }
+        
+        tf_tcp_update_timer(worker, conn, false);
+        return true;
+    }
+    
+    while (true) {
+        bool alive = (worker->ring ? tf_tcp_uring_send_pending(worker, conn) :
+                      tf_tcp_write_pending(worker, conn));
+        
+        if (!alive)
+            return false;
+        
+        tf_index_t queued = tf_conn_get_output_length(conn);
+        
+        if (!tf_conn_wants_drain(conn) || tf_conn_is_closing(conn) ||
+            queued >= TF_TCP_OUTPUT_LOW_WATER)
+            return true;
+        
+        tf_conn_set_wants_drain(conn, false);
+        tf_tcp_notify(worker, conn, TF_TCP_CONNECTION_DRAINED, NULL, 0);
+        
+        // nothing new, nothing to send
+        if (tf_conn_get_output_length(conn) <= queued && !tf_conn_is_closing(conn))
+            return true;
+    }
+}
+
+/// starts tracking a freshly accepted client
+void tf_tcp_add_connection(tf_tcp_worker_ref worker, tf_socket_t newcl) {
+    tf_tcp_ref tcp = worker->server;
+    int truev = 1;
+    
+#ifdef SO_NOSIGPIPE
+    setsockopt(newcl, SOL_SOCKET, SO_NOSIGPIPE, &truev, sizeof(truev));
+#endif
+    // responses are already gathered into as few writes as possible,
+    // Nagle would only hold back the tail of a pipelined batch (the
+    // headers still wait for their file thanks to MSG_MORE)
+    if (tcp->listen_options.nodelay)
+        setsockopt(newcl, IPPROTO_TCP, TCP_NODELAY, &truev, sizeof(truev));
+    
+    // save the socket for further use, drop it if we are full
+    tf_conn_ref conn = tf_conn_table_insert(worker->connections, newcl,
+                                            worker->id);
+    bool tracked = (conn != NULL);
+    
+    // accepted non-blocking already, a slow client must never block the loop
+    if (tracked && worker->ring) {
+        tf_conn_get_uring(conn)->generation = ++worker->generation;
+        tracked = tf_tcp_uring_update_receive(worker, conn);
+    } else if (tracked) {
+        tracked = tf_poller_add(worker->poller, newcl, TF_POLLER_READABLE);
+        
+        if (tracked)
+            tf_conn_set_poll_flags(conn, TF_POLLER_READABLE);
+    }
+    
+    if (!tracked) {
+        TF_LOG_WARN("cannot track socket %d, dropping connection", newcl);
+        tf_metrics_count(tcp->metrics, worker->id, TF_METRICS_CONNECTIONS_REJECTED, 1);
+        
+        tf_conn_table_remove(worker->connections, conn);
+        close(newcl);
+        return;
+    }
+    
+    tf_conn_get_timing(conn)->accepted_at = tf_monotonic_ns();
+    tf_metrics_count(tcp->metrics, worker->id, TF_METRICS_CONNECTIONS_ACCEPTED, 1);
+    
+    tf_conn_get_timer(conn)->data = conn;
+    tf_tcp_start_read_timeout(worker, conn, TF_TCP_TIMEOUT_IDLE);
+    
+    // accepted, call the callback for proper backend-side handling
+    tf_tcp_notify(worker, conn, TF_TCP_CONNECTION_NEW, NULL, 0);
+    
+    tf_tcp_flush(worker, conn);
+}
+
+/// the handshake of an outgoing connection is over, one way or the other,
+/// returns false if the connection is gone
+bool tf_tcp_complete_connect(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    int error = 0;
+    socklen_t length = sizeof(error);
+    
+    if (getsockopt(current, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        error = errno;
+    
+    if (error != 0) {
+        TF_LOG_DEBUG("connect failed on socket %d, errno = %s", current, strerror(error));
+        
+        tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+        return false;
+    }
+    
+    tf_conn_set_connecting(conn, false);
+    tf_tcp_notify(worker, conn, TF_TCP_CONNECTION_NEW, NULL, 0);
+    
+    // starts reading and sends what's been queued meanwhile
+    return tf_tcp_flush(worker, conn);
+}
+
+void tf_tcp_accept_pending(tf_tcp_worker_ref worker) {
+    // the listening socket is non-blocking and edge-triggered, so take
+    // everything that is waiting in the backlog right away
+    while (true) {
+        // the address can be looked up later on, tf_socket_get_client_ip
+#ifdef SOCK_NONBLOCK
+        // non-blocking and close-on-exec right away, no fcntl() per client
+        tf_socket_t newcl = accept4(worker->main_socket, NULL, NULL,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        tf_socket_t newcl = accept(worker->main_socket, NULL, NULL);
+        
+        if (newcl >= 0 && (!tf_socket_set_nonblocking(newcl) ||
+                           fcntl(newcl, F_SETFD, FD_CLOEXEC) < 0)) {
+            close(newcl);
+            continue;
+        }
+#endif
+        
+        if (newcl < 0) {
+            // gone before we got to it, the rest of the backlog is still there
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                TF_LOG_WARN("connection accept failed, errno = %s, will continue",
+                            strerror(errno));
+            
+            break;
+        }
+        
+        tf_tcp_add_connection(worker, newcl);
+    }
+}
+
+///
+/// counts freshly received input, restarts the read deadline and hands the
+/// data (or the amount spliced) to the callback, returns false if the
+/// connection is gone
+///
+bool tf_tcp_handle_input(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                         const tf_tcp_connection_type_t ctype,
+                         char* data, const tf_index_t length) {
+    tf_tcp_ref tcp = worker->server;
+    
+    tf_conn_touch(conn);
+    tf_metrics_count(tcp->metrics, worker->id, TF_METRICS_BYTES_RECEIVED, length);
+    
+    // any data restarts the wait, the header deadline keeps running
+    // until the callback moves on to something else
+    tf_tcp_timeout_t timeout = tf_conn_get_read_timeout(conn, NULL);
+    if (timeout == TF_TCP_TIMEOUT_IDLE || timeout == TF_TCP_TIMEOUT_BODY)
+        tf_tcp_start_read_timeout(worker, conn, timeout);
+    
+    tf_tcp_notify(worker, conn, ctype, data, length);
+    
+    return tf_tcp_flush(worker, conn);
+}
+
+///
+/// moves what the client has sent into the connection's splice target
+/// through the worker's pipe, *movedp is 0 once there is nothing left to
+/// read, returns false if the connection is gone
+///
+/// a target that cannot take the data is dropped and reported as nothing
+/// spliced, whatever was left in the pipe goes with the pipe
+///
+bool tf_tcp_splice_pending(tf_tcp_worker_ref worker, tf_conn_ref conn, tf_index_t* movedp) {
+    *movedp = 0;
+    
+#if defined(__linux__)
+    tf_socket_t current = tf_conn_get_socket(conn);
+    int* pipe = worker->splice_pipe;
+    uint64_t left = 0;
+    int fd = tf_conn_get_splice(conn, &left);
+    
+    if (pipe[0] < 0 && pipe2(pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        TF_LOG_WARN("cannot open a pipe to splice socket %d, errno = %s", current,
+                    strerror(errno));
+        
+        pipe[0] = pipe[1] = -1;
+        tf_conn_set_splice(conn, -1, 0);
+        return tf_tcp_handle_input(worker, conn, TF_TCP_CONNECTION_SPLICED, NULL, 0);
+    }
+    
+    size_t wanted = (left < TF_TCP_SPLICE_CHUNK ? (size_t)left : TF_TCP_SPLICE_CHUNK);
+    ssize_t in = splice(current, NULL, pipe[1], NULL, wanted,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    
+    if (in < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return true; // nothing left to read right now
+    
+    if (in <= 0) {
+        // EOF or failure, flush what's been queued first
+        tf_conn_set_close_reason(conn, TF_TCP_CLOSE_PEER);
+        tf_conn_close(conn);
+        tf_tcp_write_pending(worker, conn);
+        return false;
+    }
+    
+    ssize_t out = 0;
+    
+    // the target is a file or a blocking pipe, so this doesn't take turns
+    // with other connections
+    while (out < in) {
+        ssize_t moved = splice(pipe[0], NULL, fd, NULL, (size_t)(in - out), SPLICE_F_MOVE);
+        
+        if (moved < 0 && errno == EINTR)
+            continue;
+        
+        if (moved <= 0) {
+            TF_LOG_WARN("cannot splice socket %d into %d, errno = %s", current, fd,
+                        (moved < 0 ? strerror(errno) : "none"));
+            
+            close(pipe[0]);
+            close(pipe[1]);
+            pipe[0] = pipe[1] = -1;
+            
+            tf_conn_set_splice(conn, -1, 0);
+            return tf_tcp_handle_input(worker, conn, TF_TCP_CONNECTION_SPLICED, NULL, 0);
+        }
+        
+        out += moved;
+    }
+    
+    tf_conn_set_splice(conn, fd, left - (uint64_t)in);
+    *movedp = (tf_index_t)in;
+    
+    return tf_tcp_handle_input(worker, conn, TF_TCP_CONNECTION_SPLICED, NULL, *movedp);
+#else
+    // tf_tcp_set_splice never sets a target here
+    (void)(worker);
+    tf_conn_set_splice(conn, -1, 0);
+    
+    return true;
+#endif
+}
+
+void tf_tcp_read_pending(tf_tcp_worker_ref worker, tf_conn_ref conn) {
+    tf_socket_t current = tf_conn_get_socket(conn);
+    
+    // drain the socket, edge-triggered notifications won't come again for
+    // data that is already sitting in the kernel buffer
+    while (true) {
+        uint64_t splice_left = 0;
+        tf_index_t input_length = 0;
+        
+        tf_conn_get_splice(conn, &splice_left);
+        tf_conn_get_input(conn, &input_length);
+        
+        // the input goes around the input buffer while there is a target
+        if (splice_left > 0 && input_length < 1) {
+            tf_index_t moved = 0;
+            
+            if (!tf_tcp_splice_pending(worker, conn, &moved) || moved < 1)
+                break; // closed or drained
+            
+            if (!(tf_conn_get_poll_flags(conn) & TF_POLLER_READABLE))
+                break;
+            
+            continue;
+        }
+        
+        // read straight into the connection's pooled input buffer
+        tf_index_t available = 0;
+        char* space = tf_conn_reserve_input(conn, TF_TCP_MAX_PKT_SIZE, &available);
+        
+        if (!space) {
+            TF_LOG_WARN("input of socket %d is too big, closing", current);
+            
+            tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+            break;
+        }
+        
+        tf_index_t dlen = 0;
+        
+        if (!tf_socket_read_data(current, space, available, &dlen)) {
+            // probably closing connection, flush what's been queued first
+            tf_conn_set_close_reason(conn, TF_TCP_CLOSE_PEER);
+            tf_conn_close(conn);
+            tf_tcp_write_pending(worker, conn);
+            break;
+        }
+        
+        if (dlen < 1) {
+            // everything has been read, don't hold on to an empty buffer
+            tf_conn_consume_input(conn, 0);
+            break;
+        }
+        
+        tf_conn_commit_input(conn, dlen);
+        
+        if (!tf_tcp_handle_input(worker, conn, TF_TCP_CONNECTION_CONTINUE, space, dlen))
+            break; // closed
+        
+        // reading resumes once the output queue goes down
+        if (!(tf_conn_get_poll_flags(conn) & TF_POLLER_READABLE))
+            break;
+    }
+}
+
+/// closes all the connections whose deadline has passed
+void tf_tcp_close_expired(tf_tcp_worker_ref worker) {
+    if (tf_timer_wheel_advance(worker->timers, worker->now) < 1)
+        return;
+    
+    tf_timer_t* timer = NULL;
+    
+    while ((timer = tf_timer_wheel_pop_expired(worker->timers))) {
+        tf_conn_ref conn = (tf_conn_ref)timer->data;
+        tf_tcp_close_reason_t reason = (tf_tcp_close_reason_t)(TF_TCP_CLOSE_TIMEOUT_HEADER +
+                                                               timer->tag);
+        
+        TF_LOG_INFO("socket %d closed, %s", tf_conn_get_socket(conn),
+                    tf_tcp_close_reason_get_name(reason));
+        
+        tf_tcp_close_connection(worker, conn, reason);
+    }
+}
+
+void tf_tcp_uring_complete_accept(tf_tcp_worker_ref worker,
+                                  const tf_uring_completion_t* completion) {
+    if (completion->result >= 0)
+        tf_tcp_add_connection(worker, completion->result);
+    else if (completion->result != -EAGAIN && completion->result != -EINTR &&
+             completion->result != -ECANCELED)
+        TF_LOG_WARN("connection accept failed, errno = %s, will continue",
+                    strerror(-completion->result));
+    
+    // the multishot accept has stopped, start another one
+    if (!(completion->flags & TF_URING_COMPLETION_MORE) &&
+        !tf_uring_accept(worker->ring, worker->main_socket,
+                         tf_tcp_uring_data(TF_TCP_URING_ACCEPT, worker->main_socket, 0)))
+        TF_LOG_ERROR("Cannot accept on worker %u anymore", worker->id);
+}
+
+void tf_tcp_uring_complete_receive(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                                   const tf_uring_completion_t* completion) {
+    tf_conn_uring_t* state = tf_conn_get_uring(conn);
+    
+    if (!(completion->flags & TF_URING_COMPLETION_MORE)) {
+        state->receiving = false;
+        state->cancelling = false;
+    }
+    
+    // whatever comes in after the connection was asked to close is dropped,
+    // just like the poller stops reading then
+    if (tf_conn_is_closing(conn))
+        return;
+    
+    if (completion->result > 0 && (completion->flags & TF_URING_COMPLETION_BUFFER)) {
+        // the provided buffer goes back to the kernel right after this
+        tf_index_t length = (tf_index_t)completion->result;
+        tf_index_t total = 0;
+        
+        if (!tf_conn_append_input(conn, tf_uring_get_buffer(worker->ring, completion->buffer),
+                                  length)) {
+            TF_LOG_WARN("input of socket %d is too big, closing", tf_conn_get_socket(conn));
+            
+            tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+            return;
+        }
+        
+        char* input = tf_conn_get_input(conn, &total);
+        
+        if (!tf_tcp_handle_input(worker, conn, TF_TCP_CONNECTION_CONTINUE,
+                                 input + total - length, length))
+            return; // closed
+    } else if (completion->result != -ENOBUFS && completion->result != -ECANCELED) {
+        // EOF or failure, flush what's been queued first
+        tf_conn_set_close_reason(conn, TF_TCP_CLOSE_PEER);
+        tf_conn_close(conn);
+        tf_tcp_flush(worker, conn);
+        return;
+    }
+    
+    if (!state->receiving && !tf_tcp_uring_update_receive(worker, conn))
+        tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+}
+
+void tf_tcp_uring_complete_send(tf_tcp_worker_ref worker, tf_conn_ref conn,
+                                const tf_uring_completion_t* completion) {
+    tf_conn_uring_t* state = tf_conn_get_uring(conn);
+    
+    state->sends--;
+    
+    // the sends linked after a short one are cancelled, what's left of the
+    // queue goes out with the next chain
+    if (completion->result < 0 && completion->result != -ECANCELED) {
+        if (completion->result != -EPIPE && completion->result != -ECONNRESET)
+            TF_LOG_DEBUG("send failed on socket %d, errno = %s", tf_conn_get_socket(conn),
+                         strerror(-completion->result));
+        
+        tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+        return;
+    }
+    
+    if (completion->result > 0) {
+        tf_conn_consume_output(conn, (tf_index_t)completion->result);
+        tf_conn_touch(conn);
+        tf_tcp_record_sent(worker, conn, (uint64_t)completion->result);
+    }
+    
+    if (state->sends > 0)
+        return;
+    
+    tf_tcp_update_timer(worker, conn, true);
+    tf_tcp_flush(worker, conn);
+}
+
+/// runs what's been posted and polls for the next batch, the poll is one-shot
+bool tf_tcp_uring_watch_mailbox(tf_tcp_worker_ref worker) {
+    int descriptor = tf_mailbox_get_descriptor(worker->mailbox);
+    
+    return tf_uring_poll_readable(worker->ring, descriptor,
+                                  tf_tcp_uring_data(TF_TCP_URING_MAILBOX, descriptor, 0));
+}
+
+void tf_tcp_uring_complete_mailbox(tf_tcp_worker_ref worker,
+                                   const tf_uring_completion_t* completion) {
+    (void)(completion);
+    
+    // drained before polling again, or the poll would complete right away
+    tf_mailbox_run(worker->mailbox);
+    
+    if (!tf_tcp_uring_watch_mailbox(worker))
+        TF_LOG_ERROR("Cannot watch the mailbox of worker %u anymore", worker->id);
+}
+
+void tf_tcp_uring_complete(tf_tcp_worker_ref worker,
+                           const tf_uring_completion_t* completion) {
+    tf_tcp_uring_op_t op = (tf_tcp_uring_op_t)(completion->data & 0xff);
+    tf_socket_t current = (tf_socket_t)((completion->data >> 8) & 0xffffff);
+    uint32_t generation = (uint32_t)(completion->data >> 32);
+    
+    if (op == TF_TCP_URING_ACCEPT) {
+        tf_tcp_uring_complete_accept(worker, completion);
+        return;
+    }
+    
+    if (op == TF_TCP_URING_MAILBOX) {
+        tf_tcp_uring_complete_mailbox(worker, completion);
+        return;
+    }
+    
+    tf_conn_ref conn = tf_conn_table_get(worker->connections, current);
+    
+    // leftovers of a connection that is gone, maybe with its socket reused
+    if (!conn || tf_conn_get_uring(conn)->generation != generation)
+        op = TF_TCP_URING_CANCEL;
+    
+    switch (op) {
+        case TF_TCP_URING_RECEIVE:
+            tf_tcp_uring_complete_receive(worker, conn, completion);
+            break;
+        case TF_TCP_URING_SEND:
+            tf_tcp_uring_complete_send(worker, conn, completion);
+            break;
+        case TF_TCP_URING_POLL:
+            tf_conn_get_uring(conn)->polling = false;
+            
+            if (completion->result < 0 && completion->result != -ECANCELED)
+                tf_tcp_close_connection(worker, conn, TF_TCP_CLOSE_ERROR);
+            else if (tf_conn_is_connecting(conn))
+                tf_tcp_complete_connect(worker, conn);
+            else
+                tf_tcp_flush(worker, conn);
+            
+            break;
+        case TF_TCP_URING_ACCEPT:
+        case TF_TCP_URING_CANCEL:
+        case TF_TCP_URING_MAILBOX:
+            break;
+    }
+    
+    if (completion->flags & TF_URING_COMPLETION_BUFFER)
+        tf_uring_recycle_buffer(worker->ring, completion->buffer);
+}
+
+bool tf_tcp_worker_run_uring(tf_tcp_worker_ref worker) {
+    tf_uring_completion_t completions[TF_URING_MAX_COMPLETIONS];
+    
+    // the ring belongs to this thread from now on
+    if (!tf_uring_start(worker->ring)) {
+        TF_LOG_ERROR("Cannot start io_uring in worker %u, errno = %s, exiting...",
+                     worker->id, strerror(errno));
+        
+        return false;
+    }
+    
+    if (!tf_uring_accept(worker->ring, worker->main_socket,
+                         tf_tcp_uring_data(TF_TCP_URING_ACCEPT, worker->main_socket, 0)) ||
+        !tf_tcp_uring_watch_mailbox(worker))
+        return false;
+    
+    while (true) {
+        // submit everything prepared since the last round and sleep until
+        // there's a completion or the next deadline is due
+        int timeout = tf_timer_wheel_get_timeout(worker->timers, worker->now);
+        
+        if (!tf_uring_submit_and_wait(worker->ring, (timeout >= 0 ? timeout : -1))) {
+            TF_LOG_ERROR("io_uring wait failed in worker %u, errno = %s, exiting...",
+                         worker->id, strerror(errno));
+            
+            return false;
+        }
+        
+        // io_uring_enter is no cancellation point, tf_tcp_release's signal
+        // only interrupts it
+        pthread_testcancel();
+        
+        worker->now = tf_monotonic_ms();
+        
+        tf_index_t count = tf_uring_get_completions(worker->ring, completions,
+                                                    TF_URING_MAX_COMPLETIONS);
+        
+        for (tf_index_t index = 0; index < count; index++)
+            tf_tcp_uring_complete(worker, completions + index);
+        
+        tf_tcp_close_expired(worker);
+    }
+    
+    return true;
+}
+
+bool tf_tcp_worker_run(tf_tcp_worker_ref worker) {
+    tf_poller_event_t events[TF_POLLER_MAX_EVENTS];
+    
+    if (worker->ring)
+        return tf_tcp_worker_run_uring(worker);
+    
+    while (true) {
+        // sleep until there's activity or the next deadline is due
+        int timeout = tf_timer_wheel_get_timeout(worker->timers, worker->now);
+        int count = tf_poller_wait(worker->poller, events, TF_POLLER_MAX_EVENTS,
+                                   (timeout >= 0 ? timeout : TF_POLLER_WAIT_FOREVER));
+        
+        worker->now = tf_monotonic_ms();
+        
+        if (count < 0) {
+            TF_LOG_ERROR("Poller wait failed in worker %u, errno = %s, exiting...",
+                         worker->id, strerror(errno));
+            
+            // TODO: maybe make a function that will close all client connections
+            // too, as dirty cleanup might be unacceptable for non-standalone TCP
+            // server apps
+            return false;
+        }
+        
+        for (int index = 0; index < count; index++) {
+            tf_socket_t current = events[index].socket;
+            
+            if (current == worker->main_socket) {
+                tf_tcp_accept_pending(worker); // incoming connection
+                continue;
+            }
+            
+            if (current == tf_mailbox_get_descriptor(worker->mailbox)) {
+                tf_mailbox_run(worker->mailbox); // finished pool jobs
+                continue;
+            }
+            
+            tf_conn_ref conn = tf_conn_table_get(worker->connections, current);
+            
+            // writable or failed, either way the handshake is over
+            if (conn && tf_conn_is_connecting(conn)) {
+                tf_tcp_complete_connect(worker, conn);
+                continue;
+            }
+            
+            // the socket may have been closed by an earlier event in this batch
+            if (conn && (events[index].flags & TF_POLLER_WRITABLE) &&
+                !tf_tcp_flush(worker, conn))
+                continue;
+            
+            if (conn && (tf_conn_get_poll_flags(conn) & TF_POLLER_READABLE) &&
+                (events[index].flags & (TF_POLLER_READABLE | TF_POLLER_HANGUP)))
+                tf_tcp_read_pending(worker, conn);
+        }
+        
+        tf_tcp_close_expired(worker);
+    }
+    
+    return true;
+}
+
+void* tf_tcp_worker_thread(void* arg) {
+    tf_tcp_worker_run((tf_tcp_worker_ref)arg);
+    return NULL;
+}
+
+/// one ring per worker, all of them or none
+bool tf_tcp_init_rings(tf_tcp_ref tcp) {
+    for (tf_index_t index = 0; index < tcp->worker_count; index++) {
+        tcp->workers[index].ring = tf_uring_init(TF_TCP_URING_ENTRIES,
+                                                 TF_TCP_URING_BUFFER_COUNT,
+                                                 TF_TCP_URING_BUFFER_SIZE);
+        
+        if (!tcp->workers[index].ring) {
+            for (tf_index_t other = 0; other < index; other++) {
+                tf_uring_release(tcp->workers[other].ring);
+                tcp->workers[other].ring = NULL;
+            }
+            
+            return false;
+        }
+    }
     
-    // max client count
-    tf_index_t max_clients;
-    // max connections count
-    tf_index_t max_connections;
-};
+    return true;
+}
 
 //
 // public
@@ -66,21 +1275,16 @@ bool tf_make_ipv4_sockaddr(const char* address, const tf_port_t port,
 
 #define TF_TCP_INIT_DESTROY_PROGRESS(msg) \
 { \
-    TF_LOG(msg); \
+    TF_LOG_ERROR(msg); \
     \
-    tf_int_array_release(server->client_sockets); \
-    FD_ZERO(&server->client_descs); \
-    \
-    if (server->main_socket >= 0) \
-        close(server->main_socket); \
-    \
-    free(server); \
+    tf_tcp_release(server); \
     return NULL; \
 }
 
 tf_tcp_ref tf_tcp_init(const char* ipv4a,
                        const tf_port_t port,
-                       const tf_index_t max_clients) {
+                       const tf_index_t max_clients,
+                       const tf_index_t workers) {
     tf_tcp_ref server = tf_struct_alloc(tf_tcp_s);
     
     // convert IPv4 string into sockaddr_in
@@ -89,24 +1293,29 @@ tf_tcp_ref tf_tcp_init(const char* ipv4a,
     
     // TODO: make const
     server->max_clients = (max_clients >= 1 ? max_clients : 3);
-    server->client_sockets = tf_int_array_init(server->max_clients, false);
+    server->worker_count = (workers >= 1 ? workers : 1);
+    tf_tcp_get_default_listen_options(&server->listen_options);
     
-    // initialize server socket
-    server->main_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server->main_socket < 0)
-        TF_TCP_INIT_DESTROY_PROGRESS("Socket creation failed, see errno for more info")
+#ifndef SO_REUSEPORT
+    if (server->worker_count > 1) {
+        TF_LOG_WARN("SO_REUSEPORT is not available, falling back to a single worker");
+        server->worker_count = 1;
+    }
+#endif
     
-    TF_LOG("server = <%p>, main_socket = %d", server, server->main_socket);
-        
-    // we need to point to this while setting the REUSEADDR flag
-    bool truev = true;
-    setsockopt(server->main_socket, SOL_SOCKET, SO_REUSEADDR, &truev, sizeof(truev));
+    server->workers = calloc(server->worker_count, sizeof(struct tf_tcp_worker_s));
+    for (tf_index_t index = 0; index < server->worker_count; index++)
+        server->workers[index].main_socket = -1;
+    
+    TF_LOG_DEBUG("server = <%p>, workers = %u", server, server->worker_count);
+    
+    server->metrics = tf_metrics_init(server->worker_count);
+    
+    for (tf_index_t index = 0; index < server->worker_count; index++) {
+        if (!tf_tcp_worker_init(server, server->workers + index, index))
+            TF_TCP_INIT_DESTROY_PROGRESS("Worker setup failed, see errno for more info")
+    }
     
-    // now bind the main socket
-    if (bind(server->main_socket, (struct sockaddr*)&server->main_address,
-             sizeof(server->main_address)) < 0)
-        TF_TCP_INIT_DESTROY_PROGRESS("Bind failed, see errno for more info")
-        
     return server;
 }
 
@@ -117,118 +1326,364 @@ bool tf_tcp_listen(tf_tcp_ref tcp, const tf_tcp_callback_t cb,
     if (!tcp || !cb)
         return false; // a valid callback is required
     
-    if (listen(tcp->main_socket, tcp->max_connections) < 0) {
-        perror(strerror(errno));
-        TF_LOG("Listen failed, returning false");
-        
-        return false;
+    tcp->callback = cb;
+    tcp->callback_meta = cbmeta;
+    
+    if (tcp->backend == TF_TCP_BACKEND_URING && !tf_tcp_init_rings(tcp)) {
+        TF_LOG_WARN("Cannot set up io_uring, falling back to %s",
+                    tf_poller_get_backend_name());
+        tcp->backend = TF_TCP_BACKEND_POLLER;
     }
     
-    while (true) {
-        // clean all the FDs and client sockets
-        FD_ZERO(&tcp->client_descs);
+    for (tf_index_t index = 0; index < tcp->worker_count; index++) {
+        tf_tcp_worker_ref worker = tcp->workers + index;
         
-        // fill in fdset with valid sockets, starting with the main socket
-        FD_SET(tcp->main_socket, &tcp->client_descs);
+        if (!tf_tcp_worker_listen(worker))
+            return false;
         
-        // determine client connection sockets' statuses
-        tf_socket_t recent_conn = tcp->main_socket;
+        // with io_uring the worker arms a multishot accept and a mailbox
+        // poll instead
+        if (!worker->ring &&
+            (!tf_poller_add(worker->poller, worker->main_socket, TF_POLLER_READABLE) ||
+             !tf_poller_add(worker->poller, tf_mailbox_get_descriptor(worker->mailbox),
+                            TF_POLLER_READABLE))) {
+            TF_LOG_ERROR("Cannot watch main socket, returning false");
+            return false;
+        }
+    }
+    
+    TF_LOG_INFO("Listen intact (%s, %u workers), waiting for connections...",
+                (tcp->backend == TF_TCP_BACKEND_URING ? "io_uring" :
+                 tf_poller_get_backend_name()), tcp->worker_count);
+    
+    // worker 0 runs on the calling thread, the rest get their own
+    for (tf_index_t index = 1; index < tcp->worker_count; index++) {
+        tf_tcp_worker_ref worker = tcp->workers + index;
         
-        for (tf_index_t index = 0; index < tf_int_array_get_count(tcp->client_sockets);
-             index++) {
-            tf_socket_t desc = tf_int_array_get_at(tcp->client_sockets,
-                                                   index, -1);
-            
-            // if socket is valid, then track it
-            if (desc > 0)
-                FD_SET(desc, &tcp->client_descs);
+        if (pthread_create(&worker->thread, NULL, tf_tcp_worker_thread, worker) != 0) {
+            TF_LOG_WARN("Cannot start worker %u, continuing without it", index);
             
-            recent_conn = tf_keep_greater(recent_conn, desc);
+            tf_tcp_worker_abandon(worker);
+            continue;
         }
         
-        // wait for activity/new connections via select
-        if (select(recent_conn + 1, &tcp->client_descs, NULL, NULL, NULL) < 0) {
-            if (errno == EINTR)
-                TF_LOG("User interrupt received, continuing nevertheless");
-            else {
-                perror(strerror(errno));
-                TF_LOG("Select failed, closing server connection and exiting...");
-                
-                // TODO: maybe make a function that will close all client connections
-                // too, as dirty cleanup might be unacceptable for non-standalone TCP
-                // server apps
-                return false;
-            }
-        }
+        worker->thread_started = true;
+    }
+    
+    return tf_tcp_worker_run(tcp->workers);
+}
+
+tf_index_t tf_tcp_get_worker_count(const tf_tcp_ref tcp) {
+    return (tcp ? tcp->worker_count : 0);
+}
+
+void tf_tcp_get_default_listen_options(tf_tcp_listen_options_t* optionsp) {
+    if (!optionsp)
+        return;
+    
+    bzero(optionsp, sizeof(tf_tcp_listen_options_t));
+    
+    optionsp->backlog = TF_TCP_DEFAULT_BACKLOG;
+    optionsp->nodelay = true;
+}
+
+void tf_tcp_set_listen_options(tf_tcp_ref tcp, const tf_tcp_listen_options_t* options) {
+    if (tcp && options)
+        tcp->listen_options = *options;
+}
+
+tf_metrics_ref tf_tcp_get_metrics(const tf_tcp_ref tcp) {
+    return (tcp ? tcp->metrics : NULL);
+}
+
+bool tf_tcp_set_backend(tf_tcp_ref tcp, const tf_tcp_backend_t backend) {
+    if (!tcp)
+        return false;
+    
+    if (backend == TF_TCP_BACKEND_URING && !tf_uring_is_supported()) {
+        TF_LOG_WARN("io_uring is not available, staying with %s",
+                    tf_poller_get_backend_name());
         
-        if (FD_ISSET(tcp->main_socket, &tcp->client_descs)) {
-            // incoming connection
-            
-            // TODO: maybe cb should have sth like a struct for storing IP address
-            // meta which will be passed on every occasion?
-            struct sockaddr claddr;
-            socklen_t clalen = 0;
-            
-            tf_socket_t newcl = accept(tcp->main_socket,
-                                       &claddr, &clalen);
-            if (newcl > 0) {
-                // accepted, call the callback for proper backend-side handling
-                cb(tcp, TF_TCP_CONNECTION_NEW, NULL, 0, newcl, cbmeta);
-                // then save the socket for further use
-                tf_int_array_push_replacing_zeroes(tcp->client_sockets,
-                                                   newcl);
-            } else
-                TF_LOG("warning! connection accept failed, errno = %s, will continue",
-                       strerror(errno));
-        } else {
-            // existing connection update (probably)
-            for (tf_index_t iter = 0; iter < tf_int_array_get_count(tcp->client_sockets);
-                 iter++) {
-                tf_socket_t current = tf_int_array_get_at(tcp->client_sockets, iter, 0);
-                
-                if (FD_ISSET(current, &tcp->client_descs)) {
-                    // read incoming data
-                    // TODO: support reading more than 1024 pkt sizes
-                    tf_index_t dlen = 0;
-                    tf_data_ref dread = tf_socket_read_data(current, &dlen);
-                    
-                    if (dlen < 1) {
-                        // probably closing connection
-                        cb(tcp, TF_TCP_CONNECTION_CLOSE, dread, dlen, current, cbmeta);
-                        
-                        // close & zero out connection
-                        close(current);
-                        tf_int_array_set_at(tcp->client_sockets, iter, 0);
-                    } else
-                        cb(tcp, TF_TCP_CONNECTION_CONTINUE, dread, dlen, current, cbmeta);
-                }
-            }
-        }
+        tcp->backend = TF_TCP_BACKEND_POLLER;
+        return false;
+    }
+    
+    tcp->backend = backend;
+    return true;
+}
+
+tf_tcp_backend_t tf_tcp_get_backend(const tf_tcp_ref tcp) {
+    return (tcp ? tcp->backend : TF_TCP_BACKEND_POLLER);
+}
+
+tf_mailbox_ref tf_tcp_get_mailbox(const tf_tcp_ref tcp, const tf_index_t worker) {
+    return (tcp && worker < tcp->worker_count ? tcp->workers[worker].mailbox : NULL);
+}
+
+bool tf_tcp_set_splice(tf_tcp_ref tcp, tf_conn_ref conn, const int fd,
+                       const uint64_t length) {
+    if (!tcp || !conn)
+        return false;
+    
+#if defined(__linux__)
+    // io_uring receives into its own buffers whenever data arrives
+    if (tcp->workers[tf_conn_get_worker_id(conn)].ring)
+        return false;
+    
+    tf_conn_set_splice(conn, fd, (fd >= 0 ? length : 0));
+    return true;
+#else
+    (void)(fd);
+    (void)(length);
+    
+    return false;
+#endif
+}
+
+bool tf_tcp_address_parse(const char* text, tf_tcp_address_t* addressp) {
+    tf_tcp_address_t result;
+    bzero(&result, sizeof(result));
+    
+    if (!text)
+        return false;
+    
+    if (strncmp(text, "unix:", 5) == 0) {
+        struct sockaddr_un* local = (struct sockaddr_un*)&result.storage;
+        size_t length = strlen(text + 5);
+        
+        if (length < 1 || length >= sizeof(local->sun_path))
+            return false;
+        
+        local->sun_family = AF_UNIX;
+        memcpy(local->sun_path, text + 5, length);
+        result.length = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + 1);
+        
+        TF_PTR_SET(addressp, result);
+        return true;
+    }
+    
+    const char* colon = strrchr(text, ':');
+    char host[INET6_ADDRSTRLEN + 2];
+    char* end = NULL;
+    
+    if (!colon || colon == text || (size_t)(colon - text) >= sizeof(host))
+        return false;
+    
+    unsigned long port = strtoul(colon + 1, &end, 10);
+    
+    if (end == colon + 1 || *end || port < 1 || port > 65535)
+        return false;
+    
+    size_t hlen = (size_t)(colon - text);
+    
+    memcpy(host, text, hlen);
+    host[hlen] = '\0';
+    
+    // IPv6 addresses are bracketed, the port comes after the brackets
+    if (host[0] == '[' && hlen > 2 && host[hlen - 1] == ']') {
+        struct sockaddr_in6* ipv6 = (struct sockaddr_in6*)&result.storage;
+        
+        host[hlen - 1] = '\0';
+        
+        if (inet_pton(AF_INET6, host + 1, &ipv6->sin6_addr) != 1)
+            return false;
+        
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons((tf_port_t)port);
+        result.length = sizeof(struct sockaddr_in6);
+    } else {
+        struct sockaddr_in* ipv4 = (struct sockaddr_in*)&result.storage;
+        
+        if (inet_pton(AF_INET, host, &ipv4->sin_addr) != 1)
+            return false;
+        
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = htons((tf_port_t)port);
+        result.length = sizeof(struct sockaddr_in);
+    }
+    
+    TF_PTR_SET(addressp, result);
+    return true;
+}
+
+tf_conn_ref tf_tcp_connect(tf_tcp_ref tcp, const tf_index_t worker_id,
+                           const tf_tcp_address_t* address,
+                           const tf_tcp_callback_t callback, tf_data_ref meta) {
+    if (!tcp || worker_id >= tcp->worker_count || !address || !callback)
+        return NULL;
+    
+    tf_tcp_worker_ref worker = tcp->workers + worker_id;
+    int family = address->storage.ss_family;
+    int truev = 1;
+    
+#ifdef SOCK_NONBLOCK
+    tf_socket_t current = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+    tf_socket_t current = socket(family, SOCK_STREAM, 0);
+    
+    if (current >= 0 && (!tf_socket_set_nonblocking(current) ||
+                         fcntl(current, F_SETFD, FD_CLOEXEC) < 0)) {
+        close(current);
+        current = -1;
+    }
+#endif
+    
+    if (current < 0) {
+        TF_LOG_WARN("cannot open a socket to connect, errno = %s", strerror(errno));
+        return NULL;
+    }
+    
+#ifdef SO_NOSIGPIPE
+    setsockopt(current, SOL_SOCKET, SO_NOSIGPIPE, &truev, sizeof(truev));
+#endif
+    // requests are gathered into as few writes as the responses are
+    if (family != AF_UNIX)
+        setsockopt(current, IPPROTO_TCP, TCP_NODELAY, &truev, sizeof(truev));
+    
+    // a local peer may take it right away, the writability says so either way
+    if (connect(current, (const struct sockaddr*)&address->storage, address->length) < 0 &&
+        errno != EINPROGRESS) {
+        TF_LOG_DEBUG("connect failed on socket %d, errno = %s", current, strerror(errno));
+        
+        close(current);
+        return NULL;
+    }
+    
+    tf_conn_ref conn = tf_conn_table_insert(worker->connections, current, worker->id);
+    bool tracked = (conn != NULL);
+    
+    if (tracked) {
+        tf_conn_set_callback(conn, callback, meta);
+        tf_conn_set_connecting(conn, true);
+    }
+    
+    if (tracked && worker->ring) {
+        tf_conn_uring_t* state = tf_conn_get_uring(conn);
+        
+        state->generation = ++worker->generation;
+        state->polling = tf_uring_poll_writable(worker->ring, current,
+                                                tf_tcp_uring_data(TF_TCP_URING_POLL, current,
+                                                                  state->generation));
+        tracked = state->polling;
+    } else if (tracked) {
+        tracked = tf_poller_add(worker->poller, current, TF_POLLER_WRITABLE);
+        
+        if (tracked)
+            tf_conn_set_poll_flags(conn, TF_POLLER_WRITABLE);
+    }
+    
+    if (!tracked) {
+        TF_LOG_WARN("cannot track socket %d, dropping connection", current);
+        
+        tf_conn_table_remove(worker->connections, conn);
+        close(current);
+        return NULL;
+    }
+    
+    // not a client, there's no first response byte to measure
+    tf_conn_get_timing(conn)->accepted_at = tf_monotonic_ns();
+    tf_conn_get_timing(conn)->first_byte_sent = true;
+    
+    tf_conn_get_timer(conn)->data = conn;
+    tf_tcp_start_read_timeout(worker, conn, TF_TCP_TIMEOUT_IDLE);
+    tf_tcp_update_timer(worker, conn, false);
+    
+    return conn;
+}
+
+void tf_tcp_set_paused(tf_tcp_ref tcp, tf_conn_ref conn, const bool paused) {
+    if (!tcp || !conn || tf_conn_is_paused(conn) == paused)
+        return;
+    
+    tf_tcp_worker_ref worker = tcp->workers + tf_conn_get_worker_id(conn);
+    
+    tf_conn_set_paused(conn, paused);
+    
+    // the handshake has to be over first, reading starts after it
+    if (tf_conn_is_connecting(conn) || tf_conn_is_closing(conn))
+        return;
+    
+    bool updated = (worker->ring ? tf_tcp_uring_update_receive(worker, conn) :
+                    tf_tcp_update_interest(worker, conn));
+    
+    // the caller may still be using it, the server closes it later on
+    if (!updated) {
+        TF_LOG_WARN("cannot update events of socket %d, closing", tf_conn_get_socket(conn));
+        
+        tf_conn_set_close_reason(conn, TF_TCP_CLOSE_ERROR);
+        tf_conn_close(conn);
+    }
+}
+
+bool tf_tcp_resume(tf_tcp_ref tcp, tf_conn_ref conn) {
+    if (!tcp || !conn)
+        return false;
+    
+    return tf_tcp_flush(tcp->workers + tf_conn_get_worker_id(conn), conn);
+}
+
+void tf_tcp_set_timeout(tf_tcp_ref tcp, const tf_tcp_timeout_t timeout,
+                        const tf_index_t length) {
+    if (tcp && timeout < TF_TCP_TIMEOUT_COUNT)
+        tcp->timeouts[timeout] = length;
+}
+
+void tf_tcp_set_read_timeout(tf_tcp_ref tcp, tf_conn_ref conn,
+                             const tf_tcp_timeout_t timeout, const bool restart) {
+    if (!tcp || !conn || timeout >= TF_TCP_TIMEOUT_COUNT)
+        return;
+    
+    if (!restart && tf_conn_get_read_timeout(conn, NULL) == timeout)
+        return; // keeps running
+    
+    tf_tcp_start_read_timeout(tcp->workers + tf_conn_get_worker_id(conn), conn, timeout);
+}
+
+const char* tf_tcp_close_reason_get_name(const tf_tcp_close_reason_t reason) {
+    switch (reason) {
+        case TF_TCP_CLOSE_DONE:
+            return "done";
+        case TF_TCP_CLOSE_PEER:
+            return "closed by peer";
+        case TF_TCP_CLOSE_ERROR:
+            return "error";
+        case TF_TCP_CLOSE_TIMEOUT_HEADER:
+            return "request head timeout";
+        case TF_TCP_CLOSE_TIMEOUT_BODY:
+            return "request body timeout";
+        case TF_TCP_CLOSE_TIMEOUT_IDLE:
+            return "idle timeout";
+        case TF_TCP_CLOSE_TIMEOUT_WRITE:
+            return "write timeout";
+        case TF_TCP_CLOSE_TIMEOUT_HANDLER:
+            return "handler timeout";
+        case TF_TCP_CLOSE_REASON_COUNT:
+            break;
     }
     
-    TF_LOG("Listen intact, waiting for connections...");
+    return "unknown";
 }
 
 void tf_tcp_release(tf_tcp_ref tcp) {
     if (!tcp)
         return;
     
-    // close all client connections if active
-    for (tf_index_t index = 0; index < tf_int_array_get_count(tcp->client_sockets);
-         index++) {
-        tf_socket_t sock = tf_int_array_get_at(tcp->client_sockets,
-                                               index, -1);
+    if (tcp->workers) {
+        // stop the extra reactor threads before pulling their state away
+        for (tf_index_t index = 0; index < tcp->worker_count; index++) {
+            if (tcp->workers[index].thread_started) {
+                pthread_cancel(tcp->workers[index].thread);
+                pthread_join(tcp->workers[index].thread, NULL);
+            }
+        }
         
-        if (sock > 0)
-            close(sock);
+        for (tf_index_t index = 0; index < tcp->worker_count; index++)
+            tf_tcp_worker_release(tcp->workers + index);
+        
+        free(tcp->workers);
     }
     
-    // cleanup with all the client-related stuff
-    tf_int_array_release(tcp->client_sockets);
-    FD_ZERO(&tcp->client_descs);
-    
-    // close main socket too
-    close(tcp->main_socket);
+    tf_metrics_release(tcp->metrics);
     free(tcp);
 }
 
@@ -236,39 +1691,216 @@ void tf_tcp_release(tf_tcp_ref tcp) {
 // socket ops public
 //
 
-tf_data_ref tf_socket_read_data(tf_socket_t socket,
-                                tf_index_t* sizep) {
-    tf_data_ref result = malloc(TF_TCP_MAX_PKT_SIZE);
-    bzero(result, TF_TCP_MAX_PKT_SIZE);
+bool tf_socket_read_data(tf_socket_t socket,
+                         tf_data_ref buffer,
+                         const tf_index_t capacity,
+                         tf_index_t* sizep) {
+    TF_PTR_SET(sizep, 0);
     
-    ssize_t alen = read(socket, result, TF_TCP_MAX_PKT_SIZE);
-    if (alen < 1) {
-        // fail
-        perror(strerror(errno));
-        
-        free(result);
-        TF_PTR_SET(sizep, 0);
+    if (!buffer || capacity < 1)
+        return false;
+    
+    ssize_t alen = recv(socket, buffer, capacity, MSG_DONTWAIT);
+    if (alen < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true; // nothing left to read right now
         
-        return NULL;
+        // fail
+        TF_LOG_DEBUG("recv failed on socket %d, errno = %s", socket, strerror(errno));
+        return false;
     }
     
+    if (alen == 0)
+        return false; // EOF
+    
     TF_PTR_SET(sizep, (tf_index_t)(alen));
-    return result;
+    return true;
 }
 
 bool tf_socket_send_data(tf_socket_t socket,
                          const tf_data_ref data,
-                         const tf_index_t dlen) {
+                         const tf_index_t dlen,
+                         tf_index_t* sentp) {
+    TF_PTR_SET(sentp, 0);
+    
     if (!data || dlen < 1) {
-        perror("cannot send NULL data");
+        TF_LOG_WARN("cannot send NULL data");
+        return false;
+    }
+    
+    ssize_t alen = send(socket, data, dlen, MSG_NOSIGNAL);
+    if (alen < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true; // try again once the socket is writable
+        
+        // fail
+        TF_LOG_DEBUG("send failed on socket %d, errno = %s", socket, strerror(errno));
         return false;
     }
     
-    if (send(socket, data, dlen, 0) < 0) {
+    TF_PTR_SET(sentp, (tf_index_t)(alen));
+    return true;
+}
+
+bool tf_socket_send_buffers(tf_socket_t socket,
+                            const tf_buffer_ref head,
+                            const tf_index_t offset,
+                            tf_index_t* sentp) {
+    TF_PTR_SET(sentp, 0);
+    
+    uint64_t file_offset = 0;
+    int file = tf_buffer_get_file(head, &file_offset);
+    
+    // file ranges go out one at a time, straight from the page cache
+    if (file >= 0)
+        return tf_socket_send_file(socket, file, file_offset + offset,
+                                   tf_buffer_get_length(head) - offset, sentp);
+    
+    struct iovec vectors[TF_TCP_MAX_IOV];
+    int count = 0;
+    int flags = MSG_NOSIGNAL;
+    tf_index_t skip = offset;
+    
+    // gather as much of the chain as possible, headers and body go out
+    // with one syscall this way
+    for (tf_buffer_ref current = head; current && count < TF_TCP_MAX_IOV;
+         current = tf_buffer_get_next(current)) {
+        if (tf_buffer_get_file(current, NULL) >= 0) {
+            // let the kernel merge the headers with the file contents
+            flags |= MSG_MORE;
+            break;
+        }
+        
+        tf_index_t length = tf_buffer_get_length(current);
+        
+        if (length <= skip) {
+            skip -= length;
+            continue;
+        }
+        
+        vectors[count].iov_base = tf_buffer_get_data(current) + skip;
+        vectors[count].iov_len = length - skip;
+        
+        count++;
+        skip = 0;
+    }
+    
+    if (count < 1)
+        return true; // nothing to send
+    
+    struct msghdr message;
+    bzero(&message, sizeof(message));
+    
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+    
+    ssize_t alen = sendmsg(socket, &message, flags);
+    if (alen < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true; // try again once the socket is writable
+        
         // fail
-        perror(strerror(errno));
+        if (errno != EPIPE && errno != ECONNRESET)
+            TF_LOG_DEBUG("sendmsg failed on socket %d, errno = %s", socket, strerror(errno));
+        
+        return false;
+    }
+    
+    TF_PTR_SET(sentp, (tf_index_t)(alen));
+    return true;
+}
+
+bool tf_socket_send_file(tf_socket_t socket,
+                         const int file,
+                         const uint64_t offset,
+                         const tf_index_t length,
+                         tf_index_t* sentp) {
+    TF_PTR_SET(sentp, 0);
+    
+    if (file < 0 || length < 1)
+        return false;
+    
+#if defined(__linux__)
+    off_t position = (off_t)offset;
+    ssize_t alen = sendfile(socket, file, &position, length);
+    
+    if (alen < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true; // try again once the socket is writable
+        
+        if (errno != EPIPE && errno != ECONNRESET)
+            TF_LOG_DEBUG("sendfile failed on socket %d, errno = %s", socket, strerror(errno));
+        
+        return false;
+    }
+#elif defined(__APPLE__)
+    off_t alen = (off_t)length;
+    
+    // the amount sent is reported even if the call fails with EAGAIN
+    if (sendfile(file, socket, (off_t)offset, &alen, NULL, 0) < 0 &&
+        errno != EAGAIN && errno != EINTR) {
+        if (errno != EPIPE && errno != ENOTCONN)
+            TF_LOG_DEBUG("sendfile failed on socket %d, errno = %s", socket, strerror(errno));
+        
+        return false;
+    }
+    
+    if (alen < 1 && (errno == EAGAIN || errno == EINTR))
+        return true;
+#else
+    // no zero-copy path here, go through a bounce buffer
+    char chunk[TF_TCP_FILE_COPY_CHUNK];
+    tf_index_t wanted = (length < sizeof(chunk) ? length : (tf_index_t)sizeof(chunk));
+    
+    ssize_t read_length = pread(file, chunk, wanted, (off_t)offset);
+    if (read_length <= 0)
+        return false;
+    
+    ssize_t alen = send(socket, chunk, (size_t)read_length, MSG_NOSIGNAL);
+    if (alen < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true;
+        
         return false;
     }
+#endif
+    
+    // the file got shorter than promised, nothing is going to fix that
+    if (alen == 0)
+        return false;
     
+    TF_PTR_SET(sentp, (tf_index_t)(alen));
     return true;
 }
+
+char* tf_socket_get_client_ip(tf_socket_t socket,
+                              tf_port_t* portp) {
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    char text[INET6_ADDRSTRLEN];
+    const void* ip = NULL;
+    tf_port_t port = 0;
+    
+    TF_PTR_SET(portp, 0);
+    
+    if (getpeername(socket, (struct sockaddr*)&address, &length) < 0)
+        return NULL;
+    
+    if (address.ss_family == AF_INET) {
+        const struct sockaddr_in* ipv4 = (const struct sockaddr_in*)&address;
+        
+        ip = &ipv4->sin_addr;
+        port = ntohs(ipv4->sin_port);
+    } else if (address.ss_family == AF_INET6) {
+        const struct sockaddr_in6* ipv6 = (const struct sockaddr_in6*)&address;
+        
+        ip = &ipv6->sin6_addr;
+        port = ntohs(ipv6->sin6_port);
+    }
+    
+    if (!ip || !inet_ntop(address.ss_family, ip, text, sizeof(text)))
+        return NULL;
+    
+    TF_PTR_SET(portp, port);
+    return strdup(text);
+}
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <sys/socket.h>
 #include "types.h"
 
 //
@@ -15,26 +16,193 @@
 //
 
 #define TF_TCP_IP_LISTEN_ANY NULL
+/// minimum free space offered to a single read
 #define TF_TCP_MAX_PKT_SIZE 1024
+/// reading from a client pauses while it has more queued output than that
+#define TF_TCP_OUTPUT_HIGH_WATER (256 * 1024)
+/// connections asking for it are told when their output gets below that
+#define TF_TCP_OUTPUT_LOW_WATER (64 * 1024)
+/// pending connections per listening socket, the kernel caps it at
+/// net.core.somaxconn
+#define TF_TCP_DEFAULT_BACKLOG 4096
 
+/// peer of an outgoing connection, see tf_tcp_address_parse
+typedef struct {
+    struct sockaddr_storage storage;
+    socklen_t length;
+} tf_tcp_address_t;
+
+/// listening socket setup, see tf_tcp_set_listen_options
+typedef struct {
+    // connections the kernel completes on its own while the worker is
+    // busy, beyond that new ones have to retry their SYN
+    int backlog;
+    // seconds a connection may wait for its first data before the worker
+    // hears of it (TCP_DEFER_ACCEPT, Linux only), 0 to accept right away
+    int defer_accept;
+    // pending TCP Fast Open requests (data in the SYN), 0 disables it,
+    // the system has to allow it as well (net.ipv4.tcp_fastopen on Linux)
+    int fastopen;
+    // TCP_NODELAY on the client sockets
+    bool nodelay;
+    // SO_RCVBUF and SO_SNDBUF inherited by the client sockets, 0 leaves
+    // them to the kernel's auto-tuning
+    int receive_buffer;
+    int send_buffer;
+} tf_tcp_listen_options_t;
+
+///
+/// creates a TCP server with the specified amount of workers, each of
+/// them has its own SO_REUSEPORT listening socket, client list and event
+/// loop, max_clients is applied per worker
+///
 tf_tcp_ref tf_tcp_init(const char* ipv4a,
                        const tf_port_t port,
-                       const tf_index_t max_clients);
+                       const tf_index_t max_clients,
+                       const tf_index_t workers);
 
+/// runs worker 0 on the calling thread and all the others on their own
+/// threads, the callback must be thread-safe if there is more than one
 bool tf_tcp_listen(tf_tcp_ref tcp, const tf_tcp_callback_t cb,
                    tf_data_ref cbmeta);
 
+tf_index_t tf_tcp_get_worker_count(const tf_tcp_ref tcp);
+
+/// TF_TCP_DEFAULT_BACKLOG, TCP_NODELAY and everything else left alone
+void tf_tcp_get_default_listen_options(tf_tcp_listen_options_t* optionsp);
+
+///
+/// replaces the listening socket setup, must be set before tf_tcp_listen,
+/// options the system doesn't have or refuses are logged and skipped
+///
+void tf_tcp_set_listen_options(tf_tcp_ref tcp, const tf_tcp_listen_options_t* options);
+
+/// counters and timings of all the workers, see metrics.h
+tf_metrics_ref tf_tcp_get_metrics(const tf_tcp_ref tcp);
+
+///
+/// picks how the workers wait for I/O, must be set before tf_tcp_listen:
+/// readiness through the poller (epoll/select, the default) or completions
+/// through io_uring (Linux only), with multishot accepts and receives into
+/// a ring of provided buffers and the output going out as linked sends
+///
+/// returns false and stays with the poller if io_uring is not available,
+/// tf_tcp_listen falls back to it as well if a worker cannot get its ring
+///
+bool tf_tcp_set_backend(tf_tcp_ref tcp, const tf_tcp_backend_t backend);
+tf_tcp_backend_t tf_tcp_get_backend(const tf_tcp_ref tcp);
+
+///
+/// mailbox of the specified worker (see pool.h), tasks posted there run
+/// on that worker's thread in between its I/O, so that's where results
+/// computed elsewhere are handed back to its connections
+///
+tf_mailbox_ref tf_tcp_get_mailbox(const tf_tcp_ref tcp, const tf_index_t worker);
+
+///
+/// to be called on the connection's worker thread outside the callback
+/// (from a mailbox task) after queueing output or closing the connection,
+/// does what the server does right after each callback: sends the output,
+/// updates the deadlines and closes a closing connection once drained,
+/// returns false if the connection is gone
+///
+bool tf_tcp_resume(tf_tcp_ref tcp, tf_conn_ref conn);
+
+///
+/// to be called from the callback: up to length bytes of what the client
+/// sends next go straight into fd (a file or a blocking pipe) with splice()
+/// instead of into the input, TF_TCP_CONNECTION_SPLICED callbacks tell how
+/// much went each time, 0 if fd failed (the target is dropped then), the
+/// input is read as usual again afterwards
+///
+/// the input must be empty (consumed) for the splicing to start, returns
+/// false if the backend cannot splice (io_uring, systems other than Linux),
+/// a negative fd drops the target
+///
+bool tf_tcp_set_splice(tf_tcp_ref tcp, tf_conn_ref conn, const int fd,
+                       const uint64_t length);
+
+/// reads "IPv4:port", "[IPv6]:port" or "unix:/path/to/socket", false if
+/// text is none of them
+bool tf_tcp_address_parse(const char* text, tf_tcp_address_t* addressp);
+
+///
+/// opens an outgoing connection, to be called on the thread of the worker
+/// it belongs to, which serves it like its clients, except that it has
+/// its own callback: TF_TCP_CONNECTION_NEW once the handshake is over, or
+/// TF_TCP_CONNECTION_CLOSE with TF_TCP_CLOSE_ERROR if it fails, output
+/// queued in the meantime goes out right after the handshake
+///
+/// counts against the worker's max_clients, NULL if the connection cannot
+/// be started at all
+///
+tf_conn_ref tf_tcp_connect(tf_tcp_ref tcp, const tf_index_t worker,
+                           const tf_tcp_address_t* address,
+                           const tf_tcp_callback_t callback, tf_data_ref meta);
+
+///
+/// stops reading from the connection until it's unpaused, what the peer
+/// sends meanwhile waits in the kernel and TCP flow control slows it down,
+/// to be called on the connection's worker thread
+///
+void tf_tcp_set_paused(tf_tcp_ref tcp, tf_conn_ref conn, const bool paused);
+
+///
+/// sets one of the connection deadlines in milliseconds (0 disables it, all
+/// of them are disabled by default), must be set before tf_tcp_listen,
+/// connections missing a deadline are closed with the matching
+/// TF_TCP_CLOSE_TIMEOUT_* reason
+///
+/// new connections start with the idle deadline, which is restarted by
+/// every read, the write deadline applies whenever output is pending
+///
+void tf_tcp_set_timeout(tf_tcp_ref tcp, const tf_tcp_timeout_t timeout,
+                        const tf_index_t length);
+
+///
+/// switches the deadline used while no output is pending, to be called
+/// from the callback, the running deadline is kept if it's of the same
+/// kind unless restart is set
+///
+void tf_tcp_set_read_timeout(tf_tcp_ref tcp, tf_conn_ref conn,
+                             const tf_tcp_timeout_t timeout, const bool restart);
+
+const char* tf_tcp_close_reason_get_name(const tf_tcp_close_reason_t reason);
+
 void tf_tcp_release(tf_tcp_ref tcp);
 
 //
 // socket ops
 //
 
-tf_data_ref tf_socket_read_data(tf_socket_t socket,
-                                tf_index_t* sizep);
+/// reads at most capacity bytes into buffer without blocking, returns false
+/// on EOF or failure, *sizep is 0 if there is nothing to read right now
+bool tf_socket_read_data(tf_socket_t socket,
+                         tf_data_ref buffer,
+                         const tf_index_t capacity,
+                         tf_index_t* sizep);
+/// sends as much as possible without blocking, returns false on failure,
+/// *sentp is 0 if the socket cannot take anything right now
 bool tf_socket_send_data(tf_socket_t socket,
                          const tf_data_ref data,
-                         const tf_index_t dlen);
+                         const tf_index_t dlen,
+                         tf_index_t* sentp);
+/// same for a buffer chain, starting offset bytes into the first buffer,
+/// the whole chain (or a big part of it) goes out with a single syscall
+bool tf_socket_send_buffers(tf_socket_t socket,
+                            const tf_buffer_ref head,
+                            const tf_index_t offset,
+                            tf_index_t* sentp);
+
+/// sends up to length bytes of the file starting at offset without
+/// copying them through user space (where sendfile() is available)
+bool tf_socket_send_file(tf_socket_t socket,
+                         const int file,
+                         const uint64_t offset,
+                         const tf_index_t length,
+                         tf_index_t* sentp);
 
+/// address of the peer (IPv4 or IPv6) as text, to be freed, its port goes
+/// to portp, NULL if the socket has no peer
 char* tf_socket_get_client_ip(tf_socket_t socket,
                               tf_port_t* portp);
@@ -0,0 +1,270 @@
+//
+//  timer.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <limits.h>
+#include "privutil.h"
+#include "timer.h"
+
+//
+// private
+//
+
+#define TF_TIMER_SLOT_MASK (TF_TIMER_SLOTS - 1)
+/// furthest a timer can be put from the current tick
+#define TF_TIMER_MAX_DELTA ((1ull << (TF_TIMER_SLOT_BITS * TF_TIMER_LEVELS)) - 1)
+
+struct tf_timer_wheel_s {
+    // list heads, a timer is linked into the one of its slot
+    tf_timer_t slots[TF_TIMER_LEVELS][TF_TIMER_SLOTS];
+    // due timers waiting for tf_timer_wheel_pop_expired
+    tf_timer_t expired;
+    
+    // next tick to be processed
+    uint64_t current;
+    
+    tf_index_t count;
+    tf_index_t expired_count;
+};
+
+void tf_timer_list_init(tf_timer_t* head) {
+    head->prev = head;
+    head->next = head;
+}
+
+bool tf_timer_list_is_empty(const tf_timer_t* head) {
+    return (head->next == head);
+}
+
+void tf_timer_list_append(tf_timer_t* head, tf_timer_t* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void tf_timer_list_unlink(tf_timer_t* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/// tick the timer is due at, rounded up so it never fires early
+uint64_t tf_timer_get_tick(const tf_timer_t* timer) {
+    return (timer->expires_at + TF_TIMER_TICK_MS - 1) / TF_TIMER_TICK_MS;
+}
+
+/// links the timer into the slot for its expiration tick
+void tf_timer_wheel_place(tf_timer_wheel_ref wheel, tf_timer_t* timer) {
+    uint64_t tick = tf_timer_get_tick(timer);
+    
+    if (tick < wheel->current) {
+        tf_timer_list_append(&wheel->expired, timer);
+        wheel->expired_count++;
+        return;
+    }
+    
+    uint64_t delta = tick - wheel->current;
+    
+    if (delta > TF_TIMER_MAX_DELTA) {
+        // too far away, it'll be put back once it's closer
+        delta = TF_TIMER_MAX_DELTA;
+        tick = wheel->current + delta;
+    }
+    
+    tf_index_t level = 0;
+    while (delta >= (1ull << (TF_TIMER_SLOT_BITS * (level + 1))))
+        level++;
+    
+    tf_index_t slot = (tf_index_t)((tick >> (TF_TIMER_SLOT_BITS * level)) &
+                                   TF_TIMER_SLOT_MASK);
+    
+    tf_timer_list_append(&wheel->slots[level][slot], timer);
+}
+
+/// spreads a slot of a coarser level over the finer ones
+void tf_timer_wheel_cascade(tf_timer_wheel_ref wheel, const tf_index_t level,
+                            const tf_index_t slot) {
+    tf_timer_t* head = &wheel->slots[level][slot];
+    
+    if (tf_timer_list_is_empty(head))
+        return;
+    
+    // detach the whole list first, timers may land in the same slot again
+    tf_timer_t pending;
+    
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    
+    tf_timer_list_init(head);
+    
+    while (!tf_timer_list_is_empty(&pending)) {
+        tf_timer_t* timer = pending.next;
+        
+        tf_timer_list_unlink(timer);
+        tf_timer_wheel_place(wheel, timer);
+    }
+}
+
+//
+// public
+//
+
+tf_timer_wheel_ref tf_timer_wheel_init(const uint64_t now) {
+    tf_timer_wheel_ref wheel = tf_struct_alloc(tf_timer_wheel_s);
+    
+    for (tf_index_t level = 0; level < TF_TIMER_LEVELS; level++) {
+        for (tf_index_t slot = 0; slot < TF_TIMER_SLOTS; slot++)
+            tf_timer_list_init(&wheel->slots[level][slot]);
+    }
+    
+    tf_timer_list_init(&wheel->expired);
+    wheel->current = now / TF_TIMER_TICK_MS;
+    
+    return wheel;
+}
+
+void tf_timer_wheel_arm(tf_timer_wheel_ref wheel, tf_timer_t* timer,
+                        const uint64_t expires_at) {
+    if (!wheel || !timer)
+        return;
+    
+    tf_timer_wheel_cancel(wheel, timer);
+    
+    timer->expires_at = expires_at;
+    tf_timer_wheel_place(wheel, timer);
+    
+    wheel->count++;
+}
+
+void tf_timer_wheel_cancel(tf_timer_wheel_ref wheel, tf_timer_t* timer) {
+    if (!wheel || !tf_timer_is_armed(timer))
+        return;
+    
+    // the slots only hold timers due at the current tick or later, so
+    // anything due before is on the expired list
+    if (tf_timer_get_tick(timer) < wheel->current)
+        wheel->expired_count--;
+    
+    tf_timer_list_unlink(timer);
+    wheel->count--;
+}
+
+bool tf_timer_is_armed(const tf_timer_t* timer) {
+    return (timer && timer->next != NULL);
+}
+
+tf_index_t tf_timer_wheel_advance(tf_timer_wheel_ref wheel, const uint64_t now) {
+    if (!wheel)
+        return 0;
+    
+    uint64_t target = now / TF_TIMER_TICK_MS;
+    
+    // nothing in the slots, no point in walking through them
+    if (wheel->count == wheel->expired_count && wheel->current <= target)
+        wheel->current = target + 1;
+    
+    while (wheel->current <= target) {
+        tf_index_t slot = (tf_index_t)(wheel->current & TF_TIMER_SLOT_MASK);
+        
+        // level 0 wrapped around, bring the next batch down
+        if (slot == 0) {
+            for (tf_index_t level = 1; level < TF_TIMER_LEVELS; level++) {
+                tf_index_t index = (tf_index_t)((wheel->current >>
+                                                 (TF_TIMER_SLOT_BITS * level)) &
+                                                TF_TIMER_SLOT_MASK);
+                
+                tf_timer_wheel_cascade(wheel, level, index);
+                
+                if (index != 0)
+                    break;
+            }
+        }
+        
+        tf_timer_t* head = &wheel->slots[0][slot];
+        
+        while (!tf_timer_list_is_empty(head)) {
+            tf_timer_t* timer = head->next;
+            
+            tf_timer_list_unlink(timer);
+            tf_timer_list_append(&wheel->expired, timer);
+            
+            wheel->expired_count++;
+        }
+        
+        wheel->current++;
+    }
+    
+    return wheel->expired_count;
+}
+
+tf_timer_t* tf_timer_wheel_pop_expired(tf_timer_wheel_ref wheel) {
+    if (!wheel || tf_timer_list_is_empty(&wheel->expired))
+        return NULL;
+    
+    tf_timer_t* timer = wheel->expired.next;
+    
+    tf_timer_list_unlink(timer);
+    
+    wheel->count--;
+    wheel->expired_count--;
+    
+    return timer;
+}
+
+int tf_timer_wheel_get_timeout(const tf_timer_wheel_ref wheel, const uint64_t now) {
+    if (!wheel || wheel->count < 1)
+        return -1;
+    
+    if (wheel->expired_count > 0)
+        return 0;
+    
+    // next level 0 wrap, coarser levels may have something due by then
+    uint64_t due = ((wheel->current + TF_TIMER_SLOT_MASK) >> TF_TIMER_SLOT_BITS) <<
+                   TF_TIMER_SLOT_BITS;
+    
+    for (uint64_t tick = wheel->current; tick < due; tick++) {
+        if (!tf_timer_list_is_empty(&wheel->slots[0][tick & TF_TIMER_SLOT_MASK])) {
+            due = tick;
+            break;
+        }
+    }
+    
+    uint64_t due_at = due * TF_TIMER_TICK_MS;
+    
+    if (due_at <= now)
+        return 0;
+    
+    return (due_at - now > INT_MAX ? INT_MAX : (int)(due_at - now));
+}
+
+tf_index_t tf_timer_wheel_get_count(const tf_timer_wheel_ref wheel) {
+    return (wheel ? wheel->count : 0);
+}
+
+void tf_timer_wheel_release(tf_timer_wheel_ref wheel) {
+    if (!wheel)
+        return;
+    
+    for (tf_index_t level = 0; level < TF_TIMER_LEVELS; level++) {
+        for (tf_index_t slot = 0; slot < TF_TIMER_SLOTS; slot++) {
+            while (!tf_timer_list_is_empty(&wheel->slots[level][slot]))
+                tf_timer_list_unlink(wheel->slots[level][slot].next);
+        }
+    }
+    
+    while (!tf_timer_list_is_empty(&wheel->expired))
+        tf_timer_list_unlink(wheel->expired.next);
+    
+    free(wheel);
+}
@@ -0,0 +1,82 @@
+//
+//  timer.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// hierarchical timer wheel
+//
+// time is cut into ticks of TF_TIMER_TICK_MS, timers due within the next
+// 64 ticks sit in the slot of their tick, later ones in coarser levels
+// (64 slots of 64 ticks, of 64*64 ticks, ...) and move down a level each
+// time the level below wraps around
+//
+// timers are embedded into the objects they belong to and linked into
+// circular lists, so arming, re-arming and cancelling are O(1) and never
+// allocate, advancing costs O(1) per elapsed tick plus the timers that
+// move or expire
+//
+// not thread-safe, meant to be owned by a single event loop
+//
+
+/// timer resolution in milliseconds, timers never fire early but may
+/// fire up to that much late
+#define TF_TIMER_TICK_MS 10
+/// levels of 64 slots each, 4 of them cover about 19 days
+#define TF_TIMER_LEVELS 4
+#define TF_TIMER_SLOT_BITS 6
+#define TF_TIMER_SLOTS (1 << TF_TIMER_SLOT_BITS)
+
+/// timer to be embedded into its owner, must be zeroed before first use
+typedef struct tf_timer_s tf_timer_t;
+struct tf_timer_s {
+    // list links, both NULL while not armed
+    tf_timer_t* prev;
+    tf_timer_t* next;
+    
+    // monotonic milliseconds
+    uint64_t expires_at;
+    
+    // free for the owner to use
+    tf_data_ref data;
+    uint8_t tag;
+};
+
+/// now is the current monotonic time in milliseconds
+tf_timer_wheel_ref tf_timer_wheel_init(const uint64_t now);
+
+/// arms the timer to expire at the given monotonic time, re-arms it if
+/// it's already armed
+void tf_timer_wheel_arm(tf_timer_wheel_ref wheel, tf_timer_t* timer,
+                        const uint64_t expires_at);
+/// does nothing if the timer is not armed
+void tf_timer_wheel_cancel(tf_timer_wheel_ref wheel, tf_timer_t* timer);
+bool tf_timer_is_armed(const tf_timer_t* timer);
+
+///
+/// moves the wheel forward to now, all the timers that are due by then
+/// are collected and can be taken out one by one with
+/// tf_timer_wheel_pop_expired, returns the amount of expired timers
+///
+tf_index_t tf_timer_wheel_advance(tf_timer_wheel_ref wheel, const uint64_t now);
+/// takes out the next expired timer (disarmed), NULL if there are no more
+tf_timer_t* tf_timer_wheel_pop_expired(tf_timer_wheel_ref wheel);
+
+///
+/// milliseconds until the wheel has to be advanced again, to be used as
+/// the event loop wait timeout, -1 if no timers are armed
+///
+int tf_timer_wheel_get_timeout(const tf_timer_wheel_ref wheel, const uint64_t now);
+
+/// armed timers, expired ones that have not been popped included
+tf_index_t tf_timer_wheel_get_count(const tf_timer_wheel_ref wheel);
+
+/// the timers still armed are left alone (only unlinked from the wheel)
+void tf_timer_wheel_release(tf_timer_wheel_ref wheel);
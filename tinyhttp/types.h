@@ -16,6 +16,12 @@ typedef uint32_t tf_index_t;
 /// void* typedef for readability purposes
 typedef void* tf_data_ref;
 
+/// non-owning (pointer, length) string view, not NUL-terminated
+typedef struct {
+    const char* data;
+    tf_index_t length;
+} tf_str_view_t;
+
 /// deallocator type
 typedef void (*tf_deallocator_t)(void*);
 
@@ -33,13 +39,114 @@ typedef int tf_socket_t;
 /// TCP server control object
 typedef struct tf_tcp_s* tf_tcp_ref;
 
+/// HTTP server on top of tf_tcp
+typedef struct tf_http_server_s* tf_http_server_ref;
+/// response body sent piece by piece with chunked encoding
+typedef struct tf_http_stream_s* tf_http_stream_ref;
+/// request body received piece by piece
+typedef struct tf_http_body_s* tf_http_body_ref;
+
+/// bump-pointer allocator for request-scoped objects
+typedef struct tf_arena_s* tf_arena_ref;
+
+/// static file engine with an open file cache
+typedef struct tf_docroot_s* tf_docroot_ref;
+
+/// per-worker cache of serialized responses
+typedef struct tf_cache_s* tf_cache_ref;
+/// single cached response
+typedef struct tf_cache_entry_s* tf_cache_entry_ref;
+
+/// method + path pattern request router
+typedef struct tf_router_s* tf_router_ref;
+
+/// hierarchical timer wheel, one per event loop
+typedef struct tf_timer_wheel_s* tf_timer_wheel_ref;
+
+/// per-worker counters and latency histograms
+typedef struct tf_metrics_s* tf_metrics_ref;
+
+/// pooled, chainable I/O buffer
+typedef struct tf_buffer_s* tf_buffer_ref;
+
+/// single client connection of a TCP server
+typedef struct tf_conn_s* tf_conn_ref;
+/// socket-indexed connection table
+typedef struct tf_conn_table_s* tf_conn_table_ref;
+
+/// readiness notification backend (epoll/select)
+typedef struct tf_poller_s* tf_poller_ref;
+/// io_uring submission/completion rings
+typedef struct tf_uring_s* tf_uring_ref;
+
+/// work-stealing thread pool for blocking jobs
+typedef struct tf_pool_s* tf_pool_ref;
+/// lock-free queue of tasks for an event loop thread, with a wakeup descriptor
+typedef struct tf_mailbox_s* tf_mailbox_ref;
+/// per-client rate limits and load shedding
+typedef struct tf_admit_s* tf_admit_ref;
+/// reverse proxy with pooled upstream connections
+typedef struct tf_proxy_s* tf_proxy_ref;
+
+/// readiness event flags
+typedef enum {
+    TF_POLLER_READABLE = 1 << 0,
+    TF_POLLER_WRITABLE = 1 << 1,
+    // peer closed the connection or an error is pending
+    TF_POLLER_HANGUP = 1 << 2
+} tf_poller_flags_t;
+
 /// TCP server listen connection type
 typedef enum {
     TF_TCP_CONNECTION_NEW,
     TF_TCP_CONNECTION_CONTINUE,
-    TF_TCP_CONNECTION_CLOSE
+    TF_TCP_CONNECTION_CLOSE,
+    // the output queue has gone down, see tf_conn_set_wants_drain
+    TF_TCP_CONNECTION_DRAINED,
+    // input went into the splice target, see tf_tcp_set_splice
+    TF_TCP_CONNECTION_SPLICED
 } tf_tcp_connection_type_t;
 
+/// how the TCP server does its I/O, see tf_tcp_set_backend
+typedef enum {
+    // readiness notifications (epoll/select) and a syscall per operation
+    TF_TCP_BACKEND_POLLER,
+    // submissions and completions through io_uring
+    TF_TCP_BACKEND_URING
+} tf_tcp_backend_t;
+
+/// per-connection deadlines, see tf_tcp_set_timeout
+typedef enum {
+    // the request head has to be complete this long after its first byte
+    TF_TCP_TIMEOUT_HEADER,
+    // longest pause while a request body is being received
+    TF_TCP_TIMEOUT_BODY,
+    // longest wait for the next request (or any data for plain TCP)
+    TF_TCP_TIMEOUT_IDLE,
+    // longest time queued output may sit without the client taking any
+    TF_TCP_TIMEOUT_WRITE,
+    // longest time a request may take to be answered off the reactor
+    TF_TCP_TIMEOUT_HANDLER,
+    TF_TCP_TIMEOUT_COUNT
+} tf_tcp_timeout_t;
+
+/// why a connection is closed, see tf_conn_get_close_reason
+typedef enum {
+    // tf_conn_close was called and everything has been sent
+    TF_TCP_CLOSE_DONE,
+    // the client closed its end
+    TF_TCP_CLOSE_PEER,
+    // socket/poller failure or too much input
+    TF_TCP_CLOSE_ERROR,
+    // a deadline passed, same order as tf_tcp_timeout_t
+    TF_TCP_CLOSE_TIMEOUT_HEADER,
+    TF_TCP_CLOSE_TIMEOUT_BODY,
+    TF_TCP_CLOSE_TIMEOUT_IDLE,
+    TF_TCP_CLOSE_TIMEOUT_WRITE,
+    TF_TCP_CLOSE_TIMEOUT_HANDLER,
+    TF_TCP_CLOSE_REASON_COUNT
+} tf_tcp_close_reason_t;
+
 ///
 /// TCP server listen handler callback
 /// Arguments:
@@ -47,7 +154,8 @@ typedef enum {
 /// - connection state/type
 /// - data sent by the client
 /// - data length
-/// - client socket
+/// - client connection (see conn.h)
+/// - index of the worker (reactor thread) that owns the connection
 /// - additional user-specified data that needs to be passed to the call-
 ///   back
 ///
@@ -55,5 +163,6 @@ typedef void (*tf_tcp_callback_t)(tf_tcp_ref,
                                   tf_tcp_connection_type_t,
                                   tf_data_ref const,
                                   const tf_index_t,
-                                  tf_socket_t,
+                                  tf_conn_ref,
+                                  tf_index_t,
                                   tf_data_ref);
@@ -0,0 +1,609 @@
+//
+//  uring.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "privutil.h"
+#include "uring.h"
+
+#ifdef TF_URING
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#ifdef TF_URING
+
+//
+// private
+//
+
+/// the only provided buffer group there is
+#define TF_URING_BUFFER_GROUP 0
+
+struct tf_uring_s {
+    int ring_desc;
+    
+    // submission queue, shared with the kernel
+    void* sq_map;
+    size_t sq_map_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    // prepared up to here, handed to the kernel up to submitted
+    unsigned sq_prepared;
+    unsigned sq_submitted;
+    
+    // completion queue, in the same mapping as the submission queue
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    
+    // provided buffers for receives
+    struct io_uring_buf_ring* buffer_ring;
+    size_t buffer_ring_size;
+    char* buffers;
+    tf_index_t buffer_count;
+    tf_index_t buffer_size;
+    uint16_t buffer_tail;
+};
+
+int tf_uring_setup(const unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int tf_uring_enter(const int ring_desc, const unsigned submit, const unsigned wait,
+                   const unsigned flags, void* arg, const size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring_desc, submit, wait, flags, arg, arg_size);
+}
+
+int tf_uring_register(const int ring_desc, const unsigned opcode, void* arg,
+                      const unsigned count) {
+    return (int)syscall(__NR_io_uring_register, ring_desc, opcode, arg, count);
+}
+
+///
+/// sets up the ring with the cheapest task running mode the kernel has,
+/// disabled until tf_uring_start so it can be bound to another thread
+///
+int tf_uring_create(const tf_index_t entries, struct io_uring_params* params) {
+    // completions are only ever reaped by the thread owning the ring, so
+    // the kernel may hold them back until it asks
+    static const unsigned flags[] = {
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_COOP_TASKRUN,
+        0
+    };
+    
+    for (tf_index_t index = 0; index < sizeof(flags) / sizeof(flags[0]); index++) {
+        bzero(params, sizeof(struct io_uring_params));
+        params->flags = flags[index] | IORING_SETUP_R_DISABLED;
+        
+        int ring_desc = tf_uring_setup((unsigned)entries, params);
+        if (ring_desc >= 0 || errno != EINVAL)
+            return ring_desc;
+    }
+    
+    return -1;
+}
+
+bool tf_uring_map(tf_uring_ref ring, const struct io_uring_params* params) {
+    // the completion queue shares the mapping (IORING_FEAT_SINGLE_MMAP)
+    size_t sq_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    size_t cq_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    
+    ring->sq_map_size = (sq_size > cq_size ? sq_size : cq_size);
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->ring_desc, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        return false;
+    }
+    
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_desc, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return false;
+    }
+    
+    char* base = ring->sq_map;
+    
+    ring->sq_head = (unsigned*)(base + params->sq_off.head);
+    ring->sq_tail = (unsigned*)(base + params->sq_off.tail);
+    ring->sq_mask = *(unsigned*)(base + params->sq_off.ring_mask);
+    ring->sq_entries = params->sq_entries;
+    ring->sq_prepared = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_prepared;
+    
+    // slot i always holds entry i
+    unsigned* array = (unsigned*)(base + params->sq_off.array);
+    for (unsigned index = 0; index < params->sq_entries; index++)
+        array[index] = index;
+    
+    ring->cq_head = (unsigned*)(base + params->cq_off.head);
+    ring->cq_tail = (unsigned*)(base + params->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(base + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(base + params->cq_off.cqes);
+    
+    return true;
+}
+
+bool tf_uring_setup_buffers(tf_uring_ref ring, const tf_index_t count,
+                            const tf_index_t size) {
+    ring->buffer_ring_size = count * sizeof(struct io_uring_buf);
+    ring->buffer_ring = mmap(NULL, ring->buffer_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buffer_ring == MAP_FAILED) {
+        ring->buffer_ring = NULL;
+        return false;
+    }
+    
+    ring->buffers = malloc(count * size);
+    ring->buffer_count = count;
+    ring->buffer_size = size;
+    
+    if (!ring->buffers)
+        return false;
+    
+    struct io_uring_buf_reg registration;
+    bzero(&registration, sizeof(registration));
+    
+    registration.ring_addr = (uint64_t)(uintptr_t)ring->buffer_ring;
+    registration.ring_entries = (uint32_t)count;
+    registration.bgid = TF_URING_BUFFER_GROUP;
+    
+    if (tf_uring_register(ring->ring_desc, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+        return false;
+    
+    for (tf_index_t buffer = 0; buffer < count; buffer++)
+        tf_uring_recycle_buffer(ring, (uint16_t)buffer);
+    
+    return true;
+}
+
+/// next free submission entry, submits what's prepared if there is none
+struct io_uring_sqe* tf_uring_get_sqe(tf_uring_ref ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    
+    if (ring->sq_prepared - head >= ring->sq_entries) {
+        if (!tf_uring_submit_and_wait(ring, 0))
+            return NULL;
+        
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_prepared - head >= ring->sq_entries)
+            return NULL;
+    }
+    
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_prepared & ring->sq_mask];
+    bzero(sqe, sizeof(struct io_uring_sqe));
+    
+    return sqe;
+}
+
+/// makes the prepared entry visible to the kernel
+void tf_uring_push_sqe(tf_uring_ref ring) {
+    ring->sq_prepared++;
+    __atomic_store_n(ring->sq_tail, ring->sq_prepared, __ATOMIC_RELEASE);
+}
+
+/// one-shot poll for the specified events
+bool tf_uring_poll(tf_uring_ref ring, const int descriptor, const uint32_t events,
+                   const uint64_t data) {
+    struct io_uring_sqe* sqe = tf_uring_get_sqe(ring);
+    if (!sqe)
+        return false;
+    
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = descriptor;
+    sqe->poll32_events = events;
+    sqe->user_data = data;
+    
+    tf_uring_push_sqe(ring);
+    return true;
+}
+
+//
+// public
+//
+
+bool tf_uring_is_supported(void) {
+    static int supported = -1;
+    
+    if (supported >= 0)
+        return (supported > 0);
+    
+    tf_uring_ref ring = tf_uring_init(4, 1, 64);
+    bool result = (ring != NULL);
+    
+    if (ring) {
+        struct io_uring_probe* probe = calloc(1, sizeof(struct io_uring_probe) +
+                                              256 * sizeof(struct io_uring_probe_op));
+        static const uint8_t required[] = {
+            IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_POLL_ADD,
+            IORING_OP_ASYNC_CANCEL,
+            // not used, but only kernels with multishot recv (6.0) have it
+            IORING_OP_SEND_ZC
+        };
+        
+        if (tf_uring_register(ring->ring_desc, IORING_REGISTER_PROBE, probe, 256) < 0)
+            result = false;
+        
+        for (tf_index_t index = 0; result && index < sizeof(required); index++)
+            result = (required[index] <= probe->last_op &&
+                      (probe->ops[required[index]].flags & IO_URING_OP_SUPPORTED));
+        
+        free(probe);
+        tf_uring_release(ring);
+    }
+    
+    supported = (result ? 1 : 0);
+    return result;
+}
+
+tf_uring_ref tf_uring_init(const tf_index_t entries,
+                           const tf_index_t buffer_count,
+                           const tf_index_t buffer_size) {
+    if (buffer_count < 1 || buffer_count > 32768 || (buffer_count & (buffer_count - 1)))
+        return NULL;
+    
+    struct io_uring_params params;
+    int ring_desc = tf_uring_create(entries, &params);
+    
+    if (ring_desc < 0) {
+        TF_LOG_DEBUG("io_uring_setup failed, errno = %s", strerror(errno));
+        return NULL;
+    }
+    
+    tf_uring_ref ring = tf_struct_alloc(tf_uring_s);
+    ring->ring_desc = ring_desc;
+    
+    static const uint32_t features = (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                                      IORING_FEAT_EXT_ARG);
+    
+    if ((params.features & features) != features || !tf_uring_map(ring, &params) ||
+        !tf_uring_setup_buffers(ring, buffer_count, buffer_size)) {
+        TF_LOG_DEBUG("io_uring lacks features or buffer rings, errno = %s", strerror(errno));
+        
+        tf_uring_release(ring);
+        return NULL;
+    }
+    
+    return ring;
+}
+
+bool tf_uring_start(tf_uring_ref ring) {
+    return (ring && tf_uring_register(ring->ring_desc, IORING_REGISTER_ENABLE_RINGS,
+                                      NULL, 0) >= 0);
+}
+
+bool tf_uring_reserve(tf_uring_ref ring, const tf_index_t count) {
+    if (count > ring->sq_entries)
+        return false;
+    
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_prepared - head + count <= ring->sq_entries)
+        return true;
+    
+    if (!tf_uring_submit_and_wait(ring, 0))
+        return false;
+    
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return (ring->sq_prepared - head + count <= ring->sq_entries);
+}
+
+bool tf_uring_accept(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    struct io_uring_sqe* sqe = tf_uring_get_sqe(ring);
+    if (!sqe)
+        return false;
+    
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = data;
+    
+    tf_uring_push_sqe(ring);
+    return true;
+}
+
+bool tf_uring_receive(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    struct io_uring_sqe* sqe = tf_uring_get_sqe(ring);
+    if (!sqe)
+        return false;
+    
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = TF_URING_BUFFER_GROUP;
+    sqe->user_data = data;
+    
+    tf_uring_push_sqe(ring);
+    return true;
+}
+
+bool tf_uring_send(tf_uring_ref ring, tf_socket_t socket, const char* buffer,
+                   const tf_index_t length, const bool link, const uint64_t data) {
+    struct io_uring_sqe* sqe = tf_uring_get_sqe(ring);
+    if (!sqe)
+        return false;
+    
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = socket;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    // a short send breaks the link, so the rest never goes out of order
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->flags = (link ? IOSQE_IO_LINK : 0);
+    sqe->user_data = data;
+    
+    tf_uring_push_sqe(ring);
+    return true;
+}
+
+bool tf_uring_poll_writable(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    return tf_uring_poll(ring, socket, POLLOUT, data);
+}
+
+bool tf_uring_poll_readable(tf_uring_ref ring, const int descriptor, const uint64_t data) {
+    return tf_uring_poll(ring, descriptor, POLLIN, data);
+}
+
+bool tf_uring_cancel(tf_uring_ref ring, const uint64_t target, const uint64_t data) {
+    struct io_uring_sqe* sqe = tf_uring_get_sqe(ring);
+    if (!sqe)
+        return false;
+    
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = data;
+    
+    tf_uring_push_sqe(ring);
+    return true;
+}
+
+bool tf_uring_submit_and_wait(tf_uring_ref ring, const int timeout_ms) {
+    unsigned pending = ring->sq_prepared - ring->sq_submitted;
+    unsigned flags = 0;
+    unsigned wait = 0;
+    
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    bzero(&arg, sizeof(arg));
+    
+    if (timeout_ms != 0) {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        wait = 1;
+        
+        arg.sigmask_sz = _NSIG / 8;
+        
+        if (timeout_ms > 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    } else if (pending < 1)
+        return true;
+    else
+        flags = IORING_ENTER_GETEVENTS; // deferred completions are run then
+    
+    int result = tf_uring_enter(ring->ring_desc, pending, wait, flags,
+                                (wait > 0 ? &arg : NULL), (wait > 0 ? sizeof(arg) : 0));
+    
+    // whatever the kernel took, even if waiting failed afterwards
+    ring->sq_submitted = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    
+    // timing out, being interrupted or a full completion queue are no failures
+    return (result >= 0 || errno == ETIME || errno == EINTR || errno == EAGAIN ||
+            errno == EBUSY);
+}
+
+tf_index_t tf_uring_get_completions(tf_uring_ref ring,
+                                    tf_uring_completion_t* completions,
+                                    const tf_index_t max_completions) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    tf_index_t count = 0;
+    
+    for (; head != tail && count < max_completions; head++, count++) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        tf_uring_completion_t* completion = completions + count;
+        
+        completion->data = cqe->user_data;
+        completion->result = cqe->res;
+        completion->flags = 0;
+        completion->buffer = 0;
+        
+        if (cqe->flags & IORING_CQE_F_MORE)
+            completion->flags |= TF_URING_COMPLETION_MORE;
+        
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            completion->flags |= TF_URING_COMPLETION_BUFFER;
+            completion->buffer = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+    }
+    
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+char* tf_uring_get_buffer(const tf_uring_ref ring, const uint16_t buffer) {
+    if (!ring || buffer >= ring->buffer_count)
+        return NULL;
+    
+    return ring->buffers + ((size_t)buffer * ring->buffer_size);
+}
+
+void tf_uring_recycle_buffer(tf_uring_ref ring, const uint16_t buffer) {
+    if (!ring || buffer >= ring->buffer_count)
+        return;
+    
+    struct io_uring_buf* entry = &ring->buffer_ring->bufs[ring->buffer_tail &
+                                                          (ring->buffer_count - 1)];
+    
+    entry->addr = (uint64_t)(uintptr_t)tf_uring_get_buffer(ring, buffer);
+    entry->len = (uint32_t)ring->buffer_size;
+    entry->bid = buffer;
+    
+    ring->buffer_tail++;
+    __atomic_store_n(&ring->buffer_ring->tail, ring->buffer_tail, __ATOMIC_RELEASE);
+}
+
+void tf_uring_release(tf_uring_ref ring) {
+    if (!ring)
+        return;
+    
+    // closing the ring unregisters the buffers and cancels what's left
+    if (ring->ring_desc >= 0)
+        close(ring->ring_desc);
+    
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    
+    if (ring->sq_map)
+        munmap(ring->sq_map, ring->sq_map_size);
+    
+    if (ring->buffer_ring)
+        munmap(ring->buffer_ring, ring->buffer_ring_size);
+    
+    free(ring->buffers);
+    free(ring);
+}
+
+#else
+
+//
+// public
+//
+
+bool tf_uring_is_supported(void) {
+    return false;
+}
+
+tf_uring_ref tf_uring_init(const tf_index_t entries,
+                           const tf_index_t buffer_count,
+                           const tf_index_t buffer_size) {
+    (void)(entries);
+    (void)(buffer_count);
+    (void)(buffer_size);
+    
+    return NULL;
+}
+
+bool tf_uring_start(tf_uring_ref ring) {
+    (void)(ring);
+    
+    return false;
+}
+
+bool tf_uring_reserve(tf_uring_ref ring, const tf_index_t count) {
+    (void)(ring);
+    (void)(count);
+    
+    return false;
+}
+
+bool tf_uring_accept(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    (void)(ring);
+    (void)(socket);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_receive(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    (void)(ring);
+    (void)(socket);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_send(tf_uring_ref ring, tf_socket_t socket, const char* buffer,
+                   const tf_index_t length, const bool link, const uint64_t data) {
+    (void)(ring);
+    (void)(socket);
+    (void)(buffer);
+    (void)(length);
+    (void)(link);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_poll_writable(tf_uring_ref ring, tf_socket_t socket, const uint64_t data) {
+    (void)(ring);
+    (void)(socket);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_poll_readable(tf_uring_ref ring, const int descriptor, const uint64_t data) {
+    (void)(ring);
+    (void)(descriptor);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_cancel(tf_uring_ref ring, const uint64_t target, const uint64_t data) {
+    (void)(ring);
+    (void)(target);
+    (void)(data);
+    
+    return false;
+}
+
+bool tf_uring_submit_and_wait(tf_uring_ref ring, const int timeout_ms) {
+    (void)(ring);
+    (void)(timeout_ms);
+    
+    return false;
+}
+
+tf_index_t tf_uring_get_completions(tf_uring_ref ring,
+                                    tf_uring_completion_t* completions,
+                                    const tf_index_t max_completions) {
+    (void)(ring);
+    (void)(completions);
+    (void)(max_completions);
+    
+    return 0;
+}
+
+char* tf_uring_get_buffer(const tf_uring_ref ring, const uint16_t buffer) {
+    (void)(ring);
+    (void)(buffer);
+    
+    return NULL;
+}
+
+void tf_uring_recycle_buffer(tf_uring_ref ring, const uint16_t buffer) {
+    (void)(ring);
+    (void)(buffer);
+}
+
+void tf_uring_release(tf_uring_ref ring) {
+    (void)(ring);
+}
+
+#endif
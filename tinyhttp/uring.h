@@ -0,0 +1,114 @@
+//
+//  uring.h
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#pragma once
+
+#include "types.h"
+
+//
+// completion-based I/O through io_uring (raw syscalls, no liburing)
+//
+// only what the TCP server needs: multishot accept, multishot receive into
+// a ring of provided buffers, linked sends, readiness polls and
+// cancellation, everything prepared is submitted by the next
+// tf_uring_submit_and_wait, which also waits for completions
+//
+// Linux only, elsewhere or with TF_URING_DISABLE defined at compile time
+// tf_uring_is_supported is always false
+//
+
+#if defined(__linux__) && !defined(TF_URING_DISABLE)
+#define TF_URING 1
+#endif
+
+/// max amount of completions returned by a single tf_uring_get_completions
+#define TF_URING_MAX_COMPLETIONS 256
+
+typedef enum {
+    // the multishot request stays armed, more completions are coming
+    TF_URING_COMPLETION_MORE = 1 << 0,
+    // the data went into the provided buffer tf_uring_completion_t.buffer
+    TF_URING_COMPLETION_BUFFER = 1 << 1
+} tf_uring_completion_flags_t;
+
+/// single completion
+typedef struct {
+    // whatever was passed when the request was prepared
+    uint64_t data;
+    // like the syscall would return it, -errno on failure
+    int32_t result;
+    // combination of tf_uring_completion_flags_t
+    uint8_t flags;
+    uint16_t buffer;
+} tf_uring_completion_t;
+
+///
+/// checks once whether the running kernel has everything used here
+/// (multishot accept/recv, provided buffer rings, waiting with a timeout),
+/// not thread-safe the first time
+///
+bool tf_uring_is_supported(void);
+
+///
+/// creates a ring with room for entries prepared requests and
+/// buffer_count (a power of two) provided buffers of buffer_size bytes
+/// for the receives, NULL if io_uring is not supported
+///
+tf_uring_ref tf_uring_init(const tf_index_t entries,
+                           const tf_index_t buffer_count,
+                           const tf_index_t buffer_size);
+
+///
+/// enables the ring and binds it to the calling thread, the only one
+/// allowed to use it from then on, to be called before preparing anything
+///
+bool tf_uring_start(tf_uring_ref ring);
+
+///
+/// request preparation, every function returns false if there's no room
+/// left even after submitting what's been prepared so far
+///
+
+/// makes sure count requests can be prepared without anything being
+/// submitted in between (which would break a chain of linked ones)
+bool tf_uring_reserve(tf_uring_ref ring, const tf_index_t count);
+
+/// accepts connections until failing or cancelled, result is the socket
+bool tf_uring_accept(tf_uring_ref ring, tf_socket_t socket, const uint64_t data);
+/// receives into provided buffers until EOF, failure, cancellation or
+/// running out of buffers (-ENOBUFS)
+bool tf_uring_receive(tf_uring_ref ring, tf_socket_t socket, const uint64_t data);
+/// sends all of buffer, link makes the next prepared request wait for
+/// this one and get cancelled if this one fails or comes up short, buffer
+/// has to stay around until the completion
+bool tf_uring_send(tf_uring_ref ring, tf_socket_t socket, const char* buffer,
+                   const tf_index_t length, const bool link, const uint64_t data);
+/// completes once the socket is writable
+bool tf_uring_poll_writable(tf_uring_ref ring, tf_socket_t socket, const uint64_t data);
+/// completes once the descriptor is readable
+bool tf_uring_poll_readable(tf_uring_ref ring, const int descriptor, const uint64_t data);
+/// cancels the request prepared with target
+bool tf_uring_cancel(tf_uring_ref ring, const uint64_t target, const uint64_t data);
+
+///
+/// submits everything prepared and waits up to timeout_ms (-1 forever, 0
+/// not at all) for at least one completion, false on failure
+///
+bool tf_uring_submit_and_wait(tf_uring_ref ring, const int timeout_ms);
+
+/// takes up to max_completions completions off the ring
+tf_index_t tf_uring_get_completions(tf_uring_ref ring,
+                                    tf_uring_completion_t* completions,
+                                    const tf_index_t max_completions);
+
+/// contents of a provided buffer, valid until it is recycled
+char* tf_uring_get_buffer(const tf_uring_ref ring, const uint16_t buffer);
+/// hands a provided buffer back to the kernel
+void tf_uring_recycle_buffer(tf_uring_ref ring, const uint16_t buffer);
+
+void tf_uring_release(tf_uring_ref ring);
@@ -0,0 +1,120 @@
+//
+//  header_gen.c
+//  tinyhttp
+//
+//  Created by Tim K. on 18.10.26.
+//  Copyright © 2026 Tim K. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "header.h"
+
+//
+// makes tinyhttp/header_table.h, the perfect hash of the names in
+// header.def: a multiplier that spreads their keys (tf_http_header_get_key)
+// over a table of 2^bits slots without any two of them landing in the same
+// one, the top bits of key * multiplier are the slot
+//
+// the search is deterministic, the same list always gives the same table
+//
+
+#define TF_HEADER_GEN_MIN_BITS 8
+#define TF_HEADER_GEN_MAX_BITS 12
+#define TF_HEADER_GEN_TRIES 10000000
+
+static const char* tf_header_gen_names[TF_HTTP_HEADER_COUNT] = {
+    NULL,
+#define TF_HTTP_HEADER(id, name) name,
+#include "header.def"
+#undef TF_HTTP_HEADER
+};
+
+/// id in every slot, 0 for the empty ones
+static unsigned char tf_header_gen_slots[1 << TF_HEADER_GEN_MAX_BITS];
+
+/// fills tf_header_gen_slots, false if two names share a slot
+int tf_header_gen_try(const unsigned multiplier, const unsigned bits) {
+    memset(tf_header_gen_slots, 0, sizeof(tf_header_gen_slots));
+    
+    for (unsigned id = 1; id < TF_HTTP_HEADER_COUNT; id++) {
+        const char* name = tf_header_gen_names[id];
+        unsigned slot = (tf_http_header_get_key(name, (tf_index_t)strlen(name)) *
+                         multiplier) >> (32 - bits);
+        
+        if (tf_header_gen_slots[slot])
+            return 0;
+        
+        tf_header_gen_slots[slot] = (unsigned char)id;
+    }
+    
+    return 1;
+}
+
+int main(void) {
+    unsigned min_length = 0xffff;
+    unsigned max_length = 0;
+    
+    for (unsigned id = 1; id < TF_HTTP_HEADER_COUNT; id++) {
+        const char* name = tf_header_gen_names[id];
+        unsigned length = (unsigned)strlen(name);
+        
+        // lookups trust the keys to tell the names apart
+        for (unsigned other = 1; other < id; other++) {
+            const char* other_name = tf_header_gen_names[other];
+            
+            if (tf_http_header_get_key(name, length) ==
+                tf_http_header_get_key(other_name, (tf_index_t)strlen(other_name))) {
+                fprintf(stderr, "%s and %s have the same key\n", name, other_name);
+                return 1;
+            }
+        }
+        
+        if (length < 2) {
+            fprintf(stderr, "%s is too short\n", name);
+            return 1;
+        }
+        
+        min_length = (length < min_length ? length : min_length);
+        max_length = (length > max_length ? length : max_length);
+    }
+    
+    for (unsigned bits = TF_HEADER_GEN_MIN_BITS; bits <= TF_HEADER_GEN_MAX_BITS; bits++) {
+        uint32_t multiplier = 2654435761u;
+        
+        for (unsigned attempt = 0; attempt < TF_HEADER_GEN_TRIES; attempt++) {
+            // odd multipliers only, an even one throws away a key bit
+            multiplier = (multiplier * 1664525u + 1013904223u) | 1;
+            
+            if (!tf_header_gen_try(multiplier, bits))
+                continue;
+            
+            printf("//\n"
+                   "//  header_table.h\n"
+                   "//  tinyhttp\n"
+                   "//\n"
+                   "//  Made by tools/header_gen.c from header.def, do not edit.\n"
+                   "//\n"
+                   "\n"
+                   "#pragma once\n"
+                   "\n"
+                   "#define TF_HTTP_HEADER_MIN_LENGTH %u\n"
+                   "#define TF_HTTP_HEADER_MAX_LENGTH %u\n"
+                   "#define TF_HTTP_HEADER_MULTIPLIER %uu\n"
+                   "#define TF_HTTP_HEADER_SHIFT %u\n"
+                   "\n"
+                   "static const uint8_t tf_http_header_slots[%u] = {",
+                   min_length, max_length, multiplier, 32 - bits, 1u << bits);
+            
+            for (unsigned slot = 0; slot < (1u << bits); slot++)
+                printf("%s%u", (slot == 0 ? "\n    " : (slot % 16 == 0 ? ",\n    " : ", ")),
+                       tf_header_gen_slots[slot]);
+            
+            printf("\n};\n");
+            return 0;
+        }
+    }
+    
+    fprintf(stderr, "no perfect hash found\n");
+    return 1;
+}